@@ -22,8 +22,10 @@
 #include "netinfo_priv.h"
 #include "autoip.h"
 #include "appconfig.h"
+#include "ifindex-map.h"
 
 ni_autoip_device_t *	ni_autoip_active;
+static ni_ifindex_map_t	ni_autoip_index;	/* active devices by ifindex */
 
 /*
  * Create and destroy autoip device handles
@@ -49,6 +51,7 @@ ni_autoip_device_new(const char *ifname, const ni_linkinfo_t *link)
 
 	/* append to end of list */
 	*pos = dev;
+	ni_ifindex_map_set(&ni_autoip_index, dev->link.ifindex, dev);
 
 	return dev;
 }
@@ -69,14 +72,7 @@ ni_autoip_device_find(const char *ifname)
 ni_autoip_device_t *
 ni_autoip_device_by_index(unsigned int ifindex)
 {
-	ni_autoip_device_t *dev;
-
-	for (dev = ni_autoip_active; dev; dev = dev->next) {
-		if (dev->link.ifindex == ifindex)
-			return dev;
-	}
-
-	return NULL;
+	return ni_ifindex_map_get(&ni_autoip_index, ifindex);
 }
 
 static void
@@ -144,6 +140,7 @@ ni_autoip_device_free(ni_autoip_device_t *dev)
 
 	ni_string_free(&dev->devinfo.ifname);
 	ni_string_free(&dev->ifname);
+	ni_ifindex_map_remove(&ni_autoip_index, dev->link.ifindex, dev);
 	dev->link.ifindex = 0;
 
 	for (pos = &ni_autoip_active; *pos; pos = &(*pos)->next) {
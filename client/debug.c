@@ -0,0 +1,348 @@
+/*
+ *	wicked client debug actions
+ *
+ *	Copyright (C) 2014 SUSE LINUX Products GmbH, Nuernberg, Germany.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <wicked/netinfo.h>
+#include <wicked/logging.h>
+#include <wicked/wicked.h>
+#include <wicked/dbus.h>
+#include <wicked/dbus-errors.h>
+#include <wicked/objectmodel.h>
+#include <wicked/client.h>
+
+#include "util_priv.h"
+#include "wicked-client.h"
+
+typedef struct ni_debug_bucket {
+	uint32_t		usec;
+	uint32_t		count;
+} ni_debug_bucket_t;
+
+static int
+ni_debug_bucket_cmp(const void *a, const void *b)
+{
+	const ni_debug_bucket_t *x = a, *y = b;
+
+	return x->usec < y->usec ? -1 : x->usec > y->usec;
+}
+
+/*
+ * Compute the given percentiles from a histogram, an array with the
+ * lower bound and count of each non-empty bucket.
+ */
+static void
+ni_debug_dbus_percentiles(const ni_dbus_variant_t *hist, const unsigned int *pct,
+			unsigned long *result, unsigned int npct)
+{
+	ni_debug_bucket_t *buckets;
+	unsigned long total = 0, sum = 0;
+	unsigned int i, n, k;
+
+	memset(result, 0, npct * sizeof(result[0]));
+	if (!hist || !ni_dbus_variant_is_dict_array(hist) || !hist->array.len)
+		return;
+
+	buckets = xcalloc(hist->array.len, sizeof(buckets[0]));
+	for (i = n = 0; i < hist->array.len; ++i) {
+		const ni_dbus_variant_t *bucket = &hist->variant_array_value[i];
+
+		if (!ni_dbus_dict_get_uint32(bucket, "usec", &buckets[n].usec)
+		 || !ni_dbus_dict_get_uint32(bucket, "count", &buckets[n].count))
+			continue;
+		total += buckets[n++].count;
+	}
+	qsort(buckets, n, sizeof(buckets[0]), ni_debug_bucket_cmp);
+
+	for (i = k = 0; i < n && k < npct; ++i) {
+		sum += buckets[i].count;
+		while (k < npct && sum * 100 >= total * pct[k])
+			result[k++] = buckets[i].usec;
+	}
+	free(buckets);
+}
+
+static void
+ni_debug_dbus_stats_print(const ni_dbus_variant_t *stats)
+{
+	static const unsigned int pct[] = { 50, 90, 99 };
+	const ni_dbus_variant_t *calls, *slow_calls;
+	uint32_t threshold = 0;
+	unsigned int i;
+
+	calls = ni_dbus_dict_get(stats, "calls");
+	printf("%-6s %8s %6s %8s %8s %8s %8s %8s  %s\n", "side", "calls", "errors",
+			"avg", "p50", "p90", "p99", "max", "method");
+
+	for (i = 0; calls && ni_dbus_variant_is_dict_array(calls) && i < calls->array.len; ++i) {
+		const ni_dbus_variant_t *call = &calls->variant_array_value[i];
+		const char *side = NULL, *interface = NULL, *method = NULL;
+		uint64_t count = 0, errors = 0, total = 0, max = 0;
+		unsigned long p[3];
+
+		ni_dbus_dict_get_string(call, "side", &side);
+		ni_dbus_dict_get_string(call, "interface", &interface);
+		ni_dbus_dict_get_string(call, "method", &method);
+		ni_dbus_dict_get_uint64(call, "count", &count);
+		ni_dbus_dict_get_uint64(call, "errors", &errors);
+		ni_dbus_dict_get_uint64(call, "total-usec", &total);
+		ni_dbus_dict_get_uint64(call, "max-usec", &max);
+		if (!count)
+			continue;
+
+		ni_debug_dbus_percentiles(ni_dbus_dict_get(call, "histogram"), pct, p, 3);
+		printf("%-6s %8llu %6llu %8llu %8lu %8lu %8lu %8llu  %s.%s\n",
+				side, (unsigned long long) count,
+				(unsigned long long) errors,
+				(unsigned long long) (total / count),
+				p[0], p[1], p[2], (unsigned long long) max,
+				interface, method);
+	}
+
+	slow_calls = ni_dbus_dict_get(stats, "slow-calls");
+	if (!slow_calls || !ni_dbus_variant_is_dict_array(slow_calls) || !slow_calls->array.len)
+		return;
+
+	ni_dbus_dict_get_uint32(stats, "slow-threshold", &threshold);
+	printf("\nCalls slower than %u msec:\n", threshold / 1000);
+	for (i = 0; i < slow_calls->array.len; ++i) {
+		const ni_dbus_variant_t *call = &slow_calls->variant_array_value[i];
+		const char *side = NULL, *interface = NULL, *method = NULL;
+		const char *path = NULL, *error = NULL;
+		uint64_t when = 0, usec = 0;
+		uint32_t size = 0;
+		char timebuf[32];
+		time_t t;
+
+		ni_dbus_dict_get_string(call, "side", &side);
+		ni_dbus_dict_get_string(call, "interface", &interface);
+		ni_dbus_dict_get_string(call, "method", &method);
+		ni_dbus_dict_get_string(call, "path", &path);
+		ni_dbus_dict_get_string(call, "error", &error);
+		ni_dbus_dict_get_uint64(call, "time", &when);
+		ni_dbus_dict_get_uint64(call, "usec", &usec);
+		ni_dbus_dict_get_uint32(call, "size", &size);
+
+		t = when;
+		strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M:%S", localtime(&t));
+		printf("%s %-6s %8llu usec %6u bytes  %s.%s %s%s%s\n",
+				timebuf, side, (unsigned long long) usec, size,
+				interface, method, path ? path : "",
+				error ? " failed: " : "", error ? error : "");
+	}
+}
+
+static int
+ni_debug_dbus_stats(int argc, char **argv)
+{
+	enum { OPT_HELP, OPT_RESET };
+	static struct option options[] = {
+		{ "help",	no_argument,	NULL,	OPT_HELP },
+		{ "reset",	no_argument,	NULL,	OPT_RESET },
+		{ NULL }
+	};
+	ni_dbus_variant_t result = NI_DBUS_VARIANT_INIT;
+	DBusError error = DBUS_ERROR_INIT;
+	ni_dbus_object_t *root_object;
+	ni_bool_t opt_reset = FALSE;
+	int c, rv = NI_WICKED_RC_ERROR;
+
+	optind = 1;
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		case OPT_RESET:
+			opt_reset = TRUE;
+			break;
+
+		case OPT_HELP:
+		default:
+			fprintf(stderr,
+				"wicked [options] debug dbus-stats [--reset]\n"
+				"\nShow the latency of the dbus calls handled by wickedd, in usec.\n"
+				"\nSupported options:\n"
+				"  --help\n"
+				"      Show this help text.\n"
+				"  --reset\n"
+				"      Reset the statistics after showing them.\n"
+				);
+			return NI_WICKED_RC_USAGE;
+		}
+	}
+
+	if (!(root_object = ni_call_create_client()))
+		return rv;
+
+	if (!ni_dbus_object_call_variant(root_object, NI_OBJECTMODEL_DEBUG_INTERFACE,
+				"getDBusStats", 0, NULL, 1, &result, &error)) {
+		ni_dbus_print_error(&error, "unable to get dbus statistics");
+		goto out;
+	}
+	ni_debug_dbus_stats_print(&result);
+
+	if (opt_reset && !ni_dbus_object_call_variant(root_object, NI_OBJECTMODEL_DEBUG_INTERFACE,
+				"resetDBusStats", 0, NULL, 0, NULL, &error)) {
+		ni_dbus_print_error(&error, "unable to reset dbus statistics");
+		goto out;
+	}
+	rv = NI_WICKED_RC_SUCCESS;
+
+out:
+	ni_dbus_variant_destroy(&result);
+	dbus_error_free(&error);
+	return rv;
+}
+
+static void
+ni_debug_txsched_stats_print(const ni_dbus_variant_t *stats)
+{
+	const char *name = NULL;
+	uint32_t window = 0, rate = 0, burst = 0, pending = 0, max_pending = 0;
+	uint64_t queued = 0, sent = 0, limited = 0, forced = 0, cancelled = 0;
+	uint64_t avg_wait = 0, max_wait = 0;
+
+	if (!ni_dbus_dict_get_string(stats, "name", &name))
+		return;
+
+	ni_dbus_dict_get_uint32(stats, "window", &window);
+	ni_dbus_dict_get_uint32(stats, "rate", &rate);
+	ni_dbus_dict_get_uint32(stats, "burst", &burst);
+	ni_dbus_dict_get_uint64(stats, "queued", &queued);
+	ni_dbus_dict_get_uint64(stats, "sent", &sent);
+	ni_dbus_dict_get_uint64(stats, "limited", &limited);
+	ni_dbus_dict_get_uint64(stats, "forced", &forced);
+	ni_dbus_dict_get_uint64(stats, "cancelled", &cancelled);
+	ni_dbus_dict_get_uint32(stats, "pending", &pending);
+	ni_dbus_dict_get_uint32(stats, "max-pending", &max_pending);
+	ni_dbus_dict_get_uint64(stats, "avg-wait", &avg_wait);
+	ni_dbus_dict_get_uint64(stats, "max-wait", &max_wait);
+
+	printf("%s: window %u msec, rate %u/sec, burst %u\n", name, window, rate, burst);
+	printf("  %llu queued, %llu sent (%llu rate limited, %llu at deadline), %llu cancelled\n",
+			(unsigned long long) queued, (unsigned long long) sent,
+			(unsigned long long) limited, (unsigned long long) forced,
+			(unsigned long long) cancelled);
+	printf("  %u pending (max %u), wait avg %llu max %llu msec\n",
+			pending, max_pending, (unsigned long long) avg_wait,
+			(unsigned long long) max_wait);
+}
+
+static int
+ni_debug_txsched_stats(int argc, char **argv)
+{
+	static const char *bus_names[] = {
+		NI_OBJECTMODEL_DBUS_BUS_NAME_DHCP4,
+		NI_OBJECTMODEL_DBUS_BUS_NAME_DHCP6,
+		NULL
+	};
+	enum { OPT_HELP };
+	static struct option options[] = {
+		{ "help",	no_argument,	NULL,	OPT_HELP },
+		{ NULL }
+	};
+	const char **bus_name;
+	int c, rv = NI_WICKED_RC_SUCCESS;
+
+	optind = 1;
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		case OPT_HELP:
+		default:
+			fprintf(stderr,
+				"wicked [options] debug txsched-stats\n"
+				"\nShow the transmit scheduler statistics of the dhcp supplicants.\n"
+				"\nSupported options:\n"
+				"  --help\n"
+				"      Show this help text.\n"
+				);
+			return NI_WICKED_RC_USAGE;
+		}
+	}
+
+	ni_objectmodel_init(NULL);
+	for (bus_name = bus_names; *bus_name; ++bus_name) {
+		ni_dbus_variant_t result = NI_DBUS_VARIANT_INIT;
+		DBusError error = DBUS_ERROR_INIT;
+		ni_dbus_object_t *root_object;
+		ni_dbus_client_t *client;
+		char *path = NULL;
+
+		if (!(client = ni_create_dbus_client(*bus_name))) {
+			rv = NI_WICKED_RC_ERROR;
+			continue;
+		}
+
+		ni_string_printf(&path, "%s/%s", NI_OBJECTMODEL_OBJECT_PATH,
+				strrchr(*bus_name, '.') + 1);
+		root_object = ni_dbus_client_object_new(client, &ni_dbus_anonymous_class,
+				path, NI_OBJECTMODEL_DEBUG_INTERFACE, NULL);
+
+		if (ni_dbus_object_call_variant(root_object, NI_OBJECTMODEL_DEBUG_INTERFACE,
+					"getTxschedStats", 0, NULL, 1, &result, &error)) {
+			ni_debug_txsched_stats_print(&result);
+		} else {
+			ni_dbus_print_error(&error, "unable to get %s statistics", *bus_name);
+			rv = NI_WICKED_RC_ERROR;
+		}
+
+		ni_dbus_variant_destroy(&result);
+		dbus_error_free(&error);
+		ni_dbus_object_free(root_object);
+		ni_dbus_client_free(client);
+		ni_string_free(&path);
+	}
+	return rv;
+}
+
+int
+do_debug(int argc, char **argv)
+{
+	const char *command;
+
+	if (argc < 2) {
+		fprintf(stderr,
+			"wicked [options] debug <subcommand>\n"
+			"\nSupported subcommands:\n"
+			"  dbus-stats [--reset]\n"
+			"  txsched-stats\n"
+			);
+		return NI_WICKED_RC_USAGE;
+	}
+
+	argv++;
+	argc--;
+
+	command = argv[0];
+	if (ni_string_eq(command, "dbus-stats"))
+		return ni_debug_dbus_stats(argc, argv);
+	if (ni_string_eq(command, "txsched-stats"))
+		return ni_debug_txsched_stats(argc, argv);
+
+	ni_error("Unsupported debug subcommand \"%s\"", command);
+	return NI_WICKED_RC_USAGE;
+}
@@ -47,6 +47,95 @@
 #include "ifreload.h"
 #include "ifstatus.h"
 
+/*
+ * Top-level config nodes, which can be re-applied to a running device
+ * in place via its changeDevice, changeProtocol and addrconf methods.
+ * Changes to any other node (name, factory device config like <vlan>
+ * or <bond> and its slaves, ...) require a full ifdown/ifup cycle.
+ */
+static const char *	ni_ifreload_incremental_nodes[] = {
+	"control",
+	"link",
+	"ethernet",
+	"firewall",
+	"lldp",
+	"ipv4",
+	"ipv6",
+	"ipv4:static",
+	"ipv6:static",
+	"ipv4:dhcp",
+	"ipv6:dhcp",
+	"ipv4:auto",
+	NULL
+};
+
+static ni_bool_t
+ni_ifreload_node_is_incremental(const ni_ifworker_t *w, const char *name)
+{
+	const char **ptr;
+
+	/* link config of a port refers to its master */
+	if (ni_string_eq(name, "link") && w->masterdev)
+		return FALSE;
+
+	for (ptr = ni_ifreload_incremental_nodes; *ptr; ++ptr) {
+		if (ni_string_eq(*ptr, name))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/*
+ * Compare the config subtree fingerprints of the worker with these
+ * recorded in the client-state of the device and check if all the
+ * changes can be applied in place. Returns the changed node names.
+ */
+static ni_bool_t
+ni_ifreload_worker_is_incremental(ni_ifworker_t *w, ni_string_array_t *changed)
+{
+	ni_string_array_t removed = NI_STRING_ARRAY_INIT;
+	ni_netdev_t *dev = w->device;
+	ni_client_state_t *cs;
+	ni_bool_t ret = FALSE;
+	unsigned int i;
+
+	ni_string_array_destroy(changed);
+	if (!ni_ifcheck_worker_config_exists(w) || !ni_ifcheck_device_configured(dev))
+		return FALSE;
+
+	if (!ni_ifcheck_device_is_up(dev) || ni_string_eq_nocase(w->control.mode, "off"))
+		return FALSE;
+
+	/* no fingerprints recorded, e.g. by an older version */
+	cs = dev->client_state;
+	if (!cs->config.subtrees.count || !w->config.meta.subtrees.count)
+		return FALSE;
+
+	ni_client_state_subtree_array_diff(&cs->config.subtrees,
+			&w->config.meta.subtrees, changed, &removed);
+
+	for (i = 0; i < removed.count; ++i) {
+		ni_debug_application("%s: config node <%s> removed, reload requires ifdown",
+				w->name, removed.data[i]);
+		goto done;
+	}
+
+	for (i = 0; i < changed->count; ++i) {
+		if (!ni_ifreload_node_is_incremental(w, changed->data[i])) {
+			ni_debug_application("%s: config node <%s> changed, reload requires ifdown",
+					w->name, changed->data[i]);
+			goto done;
+		}
+	}
+	ret = TRUE;
+
+done:
+	ni_string_array_destroy(&removed);
+	if (!ret)
+		ni_string_array_destroy(changed);
+	return ret;
+}
+
 static int
 ni_do_ifreload_direct(int argc, char **argv)
 {
@@ -73,7 +162,9 @@ ni_do_ifreload_direct(int argc, char **argv)
 	ni_string_array_t opt_ifconfig = NI_STRING_ARRAY_INIT;
 	ni_ifworker_array_t up_marked = NI_IFWORKER_ARRAY_INIT;
 	ni_ifworker_array_t down_marked = NI_IFWORKER_ARRAY_INIT;
+	ni_ifworker_array_t incr_marked = NI_IFWORKER_ARRAY_INIT;
 	ni_string_array_t ifnames = NI_STRING_ARRAY_INIT;
+	ni_string_array_t changed = NI_STRING_ARRAY_INIT;
 	ni_ifmatcher_t ifmatch;
 	ni_bool_t check_prio = TRUE;
 	ni_bool_t opt_persistent = FALSE;
@@ -257,6 +348,15 @@ usage:
 		if (opt_persistent)
 			ni_ifworker_control_set_persistent(w, TRUE);
 
+		/* Apply the changes in place when possible */
+		if (ni_ifreload_worker_is_incremental(w, &changed)) {
+			ni_info("%s: applying %u changed config node(s) in place",
+				w->name, changed.count);
+			ni_ifworker_set_incremental_reload(w, &changed);
+			ni_ifworker_array_append(&incr_marked, w);
+			continue;
+		}
+
 		/* Remember all changed devices */
 		if (ni_ifcheck_worker_config_exists(w) &&
 		    !ni_string_eq_nocase(w->control.mode, "off")) {
@@ -295,7 +395,7 @@ usage:
 		}
 	}
 
-	if (0 == nmarked && 0 == up_marked.count) {
+	if (0 == nmarked && 0 == up_marked.count && 0 == incr_marked.count) {
 		ni_note("ifreload: no matching interfaces");
 		status = NI_WICKED_RC_SUCCESS;
 		goto cleanup;
@@ -318,6 +418,20 @@ usage:
 	}
 
 	ni_fsm_pull_in_children(&up_marked);
+
+	/* Devices changed in place and their children are not cycled,
+	 * but walk the up transitions calling changed methods only. */
+	ni_fsm_pull_in_children(&incr_marked);
+	for (i = 0; i < incr_marked.count; ++i) {
+		ni_ifworker_t *w = incr_marked.data[i];
+
+		if (ni_ifworker_array_index(&up_marked, w) >= 0)
+			continue;
+		if (!w->reload.incremental)
+			ni_ifworker_set_incremental_reload(w, NULL);
+		ni_ifworker_array_append(&up_marked, w);
+	}
+
 	/* Drop deleted or apply the up range */
 	ni_fsm_reset_matching_workers(fsm, &up_marked, &up_range, FALSE);
 
@@ -347,8 +461,10 @@ usage:
 
 cleanup:
 	ni_string_array_destroy(&ifnames);
+	ni_string_array_destroy(&changed);
 	ni_string_array_destroy(&opt_ifconfig);
 	ni_ifworker_array_destroy(&down_marked);
+	ni_ifworker_array_destroy(&incr_marked);
 	ni_ifworker_array_destroy(&up_marked);
 	return status;
 }
@@ -380,6 +496,7 @@ ni_do_ifreload_nanny(int argc, char **argv)
 	ni_ifworker_array_t down_marked = NI_IFWORKER_ARRAY_INIT;
 	ni_string_array_t opt_ifconfig = NI_STRING_ARRAY_INIT;
 	ni_string_array_t ifnames = NI_STRING_ARRAY_INIT;
+	ni_string_array_t changed = NI_STRING_ARRAY_INIT;
 	ni_nanny_fsm_monitor_t *monitor = NULL;
 	ni_ifmatcher_t ifmatch;
 	ni_bool_t check_prio = TRUE;
@@ -556,6 +673,16 @@ usage:
 			continue;
 		}
 
+		/* Keep the device up, nanny re-applies the changed policy */
+		if (ni_ifreload_worker_is_incremental(w, &changed)) {
+			ni_info("%s: applying %u changed config node(s) in place",
+				w->name, changed.count);
+			ni_ifworker_array_append(&up_marked, w);
+			ni_ifworker_array_remove(&down_marked, w);
+			--i;
+			continue;
+		}
+
 		/* Remember all changed devices */
 		if (ni_ifcheck_worker_config_exists(w) &&
 		    !ni_string_eq_nocase(w->control.mode, "off")) {
@@ -653,6 +780,7 @@ usage:
 
 cleanup:
 	ni_string_array_destroy(&ifnames);
+	ni_string_array_destroy(&changed);
 	ni_nanny_fsm_monitor_free(monitor);
 	ni_string_array_destroy(&opt_ifconfig);
 	ni_ifworker_array_destroy(&down_marked);
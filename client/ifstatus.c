@@ -51,6 +51,7 @@
 #include "appconfig.h"
 #include "ifcheck.h"
 #include "ifstatus.h"
+#include "netif-snapshot.h"
 
 /*
  * ifstatus code matrix + mapped lsb exit code.
@@ -495,6 +496,46 @@ ni_ifstatus_show_status(const char *ifname, unsigned int status)
 	if_printf(ifname, "", "%s\n", ni_ifstatus_code_name(status));
 }
 
+static void
+ni_ifstatus_show_device(const ni_netdev_t *dev, ni_bool_t verbose)
+{
+	ni_ifstatus_show_iflink (dev, verbose);
+	ni_ifstatus_show_iftype (dev, verbose);
+
+	/* TODO: Hmm... this is the running config only;
+	 *              show current config info too?
+	 */
+	ni_ifstatus_show_control (dev, verbose);
+	ni_ifstatus_show_config (dev, verbose);
+	ni_ifstatus_show_leases (dev, verbose);
+
+	ni_ifstatus_show_addrs  (dev, verbose);
+	ni_ifstatus_show_routes (dev, verbose);
+}
+
+/*
+ * Load the interface state snapshot published by wickedd;
+ * this neither needs dbus nor the schema.
+ */
+static ni_netconfig_t *
+ni_ifstatus_load_snapshot(void)
+{
+	const char *path = ni_global.config ? ni_global.config->netif_snapshot : NULL;
+	ni_netconfig_t *nc;
+
+	if (ni_string_empty(path)) {
+		ni_error("no netif-snapshot file configured");
+		return NULL;
+	}
+
+	nc = ni_netconfig_new();
+	if (ni_netif_snapshot_load(path, nc, NULL) < 0) {
+		ni_netconfig_free(nc);
+		return NULL;
+	}
+	return nc;
+}
+
 static int
 ni_ifstatus_to_retcode(int status, ni_bool_t mandatory)
 {
@@ -515,7 +556,7 @@ int
 ni_do_ifstatus(int argc, char **argv)
 {
 	enum  { OPT_QUIET, OPT_BRIEF, OPT_NORMAL, OPT_VERBOSE,
-		OPT_HELP, OPT_SHOW, OPT_IFCONFIG, OPT_TRANSIENT };
+		OPT_HELP, OPT_SHOW, OPT_IFCONFIG, OPT_TRANSIENT, OPT_SNAPSHOT };
 	static struct option ifcheck_options[] = {
 		{ "help",         no_argument,       NULL, OPT_HELP        },
 		{ "quiet",        no_argument,       NULL, OPT_QUIET       },
@@ -523,6 +564,7 @@ ni_do_ifstatus(int argc, char **argv)
 		{ "verbose",      no_argument,       NULL, OPT_VERBOSE     },
 		{ "ifconfig",     required_argument, NULL, OPT_IFCONFIG    },
 		{ "transient",    no_argument,       NULL, OPT_TRANSIENT },
+		{ "snapshot",     no_argument,       NULL, OPT_SNAPSHOT    },
 
 		{ NULL,           no_argument,       NULL, 0               }
 	};
@@ -535,7 +577,9 @@ ni_do_ifstatus(int argc, char **argv)
 	ni_bool_t         multiple = FALSE;
 	ni_bool_t         all = FALSE;
 	ni_bool_t         opt_transient = FALSE;
+	ni_bool_t         opt_snapshot = FALSE;
 	ni_bool_t         check_config;
+	ni_netconfig_t *  nc = NULL;
 	ni_fsm_t *        fsm;
 	unsigned int      i, nmarked;
 
@@ -570,6 +614,9 @@ ni_do_ifstatus(int argc, char **argv)
 				"      Return exit status only\n"
 				"  --brief\n"
 				"      Show only a brief status, no additional info\n"
+				"  --snapshot\n"
+				"      Show the device state snapshot published by wickedd,\n"
+				"      without interface configurations and dbus calls\n"
 				"\n"
 				"  --ifconfig <filename>\n"
 				"      Read interface configuration(s) from file\n"
@@ -590,6 +637,10 @@ ni_do_ifstatus(int argc, char **argv)
 		case OPT_TRANSIENT:
 			opt_transient = TRUE;
 			break;
+
+		case OPT_SNAPSHOT:
+			opt_snapshot = TRUE;
+			break;
 		}
 	}
 
@@ -601,28 +652,35 @@ ni_do_ifstatus(int argc, char **argv)
 			goto usage;
 	}
 
-	if (!ni_fsm_create_client(fsm)) {
-		/* Severe error we always explicitly return */
-		status = NI_WICKED_ST_ERROR;
-		goto cleanup;
-	}
+	if (opt_snapshot) {
+		if (!(nc = ni_ifstatus_load_snapshot())) {
+			status = NI_WICKED_ST_ERROR;
+			goto cleanup;
+		}
+	} else {
+		if (!ni_fsm_create_client(fsm)) {
+			/* Severe error we always explicitly return */
+			status = NI_WICKED_ST_ERROR;
+			goto cleanup;
+		}
 
-	if (!ni_fsm_refresh_state(fsm)) {
-		/* Severe error we always explicitly return */
-		status = NI_WICKED_ST_ERROR;
-		goto cleanup;
-	}
+		if (!ni_fsm_refresh_state(fsm)) {
+			/* Severe error we always explicitly return */
+			status = NI_WICKED_ST_ERROR;
+			goto cleanup;
+		}
 
-	if (check_config && opt_ifconfig.count == 0) {
-		const ni_string_array_t *sources = ni_config_sources("ifconfig");
+		if (check_config && opt_ifconfig.count == 0) {
+			const ni_string_array_t *sources = ni_config_sources("ifconfig");
 
-		if (sources && sources->count)
-			ni_string_array_copy(&opt_ifconfig, sources);
-	}
+			if (sources && sources->count)
+				ni_string_array_copy(&opt_ifconfig, sources);
+		}
 
-	if (!ni_ifconfig_load(fsm, opt_global_rootdir, &opt_ifconfig, TRUE, TRUE)) {
-		status = NI_WICKED_ST_ERROR;
-		goto cleanup;
+		if (!ni_ifconfig_load(fsm, opt_global_rootdir, &opt_ifconfig, TRUE, TRUE)) {
+			status = NI_WICKED_ST_ERROR;
+			goto cleanup;
+		}
 	}
 
 	status = NI_WICKED_ST_OK;
@@ -642,7 +700,34 @@ ni_do_ifstatus(int argc, char **argv)
 	if (ifnames.count > 1 || all)
 		multiple = TRUE;
 
-	for (i = 0, nmarked = 0; i < fsm->workers.count; ++i) {
+	nmarked = 0;
+	if (nc) {
+		ni_netdev_t *dev;
+
+		/* The snapshot knows devices, but no configs */
+		for (dev = ni_netconfig_devlist(nc); dev; dev = dev->next) {
+			unsigned int st;
+			ni_bool_t mandatory;
+
+			if (!all && ni_string_array_index(&ifnames, dev->name) == -1)
+				continue;
+
+			if (nmarked && opt_verbose > OPT_BRIEF)
+				printf("\n");
+
+			st = ni_ifstatus_of_device(dev, &mandatory);
+			ni_uint_array_append(&stcodes, st);
+			ni_uint_array_append(&stflags, mandatory);
+			nmarked++;
+
+			if (opt_verbose > OPT_QUIET)
+				ni_ifstatus_show_status(dev->name, st);
+
+			if (opt_verbose > OPT_BRIEF)
+				ni_ifstatus_show_device(dev, opt_verbose > OPT_NORMAL);
+		}
+	} else
+	for (i = 0; i < fsm->workers.count; ++i) {
 		ni_ifworker_t *w = fsm->workers.data[i];
 		ni_netdev_t *dev = w->device;
 		unsigned int st = NI_WICKED_ST_NO_DEVICE;
@@ -671,20 +756,8 @@ ni_do_ifstatus(int argc, char **argv)
 		if (opt_verbose <= OPT_BRIEF)
 			continue;
 
-		if (dev) {
-			ni_ifstatus_show_iflink (dev, opt_verbose > OPT_NORMAL);
-			ni_ifstatus_show_iftype (dev, opt_verbose > OPT_NORMAL);
-
-			/* TODO: Hmm... this is the running config only;
-			 *              show current config info too?
-			 */
-			ni_ifstatus_show_control (dev, opt_verbose > OPT_NORMAL);
-			ni_ifstatus_show_config (dev, opt_verbose > OPT_NORMAL);
-			ni_ifstatus_show_leases (dev, opt_verbose > OPT_NORMAL);
-
-			ni_ifstatus_show_addrs  (dev, opt_verbose > OPT_NORMAL);
-			ni_ifstatus_show_routes (dev, opt_verbose > OPT_NORMAL);
-		}
+		if (dev)
+			ni_ifstatus_show_device(dev, opt_verbose > OPT_NORMAL);
 	}
 
 	if (nmarked == 0) {
@@ -720,6 +793,8 @@ ni_do_ifstatus(int argc, char **argv)
 	}
 
 cleanup:
+	if (nc)
+		ni_netconfig_free(nc);
 	ni_uint_array_destroy(&stcodes);
 	ni_uint_array_destroy(&stflags);
 	ni_string_array_destroy(&ifnames);
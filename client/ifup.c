@@ -317,13 +317,15 @@ ni_nanny_fsm_monitor_new(ni_fsm_t *fsm)
 	if (!(fsm->client_root_object = ni_call_create_client()))
 		return NULL;
 
-	if (!(client = ni_dbus_object_get_client(fsm->client_root_object)))
+	/* The progress signals are sent by nanny on the bus; the wickedd
+	 * client may be a direct (peer) connection which never sees them */
+	if (!(client = ni_nanny_create_client(NULL)))
 		return NULL;
 
 	monitor = calloc(1, sizeof(*monitor));
 	if (monitor) {
-		ni_dbus_client_add_signal_handler(client, NULL, NULL,
-				NI_OBJECTMODEL_MANAGED_NETIF_INTERFACE,
+		ni_dbus_client_add_signal_handler_ex(client, NULL, NULL,
+				NI_OBJECTMODEL_MANAGED_NETIF_INTERFACE, "progressInfo",
 				ni_nanny_fsm_monitor_handler, monitor);
 	}
 	return monitor;
@@ -102,6 +102,7 @@ static int		do_show_config(int, char **, const char *);
 extern int		do_nanny(int, char **);
 extern int		do_lease(int, char **);
 extern int		do_check(int, char **);
+extern int		do_debug(int, char **);
 static int		do_xpath(int, char **);
 static int		do_get_names(int, char **);
 static int		do_convert(int, char **);
@@ -179,6 +180,7 @@ main(int argc, char **argv)
 				"  convert     [subcommand]\n"
 				"  xpath       [options] expr ...\n"
 				"  arp         [options] <ifname> <IP>\n"
+				"  debug       [subcommand]\n"
 				);
 			goto done;
 
@@ -257,6 +259,9 @@ main(int argc, char **argv)
 		goto done;
 	}
 
+	/* Only register the object classes and services we encounter */
+	ni_objectmodel_set_lazy_registration(TRUE);
+
 	cmd = argv[optind];
 	if (!strcmp(cmd, "help")) {
 		goto usage;
@@ -308,6 +313,9 @@ main(int argc, char **argv)
 	} else
 	if (!strcmp(cmd, "arp")) {
 		status = ni_do_arp(argc - optind, argv + optind);
+	} else
+	if (!strcmp(cmd, "debug")) {
+		status = do_debug(argc - optind, argv + optind);
 	} else {
 		fprintf(stderr, "Unsupported command %s\n", cmd);
 		goto usage;
@@ -318,56 +326,48 @@ done:
 	return status;
 }
 
-/*
- * Get the dbus object for a list of interfaces.
- */
-static ni_dbus_object_t *
-get_netif_list_object(void)
-{
-	static ni_dbus_object_t *interfaces = NULL;
-
-	if (interfaces == NULL) {
-		if (!(interfaces = ni_call_get_netif_list_object()))
-			return NULL;
-
-		/* Call ObjectManager.GetManagedObjects to get list of objects and their properties */
-		if (!ni_dbus_object_refresh_children(interfaces)) {
-			ni_error("Couldn't get list of active network interfaces");
-			return NULL;
-		}
-	}
-
-	return interfaces;
-}
-
 /*
  * Look up the dbus object for an interface by name.
  * The name can be either a kernel interface device name such as eth0,
  * or a dbus object path such as /org/opensuse/Network/Interfaces/5
+ *
+ * Rather than retrieving all interfaces, we resolve the name and only
+ * fetch the properties of the interface we are interested in.
  */
 static ni_dbus_object_t *
 get_netif_object(const char *ifname)
 {
-	ni_dbus_object_t *list_object, *object;
+	ni_dbus_object_filter_t filter = NI_DBUS_OBJECT_FILTER_INIT;
+	DBusError error = DBUS_ERROR_INIT;
+	ni_dbus_object_t *list_object, *object = NULL;
+	char *path = NULL;
 
-	if (!(list_object = get_netif_list_object()))
+	if (!(list_object = ni_call_get_netif_list_object()))
 		return NULL;
 
-	/* Loop over all interfaces and find the one with matching name */
-	for (object = list_object->children; object; object = object->next) {
-		if (ifname[0] == '/') {
-			if (ni_string_eq(object->path, ifname))
-				return object;
-		} else {
-			ni_netdev_t *dev = ni_objectmodel_unwrap_netif(object, NULL);
+	if (ifname[0] == '/')
+		ni_string_dup(&path, ifname);
+	else if (!(path = ni_call_device_by_name(list_object, ifname)))
+		goto unknown;
 
-			if (dev && dev->name && !strcmp(dev->name, ifname))
-				return object;
-		}
+	ni_string_array_append(&filter.paths, path);
+	if (!ni_dbus_object_get_managed_objects_filtered(list_object, &filter, &error)) {
+		ni_dbus_print_error(&error, "Couldn't get properties of network interface %s", ifname);
+		dbus_error_free(&error);
+		goto out;
+	}
+
+	for (object = list_object->children; object; object = object->next) {
+		if (ni_string_eq(object->path, path))
+			goto out;
 	}
 
+unknown:
 	ni_error("%s: unknown network interface", ifname);
-	return NULL;
+out:
+	ni_string_array_destroy(&filter.paths);
+	ni_string_free(&path);
+	return object;
 }
 
 /* Hack */
@@ -261,6 +261,7 @@ ni_dhcp4_request_new(void)
 
 	/* By default, we try to obtain all sorts of config from the server */
 	req->update = ni_config_addrconf_update_mask(NI_ADDRCONF_DHCP, AF_INET);
+	req->rapid_commit = ni_dhcp4_config_rapid_commit();
 
 	return req;
 }
@@ -324,6 +325,7 @@ static ni_dbus_property_t	dhcp4_request_properties[] = {
 	DHCP4REQ_UINT_PROPERTY(lease-time, lease_time, RO),
 	DHCP4REQ_BOOL_PROPERTY(recover-lease, recover_lease, RO),
 	DHCP4REQ_BOOL_PROPERTY(release-lease, release_lease, RO),
+	DHCP4REQ_BOOL_PROPERTY(rapid-commit, rapid_commit, RO),
 	DHCP4REQ_STRING_PROPERTY(hostname, hostname, RO),
 	DHCP4REQ_STRING_PROPERTY(client-id, clientid, RO),
 	DHCP4REQ_STRING_PROPERTY(vendor-class, vendor_class, RO),
@@ -15,12 +15,15 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stddef.h>
 
 #include <wicked/netinfo.h>
 #include <wicked/logging.h>
 #include <wicked/xml.h>
+#include <wicked/resolver.h>
 #include "netinfo_priv.h"
 #include "appconfig.h"
+#include "ifindex-map.h"
 
 #include "dhcp4/dhcp.h"
 #include "dhcp4/protocol.h"
@@ -30,6 +33,7 @@ static unsigned int	ni_dhcp4_do_bits(unsigned int);
 static const char *	__ni_dhcp4_print_doflags(unsigned int);
 
 ni_dhcp4_device_t *	ni_dhcp4_active;
+static ni_ifindex_map_t	ni_dhcp4_index;		/* active devices by ifindex */
 
 /*
  * Create and destroy dhcp4 device handles
@@ -59,6 +63,7 @@ ni_dhcp4_device_new(const char *ifname, const ni_linkinfo_t *link)
 
 	/* append to end of list */
 	*pos = dev;
+	ni_ifindex_map_set(&ni_dhcp4_index, dev->link.ifindex, dev);
 
 	return dev;
 }
@@ -66,19 +71,14 @@ ni_dhcp4_device_new(const char *ifname, const ni_linkinfo_t *link)
 ni_dhcp4_device_t *
 ni_dhcp4_device_by_index(unsigned int ifindex)
 {
-	ni_dhcp4_device_t *dev;
-
-	for (dev = ni_dhcp4_active; dev; dev = dev->next) {
-		if (dev->system.ifindex == ifindex)
-			return dev;
-	}
-
-	return NULL;
+	return ni_ifindex_map_get(&ni_dhcp4_index, ifindex);
 }
 
 static void
 ni_dhcp4_device_close(ni_dhcp4_device_t *dev)
 {
+	ni_dhcp4_device_unschedule(dev);
+
 	ni_capture_free(dev->capture);
 	dev->capture = NULL;
 
@@ -92,6 +92,7 @@ ni_dhcp4_device_close(ni_dhcp4_device_t *dev)
 		dev->fsm.timer = NULL;
 	}
 
+	ni_dhcp4_device_drop_offers(dev);
 	ni_dhcp4_device_arp_close(dev);
 }
 
@@ -132,7 +133,7 @@ ni_dhcp4_device_free(ni_dhcp4_device_t *dev)
 
 	ni_dhcp4_device_drop_buffer(dev);
 	ni_dhcp4_device_drop_lease(dev);
-	ni_dhcp4_device_drop_best_offer(dev);
+	ni_dhcp4_device_drop_offers(dev);
 	ni_dhcp4_device_close(dev);
 	ni_string_free(&dev->system.ifname);
 	ni_string_free(&dev->ifname);
@@ -141,6 +142,7 @@ ni_dhcp4_device_free(ni_dhcp4_device_t *dev)
 	ni_dhcp4_device_set_config(dev, NULL);
 	ni_dhcp4_device_set_request(dev, NULL);
 
+	ni_ifindex_map_remove(&ni_dhcp4_index, dev->link.ifindex, dev);
 	for (pos = &ni_dhcp4_active; *pos; pos = &(*pos)->next) {
 		if (*pos == dev) {
 			*pos = dev->next;
@@ -205,25 +207,123 @@ ni_dhcp4_device_drop_lease(ni_dhcp4_device_t *dev)
 	}
 }
 
-void
-ni_dhcp4_device_set_best_offer(ni_dhcp4_device_t *dev, ni_addrconf_lease_t *lease,
-							int weight)
-{
-	if (dev->best_offer.lease && dev->best_offer.lease != lease)
-		ni_addrconf_lease_free(dev->best_offer.lease);
-	dev->best_offer.lease = lease;
-	dev->best_offer.weight = weight;
-	if (dev->config && lease)
+/*
+ * Score an offer: the server preference weighs most, then how many of
+ * the options we use it provides, then the lease time in hours.
+ */
+static int
+ni_dhcp4_offer_score(const ni_dhcp4_device_t *dev, const ni_addrconf_lease_t *lease, int weight)
+{
+	unsigned int doflags = dev->config ? dev->config->doflags : DHCP4_DO_DEFAULT;
+	unsigned int hours, options = 0;
+
+	if (lease->dhcp4.netmask.s_addr)
+		options++;
+	if ((doflags & DHCP4_DO_GATEWAY) && lease->routes)
+		options++;
+	if ((doflags & DHCP4_DO_DNS) && lease->resolver) {
+		if (lease->resolver->dns_servers.count)
+			options++;
+		if (lease->resolver->default_domain)
+			options++;
+	}
+	if ((doflags & DHCP4_DO_NTP) && lease->ntp_servers.count)
+		options++;
+	if ((doflags & DHCP4_DO_NIS) && lease->nis)
+		options++;
+	if ((doflags & DHCP4_DO_HOSTNAME) && lease->hostname)
+		options++;
+
+	hours = (lease->dhcp4.lease_time ?: DHCP4_DEFAULT_LEASETIME) / 3600;
+	if (hours > 999)
+		hours = 999;
+
+	return weight * 10000 + options * 1000 + hours;
+}
+
+/*
+ * Add an offer to the list, which keeps the best NI_DHCP4_MAX_OFFERS
+ * of them, ordered by score. A new offer of the same server replaces
+ * the previous one. Takes over the lease; returns NULL when the offer
+ * did not make it into the list.
+ */
+ni_dhcp4_offer_t *
+ni_dhcp4_device_add_offer(ni_dhcp4_device_t *dev, ni_addrconf_lease_t *lease, int weight)
+{
+	ni_dhcp4_offer_t *list = dev->offers.list;
+	unsigned int i, pos;
+	int score;
+
+	if (dev->config)
 		lease->uuid = dev->config->uuid;
+	score = ni_dhcp4_offer_score(dev, lease, weight);
+
+	for (i = 0; i < dev->offers.count; ++i) {
+		if (list[i].lease->dhcp4.server_id.s_addr == lease->dhcp4.server_id.s_addr) {
+			ni_addrconf_lease_free(list[i].lease);
+			memmove(&list[i], &list[i + 1], (dev->offers.count - i - 1) * sizeof(list[0]));
+			dev->offers.count--;
+			break;
+		}
+	}
+
+	for (pos = 0; pos < dev->offers.count; ++pos) {
+		if (list[pos].score < score)
+			break;
+	}
+	if (pos >= NI_DHCP4_MAX_OFFERS) {
+		ni_addrconf_lease_free(lease);
+		return NULL;
+	}
+
+	if (dev->offers.count == NI_DHCP4_MAX_OFFERS)
+		ni_addrconf_lease_free(list[--dev->offers.count].lease);
+	memmove(&list[pos + 1], &list[pos], (dev->offers.count - pos) * sizeof(list[0]));
+	dev->offers.count++;
+
+	memset(&list[pos], 0, sizeof(list[pos]));
+	list[pos].lease = lease;
+	list[pos].weight = weight;
+	list[pos].score = score;
+	return &list[pos];
+}
+
+/*
+ * The best offer with an address not known to be in use
+ */
+ni_dhcp4_offer_t *
+ni_dhcp4_device_best_offer(ni_dhcp4_device_t *dev)
+{
+	unsigned int i;
+
+	for (i = 0; i < dev->offers.count; ++i) {
+		if (!dev->offers.list[i].conflict)
+			return &dev->offers.list[i];
+	}
+	return NULL;
+}
+
+ni_dhcp4_offer_t *
+ni_dhcp4_device_find_offer(ni_dhcp4_device_t *dev, struct in_addr addr)
+{
+	unsigned int i;
+
+	for (i = 0; i < dev->offers.count; ++i) {
+		if (dev->offers.list[i].lease->dhcp4.address.s_addr == addr.s_addr)
+			return &dev->offers.list[i];
+	}
+	return NULL;
 }
 
 void
-ni_dhcp4_device_drop_best_offer(ni_dhcp4_device_t *dev)
+ni_dhcp4_device_drop_offers(ni_dhcp4_device_t *dev)
 {
-	dev->best_offer.weight = -1;
-	if (dev->best_offer.lease)
-		ni_addrconf_lease_free(dev->best_offer.lease);
-	dev->best_offer.lease = NULL;
+	if (dev->offers.timer) {
+		ni_timer_cancel(dev->offers.timer);
+		dev->offers.timer = NULL;
+	}
+	while (dev->offers.count)
+		ni_addrconf_lease_free(dev->offers.list[--dev->offers.count].lease);
 }
 
 /*
@@ -259,6 +359,9 @@ ni_dhcp4_acquire(ni_dhcp4_device_t *dev, const ni_dhcp4_request_t *info)
 	if ((rv = ni_dhcp4_device_refresh(dev)) < 0)
 		return rv;
 
+	/* This request supersedes a scheduled restart */
+	ni_dhcp4_device_unschedule(dev);
+
 	config = xcalloc(1, sizeof(*config));
 	config->dry_run = info->dry_run;
 	config->resend_timeout = NI_DHCP4_RESEND_TIMEOUT_INIT;
@@ -271,6 +374,9 @@ ni_dhcp4_acquire(ni_dhcp4_device_t *dev, const ni_dhcp4_request_t *info)
 	config->start_delay = info->start_delay;
 	config->recover_lease = info->recover_lease;
 	config->release_lease = info->release_lease;
+	/* An offer-only run must not make the server commit a lease */
+	config->rapid_commit = info->dry_run != NI_DHCP4_RUN_OFFER ?
+				info->rapid_commit : FALSE;
 
 	config->max_lease_time = ni_dhcp4_config_max_lease_time();
 	if (config->max_lease_time == 0)
@@ -315,6 +421,7 @@ ni_dhcp4_acquire(ni_dhcp4_device_t *dev, const ni_dhcp4_request_t *info)
 		ni_trace("  update-flags    %s", __ni_dhcp4_print_doflags(config->doflags));
 		ni_trace("  recover_lease   %s", config->recover_lease ? "true" : "false");
 		ni_trace("  release_lease   %s", config->release_lease ? "true" : "false");
+		ni_trace("  rapid_commit    %s", config->rapid_commit ? "true" : "false");
 	}
 
 	ni_dhcp4_device_set_config(dev, config);
@@ -339,6 +446,15 @@ ni_dhcp4_acquire(ni_dhcp4_device_t *dev, const ni_dhcp4_request_t *info)
 	return 1;
 }
 
+static void
+ni_dhcp4_device_restart_job(void *user_data)
+{
+	ni_dhcp4_device_t *dev = user_data;
+
+	if (dev->request)
+		ni_dhcp4_acquire(dev, dev->request);
+}
+
 /*
  * When the supplicant restarts, we reload the state from file, and check
  * for which devices we have existing requests.
@@ -346,6 +462,9 @@ ni_dhcp4_acquire(ni_dhcp4_device_t *dev, const ni_dhcp4_request_t *info)
  * For now, we go through a full discover/request cycle. If this proves
  * a too coarse approach, we should probably store the current leases
  * in the state file as well, and just do a renew/rebind.
+ *
+ * The restarts are spread by the scheduler, so that a supplicant managing
+ * many devices does not send all the discovers at once.
  */
 void
 ni_dhcp4_restart_leases(void)
@@ -354,7 +473,8 @@ ni_dhcp4_restart_leases(void)
 
 	for (dev = ni_dhcp4_active; dev; dev = dev->next) {
 		if (dev->request)
-			ni_dhcp4_acquire(dev, dev->request);
+			ni_dhcp4_device_schedule(dev, "restart",
+					ni_dhcp4_device_restart_job, 0);
 	}
 }
 
@@ -462,6 +582,12 @@ ni_dhcp4_release(ni_dhcp4_device_t *dev, const ni_uuid_t *lease_uuid)
 /*
  * Handle link up/down events
  */
+static void
+ni_dhcp4_device_link_up_job(void *user_data)
+{
+	ni_dhcp4_fsm_link_up(user_data);
+}
+
 void
 ni_dhcp4_device_event(ni_dhcp4_device_t *dev, ni_netdev_t *ifp, ni_event_t event)
 {
@@ -478,12 +604,18 @@ ni_dhcp4_device_event(ni_dhcp4_device_t *dev, ni_netdev_t *ifp, ni_event_t event
 
 	case NI_EVENT_LINK_DOWN:
 		ni_debug_dhcp("%s: link went down", dev->ifname);
+		if (dev->txjob.func == ni_dhcp4_device_link_up_job)
+			ni_dhcp4_device_unschedule(dev);
 		ni_dhcp4_fsm_link_down(dev);
 		break;
 
 	case NI_EVENT_LINK_UP:
 		ni_debug_dhcp("%s: link came up", dev->ifname);
-		ni_dhcp4_fsm_link_up(dev);
+		/* Many links may come up at once, e.g. when a switch reboots */
+		if (dev->fsm.state == NI_DHCP4_STATE_INIT
+		 || dev->fsm.state == NI_DHCP4_STATE_BOUND)
+			ni_dhcp4_device_schedule(dev, "link-up",
+					ni_dhcp4_device_link_up_job, 0);
 		break;
 
 	default: ;
@@ -560,6 +692,9 @@ ni_dhcp4_device_send_message(ni_dhcp4_device_t *dev, unsigned int msg_code, cons
 		ni_error("unable to open capture socket");
 		goto transient_failure;
 	}
+	if (ni_dhcp4_socket_set_filter(dev) < 0)
+		ni_warn("%s: unable to set capture filter for xid 0x%x",
+				dev->ifname, dev->dhcp4.xid);
 
 	ni_debug_dhcp("sending %s with xid 0x%x", ni_dhcp4_message_name(msg_code), dev->dhcp4.xid);
 
@@ -598,7 +733,8 @@ ni_dhcp4_device_send_message(ni_dhcp4_device_t *dev, unsigned int msg_code, cons
 			};
 			rv = sendto(dev->listen_fd, ni_buffer_head(buf), ni_buffer_count(buf), 0, (struct sockaddr *)&sin, sizeof(sin));
 		} else
-			rv = ni_capture_send(dev->capture, buf, &timeout);
+			rv = ni_capture_send_update_secs(dev->capture, buf, &timeout,
+					offsetof(ni_dhcp4_message_t, secs));
 		break;
 
 	default:
@@ -740,3 +876,53 @@ ni_dhcp4_config_max_lease_time(void)
 {
 	return ni_global.config->addrconf.dhcp4.lease_time;
 }
+
+ni_bool_t
+ni_dhcp4_config_shared_capture(void)
+{
+	return ni_global.config->addrconf.dhcp4.shared_capture;
+}
+
+/*
+ * The transmit scheduler of the supplicant
+ */
+ni_txsched_t *
+ni_dhcp4_txsched(void)
+{
+	static ni_txsched_t *sched;
+
+	if (sched == NULL) {
+		const struct ni_config_tx_schedule *conf = &ni_global.config->addrconf.tx_schedule;
+
+		sched = ni_txsched_new("dhcp4", conf->window, conf->rate, conf->burst);
+	}
+	return sched;
+}
+
+/*
+ * Schedule the start of a (re)acquire, renewal or rebind; it is run
+ * at the deadline (in seconds since the epoch, 0 for none) at latest.
+ */
+void
+ni_dhcp4_device_schedule(ni_dhcp4_device_t *dev, const char *what,
+			ni_txsched_func_t *func, time_t deadline)
+{
+	struct timeval tv;
+
+	ni_debug_dhcp("%s: scheduling %s", dev->ifname, what);
+	tv.tv_sec = deadline;
+	tv.tv_usec = 0;
+	ni_txsched_submit(ni_dhcp4_txsched(), &dev->txjob, what, func, dev, &tv);
+}
+
+void
+ni_dhcp4_device_unschedule(ni_dhcp4_device_t *dev)
+{
+	ni_txsched_cancel(&dev->txjob);
+}
+
+ni_bool_t
+ni_dhcp4_config_rapid_commit(void)
+{
+	return ni_global.config->addrconf.dhcp4.rapid_commit;
+}
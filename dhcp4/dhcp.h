@@ -15,6 +15,7 @@
 #include <wicked/socket.h>
 #include "netinfo_priv.h"
 #include "buffer.h"
+#include "txsched.h"
 
 enum {
 	NI_DHCP4_STATE_INIT,
@@ -34,6 +35,22 @@ typedef struct ni_dhcp4_message ni_dhcp4_message_t;
 typedef struct ni_dhcp4_config ni_dhcp4_config_t;
 typedef struct ni_dhcp4_request	ni_dhcp4_request_t;
 
+/*
+ * While selecting, we keep the best offers received and probe their
+ * addresses with ARP, so we can fall back to the next one when the
+ * address of an offer is in use.
+ */
+#define NI_DHCP4_MAX_OFFERS		4
+
+typedef struct ni_dhcp4_offer {
+	ni_addrconf_lease_t *	lease;
+	int			weight;		/* server preference */
+	int			score;
+	unsigned int		nprobes;	/* ARP probes sent */
+	unsigned int		validated : 1,	/* no reply to all probes */
+				conflict : 1;	/* address in use */
+} ni_dhcp4_offer_t;
+
 typedef struct ni_dhcp4_device {
 	struct ni_dhcp4_device *	next;
 	unsigned int		users;
@@ -45,6 +62,7 @@ typedef struct ni_dhcp4_device {
 	    int			state;
 	    const ni_timer_t *	timer;
 	} fsm;
+	ni_txsched_job_t	txjob;		/* scheduled (re)start, renewal, rebind */
 
 	ni_capture_devinfo_t	system;
 
@@ -75,15 +93,17 @@ typedef struct ni_dhcp4_device {
 	} arp;
 
 	struct {
-	   ni_addrconf_lease_t *lease;
-	   int			weight;
-	} best_offer;
+	   ni_dhcp4_offer_t	list[NI_DHCP4_MAX_OFFERS];	/* best first */
+	   unsigned int		count;
+	   const ni_timer_t *	timer;		/* ARP probes of the offers */
+	} offers;
 } ni_dhcp4_device_t;
 
 #define NI_DHCP4_RESEND_TIMEOUT_INIT	3	/* seconds */
 #define NI_DHCP4_RESEND_TIMEOUT_MAX	60	/* seconds */
 #define NI_DHCP4_REQUEST_TIMEOUT		60	/* seconds */
 #define NI_DHCP4_ARP_TIMEOUT		200	/* msec */
+#define NI_DHCP4_ARP_PROBES		3
 
 /* Initial discovery period while we scan all available leases. */
 #define NI_DHCP4_DISCOVERY_TIMEOUT	20	/* seconds */
@@ -146,6 +166,7 @@ struct ni_dhcp4_request {
 
 	ni_bool_t		recover_lease;
 	ni_bool_t		release_lease;
+	ni_bool_t		rapid_commit;	/* RFC 4039 two message exchange */
 
 	/* Options what to update based on the info received from
 	 * the DHCP4 server.
@@ -184,6 +205,7 @@ struct ni_dhcp4_config {
 
 	ni_bool_t		recover_lease;
 	ni_bool_t		release_lease;
+	ni_bool_t		rapid_commit;
 };
 
 enum ni_dhcp4_event {
@@ -217,6 +239,7 @@ extern void		ni_dhcp4_fsm_link_down(ni_dhcp4_device_t *);
 extern int		ni_dhcp4_parse_response(const ni_dhcp4_message_t *, ni_buffer_t *, ni_addrconf_lease_t **);
 
 extern int		ni_dhcp4_socket_open(ni_dhcp4_device_t *);
+extern int		ni_dhcp4_socket_set_filter(ni_dhcp4_device_t *);
 
 extern ni_bool_t	ni_dhcp4_supported(const ni_netdev_t *);
 extern int		ni_dhcp4_device_start(ni_dhcp4_device_t *);
@@ -244,8 +267,14 @@ extern void		ni_dhcp4_device_force_retransmit(ni_dhcp4_device_t *, unsigned int)
 extern void		ni_dhcp4_device_arp_close(ni_dhcp4_device_t *);
 extern void		ni_dhcp4_parse_client_id(ni_opaque_t *, unsigned short, const char *);
 extern void		ni_dhcp4_set_client_id(ni_opaque_t *, const ni_hwaddr_t *);
-extern void		ni_dhcp4_device_set_best_offer(ni_dhcp4_device_t *, ni_addrconf_lease_t *, int);
-extern void		ni_dhcp4_device_drop_best_offer(ni_dhcp4_device_t *);
+extern ni_dhcp4_offer_t *ni_dhcp4_device_add_offer(ni_dhcp4_device_t *, ni_addrconf_lease_t *, int);
+extern ni_dhcp4_offer_t *ni_dhcp4_device_best_offer(ni_dhcp4_device_t *);
+extern ni_dhcp4_offer_t *ni_dhcp4_device_find_offer(ni_dhcp4_device_t *, struct in_addr);
+extern void		ni_dhcp4_device_drop_offers(ni_dhcp4_device_t *);
+extern ni_txsched_t *	ni_dhcp4_txsched(void);
+extern void		ni_dhcp4_device_schedule(ni_dhcp4_device_t *, const char *,
+				ni_txsched_func_t *, time_t);
+extern void		ni_dhcp4_device_unschedule(ni_dhcp4_device_t *);
 
 extern int		ni_dhcp4_xml_from_lease(const ni_addrconf_lease_t *, xml_node_t *);
 extern int		ni_dhcp4_xml_to_lease(ni_addrconf_lease_t *, const xml_node_t *);
@@ -255,6 +284,8 @@ extern int		ni_dhcp4_config_ignore_server(struct in_addr);
 extern int		ni_dhcp4_config_have_server_preference(void);
 extern int		ni_dhcp4_config_server_preference(struct in_addr);
 extern unsigned int	ni_dhcp4_config_max_lease_time(void);
+extern ni_bool_t	ni_dhcp4_config_shared_capture(void);
+extern ni_bool_t	ni_dhcp4_config_rapid_commit(void);
 extern void		ni_dhcp4_config_free(ni_dhcp4_config_t *);
 
 extern ni_dhcp4_request_t *ni_dhcp4_request_new(void);
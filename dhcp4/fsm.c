@@ -46,6 +46,8 @@ static void		ni_dhcp4_fsm_fail_lease(ni_dhcp4_device_t *);
 static int		ni_dhcp4_fsm_validate_lease(ni_dhcp4_device_t *, ni_addrconf_lease_t *);
 static void		ni_dhcp4_send_event(enum ni_dhcp4_event, ni_dhcp4_device_t *, ni_addrconf_lease_t *);
 static void		__ni_dhcp4_fsm_timeout(void *, const ni_timer_t *);
+static void		ni_dhcp4_fsm_select_offer(ni_dhcp4_device_t *);
+static void		ni_dhcp4_fsm_accept_offer(ni_dhcp4_device_t *, ni_dhcp4_offer_t *);
 
 static ni_dhcp4_event_handler_t *ni_dhcp4_fsm_event_handler;
 
@@ -98,7 +100,7 @@ ni_dhcp4_fsm_process_dhcp4_packet(ni_dhcp4_device_t *dev, ni_buffer_t *msgbuf)
 	 * servers to ignore, and preferred servers. */
 	if (msg_code == DHCP4_OFFER && dev->fsm.state == NI_DHCP4_STATE_SELECTING) {
 		struct in_addr srv_addr = lease->dhcp4.server_id;
-		int weight = 0;
+		int weight;
 
 		if (ni_dhcp4_config_ignore_server(srv_addr)) {
 			ni_debug_dhcp("%s: ignoring DHCP4 offer from %s",
@@ -106,65 +108,66 @@ ni_dhcp4_fsm_process_dhcp4_packet(ni_dhcp4_device_t *dev, ni_buffer_t *msgbuf)
 			goto out;
 		}
 
-		/* If we're scanning all offers, we need to decide whether
-		 * this offer is accepted, or whether we want to wait for
-		 * more.
+		/* Check if we have any preferred servers. */
+		weight = ni_dhcp4_config_server_preference(srv_addr);
+
+		/* If we're refreshing an existing lease (eg after link disconnect
+		 * and reconnect), we accept the offer if it comes from the same
+		 * server as the original one.
 		 */
-		if (!dev->dhcp4.accept_any_offer) {
+		if (dev->lease
+		 && dev->lease->dhcp4.server_id.s_addr == srv_addr.s_addr)
+			weight = 100;
 
-			/* Check if we have any preferred servers. */
-			weight = ni_dhcp4_config_server_preference(srv_addr);
+		ni_debug_dhcp("received lease offer from %s; server weight=%d",
+				inet_ntoa(srv_addr), weight);
 
-			/* If we're refreshing an existing lease (eg after link disconnect
-			 * and reconnect), we accept the offer if it comes from the same
-			 * server as the original one.
-			 */
-			if (dev->lease
-			 && dev->lease->dhcp4.server_id.s_addr == srv_addr.s_addr)
-				weight = 100;
+		/* negative weight means never, unless we take any offer. */
+		if (weight < 0) {
+			if (!dev->dhcp4.accept_any_offer)
+				goto out;
+			weight = 0;
+		}
 
-			ni_debug_dhcp("received lease offer from %s; server weight=%d (best offer=%d)",
-					inet_ntoa(lease->dhcp4.server_id), weight,
-					dev->best_offer.weight);
+		/* Keep the offer with the others and decide once we're
+		 * done probing its address.
+		 */
+		ni_dhcp4_device_add_offer(dev, lease, weight);
+		lease = NULL;
 
-			/* negative weight means never. */
-			if (weight < 0)
-				goto out;
+		ni_dhcp4_fsm_select_offer(dev);
+		goto out;
+	}
 
-			/* weight between 0 and 100 means maybe. */
-			if (weight < 100) {
-				if (dev->best_offer.weight < weight) {
-					ni_dhcp4_device_set_best_offer(dev, lease, weight);
-					return 0;
-				}
-				goto out;
-			}
-			/* If the weight has maximum value, just accept this offer. */
+	/* An ACK to our DISCOVER is a rapid commit (RFC 4039) -- accept
+	 * it when we've asked for it, in favour of any offer we've got.
+	 */
+	if (msg_code == DHCP4_ACK && dev->fsm.state == NI_DHCP4_STATE_SELECTING) {
+		struct in_addr srv_addr = lease->dhcp4.server_id;
+
+		if (!dev->config->rapid_commit || !lease->dhcp4.rapid_commit) {
+			ni_debug_dhcp("%s: ignoring DHCP4 ACK without rapid commit from %s",
+					dev->ifname, inet_ntoa(srv_addr));
+			goto out;
 		}
-		ni_dhcp4_device_set_best_offer(dev, lease, weight);
-		lease = NULL;
+		if (ni_dhcp4_config_ignore_server(srv_addr)) {
+			ni_debug_dhcp("%s: ignoring DHCP4 rapid commit ACK from %s",
+					dev->ifname, inet_ntoa(srv_addr));
+			goto out;
+		}
+		ni_dhcp4_device_drop_offers(dev);
 	}
 
 	/* We've received a valid response; if something goes wrong now
 	 * it's nothing that could be fixed by retransmitting the message.
 	 *
-	 * The only exception would be if we ever do some filtering or
-	 * matching of OFFERs - then we would certainly want to keep
-	 * waiting for additional packets.
+	 * OFFERs are collected above, so we keep waiting for more of them.
 	 */
 	ni_dhcp4_device_disarm_retransmit(dev);
 	dev->dhcp4.xid = 0;
 
 	/* move to next stage of protocol */
 	switch (msg_code) {
-	case DHCP4_OFFER:
-		if (dev->fsm.state != NI_DHCP4_STATE_SELECTING)
-			goto ignore;
-
-		/* process best offer set above */
-		ni_dhcp4_process_offer(dev, dev->best_offer.lease);
-		break;
-
 	case DHCP4_ACK:
 		if (dev->fsm.state == NI_DHCP4_STATE_INIT) {
 			/*
@@ -176,6 +179,7 @@ ni_dhcp4_fsm_process_dhcp4_packet(ni_dhcp4_device_t *dev, ni_buffer_t *msgbuf)
 		}
 
 		if (dev->fsm.state != NI_DHCP4_STATE_REQUESTING
+		 && dev->fsm.state != NI_DHCP4_STATE_SELECTING
 		 && dev->fsm.state != NI_DHCP4_STATE_RENEWING
 		 && dev->fsm.state != NI_DHCP4_STATE_REBOOT
 		 && dev->fsm.state != NI_DHCP4_STATE_REBINDING)
@@ -221,6 +225,7 @@ ni_dhcp4_fsm_restart(ni_dhcp4_device_t *dev)
 {
 	dev->fsm.state = NI_DHCP4_STATE_INIT;
 
+	ni_dhcp4_device_unschedule(dev);
 	ni_dhcp4_device_disarm_retransmit(dev);
 	if (dev->fsm.timer) {
 		ni_timer_cancel(dev->fsm.timer);
@@ -228,6 +233,7 @@ ni_dhcp4_fsm_restart(ni_dhcp4_device_t *dev)
 	}
 	dev->dhcp4.xid = 0;
 
+	ni_dhcp4_device_drop_offers(dev);
 	ni_dhcp4_device_drop_lease(dev);
 }
 
@@ -292,7 +298,7 @@ __ni_dhcp4_fsm_discover(ni_dhcp4_device_t *dev, int scan_offers)
 		ni_dhcp4_fsm_set_timeout(dev, dev->config->request_timeout);
 	}
 
-	ni_dhcp4_device_drop_best_offer(dev);
+	ni_dhcp4_device_drop_offers(dev);
 
 	if (lease != dev->lease)
 		ni_addrconf_lease_free(lease);
@@ -323,6 +329,28 @@ ni_dhcp4_fsm_request(ni_dhcp4_device_t *dev, const ni_addrconf_lease_t *lease)
 	return rv;
 }
 
+/*
+ * Renewal and rebind are started by the scheduler; the state may have
+ * changed meanwhile.
+ */
+static void
+ni_dhcp4_fsm_renewal_job(void *user_data)
+{
+	ni_dhcp4_device_t *dev = user_data;
+
+	if (dev->fsm.state == NI_DHCP4_STATE_BOUND && dev->lease)
+		ni_dhcp4_fsm_renewal(dev);
+}
+
+static void
+ni_dhcp4_fsm_rebind_job(void *user_data)
+{
+	ni_dhcp4_device_t *dev = user_data;
+
+	if (dev->fsm.state == NI_DHCP4_STATE_RENEWING && dev->lease)
+		ni_dhcp4_fsm_rebind(dev);
+}
+
 int
 ni_dhcp4_fsm_renewal(ni_dhcp4_device_t *dev)
 {
@@ -432,17 +460,14 @@ ni_dhcp4_fsm_timeout(ni_dhcp4_device_t *dev)
 	case NI_DHCP4_STATE_SELECTING:
 		if (!dev->dhcp4.accept_any_offer) {
 			ni_dhcp4_config_t *conf = dev->config;
+			ni_dhcp4_offer_t *offer;
 
 			/* We were scanning all offers to check for a best offer.
 			 * There was no perfect match, but we may have a "good enough"
-			 * match. Check for it. */
-			if (dev->best_offer.lease) {
-				ni_addrconf_lease_t *lease = dev->best_offer.lease;
-
-				ni_debug_dhcp("accepting lease offer from %s; server weight=%d",
-						inet_ntoa(lease->dhcp4.server_id),
-						dev->best_offer.weight);
-				ni_dhcp4_process_offer(dev, lease);
+			 * match, even if we're not done probing its address yet.
+			 * Check for it. */
+			if ((offer = ni_dhcp4_device_best_offer(dev)) != NULL) {
+				ni_dhcp4_fsm_accept_offer(dev, offer);
 				return;
 			}
 
@@ -472,12 +497,14 @@ ni_dhcp4_fsm_timeout(ni_dhcp4_device_t *dev)
 		break;
 
 	case NI_DHCP4_STATE_BOUND:
-		ni_dhcp4_fsm_renewal(dev);
+		ni_dhcp4_device_schedule(dev, "renewal", ni_dhcp4_fsm_renewal_job,
+				dev->lease->time_acquired + dev->lease->dhcp4.rebind_time);
 		break;
 
 	case NI_DHCP4_STATE_RENEWING:
 		ni_error("unable to renew lease within renewal period; trying to rebind");
-		ni_dhcp4_fsm_rebind(dev);
+		ni_dhcp4_device_schedule(dev, "rebind", ni_dhcp4_fsm_rebind_job,
+				dev->lease->time_acquired + dev->lease->dhcp4.lease_time);
 		break;
 
 	case NI_DHCP4_STATE_REBINDING:
@@ -597,9 +624,115 @@ ni_dhcp4_process_offer(ni_dhcp4_device_t *dev, ni_addrconf_lease_t *lease)
 	return 0;
 }
 
+/*
+ * Send the next ARP probe for the addresses of the offers we're still
+ * validating; an offer without reply to all of them is validated.
+ * Returns TRUE while there are probes pending.
+ */
+static ni_bool_t
+ni_dhcp4_fsm_probe_offers(ni_dhcp4_device_t *dev)
+{
+	struct in_addr null = { 0 };
+	ni_dhcp4_offer_t *offer;
+	ni_bool_t pending = FALSE;
+	unsigned int i;
+
+	if (dev->arp.handle == NULL) {
+		dev->arp.handle = ni_arp_socket_open(&dev->system,
+				ni_dhcp4_fsm_process_arp_packet, dev);
+		if (dev->arp.handle == NULL)
+			ni_error("%s: unable to create ARP handle", dev->ifname);
+	}
+
+	for (i = 0; i < dev->offers.count; ++i) {
+		offer = &dev->offers.list[i];
+		if (offer->validated || offer->conflict)
+			continue;
+
+		/* When we cannot probe, take the offer as it is */
+		if (dev->arp.handle && offer->nprobes < NI_DHCP4_ARP_PROBES) {
+			ni_debug_dhcp("%s: arp validate: probing for offered %s",
+					dev->ifname, inet_ntoa(offer->lease->dhcp4.address));
+			ni_arp_send_request(dev->arp.handle, null, offer->lease->dhcp4.address);
+			offer->nprobes++;
+			pending = TRUE;
+		} else {
+			offer->validated = 1;
+		}
+	}
+	return pending;
+}
+
+static void
+__ni_dhcp4_fsm_probe_timeout(void *user_data, const ni_timer_t *timer)
+{
+	ni_dhcp4_device_t *dev = user_data;
+
+	if (dev->offers.timer != timer) {
+		ni_warn("%s: bad timer handle", __func__);
+		return;
+	}
+	dev->offers.timer = NULL;
+
+	if (dev->fsm.state == NI_DHCP4_STATE_SELECTING)
+		ni_dhcp4_fsm_select_offer(dev);
+}
+
+/*
+ * Called whenever the offers change: probe the addresses of new offers,
+ * and accept the best offer once it is validated -- when we take any
+ * offer, or the server is one we prefer. Otherwise, we wait for better
+ * offers until the discovery times out.
+ */
+static void
+ni_dhcp4_fsm_select_offer(ni_dhcp4_device_t *dev)
+{
+	ni_dhcp4_offer_t *offer;
+
+	if (dev->config->doflags & DHCP4_DO_ARP) {
+		if (dev->offers.timer == NULL && ni_dhcp4_fsm_probe_offers(dev)) {
+			dev->offers.timer = ni_timer_register(NI_DHCP4_ARP_TIMEOUT,
+					__ni_dhcp4_fsm_probe_timeout, dev);
+		}
+	}
+
+	if (!(offer = ni_dhcp4_device_best_offer(dev)))
+		return;
+
+	if (!dev->dhcp4.accept_any_offer && offer->weight < 100)
+		return;
+
+	if ((dev->config->doflags & DHCP4_DO_ARP) && !offer->validated)
+		return;
+
+	ni_dhcp4_fsm_accept_offer(dev, offer);
+}
+
+static void
+ni_dhcp4_fsm_accept_offer(ni_dhcp4_device_t *dev, ni_dhcp4_offer_t *offer)
+{
+	ni_debug_dhcp("accepting lease offer from %s; server weight=%d, score=%d",
+			inet_ntoa(offer->lease->dhcp4.server_id),
+			offer->weight, offer->score);
+
+	if (dev->offers.timer) {
+		ni_timer_cancel(dev->offers.timer);
+		dev->offers.timer = NULL;
+	}
+	ni_dhcp4_device_arp_close(dev);
+
+	ni_dhcp4_device_disarm_retransmit(dev);
+	dev->dhcp4.xid = 0;
+
+	ni_dhcp4_process_offer(dev, offer->lease);
+}
+
 static int
 ni_dhcp4_process_ack(ni_dhcp4_device_t *dev, ni_addrconf_lease_t *lease)
 {
+	ni_dhcp4_offer_t *offer;
+	ni_bool_t validated;
+
 	if (lease->dhcp4.lease_time == 0) {
 		lease->dhcp4.lease_time = DHCP4_DEFAULT_LEASETIME;
 		ni_debug_dhcp("server supplied no lease time, assuming %u seconds",
@@ -630,6 +763,18 @@ ni_dhcp4_process_ack(ni_dhcp4_device_t *dev, ni_addrconf_lease_t *lease)
 	/* set lease to validate and commit or decline */
 	ni_dhcp4_device_set_lease(dev, lease);
 
+	/* We may have probed the address while selecting already */
+	offer = ni_dhcp4_device_find_offer(dev, lease->dhcp4.address);
+	validated = dev->fsm.state == NI_DHCP4_STATE_REQUESTING
+		 && offer && offer->validated && !offer->conflict;
+	ni_dhcp4_device_drop_offers(dev);
+
+	if ((dev->config->doflags & DHCP4_DO_ARP) && validated) {
+		ni_debug_dhcp("%s: address %s validated while selecting",
+				dev->ifname, inet_ntoa(lease->dhcp4.address));
+		ni_dhcp4_device_arp_close(dev);
+		ni_dhcp4_fsm_commit_lease(dev, lease);
+	} else
 	if (dev->config->doflags & DHCP4_DO_ARP) {
 		/*
 		 * When we cannot init validate [arp], commit it.
@@ -881,7 +1026,7 @@ ni_dhcp4_fsm_validate_lease(ni_dhcp4_device_t *dev, ni_addrconf_lease_t *lease)
 	 * of 200ms each.
 	 * The "claims" part is really for IPv4LL
 	 */
-	dev->arp.nprobes = 3;
+	dev->arp.nprobes = NI_DHCP4_ARP_PROBES;
 	dev->arp.nclaims = 0;
 
 	/* dhcp4cd source code says:
@@ -941,27 +1086,25 @@ ni_dhcp4_fsm_arp_validate(ni_dhcp4_device_t *dev)
 	return 0;
 }
 
-void
-ni_dhcp4_fsm_process_arp_packet(ni_arp_socket_t *arph, const ni_arp_packet_t *pkt, void *user_data)
+/*
+ * Check whether an ARP reply comes from ourselves: from the interface
+ * itself, or from another interface of this host, which answers when
+ * connected to the same broadcast domain, except when it really has
+ * the address assigned.
+ */
+static ni_bool_t
+ni_dhcp4_fsm_arp_reply_is_own(ni_dhcp4_device_t *dev, const ni_arp_packet_t *pkt)
 {
-	ni_dhcp4_device_t *dev = user_data;
 	ni_netconfig_t *nc = ni_global_state_handle(0);
 	const ni_netdev_t *ifp;
 	ni_bool_t false_alarm = FALSE;
 	ni_bool_t found_addr = FALSE;
 
-	if (!pkt || pkt->op != ARPOP_REPLY || !dev || !dev->lease)
-		return;
-
-	/* Is it about the address we're validating at all? */
-	if (pkt->sip.s_addr != dev->lease->dhcp4.address.s_addr)
-		return;
-
 	/* Ignore any ARP replies that seem to come from our own
 	 * MAC address. Some helpful switches seem to generate
 	 * these. */
 	if (ni_link_address_equal(&dev->system.hwaddr, &pkt->sha))
-		return;
+		return TRUE;
 
 	/* As well as ARP replies that seem to come from our own
 	 * host: dup if same address, not a dup if there are two
@@ -986,7 +1129,42 @@ ni_dhcp4_fsm_process_arp_packet(ni_arp_socket_t *arph, const ni_arp_packet_t *pk
 		if (__ni_dhcp4_address_on_device(ifp, pkt->sip))
 			found_addr = TRUE;
 	}
-	if (false_alarm && !found_addr)
+	return false_alarm && !found_addr;
+}
+
+void
+ni_dhcp4_fsm_process_arp_packet(ni_arp_socket_t *arph, const ni_arp_packet_t *pkt, void *user_data)
+{
+	ni_dhcp4_device_t *dev = user_data;
+	ni_dhcp4_offer_t *offer;
+
+	if (!pkt || pkt->op != ARPOP_REPLY || !dev)
+		return;
+
+	/* While selecting, skip offers of addresses in use and fall
+	 * back to the next best one right away.
+	 */
+	if (dev->fsm.state == NI_DHCP4_STATE_SELECTING) {
+		offer = ni_dhcp4_device_find_offer(dev, pkt->sip);
+		if (!offer || offer->conflict || ni_dhcp4_fsm_arp_reply_is_own(dev, pkt))
+			return;
+
+		ni_info("%s: offered address %s already in use by %s",
+				dev->ifname, inet_ntoa(pkt->sip),
+				ni_link_address_print(&pkt->sha));
+		offer->conflict = 1;
+		ni_dhcp4_fsm_select_offer(dev);
+		return;
+	}
+
+	if (!dev->lease)
+		return;
+
+	/* Is it about the address we're validating at all? */
+	if (pkt->sip.s_addr != dev->lease->dhcp4.address.s_addr)
+		return;
+
+	if (ni_dhcp4_fsm_arp_reply_is_own(dev, pkt))
 		return;
 
 	ni_debug_dhcp("%s: address %s already in use by %s",
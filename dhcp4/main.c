@@ -344,6 +344,34 @@ static ni_dbus_service_t	__ni_objectmodel_dhcp4_interface = {
 	.name		= NI_OBJECTMODEL_DHCP4_INTERFACE,
 };
 
+/*
+ * The debug interface of the root object, exporting the statistics
+ * of the transmit scheduler.
+ */
+static dbus_bool_t
+__ni_objectmodel_dhcp4_get_txsched_stats(ni_dbus_object_t *object, const ni_dbus_method_t *method,
+			unsigned int argc, const ni_dbus_variant_t *argv,
+			ni_dbus_message_t *reply, DBusError *error)
+{
+	ni_dbus_variant_t result = NI_DBUS_VARIANT_INIT;
+	dbus_bool_t rv;
+
+	rv = ni_txsched_get_stats_dict(ni_dhcp4_txsched(), &result)
+	  && ni_dbus_message_serialize_variants(reply, 1, &result, error);
+	ni_dbus_variant_destroy(&result);
+	return rv;
+}
+
+static ni_dbus_method_t		__ni_objectmodel_dhcp4_debug_methods[] = {
+	{ "getTxschedStats",	"",		__ni_objectmodel_dhcp4_get_txsched_stats },
+	{ NULL }
+};
+
+static ni_dbus_service_t	__ni_objectmodel_dhcp4_debug_interface = {
+	.name		= NI_OBJECTMODEL_DEBUG_INTERFACE,
+	.methods	= __ni_objectmodel_dhcp4_debug_methods,
+};
+
 
 void
 dhcp4_register_services(ni_dbus_server_t *server)
@@ -353,6 +381,7 @@ dhcp4_register_services(ni_dbus_server_t *server)
 
 	/* Register the root object /org/opensuse/Network/DHCP4 */
 	ni_dbus_object_register_service(root_object, &__ni_objectmodel_dhcp4_interface);
+	ni_dbus_object_register_service(root_object, &__ni_objectmodel_dhcp4_debug_interface);
 
 	/* Register /org/opensuse/Network/DHCP4/Interface */
 	object = ni_dbus_server_register_object(server, "Interface", &ni_dbus_anonymous_class, NULL);
@@ -0,0 +1,1313 @@
+/*
+ * Decode the options of DHCP4 responses into a lease
+ *
+ * Copyright (C) 2010-2012, Olaf Kirch <okir@suse.de>
+ *
+ * The options are described by a table, giving their type, length,
+ * how repeated instances are handled and the lease field they are
+ * stored in. A response is scanned once to find the options in the
+ * options field and, when overloaded, the file and sname fields;
+ * each option is then decoded from its (possibly concatenated, as
+ * per RFC 3396) data.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <wicked/netinfo.h>
+#include <wicked/route.h>
+#include <wicked/logging.h>
+#include <wicked/resolver.h>
+#include <wicked/nis.h>
+#include "dhcp4/dhcp.h"
+#include "dhcp4/protocol.h"
+#include "buffer.h"
+#include "util_priv.h"
+
+/*
+ * Scratch memory used while parsing a single response: the data of
+ * options split into several instances and NUL terminated copies of
+ * strings while they are checked. Only what ends up in the lease is
+ * duplicated; everything else is released at once.
+ */
+#define NI_DHCP4_ARENA_SIZE		2048
+
+typedef struct ni_dhcp4_arena_chunk	ni_dhcp4_arena_chunk_t;
+
+struct ni_dhcp4_arena_chunk {
+	ni_dhcp4_arena_chunk_t *	next;
+	unsigned char			data[];
+};
+
+typedef struct ni_dhcp4_arena {
+	unsigned char *			base;
+	size_t				size;
+	size_t				used;
+	ni_dhcp4_arena_chunk_t *	chunks;
+	unsigned char			local[NI_DHCP4_ARENA_SIZE];
+} ni_dhcp4_arena_t;
+
+/*
+ * The instances of an option, in the order they were found.
+ */
+typedef struct ni_dhcp4_option_seg	ni_dhcp4_option_seg_t;
+
+struct ni_dhcp4_option_seg {
+	ni_dhcp4_option_seg_t *	next;
+	const unsigned char *	data;
+	unsigned int		len;
+};
+
+typedef struct ni_dhcp4_option_slot {
+	unsigned int		code;
+	unsigned int		count;
+	unsigned int		len;
+	ni_dhcp4_option_seg_t *	head;
+	ni_dhcp4_option_seg_t *	tail;
+} ni_dhcp4_option_slot_t;
+
+/*
+ * Parser state; holds the options found in a response and the data
+ * which is collected before it is moved into the lease.
+ */
+typedef struct ni_dhcp4_option_state {
+	ni_addrconf_lease_t *	lease;
+	ni_dhcp4_arena_t	arena;
+
+	unsigned char		index[256];	/* option code -> slot + 1 */
+	unsigned int		nslots;
+	ni_dhcp4_option_slot_t	slots[254];
+
+	unsigned int		overload;
+	uint8_t			msg_type;
+	ni_route_array_t	default_routes;
+	ni_route_array_t	static_routes;
+	ni_route_array_t	classless_routes;
+	ni_string_array_t	dns_servers;
+	ni_string_array_t	dns_search;
+	ni_string_array_t	dns_domain;
+	ni_string_array_t	nis_servers;
+	char *			nisdomain;
+} ni_dhcp4_option_state_t;
+
+typedef enum ni_dhcp4_option_type {
+	NI_DHCP4_OPTION_UNSUPPORTED = 0,
+	NI_DHCP4_OPTION_IGNORE,
+	NI_DHCP4_OPTION_FLAG,
+	NI_DHCP4_OPTION_UINT8,
+	NI_DHCP4_OPTION_UINT16,
+	NI_DHCP4_OPTION_UINT32,
+	NI_DHCP4_OPTION_IPV4,
+	NI_DHCP4_OPTION_IPV4_LIST,
+	NI_DHCP4_OPTION_DOMAIN,
+	NI_DHCP4_OPTION_DOMAIN_LIST,
+	NI_DHCP4_OPTION_DNS_SEARCH,
+	NI_DHCP4_OPTION_PATHNAME,
+	NI_DHCP4_OPTION_PRINTABLE,
+	NI_DHCP4_OPTION_PRINTABLE_LIST,
+	NI_DHCP4_OPTION_NETBIOS_TYPE,
+	NI_DHCP4_OPTION_SIP_SERVERS,
+	NI_DHCP4_OPTION_ROUTERS,
+	NI_DHCP4_OPTION_STATIC_ROUTES,
+	NI_DHCP4_OPTION_CSR,
+} ni_dhcp4_option_type_t;
+
+/*
+ * How an option sent more than once is handled: fixed size values
+ * use the last instance, other options are concatenated (RFC 3396)
+ * or, when each instance is a list element, decoded one by one.
+ */
+typedef enum ni_dhcp4_option_repeat {
+	NI_DHCP4_OPTION_LAST = 0,
+	NI_DHCP4_OPTION_CONCAT,
+	NI_DHCP4_OPTION_EACH,
+} ni_dhcp4_option_repeat_t;
+
+typedef struct ni_dhcp4_option_target {
+	ni_bool_t		lease;
+	size_t			offset;
+} ni_dhcp4_option_target_t;
+
+typedef struct ni_dhcp4_option_desc {
+	ni_dhcp4_option_type_t	type;
+	ni_dhcp4_option_repeat_t repeat;
+	unsigned int		min_len;
+	unsigned int		max_len;	/* 0: no limit */
+	ni_dhcp4_option_target_t target;
+	const char *		what;
+} ni_dhcp4_option_desc_t;
+
+#define NI_DHCP4_LEASE(field)	{ TRUE,  offsetof(ni_addrconf_lease_t, field) }
+#define NI_DHCP4_STATE(field)	{ FALSE, offsetof(ni_dhcp4_option_state_t, field) }
+
+static void
+ni_dhcp4_arena_init(ni_dhcp4_arena_t *arena)
+{
+	arena->base = arena->local;
+	arena->size = sizeof(arena->local);
+	arena->used = 0;
+	arena->chunks = NULL;
+}
+
+static void *
+ni_dhcp4_arena_alloc(ni_dhcp4_arena_t *arena, size_t len)
+{
+	ni_dhcp4_arena_chunk_t *chunk;
+	void *ptr;
+
+	len = (len + 7) & ~(size_t)7;
+	if (arena->size - arena->used < len) {
+		size_t size = len > NI_DHCP4_ARENA_SIZE ? len : NI_DHCP4_ARENA_SIZE;
+
+		chunk = xmalloc(sizeof(*chunk) + size);
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+		arena->base = chunk->data;
+		arena->size = size;
+		arena->used = 0;
+	}
+	ptr = arena->base + arena->used;
+	arena->used += len;
+	return ptr;
+}
+
+static void
+ni_dhcp4_arena_destroy(ni_dhcp4_arena_t *arena)
+{
+	ni_dhcp4_arena_chunk_t *chunk;
+
+	while ((chunk = arena->chunks) != NULL) {
+		arena->chunks = chunk->next;
+		free(chunk);
+	}
+	ni_dhcp4_arena_init(arena);
+}
+
+static int
+ni_dhcp4_option_get_sockaddr(ni_buffer_t *bp, ni_sockaddr_t *addr)
+{
+	struct sockaddr_in *sin = &addr->sin;
+
+	memset(sin, 0, sizeof(*addr));
+	sin->sin_family = AF_INET;
+	return ni_buffer_get(bp, &sin->sin_addr, 4);
+}
+
+static int
+ni_dhcp4_option_get_ipv4(ni_buffer_t *bp, struct in_addr *addr)
+{
+	return ni_buffer_get(bp, addr, 4);
+}
+
+static int
+ni_dhcp4_option_get16(ni_buffer_t *bp, uint16_t *var)
+{
+	if (ni_buffer_get(bp, var, 2) < 0)
+		return -1;
+	*var = ntohs(*var);
+	return 0;
+}
+
+static int
+ni_dhcp4_option_get32(ni_buffer_t *bp, uint32_t *var)
+{
+	if (ni_buffer_get(bp, var, 4) < 0)
+		return -1;
+	*var = ntohl(*var);
+	return 0;
+}
+
+/*
+ * Decode an RFC3397 DNS search order option.
+ */
+static int
+ni_dhcp4_decode_dnssearch(ni_buffer_t *optbuf, ni_string_array_t *list, const char *what)
+{
+	ni_stringbuf_t namebuf = NI_STRINGBUF_INIT_DYNAMIC;
+	unsigned char *base = ni_buffer_head(optbuf);
+	unsigned int base_offset = optbuf->head;
+	size_t len;
+
+	ni_string_array_destroy(list);
+
+	while (ni_buffer_count(optbuf) && !optbuf->underflow) {
+		ni_buffer_t *bp = optbuf;
+		ni_buffer_t jumpbuf;
+
+		while (1) {
+			unsigned int pos = bp->head - base_offset;
+			unsigned int pointer;
+			char label[64];
+			int length;
+
+			if ((length = ni_buffer_getc(bp)) < 0)
+				goto failure; /* unexpected EOF */
+
+			if (length == 0)
+				break;	/* end of this name */
+
+			switch (length & 0xC0) {
+			case 0:
+				/* Plain name component */
+				if (ni_buffer_get(bp, label, length) < 0)
+					goto failure;
+
+				label[length] = '\0';
+				if (!ni_stringbuf_empty(&namebuf))
+					ni_stringbuf_putc(&namebuf, '.');
+				ni_stringbuf_puts(&namebuf, label);
+				break;
+
+			case 0xC0:
+				/* Pointer */
+				pointer = (length & 0x3F) << 8;
+				if ((length = ni_buffer_getc(bp)) < 0)
+					goto failure;
+
+				pointer |= length;
+				if (pointer >= pos)
+					goto failure;
+
+				ni_buffer_init_reader(&jumpbuf, base, pos);
+				jumpbuf.head = pointer;
+				bp = &jumpbuf;
+				break;
+
+			default:
+				goto failure;
+			}
+
+		}
+
+		if (!ni_stringbuf_empty(&namebuf)) {
+
+			len = ni_string_len(namebuf.string);
+			if (ni_check_domain_name(namebuf.string, len, 0)) {
+				ni_string_array_append(list, namebuf.string);
+			} else {
+				ni_warn("Discarded suspect %s: '%s'", what,
+					ni_print_suspect(namebuf.string, len));
+			}
+		}
+		ni_stringbuf_destroy(&namebuf);
+	}
+
+	return 0;
+
+failure:
+	ni_stringbuf_destroy(&namebuf);
+	ni_string_array_destroy(list);
+	return -1;
+}
+
+/*
+ * Decode a CIDR list option.
+ */
+static int
+ni_dhcp4_decode_csr(ni_buffer_t *bp, ni_route_array_t *routes)
+{
+	while (ni_buffer_count(bp) && !bp->underflow) {
+		ni_sockaddr_t destination, gateway;
+		struct in_addr prefix = { 0 };
+		unsigned int prefix_len;
+		ni_route_t *rp;
+
+		prefix_len = ni_buffer_getc(bp);
+		if (prefix_len > 32) {
+			ni_error("invalid prefix len of %u in classless static route", prefix_len);
+			return -1;
+		}
+
+		if (prefix_len)
+			ni_buffer_get(bp, &prefix, (prefix_len + 7) / 8);
+		ni_sockaddr_set_ipv4(&destination, prefix, 0);
+
+		if (ni_dhcp4_option_get_sockaddr(bp, &gateway) < 0)
+			return -1;
+
+		rp = ni_route_create(prefix_len, &destination, &gateway, 0, NULL);
+		ni_route_array_append(routes, rp);
+	}
+
+	if (bp->underflow)
+		return -1;
+
+	return 0;
+}
+
+static int
+ni_dhcp4_decode_address_list(ni_buffer_t *bp, ni_string_array_t *list)
+{
+	while (ni_buffer_count(bp) && !bp->underflow) {
+		struct in_addr addr;
+
+		if (ni_dhcp4_option_get_ipv4(bp, &addr) < 0)
+			return -1;
+		ni_string_array_append(list, inet_ntoa(addr));
+	}
+
+	if (bp->underflow)
+		return -1;
+
+	return 0;
+}
+
+static int
+ni_dhcp4_decode_sipservers(ni_buffer_t *bp, ni_string_array_t *list)
+{
+	int encoding;
+
+	encoding = ni_buffer_getc(bp);
+	switch (encoding) {
+	case -1:
+		ni_debug_dhcp("%s: missing data", __FUNCTION__);
+		return -1;
+
+	case 0:
+		return ni_dhcp4_decode_dnssearch(bp, list, "sip-server name");
+
+	case 1:
+		return ni_dhcp4_decode_address_list(bp, list);
+
+	default:
+		ni_error("unknown sip encoding %d", encoding);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Given an IPv4 address, guess the netmask.
+ */
+static inline unsigned int
+__count_net_bits(uint32_t prefix)
+{
+	unsigned int len = 0;
+
+	while (prefix) {
+		prefix <<= 1;
+		len++;
+	}
+	return len;
+}
+
+static unsigned int
+guess_prefix_len(struct in_addr addr)
+{
+	uint32_t prefix = ntohl(addr.s_addr);
+	unsigned int len;
+
+	/* At a minimum, use the prefix len for this IPv4 address class. */
+	if (IN_CLASSA(prefix))
+		len = 8;
+	else if (IN_CLASSB(prefix))
+		len = 16;
+	else if (IN_CLASSC(prefix))
+		len = 24;
+	else
+		len = 0;
+
+	/* If the address has bits beyond the default class,
+	 * extend the prefix until we've covered all of them. */
+	return len + __count_net_bits(prefix << len);
+}
+
+static unsigned int
+guess_prefix_len_sockaddr(const ni_sockaddr_t *ap)
+{
+	return guess_prefix_len(ap->sin.sin_addr);
+}
+
+static inline unsigned int
+guess_default_maskbits(struct in_addr addr)
+{
+	uint32_t prefix = ntohl(addr.s_addr);
+
+	if (IN_CLASSA(prefix))
+		return 8;
+	if (IN_CLASSB(prefix))
+		return 16;
+	if (IN_CLASSC(prefix))
+		return 24;
+	return 32;
+}
+
+static inline in_addr_t
+cidr_to_netmask(unsigned int pfxlen)
+{
+	return pfxlen ? htonl(~((1<<(32-pfxlen))-1)) : 0U;
+}
+
+/*
+ * DHCP4_STATICROUTE
+ * List of network/gateway pairs.
+ */
+static int
+ni_dhcp4_decode_static_routes(ni_buffer_t *bp, ni_route_array_t *routes)
+{
+	while (ni_buffer_count(bp) && !bp->underflow) {
+		ni_sockaddr_t destination, gateway;
+		ni_route_t *rp;
+
+		if (ni_dhcp4_option_get_sockaddr(bp, &destination) < 0
+		 || ni_dhcp4_option_get_sockaddr(bp, &gateway) < 0)
+			return -1;
+
+		rp = ni_route_create(guess_prefix_len_sockaddr(&destination),
+				&destination,
+				&gateway,
+				0, NULL);
+		ni_route_array_append(routes, rp);
+	}
+
+	return 0;
+}
+
+/*
+ * DHCP4_ROUTERS (3)
+ * List of gateways for default route
+ */
+static int
+ni_dhcp4_decode_routers(ni_buffer_t *bp, ni_route_array_t *routes)
+{
+	ni_sockaddr_t gateway;
+
+	while (ni_buffer_count(bp) && !bp->underflow) {
+		ni_route_t *rp;
+
+		if (ni_dhcp4_option_get_sockaddr(bp, &gateway) < 0)
+			return -1;
+
+		rp = ni_route_create(0, NULL, &gateway, 0, NULL);
+		ni_route_array_append(routes, rp);
+	}
+
+	return 0;
+}
+
+/*
+ * Return the option data as a NUL terminated string in the arena.
+ */
+static char *
+ni_dhcp4_option_get_string(ni_dhcp4_arena_t *arena, ni_buffer_t *bp, unsigned int *lenp)
+{
+	unsigned int len = ni_buffer_count(bp);
+	char *str;
+
+	if (len == 0)
+		return NULL;
+
+	str = ni_dhcp4_arena_alloc(arena, len + 1);
+	ni_buffer_get(bp, str, len);
+	str[len] = '\0';
+	*lenp = len;
+	return str;
+}
+
+static int
+ni_dhcp4_option_get_domain(ni_dhcp4_arena_t *arena, ni_buffer_t *bp, char **var,
+				const char *what)
+{
+	unsigned int len;
+	char *tmp;
+
+	if (!(tmp = ni_dhcp4_option_get_string(arena, bp, &len)))
+		return -1;
+
+	if (!ni_check_domain_name(tmp, len, 0)) {
+		ni_warn("Discarded suspect %s: '%s'", what,
+			ni_print_suspect(tmp, len));
+		return -1;
+	}
+
+	ni_string_dup(var, tmp);
+	return 0;
+}
+
+static int
+ni_dhcp4_option_get_domain_list(ni_dhcp4_arena_t *arena, ni_buffer_t *bp,
+				ni_string_array_t *var, const char *what)
+{
+	ni_string_array_t list = NI_STRING_ARRAY_INIT;
+	unsigned int len, i;
+	char *tmp;
+
+	if (!(tmp = ni_dhcp4_option_get_string(arena, bp, &len)))
+		return -1;
+
+	/*
+	 * Hack to accept "compatibility abuse" of dns domain name
+	 * option containing multiple domains instead to send them
+	 * using a dns-search option...
+	 */
+	if (!ni_string_split(&list, tmp, " ", 0)) {
+		ni_warn("Discarded suspect %s: '%s'", what,
+				ni_print_suspect(tmp, len));
+		return -1;
+	}
+	for (i = 0; i < list.count; ++i) {
+		const char *dom = list.data[i];
+		if (!ni_check_domain_name(dom, ni_string_len(dom), 0)) {
+			ni_warn("Discarded suspect %s: '%s'", what,
+				ni_print_suspect(tmp, len));
+			ni_string_array_destroy(&list);
+			return -1;
+		}
+	}
+	if (list.count != 1) {
+		ni_warn("Abuse of %s option to provide a list: '%s'",
+			what, tmp);
+	}
+	ni_string_array_move(var, &list);
+	return 0;
+}
+
+static int
+ni_dhcp4_option_get_pathname(ni_dhcp4_arena_t *arena, ni_buffer_t *bp, char **var,
+				const char *what)
+{
+	unsigned int len;
+	char *tmp;
+
+	if (!(tmp = ni_dhcp4_option_get_string(arena, bp, &len)))
+		return -1;
+
+	if (!ni_check_pathname(tmp, len)) {
+		ni_warn("Discarded suspect %s: '%s'", what,
+			ni_print_suspect(tmp, len));
+		return -1;
+	}
+
+	ni_string_dup(var, tmp);
+	return 0;
+}
+
+static int
+ni_dhcp4_option_get_printable(ni_dhcp4_arena_t *arena, ni_buffer_t *bp, char **var,
+				const char *what)
+{
+	unsigned int len;
+	char *tmp;
+
+	if (!(tmp = ni_dhcp4_option_get_string(arena, bp, &len)))
+		return -1;
+
+	if (!ni_check_printable(tmp, len)) {
+		ni_warn("Discarded non-printable %s: '%s'", what,
+			ni_print_suspect(tmp, len));
+		return -1;
+	}
+
+	ni_string_dup(var, tmp);
+	return 0;
+}
+
+static int
+ni_dhcp4_option_get_printable_list(ni_dhcp4_arena_t *arena, ni_buffer_t *bp,
+				ni_string_array_t *var, const char *what)
+{
+	unsigned int len;
+	char *tmp;
+
+	if (!(tmp = ni_dhcp4_option_get_string(arena, bp, &len)))
+		return -1;
+
+	if (!ni_check_printable(tmp, len)) {
+		ni_warn("Discarded non-printable %s: '%s'", what,
+			ni_print_suspect(tmp, len));
+		return -1;
+	}
+
+	ni_string_array_append(var, tmp);
+	return 0;
+}
+
+static int
+ni_dhcp4_option_get_netbios_type(ni_buffer_t *bp, unsigned int *type)
+{
+	unsigned int len = ni_buffer_count(bp);
+
+	if (len != 1)
+		return -1;
+
+	*type = (unsigned int)ni_buffer_getc(bp);
+	switch (*type) {
+		case 0x1:	/* B-node */
+		case 0x2:	/* P-node */
+		case 0x4:	/* M-node */
+		case 0x8:	/* H-node */
+			return 0;
+		default:
+			break;
+	}
+	*type = 0;
+	return -1;
+}
+
+void
+ni_dhcp4_apply_routes(ni_addrconf_lease_t *lease, ni_route_array_t *routes)
+{
+	ni_route_array_t temp = NI_ROUTE_ARRAY_INIT;
+	ni_route_t *rp, *r;
+	ni_address_t *ap;
+	unsigned int i, j;
+
+	if (!lease || !routes)
+		return;
+
+	/* apply device routes first (if any) */
+	for (i = 0; i < routes->count; ++i) {
+		if (!(rp = routes->data[i]))
+			continue;
+		if (ni_sockaddr_is_specified(&rp->nh.gateway))
+			continue;
+		ni_route_array_append(&temp, ni_route_ref(rp));
+	}
+
+	/* now the routes with a gateway - add a
+	 * device routes as needed / when missed */
+	for (i = 0; i < routes->count; ++i) {
+		ni_bool_t added = FALSE;
+
+		if (!(rp = routes->data[i]))
+			continue;
+		if (!ni_sockaddr_is_specified(&rp->nh.gateway))
+			continue;
+
+		/* just add, when gateway is on the same net as IP */
+		for (ap = lease->addrs; !added && ap; ap = ap->next) {
+			if (!ni_address_can_reach(ap, &rp->nh.gateway))
+				continue;
+			ni_route_array_append(&temp, ni_route_ref(rp));
+			added = TRUE;
+		}
+		/* or there is a device route allowing to reach it */
+		for (j = 0; !added && j < temp.count; ++j) {
+			if (!(r = temp.data[j]))
+				continue;
+			if (ni_sockaddr_is_specified(&r->nh.gateway))
+				continue;
+
+			if (!ni_sockaddr_prefix_match(r->prefixlen,
+						&r->destination,
+						&rp->nh.gateway))
+				continue;
+			ni_route_array_append(&temp, ni_route_ref(rp));
+			added = TRUE;
+		}
+
+		/* otherwise, automatically prepend a device route */
+		if (!added) {
+			unsigned int len = ni_af_address_length(rp->family);
+			r = ni_route_create(len * 8, &rp->nh.gateway, NULL, 0, NULL);
+			ni_route_array_append(&temp, r);
+			ni_route_array_append(&temp, ni_route_ref(rp));
+		}
+	}
+	ni_route_tables_add_routes(&lease->routes, &temp);
+	ni_route_array_destroy(&temp);
+}
+
+/*
+ * The DHCP4 options we decode into the lease
+ */
+static const ni_dhcp4_option_desc_t	ni_dhcp4_option_table[256] = {
+ [DHCP4_NETMASK]		= { NI_DHCP4_OPTION_IPV4,		NI_DHCP4_OPTION_LAST,	4, 4,
+				    NI_DHCP4_LEASE(dhcp4.netmask),		NULL },
+ [DHCP4_ROUTERS]		= { NI_DHCP4_OPTION_ROUTERS,		NI_DHCP4_OPTION_CONCAT,	4, 0,
+				    NI_DHCP4_STATE(default_routes),		NULL },
+ [DHCP4_DNSSERVER]		= { NI_DHCP4_OPTION_IPV4_LIST,		NI_DHCP4_OPTION_CONCAT,	4, 0,
+				    NI_DHCP4_STATE(dns_servers),		NULL },
+ [DHCP4_LOGSERVER]		= { NI_DHCP4_OPTION_IPV4_LIST,		NI_DHCP4_OPTION_CONCAT,	4, 0,
+				    NI_DHCP4_LEASE(log_servers),		NULL },
+ [DHCP4_LPRSERVER]		= { NI_DHCP4_OPTION_IPV4_LIST,		NI_DHCP4_OPTION_CONCAT,	4, 0,
+				    NI_DHCP4_LEASE(lpr_servers),		NULL },
+ [DHCP4_HOSTNAME]		= { NI_DHCP4_OPTION_DOMAIN,		NI_DHCP4_OPTION_CONCAT,	1, 0,
+				    NI_DHCP4_LEASE(hostname),			"hostname" },
+ [DHCP4_DNSDOMAIN]		= { NI_DHCP4_OPTION_DOMAIN_LIST,	NI_DHCP4_OPTION_CONCAT,	1, 0,
+				    NI_DHCP4_STATE(dns_domain),			"dns-domain" },
+ [DHCP4_ROOTPATH]		= { NI_DHCP4_OPTION_PATHNAME,		NI_DHCP4_OPTION_CONCAT,	1, 0,
+				    NI_DHCP4_LEASE(dhcp4.root_path),		"root-path" },
+ [DHCP4_MTU]			= { NI_DHCP4_OPTION_UINT16,		NI_DHCP4_OPTION_LAST,	2, 2,
+				    NI_DHCP4_LEASE(dhcp4.mtu),			NULL },
+ [DHCP4_BROADCAST]		= { NI_DHCP4_OPTION_IPV4,		NI_DHCP4_OPTION_LAST,	4, 4,
+				    NI_DHCP4_LEASE(dhcp4.broadcast),		NULL },
+ [DHCP4_STATICROUTE]		= { NI_DHCP4_OPTION_STATIC_ROUTES,	NI_DHCP4_OPTION_CONCAT,	8, 0,
+				    NI_DHCP4_STATE(static_routes),		NULL },
+ [DHCP4_NISDOMAIN]		= { NI_DHCP4_OPTION_DOMAIN,		NI_DHCP4_OPTION_CONCAT,	1, 0,
+				    NI_DHCP4_STATE(nisdomain),			"nis-domain" },
+ [DHCP4_NISSERVER]		= { NI_DHCP4_OPTION_IPV4_LIST,		NI_DHCP4_OPTION_CONCAT,	4, 0,
+				    NI_DHCP4_STATE(nis_servers),		NULL },
+ [DHCP4_NTPSERVER]		= { NI_DHCP4_OPTION_IPV4_LIST,		NI_DHCP4_OPTION_CONCAT,	4, 0,
+				    NI_DHCP4_LEASE(ntp_servers),		NULL },
+ [DHCP4_NETBIOSNAMESERVER]	= { NI_DHCP4_OPTION_IPV4_LIST,		NI_DHCP4_OPTION_CONCAT,	4, 0,
+				    NI_DHCP4_LEASE(netbios_name_servers),	NULL },
+ [DHCP4_NETBIOSDDSERVER]	= { NI_DHCP4_OPTION_IPV4_LIST,		NI_DHCP4_OPTION_CONCAT,	4, 0,
+				    NI_DHCP4_LEASE(netbios_dd_servers),		NULL },
+ [DHCP4_NETBIOSNODETYPE]	= { NI_DHCP4_OPTION_NETBIOS_TYPE,	NI_DHCP4_OPTION_LAST,	1, 0,
+				    NI_DHCP4_LEASE(netbios_type),		NULL },
+ [DHCP4_NETBIOSSCOPE]		= { NI_DHCP4_OPTION_DOMAIN,		NI_DHCP4_OPTION_CONCAT,	1, 0,
+				    NI_DHCP4_LEASE(netbios_scope),		"netbios-scope" },
+ [DHCP4_ADDRESS]		= { NI_DHCP4_OPTION_IPV4,		NI_DHCP4_OPTION_LAST,	4, 4,
+				    NI_DHCP4_LEASE(dhcp4.address),		NULL },
+ [DHCP4_LEASETIME]		= { NI_DHCP4_OPTION_UINT32,		NI_DHCP4_OPTION_LAST,	4, 4,
+				    NI_DHCP4_LEASE(dhcp4.lease_time),		NULL },
+ [DHCP4_MESSAGETYPE]		= { NI_DHCP4_OPTION_UINT8,		NI_DHCP4_OPTION_LAST,	1, 1,
+				    NI_DHCP4_STATE(msg_type),			NULL },
+ [DHCP4_SERVERIDENTIFIER]	= { NI_DHCP4_OPTION_IPV4,		NI_DHCP4_OPTION_LAST,	4, 4,
+				    NI_DHCP4_LEASE(dhcp4.server_id),		NULL },
+ [DHCP4_MESSAGE]		= { NI_DHCP4_OPTION_PRINTABLE,		NI_DHCP4_OPTION_CONCAT,	1, 0,
+				    NI_DHCP4_LEASE(dhcp4.message),		"dhcp4-message" },
+ [DHCP4_RENEWALTIME]		= { NI_DHCP4_OPTION_UINT32,		NI_DHCP4_OPTION_LAST,	4, 4,
+				    NI_DHCP4_LEASE(dhcp4.renewal_time),		NULL },
+ [DHCP4_REBINDTIME]		= { NI_DHCP4_OPTION_UINT32,		NI_DHCP4_OPTION_LAST,	4, 4,
+				    NI_DHCP4_LEASE(dhcp4.rebind_time),		NULL },
+ [DHCP4_RAPID_COMMIT]		= { NI_DHCP4_OPTION_FLAG,		NI_DHCP4_OPTION_LAST,	0, 0,
+				    NI_DHCP4_LEASE(dhcp4.rapid_commit),		NULL },
+ /* We ignore replies about FQDN */
+ [DHCP4_FQDN]			= { NI_DHCP4_OPTION_IGNORE },
+ [DHCP4_NDS_SERVER]		= { NI_DHCP4_OPTION_IPV4_LIST,		NI_DHCP4_OPTION_CONCAT,	4, 0,
+				    NI_DHCP4_LEASE(nds_servers),		NULL },
+ [DHCP4_NDS_TREE]		= { NI_DHCP4_OPTION_PRINTABLE,		NI_DHCP4_OPTION_CONCAT,	1, 0,
+				    NI_DHCP4_LEASE(nds_tree),			"nds-tree" },
+ [DHCP4_NDS_CTX]		= { NI_DHCP4_OPTION_PRINTABLE_LIST,	NI_DHCP4_OPTION_EACH,	1, 0,
+				    NI_DHCP4_LEASE(nds_context),		"nds-context" },
+ [DHCP4_POSIX_TZ_STRING]	= { NI_DHCP4_OPTION_PRINTABLE,		NI_DHCP4_OPTION_CONCAT,	1, 0,
+				    NI_DHCP4_LEASE(posix_tz_string),		"posix-tz-string" },
+ [DHCP4_POSIX_TZ_DBNAME]	= { NI_DHCP4_OPTION_PRINTABLE,		NI_DHCP4_OPTION_CONCAT,	1, 0,
+				    NI_DHCP4_LEASE(posix_tz_dbname),		"posix-tz-dbname" },
+ [DHCP4_DNSSEARCH]		= { NI_DHCP4_OPTION_DNS_SEARCH,		NI_DHCP4_OPTION_CONCAT,	1, 0,
+				    NI_DHCP4_STATE(dns_search),			"dns-search domain" },
+ [DHCP4_SIPSERVER]		= { NI_DHCP4_OPTION_SIP_SERVERS,	NI_DHCP4_OPTION_CONCAT,	1, 0,
+				    NI_DHCP4_LEASE(sip_servers),		NULL },
+ [DHCP4_CSR]			= { NI_DHCP4_OPTION_CSR,		NI_DHCP4_OPTION_CONCAT,	1, 0,
+				    NI_DHCP4_STATE(classless_routes),		NULL },
+ [DHCP4_MSCSR]			= { NI_DHCP4_OPTION_CSR,		NI_DHCP4_OPTION_CONCAT,	1, 0,
+				    NI_DHCP4_STATE(classless_routes),		NULL },
+};
+
+static void
+ni_dhcp4_option_state_init(ni_dhcp4_option_state_t *st)
+{
+	ni_dhcp4_arena_init(&st->arena);
+	memset(st->index, 0, sizeof(st->index));
+	st->nslots = 0;
+	st->lease = NULL;
+	st->overload = 0;
+	st->msg_type = 0;
+	ni_route_array_init(&st->default_routes);
+	ni_route_array_init(&st->static_routes);
+	ni_route_array_init(&st->classless_routes);
+	ni_string_array_init(&st->dns_servers);
+	ni_string_array_init(&st->dns_search);
+	ni_string_array_init(&st->dns_domain);
+	ni_string_array_init(&st->nis_servers);
+	st->nisdomain = NULL;
+}
+
+static void
+ni_dhcp4_option_state_destroy(ni_dhcp4_option_state_t *st)
+{
+	ni_route_array_destroy(&st->default_routes);
+	ni_route_array_destroy(&st->static_routes);
+	ni_route_array_destroy(&st->classless_routes);
+	ni_string_array_destroy(&st->dns_servers);
+	ni_string_array_destroy(&st->dns_search);
+	ni_string_array_destroy(&st->dns_domain);
+	ni_string_array_destroy(&st->nis_servers);
+	ni_string_free(&st->nisdomain);
+	ni_dhcp4_arena_destroy(&st->arena);
+}
+
+static void
+ni_dhcp4_option_add(ni_dhcp4_option_state_t *st, unsigned int code,
+			const unsigned char *data, unsigned int len)
+{
+	ni_dhcp4_option_slot_t *slot;
+	ni_dhcp4_option_seg_t *seg;
+
+	seg = ni_dhcp4_arena_alloc(&st->arena, sizeof(*seg));
+	seg->next = NULL;
+	seg->data = data;
+	seg->len = len;
+
+	if (st->index[code]) {
+		slot = &st->slots[st->index[code] - 1];
+		slot->tail->next = seg;
+	} else {
+		slot = &st->slots[st->nslots++];
+		st->index[code] = st->nslots;
+		slot->code = code;
+		slot->count = 0;
+		slot->len = 0;
+		slot->head = seg;
+	}
+	slot->tail = seg;
+	slot->count++;
+	slot->len += len;
+}
+
+/*
+ * Find the options in one of the fields of a response. The overload
+ * option is only valid in the options field itself.
+ */
+static int
+ni_dhcp4_option_scan(ni_dhcp4_option_state_t *st, const unsigned char *data,
+			size_t size, ni_bool_t overloaded)
+{
+	size_t pos = 0;
+
+	while (pos < size) {
+		unsigned int code, len;
+
+		code = data[pos++];
+		if (code == DHCP4_PAD)
+			continue;
+		if (code == DHCP4_END)
+			break;
+
+		if (pos == size || size - pos - 1 < data[pos])
+			return -1;
+		len = data[pos++];
+
+		if (code == DHCP4_OPTIONSOVERLOADED) {
+			if (overloaded) {
+				ni_debug_dhcp("DHCP4: ignoring OVERLOAD option in overloaded data");
+			} else if (len) {
+				st->overload = data[pos];
+			}
+		} else {
+			ni_dhcp4_option_add(st, code, data + pos, len);
+		}
+		pos += len;
+	}
+	return 0;
+}
+
+static int
+ni_dhcp4_option_decode_data(ni_dhcp4_option_state_t *st, unsigned int code,
+			const ni_dhcp4_option_desc_t *desc,
+			const unsigned char *data, unsigned int len)
+{
+	const char *what = desc->what ? desc->what : ni_dhcp4_option_name(code);
+	ni_buffer_t buf;
+	void *var;
+
+	if (len < desc->min_len) {
+		ni_debug_dhcp("unable to parse DHCP4 option %s: too short",
+				ni_dhcp4_option_name(code));
+		return -1;
+	}
+	if (desc->max_len && len > desc->max_len) {
+		ni_debug_dhcp("excess data in DHCP4 option %s - %u bytes left",
+				ni_dhcp4_option_name(code), len - desc->max_len);
+		len = desc->max_len;
+	}
+
+	var = (desc->target.lease ? (unsigned char *) st->lease : (unsigned char *) st)
+		+ desc->target.offset;
+	ni_buffer_init_reader(&buf, (void *) data, len);
+
+	switch (desc->type) {
+	case NI_DHCP4_OPTION_FLAG:
+		*(ni_bool_t *) var = TRUE;
+		break;
+	case NI_DHCP4_OPTION_UINT8:
+		*(uint8_t *) var = ni_buffer_getc(&buf);
+		break;
+	case NI_DHCP4_OPTION_UINT16:
+		ni_dhcp4_option_get16(&buf, var);
+		break;
+	case NI_DHCP4_OPTION_UINT32:
+		ni_dhcp4_option_get32(&buf, var);
+		break;
+	case NI_DHCP4_OPTION_IPV4:
+		ni_dhcp4_option_get_ipv4(&buf, var);
+		break;
+	case NI_DHCP4_OPTION_IPV4_LIST:
+		ni_dhcp4_decode_address_list(&buf, var);
+		break;
+	case NI_DHCP4_OPTION_DOMAIN:
+		ni_dhcp4_option_get_domain(&st->arena, &buf, var, what);
+		break;
+	case NI_DHCP4_OPTION_DOMAIN_LIST:
+		ni_dhcp4_option_get_domain_list(&st->arena, &buf, var, what);
+		break;
+	case NI_DHCP4_OPTION_DNS_SEARCH:
+		ni_dhcp4_decode_dnssearch(&buf, var, what);
+		break;
+	case NI_DHCP4_OPTION_PATHNAME:
+		ni_dhcp4_option_get_pathname(&st->arena, &buf, var, what);
+		break;
+	case NI_DHCP4_OPTION_PRINTABLE:
+		ni_dhcp4_option_get_printable(&st->arena, &buf, var, what);
+		break;
+	case NI_DHCP4_OPTION_PRINTABLE_LIST:
+		ni_dhcp4_option_get_printable_list(&st->arena, &buf, var, what);
+		break;
+	case NI_DHCP4_OPTION_NETBIOS_TYPE:
+		ni_dhcp4_option_get_netbios_type(&buf, var);
+		break;
+	case NI_DHCP4_OPTION_SIP_SERVERS:
+		ni_dhcp4_decode_sipservers(&buf, var);
+		break;
+	case NI_DHCP4_OPTION_ROUTERS:
+		ni_route_array_destroy(var);
+		if (ni_dhcp4_decode_routers(&buf, var) < 0)
+			return -1;
+		break;
+	case NI_DHCP4_OPTION_STATIC_ROUTES:
+		ni_route_array_destroy(var);
+		if (ni_dhcp4_decode_static_routes(&buf, var) < 0)
+			return -1;
+		break;
+	case NI_DHCP4_OPTION_CSR:
+		ni_route_array_destroy(var);
+		if (ni_dhcp4_decode_csr(&buf, var) < 0)
+			return -1;
+		break;
+	default:
+		return 0;
+	}
+
+	if (buf.underflow) {
+		ni_debug_dhcp("unable to parse DHCP4 option %s: too short",
+				ni_dhcp4_option_name(code));
+		return -1;
+	} else if (ni_buffer_count(&buf)) {
+		ni_debug_dhcp("excess data in DHCP4 option %s - %u bytes left",
+				ni_dhcp4_option_name(code),
+				ni_buffer_count(&buf));
+	}
+	return 0;
+}
+
+static int
+ni_dhcp4_option_decode(ni_dhcp4_option_state_t *st, const ni_dhcp4_option_slot_t *slot)
+{
+	const ni_dhcp4_option_desc_t *desc = &ni_dhcp4_option_table[slot->code];
+	const ni_dhcp4_option_seg_t *seg;
+	unsigned char *data, *pos;
+
+	switch (desc->type) {
+	case NI_DHCP4_OPTION_UNSUPPORTED:
+		ni_debug_dhcp("ignoring unsupported DHCP4 code %u", slot->code);
+		return 0;
+	case NI_DHCP4_OPTION_IGNORE:
+		return 0;
+	default:
+		break;
+	}
+
+	switch (desc->repeat) {
+	case NI_DHCP4_OPTION_EACH:
+		for (seg = slot->head; seg; seg = seg->next) {
+			if (ni_dhcp4_option_decode_data(st, slot->code, desc,
+						seg->data, seg->len) < 0)
+				return -1;
+		}
+		return 0;
+
+	case NI_DHCP4_OPTION_CONCAT:
+		if (slot->count == 1)
+			break;
+
+		pos = data = ni_dhcp4_arena_alloc(&st->arena, slot->len);
+		for (seg = slot->head; seg; seg = seg->next) {
+			memcpy(pos, seg->data, seg->len);
+			pos += seg->len;
+		}
+		return ni_dhcp4_option_decode_data(st, slot->code, desc, data, slot->len);
+
+	case NI_DHCP4_OPTION_LAST:
+	default:
+		break;
+	}
+	return ni_dhcp4_option_decode_data(st, slot->code, desc,
+					slot->tail->data, slot->tail->len);
+}
+
+/*
+ * Parse a DHCP4 response.
+ * The options are collected from the options field and, when the
+ * overload option says so, from the file and sname fields first.
+ * Options split into several instances are concatenated (RFC 3396).
+ */
+int
+ni_dhcp4_parse_response(const ni_dhcp4_message_t *message, ni_buffer_t *options, ni_addrconf_lease_t **leasep)
+{
+	ni_dhcp4_option_state_t st;
+	ni_addrconf_lease_t *lease = NULL;
+	ni_bool_t use_bootserver = TRUE;
+	ni_bool_t use_bootfile = TRUE;
+	unsigned int i, pfxlen;
+	int msg_type = -1;
+
+	ni_dhcp4_option_state_init(&st);
+
+	if (options->underflow || ni_dhcp4_option_scan(&st, ni_buffer_head(options),
+					ni_buffer_count(options), FALSE) < 0)
+		goto truncated;
+
+	if (st.overload & DHCP4_OVERLOAD_BOOTFILE) {
+		use_bootfile = FALSE;
+		if (ni_dhcp4_option_scan(&st, message->bootfile,
+					sizeof(message->bootfile), TRUE) < 0)
+			goto truncated;
+	}
+	if (st.overload & DHCP4_OVERLOAD_SERVERNAME) {
+		use_bootserver = FALSE;
+		if (ni_dhcp4_option_scan(&st, message->servername,
+					sizeof(message->servername), TRUE) < 0)
+			goto truncated;
+	}
+
+	lease = ni_addrconf_lease_new(NI_ADDRCONF_DHCP, AF_INET);
+
+	lease->state = NI_ADDRCONF_STATE_GRANTED;
+	lease->type = NI_ADDRCONF_DHCP;
+	lease->family = AF_INET;
+	lease->time_acquired = time(NULL);
+
+	lease->dhcp4.address.s_addr = message->yiaddr;
+	lease->dhcp4.boot_saddr.s_addr = message->siaddr;
+	lease->dhcp4.relay_addr.s_addr = message->giaddr;
+
+	st.lease = lease;
+	for (i = 0; i < st.nslots; ++i) {
+		if (ni_dhcp4_option_decode(&st, &st.slots[i]) < 0)
+			goto error;
+	}
+	if (!st.index[DHCP4_MESSAGETYPE]) {
+		ni_debug_dhcp("DHCP4 response without message type");
+		goto error;
+	}
+	msg_type = st.msg_type;
+
+	/* Minimum legal mtu is 68 accoridng to
+	 * RFC 2132. In practise it's 576 which is the
+	 * minimum maximum message size. */
+	if (lease->dhcp4.mtu && lease->dhcp4.mtu < MTU_MIN) {
+		ni_debug_dhcp("MTU %u is too low, minimum is %d; ignoring",
+				lease->dhcp4.mtu, MTU_MIN);
+		lease->dhcp4.mtu = 0;
+	}
+
+	if (use_bootserver && message->servername[0]) {
+		char tmp[sizeof(message->servername)];
+		size_t len;
+
+		memcpy(tmp, message->servername, sizeof(tmp));
+		tmp[sizeof(tmp)-1] = '\0';
+
+		len = ni_string_len(tmp);
+		if (ni_check_domain_name(tmp, len, 0)) {
+			ni_string_dup(&lease->dhcp4.boot_sname, tmp);
+		} else {
+			ni_warn("Discarded suspect boot-server name: '%s'",
+				ni_print_suspect(tmp, len));
+		}
+	}
+	if (use_bootfile && message->bootfile[0]) {
+		char tmp[sizeof(message->bootfile)];
+		size_t len;
+
+		memcpy(tmp, message->bootfile, sizeof(tmp));
+		tmp[sizeof(tmp)-1] = '\0';
+		len = ni_string_len(tmp);
+		if (ni_check_pathname(tmp, len)) {
+			ni_string_dup(&lease->dhcp4.boot_file, tmp);
+		} else {
+			ni_warn("Discarded suspect boot-file name: '%s'",
+				ni_print_suspect(tmp, len));
+		}
+	}
+
+	/* Fill in any missing fields */
+	if (lease->dhcp4.netmask.s_addr) {
+		ni_sockaddr_t mask;
+
+		ni_sockaddr_set_ipv4(&mask, lease->dhcp4.netmask, 0);
+		if (!(pfxlen = ni_sockaddr_netmask_bits(&mask)))
+			pfxlen = 32;
+	} else {
+		pfxlen = guess_default_maskbits(lease->dhcp4.address);
+		lease->dhcp4.netmask.s_addr = cidr_to_netmask(pfxlen);
+
+		ni_debug_verbose(NI_LOG_DEBUG1, NI_TRACE_DHCP,
+				"guessed netmask: %s, cidr: %u",
+				inet_ntoa(lease->dhcp4.netmask), pfxlen);
+	}
+	if (!lease->dhcp4.broadcast.s_addr) {
+		lease->dhcp4.broadcast.s_addr = lease->dhcp4.address.s_addr |
+						~lease->dhcp4.netmask.s_addr;
+	}
+	if (lease->dhcp4.address.s_addr) {
+		ni_sockaddr_t local_addr;
+		ni_address_t *ap;
+
+		memset(&local_addr, 0, sizeof(local_addr));
+		local_addr.sin.sin_family = AF_INET;
+		local_addr.sin.sin_addr = lease->dhcp4.address;
+		ap = ni_address_new(AF_INET, pfxlen, &local_addr, &lease->addrs);
+		if (ap) {
+			memset(&ap->bcast_addr, 0, sizeof(ap->bcast_addr));
+			ap->bcast_addr.sin.sin_family = AF_INET;
+			ap->bcast_addr.sin.sin_addr = lease->dhcp4.broadcast;
+		}
+	}
+
+	if (st.classless_routes.count) {
+		/* if CSR or MSCSR are available, ignore other routes */
+		ni_dhcp4_apply_routes(lease, &st.classless_routes);
+	} else {
+		ni_dhcp4_apply_routes(lease, &st.static_routes);
+		ni_dhcp4_apply_routes(lease, &st.default_routes);
+	}
+
+	if (st.dns_servers.count || st.dns_search.count || st.dns_domain.count) {
+		ni_resolver_info_t *resolver = ni_resolver_info_new();
+
+		if (st.dns_domain.count)
+			ni_string_dup(&resolver->default_domain, st.dns_domain.data[0]);
+
+		if (st.dns_search.count)
+			ni_string_array_move(&resolver->dns_search, &st.dns_search);
+		else
+			ni_string_array_move(&resolver->dns_search, &st.dns_domain);
+
+		ni_string_array_move(&resolver->dns_servers, &st.dns_servers);
+		lease->resolver = resolver;
+	}
+	if (st.nisdomain != NULL) {
+		ni_nis_info_t *nis = ni_nis_info_new();
+
+		nis->domainname = st.nisdomain;
+		st.nisdomain = NULL;
+
+		if (st.nis_servers.count == 0)
+			nis->default_binding = NI_NISCONF_BROADCAST;
+		else
+			ni_string_array_move(&nis->default_servers, &st.nis_servers);
+		lease->nis = nis;
+	}
+
+	*leasep = lease;
+	lease = NULL;
+
+done:
+	ni_dhcp4_option_state_destroy(&st);
+	return msg_type;
+
+truncated:
+	ni_debug_dhcp("unable to parse DHCP4 response: truncated packet");
+error:
+	if (lease)
+		ni_addrconf_lease_free(lease);
+	msg_type = -1;
+	goto done;
+}
+
+/*
+ * Map DHCP4 options to names
+ */
+static const char *__dhcp4_option_names[256] = {
+ [DHCP4_PAD]			= "DHCP4_PAD",
+ [DHCP4_NETMASK]			= "DHCP4_NETMASK",
+ [DHCP4_TIMEROFFSET]		= "DHCP4_TIMEROFFSET",
+ [DHCP4_ROUTERS]			= "DHCP4_ROUTERS",
+ [DHCP4_TIMESERVER]		= "DHCP4_TIMESERVER",
+ [DHCP4_NAMESERVER]		= "DHCP4_NAMESERVER",
+ [DHCP4_DNSSERVER]		= "DHCP4_DNSSERVER",
+ [DHCP4_LOGSERVER]		= "DHCP4_LOGSERVER",
+ [DHCP4_COOKIESERVER]		= "DHCP4_COOKIESERVER",
+ [DHCP4_LPRSERVER]		= "DHCP4_LPRSERVER",
+ [DHCP4_IMPRESSSERVER]		= "DHCP4_IMPRESSSERVER",
+ [DHCP4_RLSSERVER]		= "DHCP4_RLSSERVER",
+ [DHCP4_HOSTNAME]		= "DHCP4_HOSTNAME",
+ [DHCP4_BOOTFILESIZE]		= "DHCP4_BOOTFILESIZE",
+ [DHCP4_MERITDUMPFILE]		= "DHCP4_MERITDUMPFILE",
+ [DHCP4_DNSDOMAIN]		= "DHCP4_DNSDOMAIN",
+ [DHCP4_SWAPSERVER]		= "DHCP4_SWAPSERVER",
+ [DHCP4_ROOTPATH]		= "DHCP4_ROOTPATH",
+ [DHCP4_EXTENTIONSPATH]		= "DHCP4_EXTENTIONSPATH",
+ [DHCP4_IPFORWARDING]		= "DHCP4_IPFORWARDING",
+ [DHCP4_NONLOCALSOURCEROUTING]	= "DHCP4_NONLOCALSOURCEROUTING",
+ [DHCP4_POLICYFILTER]		= "DHCP4_POLICYFILTER",
+ [DHCP4_MAXDGRAMREASMSIZE]	= "DHCP4_MAXDGRAMREASMSIZE",
+ [DHCP4_DEFAULTIPTTL]		= "DHCP4_DEFAULTIPTTL",
+ [DHCP4_PATHMTUAGINGTIMEOUT]	= "DHCP4_PATHMTUAGINGTIMEOUT",
+ [DHCP4_PATHMTUPLATEAUTABLE]	= "DHCP4_PATHMTUPLATEAUTABLE",
+ [DHCP4_MTU]			= "DHCP4_MTU",
+ [DHCP4_ALLSUBNETSLOCAL]		= "DHCP4_ALLSUBNETSLOCAL",
+ [DHCP4_BROADCAST]		= "DHCP4_BROADCAST",
+ [DHCP4_MASKDISCOVERY]		= "DHCP4_MASKDISCOVERY",
+ [DHCP4_MASKSUPPLIER]		= "DHCP4_MASKSUPPLIER",
+ [DHCP4_ROUTERDISCOVERY]		= "DHCP4_ROUTERDISCOVERY",
+ [DHCP4_ROUTERSOLICITATIONADDR]	= "DHCP4_ROUTERSOLICITATIONADDR",
+ [DHCP4_STATICROUTE]		= "DHCP4_STATICROUTE",
+ [DHCP4_TRAILERENCAPSULATION]	= "DHCP4_TRAILERENCAPSULATION",
+ [DHCP4_ARPCACHETIMEOUT]		= "DHCP4_ARPCACHETIMEOUT",
+ [DHCP4_ETHERNETENCAPSULATION]	= "DHCP4_ETHERNETENCAPSULATION",
+ [DHCP4_TCPDEFAULTTTL]		= "DHCP4_TCPDEFAULTTTL",
+ [DHCP4_TCPKEEPALIVEINTERVAL]	= "DHCP4_TCPKEEPALIVEINTERVAL",
+ [DHCP4_TCPKEEPALIVEGARBAGE]	= "DHCP4_TCPKEEPALIVEGARBAGE",
+ [DHCP4_NISDOMAIN]		= "DHCP4_NISDOMAIN",
+ [DHCP4_NISSERVER]		= "DHCP4_NISSERVER",
+ [DHCP4_NTPSERVER]		= "DHCP4_NTPSERVER",
+ [DHCP4_VENDORSPECIFICINFO]	= "DHCP4_VENDORSPECIFICINFO",
+ [DHCP4_NETBIOSNAMESERVER]	= "DHCP4_NETBIOSNAMESERVER",
+ [DHCP4_NETBIOSDDSERVER]		= "DHCP4_NETBIOSDDSERVER",
+ [DHCP4_NETBIOSNODETYPE]		= "DHCP4_NETBIOSNODETYPE",
+ [DHCP4_NETBIOSSCOPE]		= "DHCP4_NETBIOSSCOPE",
+ [DHCP4_XFONTSERVER]		= "DHCP4_XFONTSERVER",
+ [DHCP4_XDISPLAYMANAGER]		= "DHCP4_XDISPLAYMANAGER",
+ [DHCP4_ADDRESS]			= "DHCP4_ADDRESS",
+ [DHCP4_LEASETIME]		= "DHCP4_LEASETIME",
+ [DHCP4_OPTIONSOVERLOADED]	= "DHCP4_OPTIONSOVERLOADED",
+ [DHCP4_MESSAGETYPE]		= "DHCP4_MESSAGETYPE",
+ [DHCP4_SERVERIDENTIFIER]	= "DHCP4_SERVERIDENTIFIER",
+ [DHCP4_PARAMETERREQUESTLIST]	= "DHCP4_PARAMETERREQUESTLIST",
+ [DHCP4_MESSAGE]			= "DHCP4_MESSAGE",
+ [DHCP4_MAXMESSAGESIZE]		= "DHCP4_MAXMESSAGESIZE",
+ [DHCP4_RENEWALTIME]		= "DHCP4_RENEWALTIME",
+ [DHCP4_REBINDTIME]		= "DHCP4_REBINDTIME",
+ [DHCP4_CLASSID]			= "DHCP4_CLASSID",
+ [DHCP4_CLIENTID]		= "DHCP4_CLIENTID",
+ [DHCP4_USERCLASS]		= "DHCP4_USERCLASS",
+ [DHCP4_RAPID_COMMIT]		= "DHCP4_RAPID_COMMIT",
+ [DHCP4_FQDN]			= "DHCP4_FQDN",
+ [DHCP4_NDS_SERVER]		= "DHCP4_NDS_SERVER",
+ [DHCP4_NDS_TREE]		= "DHCP4_NDS_TREE",
+ [DHCP4_NDS_CTX]		= "DHCP4_NDS_CTX",
+ [DHCP4_DNSSEARCH]		= "DHCP4_DNSSEARCH",
+ [DHCP4_SIPSERVER]		= "DHCP4_SIPSERVER",
+ [DHCP4_CSR]			= "DHCP4_CSR",
+ [DHCP4_MSCSR]			= "DHCP4_MSCSR",
+ [DHCP4_END]			= "DHCP4_END",
+};
+
+const char *
+ni_dhcp4_option_name(unsigned int option)
+{
+	static char namebuf[64];
+	const char *name = NULL;
+
+	if (option < 256)
+		name = __dhcp4_option_names[option];
+	if (!name) {
+		snprintf(namebuf, sizeof(namebuf), "DHCP4_OPTION_<%u>", option);
+		name = namebuf;
+	}
+	return name;
+}
@@ -107,6 +107,7 @@ enum DHCP4_OPTIONS {
 	DHCP4_USERCLASS              = 77,  /* RFC 3004 */
 	DHCP4_SLPSERVERS             = 78,  /* RFC 2610 */
 	DHCP4_SLPSCOPES              = 79,
+	DHCP4_RAPID_COMMIT           = 80,  /* RFC 4039 */
 	DHCP4_FQDN                   = 81,
 	DHCP4_NDS_SERVER             = 85,  /* RFC 2241 */
 	DHCP4_NDS_TREE               = 86,  /* RFC 2241 */
@@ -175,6 +175,10 @@ dhcp4_tester_req_xml_init(ni_dhcp4_request_t *req, xml_document_t *doc)
 		if (ni_string_eq(child->name, "release-lease")) {
 			if (ni_parse_boolean(child->cdata, &req->release_lease) != 0)
 				goto failure;
+		} else
+		if (ni_string_eq(child->name, "rapid-commit")) {
+			if (ni_parse_boolean(child->cdata, &req->rapid_commit) != 0)
+				goto failure;
 		}
 	}
 
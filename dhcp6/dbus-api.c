@@ -269,6 +269,7 @@ static ni_dbus_method_t		ni_objectmodel_dhcp6_signals[] = {
 	{ NI_OBJECTMODEL_LEASE_ACQUIRED_SIGNAL },
 	{ NI_OBJECTMODEL_LEASE_RELEASED_SIGNAL },
 	{ NI_OBJECTMODEL_LEASE_LOST_SIGNAL },
+	{ NI_OBJECTMODEL_LEASE_UPDATED_SIGNAL },
 	{ NULL }
 };
 
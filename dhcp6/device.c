@@ -40,6 +40,7 @@
 #include "dhcp6/protocol.h"
 #include "dhcp6/fsm.h"
 #include "appconfig.h"
+#include "ifindex-map.h"
 #include "util_priv.h"
 #include "duid.h"
 
@@ -76,6 +77,7 @@
 
 static ni_opaque_t		ni_dhcp6_duid;
 ni_dhcp6_device_t *		ni_dhcp6_active;
+static ni_ifindex_map_t		ni_dhcp6_index;		/* active devices by ifindex */
 
 static void			ni_dhcp6_device_close(ni_dhcp6_device_t *);
 static void			ni_dhcp6_device_free(ni_dhcp6_device_t *);
@@ -110,6 +112,7 @@ ni_dhcp6_device_new(const char *ifname, const ni_linkinfo_t *link)
 
 	/* append to end of list */
 	*pos = dev;
+	ni_ifindex_map_set(&ni_dhcp6_index, dev->link.ifindex, dev);
 
 	return dev;
 }
@@ -117,13 +120,7 @@ ni_dhcp6_device_new(const char *ifname, const ni_linkinfo_t *link)
 ni_dhcp6_device_t *
 ni_dhcp6_device_by_index(unsigned int ifindex)
 {
-	ni_dhcp6_device_t *dev;
-
-	for (dev = ni_dhcp6_active; dev; dev = dev->next) {
-		if (dev->link.ifindex == ifindex)
-			return dev;
-	}
-	return NULL;
+	return ni_ifindex_map_get(&ni_dhcp6_index, ifindex);
 }
 
 /*
@@ -152,6 +149,7 @@ ni_dhcp6_device_put(ni_dhcp6_device_t *dev)
 static void
 ni_dhcp6_device_close(ni_dhcp6_device_t *dev)
 {
+	ni_dhcp6_device_unschedule(dev);
 	ni_dhcp6_mcast_socket_close(dev);
 
 	if (dev->fsm.timer) {
@@ -207,6 +205,7 @@ ni_dhcp6_device_free(ni_dhcp6_device_t *dev)
 	ni_dhcp6_device_set_request(dev, NULL);
 
 	ni_string_free(&dev->ifname);
+	ni_ifindex_map_remove(&ni_dhcp6_index, dev->link.ifindex, dev);
 	dev->link.ifindex = 0;
 
 	for (pos = &ni_dhcp6_active; *pos; pos = &(*pos)->next) {
@@ -254,6 +253,143 @@ ni_dhcp6_device_set_config(ni_dhcp6_device_t *dev, ni_dhcp6_config_t *config)
 	dev->config = config;
 }
 
+static unsigned int
+ni_dhcp6_ia_timer_lft(ni_dhcp6_ia_t *ia, ni_dhcp6_ia_timer_type_t type)
+{
+	switch (type) {
+	case NI_DHCP6_IA_TIMER_RENEW:
+		return ni_dhcp6_ia_get_renewal_time(ia);
+	case NI_DHCP6_IA_TIMER_REBIND:
+		return ni_dhcp6_ia_get_rebind_time(ia);
+	case NI_DHCP6_IA_TIMER_EXPIRE:
+		return ni_dhcp6_ia_min_preferred_lft(ia);
+	default:
+		return 0;
+	}
+}
+
+static void
+ni_dhcp6_ia_timer_heap_down(ni_dhcp6_ia_timer_heap_t *heap, unsigned int i)
+{
+	ni_dhcp6_ia_timer_t tmp;
+	unsigned int min, child;
+
+	for (;;) {
+		min = i;
+		child = 2 * i + 1;
+		if (child < heap->count && heap->data[child].due < heap->data[min].due)
+			min = child;
+		if (++child < heap->count && heap->data[child].due < heap->data[min].due)
+			min = child;
+		if (min == i)
+			break;
+
+		tmp = heap->data[i];
+		heap->data[i] = heap->data[min];
+		heap->data[min] = tmp;
+		i = min;
+	}
+}
+
+static void
+ni_dhcp6_device_ia_timers_destroy(ni_dhcp6_device_t *dev)
+{
+	unsigned int type;
+
+	for (type = 0; type < NI_DHCP6_IA_TIMER_MAX; ++type) {
+		free(dev->ia_timers[type].data);
+		dev->ia_timers[type].data = NULL;
+		dev->ia_timers[type].count = 0;
+	}
+}
+
+static void
+ni_dhcp6_device_ia_timers_build(ni_dhcp6_device_t *dev)
+{
+	ni_dhcp6_ia_timer_heap_t *heap;
+	ni_dhcp6_ia_timer_t *timer;
+	unsigned int type, count, i;
+	ni_dhcp6_ia_t *ia;
+
+	ni_dhcp6_device_ia_timers_destroy(dev);
+	if (!dev->lease)
+		return;
+
+	for (count = 0, ia = dev->lease->dhcp6.ia_list; ia; ia = ia->next)
+		count++;
+	if (!count)
+		return;
+
+	for (type = 0; type < NI_DHCP6_IA_TIMER_MAX; ++type) {
+		heap = &dev->ia_timers[type];
+		heap->data = xcalloc(count, sizeof(heap->data[0]));
+
+		for (ia = dev->lease->dhcp6.ia_list; ia; ia = ia->next) {
+			timer = &heap->data[heap->count++];
+			timer->ia = ia;
+			timer->lft = ni_dhcp6_ia_timer_lft(ia, type);
+			if ((timer->acquired = ia->time_acquired) == 0)
+				timer->acquired = dev->lease->time_acquired;
+
+			if (timer->lft == NI_DHCP6_INFINITE_LIFETIME)
+				timer->due = ~0ULL;
+			else
+				timer->due = (unsigned long long)timer->acquired + timer->lft;
+		}
+
+		for (i = heap->count / 2; i-- > 0; )
+			ni_dhcp6_ia_timer_heap_down(heap, i);
+	}
+}
+
+/*
+ * The IA due first for a renewal, rebind or to expire
+ */
+const ni_dhcp6_ia_timer_t *
+ni_dhcp6_device_ia_timer_first(const ni_dhcp6_device_t *dev, ni_dhcp6_ia_timer_type_t type)
+{
+	if (type >= NI_DHCP6_IA_TIMER_MAX || !dev->ia_timers[type].count)
+		return NULL;
+	return &dev->ia_timers[type].data[0];
+}
+
+static unsigned int
+__ni_dhcp6_device_ia_timer_mark(ni_dhcp6_ia_timer_heap_t *heap, unsigned int i,
+				unsigned long long now, unsigned int flag)
+{
+	ni_dhcp6_ia_timer_t *timer;
+	unsigned int count = 0;
+
+	/* Children are never due before their parent */
+	if (i >= heap->count || (timer = &heap->data[i])->due > now + 1)
+		return 0;
+
+	if (now > timer->acquired) {
+		timer->ia->flags |= flag;
+		count++;
+	}
+	count += __ni_dhcp6_device_ia_timer_mark(heap, 2 * i + 1, now, flag);
+	count += __ni_dhcp6_device_ia_timer_mark(heap, 2 * i + 2, now, flag);
+	return count;
+}
+
+/*
+ * Set the flag on all IAs which are due (within a second) and
+ * return their number; visits the due IAs only.
+ */
+unsigned int
+ni_dhcp6_device_ia_timer_mark(ni_dhcp6_device_t *dev, ni_dhcp6_ia_timer_type_t type,
+				unsigned int flag)
+{
+	struct timeval now;
+
+	if (type >= NI_DHCP6_IA_TIMER_MAX)
+		return 0;
+
+	ni_timer_get_time(&now);
+	return __ni_dhcp6_device_ia_timer_mark(&dev->ia_timers[type], 0, now.tv_sec, flag);
+}
+
 void
 ni_dhcp6_device_set_lease(ni_dhcp6_device_t *dev,  ni_addrconf_lease_t *lease)
 {
@@ -262,6 +398,7 @@ ni_dhcp6_device_set_lease(ni_dhcp6_device_t *dev,  ni_addrconf_lease_t *lease)
 	dev->lease = lease;
 	if (dev->config && lease)
 		lease->uuid = dev->config->uuid;
+	ni_dhcp6_device_ia_timers_build(dev);
 }
 
 void
@@ -281,6 +418,7 @@ ni_dhcp6_device_drop_lease(ni_dhcp6_device_t *dev)
 {
 	ni_addrconf_lease_t *lease;
 
+	ni_dhcp6_device_ia_timers_destroy(dev);
 	if ((lease = dev->lease) != NULL) {
 		ni_addrconf_lease_free(lease);
 		dev->lease = NULL;
@@ -436,13 +574,25 @@ ni_dhcp6_device_restart(ni_dhcp6_device_t *dev)
 	return rv;
 }
 
+static void
+ni_dhcp6_device_restart_job(void *user_data)
+{
+	ni_dhcp6_device_restart(user_data);
+}
+
+/*
+ * Restart all devices after the supplicant restarted, spread by the
+ * scheduler so we don't send all the solicits at once.
+ */
 void
 ni_dhcp6_restart(void)
 {
 	ni_dhcp6_device_t *dev;
 
 	for (dev = ni_dhcp6_active; dev; dev = dev->next) {
-		ni_dhcp6_device_restart(dev);
+		ni_dhcp6_device_schedule(dev, "restart",
+				ni_dhcp6_device_restart_job,
+				NI_DHCP6_INFINITE_LIFETIME);
 	}
 }
 
@@ -1332,7 +1482,7 @@ ni_dhcp6_device_transmit(ni_dhcp6_device_t *dev)
 		return rv;
 	}
 
-	rv = ni_dhcp6_socket_send(dev->mcast.sock, &dev->message, &dev->mcast.dest);
+	rv = ni_dhcp6_socket_send(dev->mcast.sock, &dev->message, &dev->mcast.dest, &dev->link);
 	if (rv <= 0 || (size_t)rv != cnt) {
 		/* Hmm... advance retrans.count here? Use stop? */
 
@@ -1471,6 +1621,56 @@ ni_dhcp6_config_max_lease_time(void)
 	return ni_global.config->addrconf.dhcp6.lease_time;
 }
 
+ni_bool_t
+ni_dhcp6_config_shared_socket(void)
+{
+	return ni_global.config->addrconf.dhcp6.shared_socket;
+}
+
+/*
+ * The transmit scheduler of the supplicant
+ */
+ni_txsched_t *
+ni_dhcp6_txsched(void)
+{
+	static ni_txsched_t *sched;
+
+	if (sched == NULL) {
+		const struct ni_config_tx_schedule *conf = &ni_global.config->addrconf.tx_schedule;
+
+		sched = ni_txsched_new("dhcp6", conf->window, conf->rate, conf->burst);
+	}
+	return sched;
+}
+
+/*
+ * Schedule a restart, renew or rebind, which is run within timeout
+ * seconds at latest (infinite lifetime for no deadline). A timeout
+ * of 0 means the remaining time is used up already -- e.g. T2 passed
+ * while we were suspended -- so the job is due right away and must
+ * not wait for the rate limit.
+ */
+void
+ni_dhcp6_device_schedule(ni_dhcp6_device_t *dev, const char *what,
+			ni_txsched_func_t *func, unsigned int timeout)
+{
+	struct timeval deadline;
+
+	ni_debug_dhcp("%s: scheduling %s", dev->ifname, what);
+	timerclear(&deadline);
+	if (timeout != NI_DHCP6_INFINITE_LIFETIME) {
+		ni_timer_get_time(&deadline);
+		deadline.tv_sec += timeout;
+	}
+	ni_txsched_submit(ni_dhcp6_txsched(), &dev->txjob, what, func, dev, &deadline);
+}
+
+void
+ni_dhcp6_device_unschedule(ni_dhcp6_device_t *dev)
+{
+	ni_txsched_cancel(&dev->txjob);
+}
+
 ni_string_array_t *
 ni_dhcp6_get_ia_addrs(struct ni_dhcp6_ia *ia_list, ni_var_array_t *p_lft, ni_var_array_t *v_lft)
 {
@@ -40,12 +40,21 @@ extern void		ni_dhcp6_device_stop(ni_dhcp6_device_t *);
 
 extern void		ni_dhcp6_device_set_lease(ni_dhcp6_device_t *,  ni_addrconf_lease_t *);
 extern void		ni_dhcp6_device_drop_lease(ni_dhcp6_device_t *);
+extern const ni_dhcp6_ia_timer_t *ni_dhcp6_device_ia_timer_first(const ni_dhcp6_device_t *,
+					ni_dhcp6_ia_timer_type_t);
+extern unsigned int	ni_dhcp6_device_ia_timer_mark(ni_dhcp6_device_t *,
+					ni_dhcp6_ia_timer_type_t, unsigned int);
 extern void		ni_dhcp6_device_set_best_offer(ni_dhcp6_device_t *, ni_addrconf_lease_t *, int);
 extern void		ni_dhcp6_device_drop_best_offer(ni_dhcp6_device_t *);
 
 extern unsigned int	ni_dhcp6_device_uptime(const ni_dhcp6_device_t *, unsigned int);
 extern int		ni_dhcp6_device_iaid(const ni_dhcp6_device_t *dev, uint32_t *iaid);
 
+extern ni_txsched_t *	ni_dhcp6_txsched(void);
+extern void		ni_dhcp6_device_schedule(ni_dhcp6_device_t *, const char *,
+					ni_txsched_func_t *, unsigned int);
+extern void		ni_dhcp6_device_unschedule(ni_dhcp6_device_t *);
+
 /* config access [/etc/wicked/config.xml, node /config/addrconf/dhcp6] */
 extern const char *	ni_dhcp6_config_default_duid(ni_opaque_t *);
 extern int		ni_dhcp6_config_user_class(ni_string_array_t *);
@@ -55,5 +64,6 @@ extern int		ni_dhcp6_config_ignore_server(struct in6_addr);
 extern ni_bool_t	ni_dhcp6_config_have_server_preference(void);
 extern ni_bool_t	ni_dhcp6_config_server_preference(const struct in6_addr *, const ni_opaque_t *, int *);
 extern unsigned int	ni_dhcp6_config_max_lease_time(void);
+extern ni_bool_t	ni_dhcp6_config_shared_socket(void);
 
 #endif /* __WICKED_DHCP6_DEVICE_H__ */
@@ -28,6 +28,7 @@
 #include <wicked/socket.h>
 #include "dhcp6/options.h"
 #include "buffer.h"
+#include "txsched.h"
 
 /*
  * -- type definitions
@@ -133,6 +134,34 @@ struct ni_dhcp6_config {
 };
 
 
+/*
+ * -- IA lifetime timers
+ *
+ * The renewal (T1), rebind (T2) and expire (shortest preferred lifetime)
+ * times of the IAs in the device lease, each kept in a min-heap by the
+ * time they are due at, so the fsm finds the next IA to act on without
+ * walking all IAs and their addresses. Rebuilt when the lease is set.
+ */
+typedef enum {
+	NI_DHCP6_IA_TIMER_RENEW,
+	NI_DHCP6_IA_TIMER_REBIND,
+	NI_DHCP6_IA_TIMER_EXPIRE,
+
+	NI_DHCP6_IA_TIMER_MAX
+} ni_dhcp6_ia_timer_type_t;
+
+typedef struct ni_dhcp6_ia_timer {
+	unsigned long long	due;		/* acquired + lft, ~0ULL: infinite */
+	unsigned int		acquired;
+	unsigned int		lft;
+	ni_dhcp6_ia_t *		ia;
+} ni_dhcp6_ia_timer_t;
+
+typedef struct ni_dhcp6_ia_timer_heap {
+	unsigned int		count;
+	ni_dhcp6_ia_timer_t *	data;
+} ni_dhcp6_ia_timer_heap_t;
+
 /*
  * -- dhcp6 device
  *
@@ -161,12 +190,14 @@ struct ni_dhcp6_device {
 	ni_dhcp6_request_t *	request;	/* the wicked request params	*/
 	ni_dhcp6_config_t *	config;		/* config built from request	*/
 	ni_addrconf_lease_t *	lease;		/* last acquired lease		*/
+	ni_dhcp6_ia_timer_heap_t ia_timers[NI_DHCP6_IA_TIMER_MAX];
 
 	struct {
 	    int			state;
 	    unsigned int	fail_on_timeout : 1;
 	    const ni_timer_t *	timer;
 	} fsm;
+	ni_txsched_job_t	txjob;		/* scheduled restart, renew, rebind */
 
 	struct {
 	    struct timeval	start;		/* when we've sent first msg        */
@@ -207,6 +238,7 @@ extern ni_dhcp6_device_t *	ni_dhcp6_device_new(const char *, const ni_linkinfo_t
 extern ni_dhcp6_device_t *	ni_dhcp6_device_get(ni_dhcp6_device_t *);
 extern void			ni_dhcp6_device_put(ni_dhcp6_device_t *);
 
+extern ni_dhcp6_device_t *	ni_dhcp6_active;
 extern ni_dhcp6_device_t *	ni_dhcp6_device_by_index(unsigned int);
 extern ni_dhcp6_device_t *	ni_dhcp6_device_by_index_show_all(unsigned int);
 
@@ -220,6 +252,7 @@ enum ni_dhcp6_event {
 	NI_DHCP6_EVENT_ACQUIRED = NI_EVENT_LEASE_ACQUIRED,
 	NI_DHCP6_EVENT_RELEASED = NI_EVENT_LEASE_RELEASED,
 	NI_DHCP6_EVENT_LOST     = NI_EVENT_LEASE_LOST,
+	NI_DHCP6_EVENT_UPDATED  = NI_EVENT_LEASE_UPDATED,
 };
 
 typedef void			ni_dhcp6_event_handler_t(enum ni_dhcp6_event,
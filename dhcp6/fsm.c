@@ -29,12 +29,15 @@
 
 #include <wicked/logging.h>
 #include <wicked/resolver.h>
+#include <wicked/system.h>
+#include <wicked/xml.h>
 
 #include "dhcp6/dhcp6.h"
 #include "dhcp6/device.h"
 #include "dhcp6/protocol.h"
 #include "dhcp6/fsm.h"
 #include "duid.h"
+#include "leasefile.h"
 
 
 struct ni_dhcp6_message {
@@ -55,11 +58,14 @@ static int			ni_dhcp6_fsm_request_lease(ni_dhcp6_device_t *, const ni_addrconf_l
 static int			ni_dhcp6_fsm_confirm_lease(ni_dhcp6_device_t *, const ni_addrconf_lease_t *);
 static int			ni_dhcp6_fsm_renew(ni_dhcp6_device_t *);
 static int			ni_dhcp6_fsm_rebind(ni_dhcp6_device_t *);
+static void			ni_dhcp6_fsm_renew_job(void *);
+static void			ni_dhcp6_fsm_rebind_job(void *);
 static int			ni_dhcp6_fsm_decline(ni_dhcp6_device_t *);
 static int			ni_dhcp6_fsm_request_info (ni_dhcp6_device_t *);
 
 static int			ni_dhcp6_fsm_accept_offer(ni_dhcp6_device_t *dev);
 static int			ni_dhcp6_fsm_commit_lease (ni_dhcp6_device_t *, ni_addrconf_lease_t *);
+static int			ni_dhcp6_fsm_update_lease (ni_dhcp6_device_t *, ni_addrconf_lease_t *);
 static int			ni_dhcp6_fsm_bound(ni_dhcp6_device_t *);
 
 static unsigned int		ni_dhcp6_fsm_get_renewal_timeout(ni_dhcp6_device_t *);
@@ -150,6 +156,7 @@ ni_dhcp6_fsm_reset(ni_dhcp6_device_t *dev)
 {
 	dev->fsm.state = NI_DHCP6_STATE_INIT;
 
+	ni_dhcp6_device_unschedule(dev);
 	ni_dhcp6_fsm_timer_cancel(dev);
 	ni_dhcp6_device_retransmit_disarm(dev);
 
@@ -349,12 +356,14 @@ ni_dhcp6_fsm_timeout(ni_dhcp6_device_t *dev)
 		break;
 
 	case NI_DHCP6_STATE_BOUND:
-		ni_dhcp6_fsm_renew(dev);
+		ni_dhcp6_device_schedule(dev, "renew", ni_dhcp6_fsm_renew_job,
+				ni_dhcp6_fsm_get_rebind_timeout(dev));
 		break;
 
 	case NI_DHCP6_STATE_RENEWING:
-		ni_dhcp6_fsm_reset(dev);
-		ni_dhcp6_fsm_rebind(dev);
+		ni_dhcp6_device_retransmit_disarm(dev);
+		ni_dhcp6_device_schedule(dev, "rebind", ni_dhcp6_fsm_rebind_job,
+				ni_dhcp6_fsm_get_expire_timeout(dev));
 		break;
 
 	case NI_DHCP6_STATE_REBINDING:
@@ -710,7 +719,7 @@ __fsm_renew_process_msg(ni_dhcp6_device_t *dev, struct ni_dhcp6_message *msg, ni
 		/*
 		 * FIXME: implement update/merge of the leases!!!
 		 */
-		ni_dhcp6_fsm_commit_lease(dev, msg->lease);
+		ni_dhcp6_fsm_update_lease(dev, msg->lease);
 		msg->lease = NULL;
 		rv = 0;
 	break;
@@ -805,7 +814,7 @@ __fsm_rebind_process_msg(ni_dhcp6_device_t *dev, struct ni_dhcp6_message *msg, n
 		/*
 		 * FIXME: implement update/merge of the leases!!!
 		 */
-		ni_dhcp6_fsm_commit_lease(dev, msg->lease);
+		ni_dhcp6_fsm_update_lease(dev, msg->lease);
 		msg->lease = NULL;
 		rv = 0;
 	break;
@@ -1260,6 +1269,30 @@ ni_dhcp6_fsm_confirm_lease(ni_dhcp6_device_t *dev, const ni_addrconf_lease_t *le
 	return rv;
 }
 
+/*
+ * Renew and rebind are started by the scheduler; the state may have
+ * changed meanwhile.
+ */
+static void
+ni_dhcp6_fsm_renew_job(void *user_data)
+{
+	ni_dhcp6_device_t *dev = user_data;
+
+	if (dev->fsm.state == NI_DHCP6_STATE_BOUND && dev->lease)
+		ni_dhcp6_fsm_renew(dev);
+}
+
+static void
+ni_dhcp6_fsm_rebind_job(void *user_data)
+{
+	ni_dhcp6_device_t *dev = user_data;
+
+	if (dev->fsm.state == NI_DHCP6_STATE_RENEWING && dev->lease) {
+		ni_dhcp6_fsm_reset(dev);
+		ni_dhcp6_fsm_rebind(dev);
+	}
+}
+
 static int
 ni_dhcp6_fsm_renew(ni_dhcp6_device_t *dev)
 {
@@ -1589,6 +1622,132 @@ ni_dhcp6_fsm_commit_lease(ni_dhcp6_device_t *dev, ni_addrconf_lease_t *lease)
 	return 0;
 }
 
+/*
+ * The lease options as xml string, without the IAs and addresses,
+ * to check whether a reply changed any of them.
+ */
+static char *
+__ni_dhcp6_fsm_lease_options_xml(const ni_addrconf_lease_t *lease)
+{
+	static const struct group_map {
+		const char *name;
+		int       (*func)(const ni_addrconf_lease_t *lease, xml_node_t *node);
+	} *g, group_map[] = {
+		{ NI_ADDRCONF_LEASE_XML_DNS_DATA_NODE, ni_addrconf_lease_dns_data_to_xml },
+		{ NI_ADDRCONF_LEASE_XML_NIS_DATA_NODE, ni_addrconf_lease_nis_data_to_xml },
+		{ NI_ADDRCONF_LEASE_XML_NTP_DATA_NODE, ni_addrconf_lease_ntp_data_to_xml },
+		{ NI_ADDRCONF_LEASE_XML_SIP_DATA_NODE, ni_addrconf_lease_sip_data_to_xml },
+		{ NI_ADDRCONF_LEASE_XML_PTZ_DATA_NODE, ni_addrconf_lease_ptz_data_to_xml },
+		{ NULL, NULL }
+	};
+	xml_node_t *node;
+	unsigned int i;
+	char *str;
+
+	node = xml_node_new("lease", NULL);
+	xml_node_new_element("hostname", node, lease->hostname);
+	xml_node_new_element("boot-url", node, lease->dhcp6.boot_url);
+	for (i = 0; i < lease->dhcp6.boot_params.count; ++i)
+		xml_node_new_element("boot-param", node, lease->dhcp6.boot_params.data[i]);
+
+	for (g = group_map; g->name && g->func; ++g)
+		g->func(lease, xml_node_new(g->name, node));
+
+	str = xml_node_sprint(node);
+	xml_node_free(node);
+	return str;
+}
+
+/*
+ * Check whether a renew or rebind reply only extends the lifetimes of
+ * the lease we have: the same IAs with the same addresses or prefixes
+ * in the same order, and no other changes in the options.
+ */
+static ni_bool_t
+ni_dhcp6_fsm_lease_lifetimes_only(const ni_addrconf_lease_t *old, const ni_addrconf_lease_t *new)
+{
+	const ni_dhcp6_ia_t *oia, *nia;
+	const ni_dhcp6_ia_addr_t *oadr, *nadr;
+	const ni_address_t *oap, *nap;
+	char *ostr, *nstr;
+	ni_bool_t same;
+
+	for (oia = old->dhcp6.ia_list, nia = new->dhcp6.ia_list; oia && nia;
+			oia = oia->next, nia = nia->next) {
+		if (oia->type != nia->type || oia->iaid != nia->iaid
+		 || oia->status.code != nia->status.code)
+			return FALSE;
+
+		for (oadr = oia->addrs, nadr = nia->addrs; oadr && nadr;
+				oadr = oadr->next, nadr = nadr->next) {
+			if (!IN6_ARE_ADDR_EQUAL(&oadr->addr, &nadr->addr)
+			 || oadr->plen != nadr->plen
+			 || oadr->status.code != nadr->status.code)
+				return FALSE;
+		}
+		if (oadr || nadr)
+			return FALSE;
+	}
+	if (oia || nia)
+		return FALSE;
+
+	for (oap = old->addrs, nap = new->addrs; oap && nap;
+			oap = oap->next, nap = nap->next) {
+		if (!ni_sockaddr_equal(&oap->local_addr, &nap->local_addr)
+		 || oap->prefixlen != nap->prefixlen)
+			return FALSE;
+	}
+	if (oap || nap)
+		return FALSE;
+
+	ostr = __ni_dhcp6_fsm_lease_options_xml(old);
+	nstr = __ni_dhcp6_fsm_lease_options_xml(new);
+	same = ostr && nstr && ni_string_eq(ostr, nstr);
+	ni_string_free(&ostr);
+	ni_string_free(&nstr);
+	return same;
+}
+
+/*
+ * Apply a renew or rebind reply. When it only extends the lifetimes,
+ * we refresh them on the addresses directly with one netlink batch,
+ * instead of a commit, where wickedd applies the whole lease again.
+ */
+static int
+ni_dhcp6_fsm_update_lease(ni_dhcp6_device_t *dev, ni_addrconf_lease_t *lease)
+{
+	ni_netconfig_t *nc;
+	ni_netdev_t *ifp;
+	ni_address_t *ap;
+
+	if (!dev->lease || dev->config->dry_run != NI_DHCP6_RUN_NORMAL
+	 || !ni_dhcp6_fsm_lease_lifetimes_only(dev->lease, lease))
+		return ni_dhcp6_fsm_commit_lease(dev, lease);
+
+	/* all the addresses have to be still there */
+	if (!(nc = ni_global_state_handle(0))
+	 || !(ifp = ni_netdev_by_index(nc, dev->link.ifindex)))
+		return ni_dhcp6_fsm_commit_lease(dev, lease);
+
+	for (ap = lease->addrs; ap; ap = ap->next) {
+		if (!ni_address_list_find(ifp->addrs, &ap->local_addr))
+			return ni_dhcp6_fsm_commit_lease(dev, lease);
+	}
+
+	if (ni_system_ipv6_addrs_update_lifetimes(ifp, lease->addrs) < 0)
+		return ni_dhcp6_fsm_commit_lease(dev, lease);
+
+	ni_dhcp6_device_set_lease(dev, lease);
+	ni_note("%s: Updated lifetimes of DHCPv6 lease with %u addresses",
+			dev->ifname, ni_address_list_count(lease->addrs));
+
+	ni_addrconf_lease_file_write(dev->ifname, lease);
+
+	/* let wickedd record the new lifetimes, without reapplying it */
+	ni_dhcp6_send_event(NI_DHCP6_EVENT_UPDATED, dev, lease);
+	return ni_dhcp6_fsm_bound(dev);
+}
+
 static int
 ni_dhcp6_fsm_bound(ni_dhcp6_device_t *dev)
 {
@@ -1624,88 +1783,32 @@ ni_dhcp6_fsm_bound(ni_dhcp6_device_t *dev)
 	return ni_dhcp6_fsm_renew(dev);
 }
 
-static unsigned int
-__ni_dhcp6_fsm_mark_ia_by_time(ni_dhcp6_device_t *dev,  unsigned int (*get_ia_time)(ni_dhcp6_ia_t *),
-							unsigned int flag)
-{
-	unsigned int rt, diff, aq;
-	unsigned int count;
-	struct timeval now;
-	ni_dhcp6_ia_t *ia;
-
-	count = 0;
-	ni_timer_get_time(&now);
-	for (ia = dev->lease->dhcp6.ia_list; ia; ia = ia->next) {
-		rt = get_ia_time(ia);
-
-		if ((aq = ia->time_acquired) == 0)
-			aq = dev->lease->time_acquired;
-
-		if (now.tv_sec > aq) {
-			diff = (now.tv_sec - aq);
-			if (diff + 1 >= rt) {
-				ia->flags |= flag;
-				++ count;
-			}
-		}
-	}
-	return count;
-}
-
 static unsigned int
 ni_dhcp6_fsm_mark_renew_ia(ni_dhcp6_device_t *dev)
 {
-	return __ni_dhcp6_fsm_mark_ia_by_time(dev, ni_dhcp6_ia_get_renewal_time, NI_DHCP6_IA_RENEW);
+	return ni_dhcp6_device_ia_timer_mark(dev, NI_DHCP6_IA_TIMER_RENEW, NI_DHCP6_IA_RENEW);
 }
 
 static unsigned int
 ni_dhcp6_fsm_mark_rebind_ia(ni_dhcp6_device_t *dev)
 {
-	return __ni_dhcp6_fsm_mark_ia_by_time(dev, ni_dhcp6_ia_get_rebind_time, NI_DHCP6_IA_REBIND);
-}
-
-static ni_dhcp6_ia_t *
-__ni_dhcp6_fsm_find_lowest_ia(ni_dhcp6_ia_t *list, unsigned int (*get_ia_time)(ni_dhcp6_ia_t *),
-				unsigned int *ia_lft)
-{
-	unsigned int lowest, lt;
-	ni_dhcp6_ia_t *ia, *ia_low;
-
-	lowest = 0;
-	ia_low = NULL;
-	for (ia = list; ia; ia = ia->next) {
-		lt = get_ia_time(ia);
-		if (ia_low == NULL || lowest > lt) {
-			ia_low = ia;
-			lowest = lt;
-		}
-	}
-	if (ia_lft)
-		*ia_lft = lowest;
-	return ia_low;
+	return ni_dhcp6_device_ia_timer_mark(dev, NI_DHCP6_IA_TIMER_REBIND, NI_DHCP6_IA_REBIND);
 }
 
 static unsigned int
-__ni_dhcp6_fsm_get_timeout(ni_dhcp6_device_t *dev, unsigned int (*get_ia_time)(ni_dhcp6_ia_t *))
+__ni_dhcp6_fsm_get_timeout(ni_dhcp6_device_t *dev, unsigned int lt, unsigned int aq)
 {
-	unsigned int lt, aq, diff;
+	unsigned int diff;
 	struct timeval now;
-	ni_dhcp6_ia_t *ia = NULL;
-
-	ia = __ni_dhcp6_fsm_find_lowest_ia(dev->lease->dhcp6.ia_list,
-						get_ia_time, &lt);
-	if (!ia)
-		return 0;
 
 	/* Infinite lease time .. should we ever refresh it? */
 	if (lt ==  NI_DHCP6_INFINITE_LIFETIME)
 		return lt;
 
 	if (lt > 0) {
-		aq = ia->time_acquired;
 		ni_timer_get_time(&now);
 
-		if (aq == 0 && (aq = dev->lease->time_acquired) == 0) {
+		if (aq == 0) {
 			ni_warn("%s(%s): lease/ia time_acquired is 0 ?!",
 				dev->ifname, __func__);
 			aq = now.tv_sec;
@@ -1722,31 +1825,36 @@ __ni_dhcp6_fsm_get_timeout(ni_dhcp6_device_t *dev, unsigned int (*get_ia_time)(n
 static unsigned int
 ni_dhcp6_fsm_get_renewal_timeout(ni_dhcp6_device_t *dev)
 {
-	return __ni_dhcp6_fsm_get_timeout(dev, ni_dhcp6_ia_get_renewal_time);
+	const ni_dhcp6_ia_timer_t *timer;
+
+	if (!(timer = ni_dhcp6_device_ia_timer_first(dev, NI_DHCP6_IA_TIMER_RENEW)))
+		return 0;
+	return __ni_dhcp6_fsm_get_timeout(dev, timer->lft, timer->acquired);
 }
 
 static unsigned int
 ni_dhcp6_fsm_get_rebind_timeout(ni_dhcp6_device_t *dev)
 {
-	return __ni_dhcp6_fsm_get_timeout(dev, ni_dhcp6_ia_get_rebind_time);
+	const ni_dhcp6_ia_timer_t *timer;
+
+	if (!(timer = ni_dhcp6_device_ia_timer_first(dev, NI_DHCP6_IA_TIMER_REBIND)))
+		return 0;
+	return __ni_dhcp6_fsm_get_timeout(dev, timer->lft, timer->acquired);
 }
 
 
 static unsigned int
 ni_dhcp6_fsm_get_expire_timeout(ni_dhcp6_device_t *dev)
 {
-	unsigned int lt, at, diff;
-	struct timeval now;
-	ni_dhcp6_ia_t *ia = NULL;
+	const ni_dhcp6_ia_timer_t *timer;
+	unsigned int lt;
 
-	ia = __ni_dhcp6_fsm_find_lowest_ia(dev->lease->dhcp6.ia_list,
-				ni_dhcp6_ia_min_preferred_lft, &lt);
-	if (!ia)
+	if (!(timer = ni_dhcp6_device_ia_timer_first(dev, NI_DHCP6_IA_TIMER_EXPIRE)))
 		return 0;
 
 	/* Infinite lease time .. should we ever refresh it? */
-	if (lt ==  NI_DHCP6_INFINITE_LIFETIME)
-		return lt;
+	if (timer->lft ==  NI_DHCP6_INFINITE_LIFETIME)
+		return timer->lft;
 
 	/*
 	 * Hmm... we have to wait until "valid lifetimes of all
@@ -1759,23 +1867,8 @@ ni_dhcp6_fsm_get_expire_timeout(ni_dhcp6_device_t *dev)
 	 */
 	/* lt = ni_dhcp6_ia_max_valid_lft(ia); */
 
-	lt = ni_dhcp6_ia_max_preferred_lft(ia);
-	if (lt > 0) {
-		at = ia->time_acquired;
-		ni_timer_get_time(&now);
-
-		if (at == 0 && (at = dev->lease->time_acquired) == 0) {
-			ni_warn("%s(%s): lease/ia time_acquired is 0 ?!",
-				dev->ifname, __func__);
-			at = now.tv_sec;
-		}
-		if (now.tv_sec > at) {
-			diff = (now.tv_sec - at);
-			if (lt > diff)
-				lt -= diff;
-		}
-	}
-	return lt;
+	lt = ni_dhcp6_ia_max_preferred_lft(timer->ia);
+	return __ni_dhcp6_fsm_get_timeout(dev, lt, timer->acquired);
 }
 
 
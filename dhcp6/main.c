@@ -40,6 +40,7 @@
 
 #include "dhcp6/dbus-api.h"
 #include "dhcp6/tester.h"
+#include "dhcp6/device.h"
 #include "duid.h"
 
 
@@ -295,6 +296,34 @@ static ni_dbus_service_t	__ni_objectmodel_dhcp6_interface = {
 	.name			= NI_OBJECTMODEL_DHCP6_INTERFACE,	/* org.opensuse.Network.DHCP6 */
 };
 
+/*
+ * The debug interface of the root object, exporting the statistics
+ * of the transmit scheduler.
+ */
+static dbus_bool_t
+__ni_objectmodel_dhcp6_get_txsched_stats(ni_dbus_object_t *object, const ni_dbus_method_t *method,
+			unsigned int argc, const ni_dbus_variant_t *argv,
+			ni_dbus_message_t *reply, DBusError *error)
+{
+	ni_dbus_variant_t result = NI_DBUS_VARIANT_INIT;
+	dbus_bool_t rv;
+
+	rv = ni_txsched_get_stats_dict(ni_dhcp6_txsched(), &result)
+	  && ni_dbus_message_serialize_variants(reply, 1, &result, error);
+	ni_dbus_variant_destroy(&result);
+	return rv;
+}
+
+static ni_dbus_method_t		__ni_objectmodel_dhcp6_debug_methods[] = {
+	{ "getTxschedStats",	"",		__ni_objectmodel_dhcp6_get_txsched_stats },
+	{ NULL }
+};
+
+static ni_dbus_service_t	__ni_objectmodel_dhcp6_debug_interface = {
+	.name		= NI_OBJECTMODEL_DEBUG_INTERFACE,
+	.methods	= __ni_objectmodel_dhcp6_debug_methods,
+};
+
 static void			dhcp6_discover_devices(ni_dbus_server_t *);
 static void			dhcp6_protocol_event(enum ni_dhcp6_event, const ni_dhcp6_device_t *, ni_addrconf_lease_t *);
 static void			dhcp6_recover_state(const char *filename);
@@ -311,6 +340,7 @@ dhcp6_register_services(ni_dbus_server_t *server)
 
 	/*  Register the root object (org.opensuse.Network.DHCP6) */
 	ni_dbus_object_register_service(root_object, &__ni_objectmodel_dhcp6_interface);
+	ni_dbus_object_register_service(root_object, &__ni_objectmodel_dhcp6_debug_interface);
 
 	/* Register /org/opensuse/Network/DHCP6/Interface */
 	object = ni_dbus_server_register_object(server, "Interface", &ni_dbus_anonymous_class, NULL);
@@ -655,6 +685,17 @@ dhcp6_protocol_event(enum ni_dhcp6_event ev, const ni_dhcp6_device_t *dev, ni_ad
 				argc, argv);
 		break;
 
+	case NI_DHCP6_EVENT_UPDATED:
+		if (lease == NULL) {
+			ni_error("%s: BUG not send %s event without a lease handle",
+				dev->ifname, NI_OBJECTMODEL_LEASE_UPDATED_SIGNAL);
+			goto done;
+		}
+		ni_dbus_server_send_signal(dhcp6_dbus_server, dev_object,
+				NI_OBJECTMODEL_ADDRCONF_INTERFACE, NI_OBJECTMODEL_LEASE_UPDATED_SIGNAL,
+				argc, argv);
+		break;
+
 	default:
 		break;
 	}
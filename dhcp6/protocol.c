@@ -74,11 +74,22 @@
 //extern int	ni_dhcp6_device_retransmit(ni_dhcp6_device_t *dev);
 
 static void	ni_dhcp6_socket_recv		(ni_socket_t *);
+static void	ni_dhcp6_shared_socket_recv	(ni_socket_t *);
 static int	ni_dhcp6_process_packet		(ni_dhcp6_device_t *dev, ni_buffer_t *msgbuf,
 						 const struct in6_addr *sender);
 
 static int	ni_dhcp6_socket_get_timeout	(const ni_socket_t *sock, struct timeval *tv);
 static void	ni_dhcp6_socket_check_timeout	(ni_socket_t *sock, const struct timeval *now);
+static int	ni_dhcp6_shared_socket_get_timeout(const ni_socket_t *sock, struct timeval *tv);
+static void	ni_dhcp6_shared_socket_check_timeout(ni_socket_t *sock, const struct timeval *now);
+
+/*
+ * The socket shared by all devices when configured
+ */
+static struct {
+	ni_socket_t *	sock;
+	unsigned int	users;
+} ni_dhcp6_shared;
 
 static int	ni_dhcp6_option_next(ni_buffer_t *options, ni_buffer_t *optbuf);
 static int	ni_dhcp6_option_get_duid(ni_buffer_t *bp, ni_opaque_t *duid);
@@ -87,6 +98,21 @@ static int	__ni_dhcp6_parse_client_options(ni_dhcp6_device_t *dev, ni_buffer_t *
 						ni_addrconf_lease_t *lease, ni_bool_t request);
 
 
+/*
+ * Size the receive buffer for a burst of replies; as root, we may
+ * exceed the net.core.rmem_max limit.
+ */
+static void
+__ni_dhcp6_socket_set_rcvbuf(int fd, int size, const char *ifname)
+{
+#if defined(SO_RCVBUFFORCE)
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) == 0)
+		return;
+#endif
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) == -1)
+		ni_error("%s: Cannot set setsockopt(SO_RCVBUF, %d): %m", ifname, size);
+}
+
 /*
  * Open a multicast socket bound to link-local address and dhcp6 client port.
  *
@@ -126,8 +152,7 @@ __ni_dhcp6_mcast_socket_open(const struct ni_dhcp6_link *link, const char *ifnam
 	if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == -1)
 		ni_error("%s: Cannot set setsockopt(SO_REUSEPORT): %m", ifname);
 #endif
-	if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &on, sizeof(on)) == -1)
-		ni_error("%s: Cannot set setsockopt(SO_RCVBUF): %m", ifname);
+	__ni_dhcp6_socket_set_rcvbuf(fd, NI_DHCP6_SOCK_RCVBUF, ifname);
 
 	if (setsockopt(fd, IPPROTO_IPV6, IPV6_RECVPKTINFO, &on, sizeof(on)) != 0)
 		ni_error("%s: Cannot set setsockopt(IPV6_RECVPKTINFO): %m", ifname);
@@ -160,6 +185,108 @@ __ni_dhcp6_mcast_socket_open(const struct ni_dhcp6_link *link, const char *ifnam
 	return fd;
 }
 
+/*
+ * Open the socket shared by all devices, bound to the dhcp6 client
+ * port on any address. Received packets are passed to the device of
+ * the interface in their packet info, the packets we send carry the
+ * interface and link-local source address in their packet info.
+ */
+static int
+__ni_dhcp6_shared_socket_open(void)
+{
+	ni_sockaddr_t saddr;
+	int fd, on;
+
+	if ((fd = socket (PF_INET6, SOCK_DGRAM, IPPROTO_UDP)) == -1) {
+		ni_error("Cannot open shared socket(INET6, DGRAM, UDP): %m");
+		return -1;
+	}
+
+	on = 1;
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == -1)
+		ni_error("dhcp6: Cannot set setsockopt(SO_REUSEADDR): %m");
+#if defined(SO_REUSEPORT)
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == -1)
+		ni_error("dhcp6: Cannot set setsockopt(SO_REUSEPORT): %m");
+#endif
+	__ni_dhcp6_socket_set_rcvbuf(fd, NI_DHCP6_SHARED_RCVBUF, "dhcp6");
+
+	if (setsockopt(fd, IPPROTO_IPV6, IPV6_RECVPKTINFO, &on, sizeof(on)) != 0) {
+		ni_error("dhcp6: Cannot set setsockopt(IPV6_RECVPKTINFO): %m");
+		close(fd);
+		return -1;
+	}
+
+	if (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
+		ni_error("dhcp6: Cannot set fcntl(SETDF, CLOEXEC): %m");
+
+	ni_sockaddr_set_ipv6(&saddr, in6addr_any, NI_DHCP6_CLIENT_PORT);
+	if (bind(fd, &saddr.sa, sizeof(saddr.six)) == -1) {
+		ni_error("dhcp6: Cannot bind(%s): %m", ni_sockaddr_print(&saddr));
+		close(fd);
+		return -1;
+	}
+
+	ni_debug_dhcp("bound shared DHCPv6 socket to [%s]:%u",
+		ni_sockaddr_print(&saddr), ntohs(saddr.six.sin6_port));
+
+	return fd;
+}
+
+/*
+ * Errors reported on the shared socket are not fatal for all
+ * the devices using it; just fetch and log them.
+ */
+static void
+ni_dhcp6_shared_socket_error(ni_socket_t *sock)
+{
+	socklen_t len = sizeof(int);
+	int err = 0;
+
+	if (getsockopt(sock->__fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err)
+		ni_debug_dhcp("error on shared DHCPv6 socket: %s", strerror(err));
+}
+
+static ni_socket_t *
+ni_dhcp6_shared_socket_hold(void)
+{
+	ni_socket_t *sock;
+	int fd;
+
+	if (ni_dhcp6_shared.sock == NULL) {
+		if ((fd = __ni_dhcp6_shared_socket_open()) == -1)
+			return NULL;
+
+		if (!(sock = ni_socket_wrap(fd, SOCK_DGRAM))) {
+			ni_error("Unable to prepare shared DHCPv6 socket");
+			close(fd);
+			return NULL;
+		}
+		sock->receive = ni_dhcp6_shared_socket_recv;
+		sock->handle_error = ni_dhcp6_shared_socket_error;
+		sock->get_timeout = ni_dhcp6_shared_socket_get_timeout;
+		sock->check_timeout = ni_dhcp6_shared_socket_check_timeout;
+
+		ni_buffer_init_dynamic(&sock->rbuf, NI_DHCP6_RBUF_SIZE);
+
+		ni_socket_activate(sock);
+		ni_dhcp6_shared.sock = sock;
+	}
+	ni_dhcp6_shared.users++;
+	return ni_dhcp6_shared.sock;
+}
+
+static void
+ni_dhcp6_shared_socket_release(void)
+{
+	if (!ni_dhcp6_shared.users || --ni_dhcp6_shared.users)
+		return;
+
+	ni_debug_dhcp("closing shared DHCPv6 socket");
+	ni_socket_close(ni_dhcp6_shared.sock);
+	ni_dhcp6_shared.sock = NULL;
+}
+
 /*
  * Open a DHCP6 socket for send and receive
  */
@@ -201,6 +328,13 @@ ni_dhcp6_mcast_socket_open(ni_dhcp6_device_t *dev)
 	dev->mcast.dest.six.sin6_port = htons(NI_DHCP6_SERVER_PORT);
 	dev->mcast.dest.six.sin6_scope_id = dev->link.ifindex;
 
+	if (ni_dhcp6_config_shared_socket()) {
+		if (!(dev->mcast.sock = ni_dhcp6_shared_socket_hold()))
+			return -1;
+		ni_debug_dhcp("%s: using shared DHCPv6 socket", dev->ifname);
+		return 0;
+	}
+
 	/* open the socket an bind to the link-local address */
 	if ((fd = __ni_dhcp6_mcast_socket_open(&dev->link, dev->ifname)) == -1)
 		return -1;
@@ -228,15 +362,27 @@ ni_dhcp6_mcast_socket_open(ni_dhcp6_device_t *dev)
 void
 ni_dhcp6_mcast_socket_close(ni_dhcp6_device_t *dev)
 {
-	if (dev->mcast.sock)
+	if (dev->mcast.sock && dev->mcast.sock == ni_dhcp6_shared.sock)
+		ni_dhcp6_shared_socket_release();
+	else if (dev->mcast.sock)
 		ni_socket_close(dev->mcast.sock);
 	dev->mcast.sock = NULL;
 	memset(&dev->mcast.dest, 0, sizeof(dev->mcast.dest));
 }
 
+/*
+ * Send a message; the packet info selects the interface and the
+ * link-local source address, as required on the shared socket.
+ */
 ssize_t
-ni_dhcp6_socket_send(ni_socket_t *sock, const ni_buffer_t *mesg, const ni_sockaddr_t *dest)
+ni_dhcp6_socket_send(ni_socket_t *sock, const ni_buffer_t *mesg, const ni_sockaddr_t *dest,
+			const struct ni_dhcp6_link *link)
 {
+	unsigned char cbuf[CMSG_SPACE(sizeof(struct in6_pktinfo))];
+	struct in6_pktinfo *pinfo;
+	struct cmsghdr *cm;
+	struct iovec iov;
+	struct msghdr msg;
 	int flags = 0;
 	size_t cnt;
 
@@ -259,8 +405,31 @@ ni_dhcp6_socket_send(ni_socket_t *sock, const ni_buffer_t *mesg, const ni_sockad
 	    ni_sockaddr_is_ipv6_linklocal(dest))
 		flags |= MSG_DONTROUTE;
 
-	return sendto(sock->__fd, ni_buffer_head(mesg), cnt,
-			flags, &dest->sa, sizeof(dest->six));
+	iov.iov_base = ni_buffer_head(mesg);
+	iov.iov_len = cnt;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name = (void *)&dest->six;
+	msg.msg_namelen = sizeof(dest->six);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if (link) {
+		memset(cbuf, 0, sizeof(cbuf));
+		msg.msg_control = cbuf;
+		msg.msg_controllen = sizeof(cbuf);
+
+		cm = CMSG_FIRSTHDR(&msg);
+		cm->cmsg_level = IPPROTO_IPV6;
+		cm->cmsg_type = IPV6_PKTINFO;
+		cm->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
+
+		pinfo = (struct in6_pktinfo *)CMSG_DATA(cm);
+		pinfo->ipi6_ifindex = link->ifindex;
+		pinfo->ipi6_addr = link->addr.six.sin6_addr;
+	}
+
+	return sendmsg(sock->__fd, &msg, flags);
 }
 
 
@@ -276,13 +445,14 @@ __ni_dhcp6_hexdump(ni_stringbuf_t *sbuf, const ni_buffer_t *packet)
 	return ni_format_hex(ni_buffer_head(packet), plen, sbuf->string, sbuf->size);
 }
 
-static void
-ni_dhcp6_socket_recv(ni_socket_t *sock)
+/*
+ * Receive a packet into the socket buffer and return the interface
+ * and our address it was received on from its packet info.
+ * Returns -1 on socket errors and 0 for packets to discard.
+ */
+static ssize_t
+__ni_dhcp6_socket_recvmsg(ni_socket_t *sock, const char *ifname, struct in6_pktinfo *info)
 {
-#ifdef	NI_DHCP6_HEXDUMP_LEVEL
-	ni_stringbuf_t hexbuf = NI_STRINGBUF_INIT_DYNAMIC;
-#endif
-	ni_dhcp6_device_t * dev = sock->user_data;
 	ni_buffer_t * rbuf = &sock->rbuf;
 	unsigned char cbuf[CMSG_SPACE(sizeof(struct in6_pktinfo))];
 	ni_sockaddr_t saddr;
@@ -310,14 +480,14 @@ ni_dhcp6_socket_recv(ni_socket_t *sock)
 	if(bytes < 0) {
 		if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
 			ni_error("%s: recvmsg error on socket %d: %m",
-				dev->ifname, sock->__fd);
-			ni_socket_deactivate(sock);
+				ifname, sock->__fd);
+			return -1;
 		}
-		return;
+		return 0;
 	} else if (bytes == 0) {
 		ni_error("%s: recvmsg didn't returned any data on socket %d",
-			dev->ifname, sock->__fd);
-		return;
+			ifname, sock->__fd);
+		return 0;
 	}
 
 	for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
@@ -330,27 +500,73 @@ ni_dhcp6_socket_recv(ni_socket_t *sock)
 
 	if (pinfo == NULL) {
 		ni_error("%s: discarding packet without packet info on socket %d",
-			dev->ifname, sock->__fd);
-		return;
-	}
-	if(dev->link.ifindex != pinfo->ipi6_ifindex) {
-		ni_error("%s: discarding packet with interface index %u instead %u",
-			dev->ifname, pinfo->ipi6_ifindex, dev->link.ifindex);
-		return;
+			ifname, sock->__fd);
+		return 0;
 	}
 
+	*info = *pinfo;
 	ni_buffer_push_tail(rbuf, bytes);
+	return bytes;
+}
+
+static void
+__ni_dhcp6_socket_process(ni_dhcp6_device_t *dev, ni_buffer_t *rbuf, const struct in6_pktinfo *pinfo)
+{
 #ifdef	NI_DHCP6_HEXDUMP_LEVEL
+	ni_stringbuf_t hexbuf = NI_STRINGBUF_INIT_DYNAMIC;
+
 	ni_debug_verbose(NI_DHCP6_HEXDUMP_LEVEL, NI_TRACE_SOCKET,
-			"%s: received %zd byte packet from %s: %s",
-			dev->ifname, bytes,
+			"%s: received %u byte packet from %s: %s",
+			dev->ifname, ni_buffer_count(rbuf),
 			ni_dhcp6_address_print(&pinfo->ipi6_addr),
 			__ni_dhcp6_hexdump(&hexbuf, rbuf));
 	ni_stringbuf_destroy(&hexbuf);
 #endif
 
 	ni_dhcp6_process_packet(dev, rbuf, &pinfo->ipi6_addr);
-	ni_buffer_reset(rbuf);
+}
+
+static void
+ni_dhcp6_socket_recv(ni_socket_t *sock)
+{
+	ni_dhcp6_device_t * dev = sock->user_data;
+	struct in6_pktinfo pinfo;
+	ssize_t bytes;
+
+	bytes = __ni_dhcp6_socket_recvmsg(sock, dev->ifname, &pinfo);
+	if (bytes < 0) {
+		ni_socket_deactivate(sock);
+	} else if (bytes > 0) {
+		if (dev->link.ifindex != pinfo.ipi6_ifindex) {
+			ni_error("%s: discarding packet with interface index %u instead %u",
+				dev->ifname, pinfo.ipi6_ifindex, dev->link.ifindex);
+		} else {
+			__ni_dhcp6_socket_process(dev, &sock->rbuf, &pinfo);
+		}
+	}
+	ni_buffer_reset(&sock->rbuf);
+}
+
+/*
+ * Pass packets received on the shared socket to the device
+ * of the interface they were received on.
+ */
+static void
+ni_dhcp6_shared_socket_recv(ni_socket_t *sock)
+{
+	ni_dhcp6_device_t *dev;
+	struct in6_pktinfo pinfo;
+
+	if (__ni_dhcp6_socket_recvmsg(sock, "dhcp6", &pinfo) > 0) {
+		dev = ni_dhcp6_device_by_index(pinfo.ipi6_ifindex);
+		if (dev && dev->mcast.sock == sock) {
+			__ni_dhcp6_socket_process(dev, &sock->rbuf, &pinfo);
+		} else {
+			ni_debug_dhcp("discarding packet received on interface index %u"
+					" without active DHCPv6 device", pinfo.ipi6_ifindex);
+		}
+	}
+	ni_buffer_reset(&sock->rbuf);
 }
 
 static int
@@ -485,6 +701,39 @@ ni_dhcp6_socket_check_timeout(ni_socket_t *sock, const struct timeval *now)
 	}
 }
 
+/*
+ * The shared socket reports the earliest retransmit deadline
+ * of the devices using it.
+ */
+static int
+ni_dhcp6_shared_socket_get_timeout(const ni_socket_t *sock, struct timeval *tv)
+{
+	ni_dhcp6_device_t *dev;
+
+	timerclear(tv);
+	for (dev = ni_dhcp6_active; dev; dev = dev->next) {
+		if (dev->mcast.sock != sock || !timerisset(&dev->retrans.deadline))
+			continue;
+		if (!timerisset(tv) || timercmp(&dev->retrans.deadline, tv, <))
+			*tv = dev->retrans.deadline;
+	}
+	return timerisset(tv) ? 0 : -1;
+}
+
+static void
+ni_dhcp6_shared_socket_check_timeout(ni_socket_t *sock, const struct timeval *now)
+{
+	ni_dhcp6_device_t *dev, *next;
+
+	for (dev = ni_dhcp6_active; dev; dev = next) {
+		next = dev->next;
+		if (dev->mcast.sock != sock || !timerisset(&dev->retrans.deadline))
+			continue;
+		if (timercmp(&dev->retrans.deadline, now, <))
+			ni_dhcp6_device_retransmit(dev);
+	}
+}
+
 /*
  * Inline functions for setting/retrieving options from a buffer
  */
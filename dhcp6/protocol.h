@@ -29,6 +29,8 @@
  */
 #define NI_DHCP6_RBUF_SIZE		65536		/* max. UDP packet  */
 #define NI_DHCP6_WBUF_SIZE		1280		/* initial size     */
+#define NI_DHCP6_SOCK_RCVBUF		(256 * 1024)	/* per interface    */
+#define NI_DHCP6_SHARED_RCVBUF		(1024 * 1024)	/* all interfaces   */
 
 /*
  * We use the preferred lifetime (== lease time) to adjust
@@ -224,7 +226,8 @@ extern int		ni_dhcp6_check_client_header(ni_dhcp6_device_t *dev, const struct in
 
 extern int		ni_dhcp6_mcast_socket_open(ni_dhcp6_device_t *);
 extern void		ni_dhcp6_mcast_socket_close(ni_dhcp6_device_t *);
-extern ssize_t		ni_dhcp6_socket_send(ni_socket_t *, const ni_buffer_t *, const ni_sockaddr_t *);
+extern ssize_t		ni_dhcp6_socket_send(ni_socket_t *, const ni_buffer_t *, const ni_sockaddr_t *,
+						const struct ni_dhcp6_link *);
 
 
 /* FIXME: cleanup */
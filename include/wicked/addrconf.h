@@ -125,6 +125,7 @@ struct ni_addrconf_lease {
 		ni_opaque_t		client_id;
 		struct in_addr		server_id;
 		struct in_addr		relay_addr;
+		ni_bool_t		rapid_commit;
 
 		struct in_addr		address;
 		struct in_addr		netmask;
@@ -158,7 +159,8 @@ struct ni_addrconf_lease {
 enum ni_lease_event {
 	NI_EVENT_LEASE_ACQUIRED,
 	NI_EVENT_LEASE_RELEASED,
-	NI_EVENT_LEASE_LOST
+	NI_EVENT_LEASE_LOST,
+	NI_EVENT_LEASE_UPDATED
 };
 
 extern ni_addrconf_lease_t *ni_addrconf_lease_new(int type, int family);
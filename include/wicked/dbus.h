@@ -29,6 +29,11 @@ struct ni_dbus_variant {
 	int			type;
 	unsigned int		__magic;
 
+	/* Set if the value was deserialized into the variant pool of
+	 * a message; arrays are pool memory and strings are borrowed
+	 * from the message, both are released with the message. */
+	unsigned int		__pooled;
+
 	/* Only valid if this variant is an array
 	 * In the case of a struct, array.len holds
 	 * the number of struct members.
@@ -143,6 +148,8 @@ struct ni_dbus_object {
 	char *			path;		/* absolute path */
 	void *			handle;		/* local object */
 	ni_dbus_object_t *	children;
+	struct ni_dbus_object_index *child_index;	/* children by name */
+	ni_dbus_object_t *	index_next;	/* parent's child_index chain */
 	const ni_dbus_service_t **interfaces;
 
 	ni_dbus_server_object_t *server_object;
@@ -151,10 +158,30 @@ struct ni_dbus_object {
 
 typedef void			ni_dbus_async_callback_t(ni_dbus_object_t *proxy,
 					ni_dbus_message_t *reply);
+typedef void			ni_dbus_async_reply_callback_t(ni_dbus_message_t *reply,
+					void *user_data);
 typedef void			ni_dbus_signal_handler_t(ni_dbus_connection_t *connection,
 					ni_dbus_message_t *signal_msg,
 					void *user_data);
 
+/*
+ * Selects what ni_dbus_object_get_managed_objects_filtered retrieves;
+ * empty arrays do not restrict. A chunk_size of 0 gets all in one reply.
+ */
+typedef struct ni_dbus_object_filter {
+	ni_string_array_t	paths;		/* object path prefixes */
+	ni_string_array_t	interfaces;
+	ni_string_array_t	properties;	/* top-level property names */
+	unsigned int		chunk_size;
+} ni_dbus_object_filter_t;
+
+#define NI_DBUS_OBJECT_FILTER_INIT { \
+	.paths = NI_STRING_ARRAY_INIT, \
+	.interfaces = NI_STRING_ARRAY_INIT, \
+	.properties = NI_STRING_ARRAY_INIT, \
+	.chunk_size = 0 \
+}
+
 extern ni_dbus_object_t *	ni_dbus_server_get_root_object(const ni_dbus_server_t *);
 extern ni_dbus_object_t *	ni_dbus_server_register_object(ni_dbus_server_t *server,
 					const char *object_path,
@@ -165,6 +192,19 @@ extern ni_dbus_object_t *	ni_dbus_server_find_object_by_handle(ni_dbus_server_t
 extern dbus_bool_t		ni_dbus_server_send_signal(ni_dbus_server_t *server, ni_dbus_object_t *object,
 					const char *interface, const char *signal_name,
 					unsigned int nargs, const ni_dbus_variant_t *args);
+extern dbus_bool_t		ni_dbus_server_send_path_signal(ni_dbus_server_t *server, const char *object_path,
+					const char *interface, const char *signal_name,
+					unsigned int nargs, const ni_dbus_variant_t *args);
+extern dbus_bool_t		ni_dbus_server_listen_peers(ni_dbus_server_t *, const char *socket_path);
+extern dbus_bool_t		ni_dbus_server_add_subscriber(ni_dbus_server_t *, ni_dbus_connection_t *,
+					const char *name);
+extern dbus_bool_t		ni_dbus_server_del_subscriber(ni_dbus_server_t *, ni_dbus_connection_t *,
+					const char *name);
+extern ni_bool_t		ni_dbus_server_has_subscribers(const ni_dbus_server_t *);
+extern dbus_bool_t		ni_dbus_server_send_subscriber_signal(ni_dbus_server_t *,
+					const char *object_path, const char *interface,
+					const char *signal_name, unsigned int nargs,
+					const ni_dbus_variant_t *args);
 
 extern dbus_bool_t		ni_dbus_class_is_subclass(const ni_dbus_class_t *sub, const ni_dbus_class_t *super);
 
@@ -209,6 +249,11 @@ extern dbus_bool_t		ni_dbus_object_get_properties_as_dict(const ni_dbus_object_t
 					const ni_dbus_service_t *interface,
 					ni_dbus_variant_t *dict,
 					DBusError *error);
+extern dbus_bool_t		ni_dbus_object_get_properties_as_dict_projected(const ni_dbus_object_t *object,
+					const ni_dbus_service_t *interface,
+					const ni_string_array_t *names,
+					ni_dbus_variant_t *dict,
+					DBusError *error);
 extern int			ni_dbus_object_translate_error(ni_dbus_object_t *, const DBusError *);
 
 extern const ni_dbus_service_t *ni_dbus_get_standard_service(const char *);
@@ -338,6 +383,7 @@ extern dbus_bool_t		ni_dbus_struct_get_string(const ni_dbus_variant_t *, unsigne
  * Client side functions
  */
 extern ni_dbus_client_t *	ni_dbus_client_open(const char *bus_type, const char *bus_name);
+extern ni_dbus_client_t *	ni_dbus_client_open_peer(const char *socket_path, const char *bus_name);
 extern void			ni_dbus_client_free(ni_dbus_client_t *);
 extern void			ni_dbus_client_add_signal_handler(ni_dbus_client_t *client,
 					const char *sender,
@@ -345,6 +391,13 @@ extern void			ni_dbus_client_add_signal_handler(ni_dbus_client_t *client,
 					const char *object_interface,
 					ni_dbus_signal_handler_t *callback,
 					void *user_data);
+extern void			ni_dbus_client_add_signal_handler_ex(ni_dbus_client_t *client,
+					const char *sender,
+					const char *object_path,
+					const char *object_interface,
+					const char *member,
+					ni_dbus_signal_handler_t *callback,
+					void *user_data);
 extern void			ni_dbus_client_set_call_timeout(ni_dbus_client_t *, unsigned int msec);
 extern void			ni_dbus_client_set_error_map(ni_dbus_client_t *, const ni_intmap_t *);
 extern int			ni_dbus_client_translate_error(ni_dbus_client_t *, const DBusError *);
@@ -372,12 +425,20 @@ extern int			ni_dbus_object_call_simple(const ni_dbus_object_t *,
 					int res_type, void *res_ptr);
 extern int			ni_dbus_object_call_async(ni_dbus_object_t *obj,
 					ni_dbus_async_callback_t *callback, const char *method, ...);
+extern int			ni_dbus_object_call_variant_async(const ni_dbus_object_t *,
+					const char *interface, const char *method,
+					unsigned int nargs, const ni_dbus_variant_t *args,
+					ni_dbus_async_reply_callback_t *callback, void *user_data,
+					DBusError *error);
+extern unsigned int		ni_dbus_object_cancel_async(const ni_dbus_object_t *, const void *user_data);
 
 extern ni_dbus_message_t *	ni_dbus_object_call_new(const ni_dbus_object_t *, const char *method, ...);
 extern ni_dbus_message_t *	ni_dbus_object_call_new_va(const ni_dbus_object_t *obj,
 					const char *method, va_list *app);
 
 extern dbus_bool_t		ni_dbus_object_get_managed_objects(ni_dbus_object_t *, DBusError *, ni_bool_t purge);
+extern dbus_bool_t		ni_dbus_object_get_managed_objects_filtered(ni_dbus_object_t *,
+					const ni_dbus_object_filter_t *, DBusError *);
 extern dbus_bool_t		ni_dbus_object_refresh_properties(ni_dbus_object_t *, const ni_dbus_service_t *, DBusError *);
 extern dbus_bool_t		ni_dbus_object_send_property(ni_dbus_object_t *proxy,
 					const char *service_name,
@@ -415,6 +476,8 @@ typedef struct ni_dbus_xml_validate_context {
 
 extern ni_xs_scope_t *		ni_dbus_xml_init(void);
 extern int			ni_dbus_xml_register_services(ni_xs_scope_t *);
+extern int			ni_dbus_xml_register_classes(ni_xs_scope_t *);
+extern const ni_dbus_service_t *ni_dbus_xml_register_service(ni_xs_service_t *);
 extern unsigned int		ni_dbus_xml_method_num_args(const ni_dbus_method_t *);
 extern const xml_node_t *	ni_dbus_xml_get_argument_metadata(const ni_dbus_method_t *, unsigned int);
 extern int			ni_dbus_xml_map_method_argument(const ni_dbus_method_t *method, unsigned int index,
@@ -140,6 +140,13 @@ struct ni_ifworker {
 		xml_node_t *		node;
 	} config;
 
+	/* Incremental (in place) reload: call only the methods
+	 * bound to one of the changed top-level config nodes. */
+	struct {
+		ni_bool_t		incremental;
+		ni_string_array_t	changed;
+	} reload;
+
 	ni_bool_t		use_default_policies;
 
 	/* The security ID can be used as a set of identifiers
@@ -177,6 +184,16 @@ struct ni_ifworker {
 
 		ni_fsm_require_t *child_state_req_list;
 
+		/* Asynchronous method call of the current action */
+		struct {
+			ni_fsm_transition_t *action;
+			unsigned int	binding;	/* next binding to call */
+			unsigned int	serial;
+			unsigned int	callbacks;
+			ni_bool_t	pending;	/* call in flight */
+			ni_bool_t	done;		/* reply received */
+			int		rv;
+		} call;
 	} fsm;
 	unsigned int		extra_waittime;
 
@@ -227,8 +244,25 @@ struct ni_fsm {
 	ni_fsm_policy_t *	policies;
 
 	ni_dbus_object_t *	client_root_object;
+
+	/* Method calls to keep in flight across workers; 0 uses
+	 * blocking calls. */
+	unsigned int		max_calls_in_flight;
+	unsigned int		calls_in_flight;
+
+	/* Calls queued during a scheduler pass; when at least
+	 * bulk_call_min workers call the same method, they are
+	 * sent in one bulk call. 0 disables bulk calls. */
+	unsigned int		bulk_call_min;
+	struct {
+		unsigned int	count;
+		struct ni_fsm_queued_call *data;
+	} call_queue;
 };
 
+#define NI_FSM_MAX_CALLS_IN_FLIGHT	64
+#define NI_FSM_BULK_CALL_MIN		4
+
 typedef struct ni_ifmatcher {
 	const char *		name;
 	const char *		mode;
@@ -301,6 +335,7 @@ extern ni_bool_t		ni_ifworker_match_alias(const ni_ifworker_t *, const char *);
 extern void			ni_ifworker_set_config(ni_ifworker_t *, xml_node_t *, const char *);
 extern ni_bool_t		ni_ifworker_control_set_usercontrol(ni_ifworker_t *, ni_bool_t);
 extern ni_bool_t		ni_ifworker_control_set_persistent(ni_ifworker_t *, ni_bool_t);
+extern ni_bool_t		ni_ifworker_set_incremental_reload(ni_ifworker_t *, const ni_string_array_t *);
 extern  void			ni_ifworker_rearm(ni_ifworker_t *);
 extern void			ni_ifworker_reset(ni_ifworker_t *);
 extern int			ni_ifworker_bind_early(ni_ifworker_t *, ni_fsm_t *, ni_bool_t);
@@ -13,6 +13,8 @@
 #include "client/client_state.h"
 
 extern ni_xs_scope_t *		ni_objectmodel_init(ni_dbus_server_t *);
+extern void			ni_objectmodel_set_lazy_registration(ni_bool_t);
+extern ni_bool_t		ni_objectmodel_lazy_registration(void);
 extern void			ni_objectmodel_register_all(void);
 extern void			ni_objectmodel_register_netif_classes(void);
 extern void			ni_objectmodel_register_netif_services(void);
@@ -20,6 +22,7 @@ extern void			ni_objectmodel_register_modem_classes(void);
 extern void			ni_objectmodel_register_modem_services(void);
 extern void			ni_objectmodel_register_addrconf_classes(void);
 extern void			ni_objectmodel_register_netif_service(ni_iftype_t, ni_dbus_service_t *);
+extern const ni_dbus_class_t *	ni_objectmodel_register_link_class(const char *);
 extern ni_dbus_server_t *	ni_objectmodel_create_service(void);
 extern ni_bool_t		ni_objectmodel_save_state(const char *);
 extern ni_bool_t		ni_objectmodel_recover_state(const char *, const char **);
@@ -32,6 +35,7 @@ extern ni_dbus_object_t *	ni_objectmodel_register_modem(ni_dbus_server_t *, ni_m
 extern dbus_bool_t		ni_objectmodel_unregister_modem(ni_dbus_server_t *, ni_modem_t *);
 extern int			ni_objectmodel_bind_extensions(void);
 extern void			ni_objectmodel_register_service(const ni_dbus_service_t *);
+extern void			ni_objectmodel_register_service_for_class(ni_dbus_service_t *, const char *);
 extern void			ni_objectmodel_register_class(const ni_dbus_class_t *);
 extern const ni_dbus_class_t *	ni_objectmodel_get_class(const char *);
 extern ni_dbus_class_t *	ni_objectmodel_class_new(const char *, const ni_dbus_class_t *);
@@ -69,6 +73,7 @@ extern ni_dbus_class_t *	ni_objectmodel_class_new(const char *, const ni_dbus_cl
 
 #define NI_OBJECTMODEL_INTERFACE		NI_OBJECTMODEL_NAMESPACE
 #define NI_OBJECTMODEL_NETIFLIST_INTERFACE	NI_OBJECTMODEL_INTERFACE ".InterfaceList"
+#define NI_OBJECTMODEL_DEBUG_INTERFACE		NI_OBJECTMODEL_INTERFACE ".Debug"
 #define NI_OBJECTMODEL_NETIF_INTERFACE		NI_OBJECTMODEL_INTERFACE ".Interface"
 #define NI_OBJECTMODEL_ETHERNET_INTERFACE	NI_OBJECTMODEL_INTERFACE ".Ethernet"
 #define NI_OBJECTMODEL_INFINIBAND_INTERFACE	NI_OBJECTMODEL_INTERFACE ".Infiniband"
@@ -107,6 +112,7 @@ extern ni_dbus_class_t *	ni_objectmodel_class_new(const char *, const ni_dbus_cl
 #define NI_OBJECTMODEL_LEASE_ACQUIRED_SIGNAL	"LeaseAcquired"
 #define NI_OBJECTMODEL_LEASE_RELEASED_SIGNAL	"LeaseReleased"
 #define NI_OBJECTMODEL_LEASE_LOST_SIGNAL	"LeaseLost"
+#define NI_OBJECTMODEL_LEASE_UPDATED_SIGNAL	"LeaseUpdated"
 
 extern const ni_dbus_class_t	ni_objectmodel_netif_class;
 extern const ni_dbus_class_t	ni_objectmodel_addrconf_device_class;
@@ -140,6 +146,8 @@ extern ni_netdev_t *		ni_objectmodel_unwrap_netif(const ni_dbus_object_t *, DBus
 extern ni_dbus_object_t *	ni_objectmodel_get_netif_object(ni_dbus_server_t *, const ni_netdev_t *);
 extern dbus_bool_t		ni_objectmodel_send_netif_event(ni_dbus_server_t *, ni_dbus_object_t *,
 					ni_event_t, const ni_uuid_t *);
+extern void			ni_objectmodel_netif_events_batch(ni_dbus_server_t *,
+					unsigned int rate, unsigned int burst);
 
 extern ni_modem_t *		ni_objectmodel_unwrap_modem(const ni_dbus_object_t *, DBusError *);
 extern ni_dbus_object_t *	ni_objectmodel_get_modem_object(ni_dbus_server_t *, const ni_modem_t *);
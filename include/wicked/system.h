@@ -8,6 +8,7 @@
 #define __WICKED_SYSTEM_H__
 
 #include <wicked/types.h>
+#include <wicked/address.h>
 
 extern int		ni_system_interface_link_change(ni_netdev_t *, const ni_netdev_req_t *);
 extern int		ni_system_interface_link_monitor(ni_netdev_t *);
@@ -70,6 +71,8 @@ extern int		ni_system_ppp_create(ni_netconfig_t *, const char *,
 				ni_ppp_t *, ni_netdev_t **);
 extern int		ni_system_ppp_delete(ni_netdev_t *);
 
+extern int		ni_system_ipv6_addrs_update_lifetimes(ni_netdev_t *, const ni_address_t *);
+
 extern int		ni_system_update_from_lease(const ni_addrconf_lease_t *, const unsigned int, const char *);
 
 #endif /* __WICKED_SYSTEM_H__ */
@@ -95,6 +95,7 @@ ni_managed_device_free(ni_managed_device_t *mdev)
 			mdev->object);
 	ni_assert(mdev->object == NULL);
 
+	ni_nanny_unschedule_recheck_debounced(mdev);
 	if (mdev->worker) {
 		ni_ifworker_release(mdev->worker);
 		mdev->worker = NULL;
@@ -85,11 +85,12 @@ ni_managed_netdev_disable(ni_managed_device_t *mdev)
 
 	ni_nanny_schedule_recheck(&mgr->down, w);
 	ni_nanny_unschedule(&mgr->recheck, w);
+	ni_nanny_unschedule_recheck_debounced(mdev);
 	if (ni_ifworker_complete(w))
 		ni_ifworker_rearm(w);
 
 	mdev->monitor = FALSE;
-	ni_nanny_policy_drop(mdev->worker->name);
+	ni_nanny_policy_drop(mgr, mdev->worker->name);
 	return TRUE;
 }
 
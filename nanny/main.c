@@ -207,47 +207,92 @@ ni_nanny_statedir(void)
 	return path;
 }
 
+/*
+ * Import policies saved in one file per policy by earlier versions
+ */
+static void
+ni_nanny_policy_import(ni_nanny_t *mgr, const char *nanny_dir, ni_string_array_t *imported)
+{
+	ni_string_array_t files = NI_STRING_ARRAY_INIT;
+	unsigned int i;
+
+	if (!ni_scandir(nanny_dir, "policy*.xml", &files))
+		return;
+
+	for (i = 0; i < files.count; ++i) {
+		xml_document_t *doc = NULL;
+		char path[PATH_MAX];
+		char *doc_string;
+		const char *pname;
+		FILE *fp;
+
+		snprintf(path, sizeof(path), "%s/%s", nanny_dir, files.data[i]);
+		if (!(fp = fopen(path, "re"))) {
+			ni_error("Cannot open policy file '%s'", path);
+			continue;
+		}
+
+		doc_string = ni_file_read(fp, NULL);
+		fclose(fp);
+		if (doc_string == NULL) {
+			ni_error("Unable to read policy file %s: %m", path);
+			continue;
+		}
+
+		doc = xml_document_from_string(doc_string, NULL);
+		if (!doc || !doc->root || !doc->root->children ||
+		    !(pname = ni_ifpolicy_get_name(doc->root->children)) ||
+		    !ni_nanny_policy_store_put(mgr->policy_store, pname, doc_string)) {
+			ni_error("Unable to import policy file '%s'", path);
+		} else {
+			ni_string_array_append(imported, path);
+		}
+
+		xml_document_free(doc);
+		ni_string_free(&doc_string);
+	}
+
+	ni_string_array_destroy(&files);
+}
+
 static ni_bool_t
 ni_nanny_policy_load(ni_nanny_t *mgr)
 {
-	ni_string_array_t files = NI_STRING_ARRAY_INIT;
-	char nanny_dir[PATH_MAX] = { '\0' };
+	ni_string_array_t imported = NI_STRING_ARRAY_INIT;
+	char path[PATH_MAX] = { '\0' };
+	const char *nanny_dir;
+	unsigned int i;
 
 	ni_assert(mgr);
 	ni_debug_application("Loading previously saved policies:");
 
-	snprintf(nanny_dir, sizeof(nanny_dir), "%s", ni_nanny_statedir());
-	if (ni_scandir(nanny_dir, "policy*.xml", &files) != 0) {
-		unsigned int i;
+	nanny_dir = ni_nanny_statedir();
+	snprintf(path, sizeof(path), "%s/%s", nanny_dir, "policy.store");
+	if (!(mgr->policy_store = ni_nanny_policy_store_open(path)))
+		return FALSE;
 
-		for (i = 0; i < files.count; ++i) {
-			char path[PATH_MAX];
-			char *doc_string;
-			FILE *fp;
+	ni_nanny_policy_import(mgr, nanny_dir, &imported);
+	if (imported.count && ni_nanny_policy_store_flush(mgr->policy_store)) {
+		for (i = 0; i < imported.count; ++i)
+			unlink(imported.data[i]);
+	}
+	ni_string_array_destroy(&imported);
 
-			snprintf(path, sizeof(path), "%s/%s", nanny_dir, files.data[i]);
-			if (!(fp = fopen(path, "re"))) {
-				ni_error("Cannot open policy file '%s'", path);
-				continue;
-			}
+	for (i = 0; i < mgr->policy_store->count; ++i) {
+		const char *pname = mgr->policy_store->data[i].name;
+		char *doc_string;
 
-			doc_string = ni_file_read(fp, NULL);
-			fclose(fp);
-			if (doc_string == NULL) {
-				ni_error("Unable to read policy file %s: %m", path);
-				continue;
-			}
+		if (!(doc_string = ni_nanny_policy_store_get(mgr->policy_store, i)))
+			continue;
 
-			if (!ni_nanny_create_policy(NULL, mgr, doc_string, TRUE)) {
-				ni_error("Unable to create policy from file '%s'", path);
-				continue;
-			}
+		if (ni_nanny_create_policy_deferred(mgr, doc_string) < 0)
+			ni_error("Unable to create stored policy '%s'", pname);
 
-			ni_string_free(&doc_string);
-		}
+		ni_string_free(&doc_string);
 	}
 
-	ni_string_array_destroy(&files);
+	/* A single hierarchy rebuild and recheck pass for all policies */
+	ni_nanny_schedule_policy_workers(mgr);
 	return TRUE;
 }
 
@@ -300,6 +345,7 @@ babysit(void)
 			ni_fatal("ni_socket_wait failed");
 	}
 
+	ni_nanny_policy_store_close(mgr->policy_store);
 	exit(0);
 }
 
@@ -387,6 +433,26 @@ ni_nanny_config_callback(void *appdata, const xml_node_t *node)
 
 			*pos = match;
 			pos = &match->next;
+		} else
+		if (ni_string_eq(child->name, "debounce")) {
+			const char *attrval;
+
+			/* <debounce window="msec" max-delay="msec"/> */
+			if ((attrval = xml_node_get_attr(child, "window")) != NULL &&
+			    ni_parse_uint(attrval, &nanny->debounce.window, 10) < 0)
+				ni_warn("%s: cannot parse debounce window \"%s\"",
+						xml_node_location(child), attrval);
+
+			if ((attrval = xml_node_get_attr(child, "max-delay")) != NULL &&
+			    ni_parse_uint(attrval, &nanny->debounce.max_delay, 10) < 0)
+				ni_warn("%s: cannot parse debounce max-delay \"%s\"",
+						xml_node_location(child), attrval);
+
+			if (nanny->debounce.max_delay < nanny->debounce.window)
+				nanny->debounce.max_delay = nanny->debounce.window;
+
+			ni_debug_nanny("debounce window=%ums, max-delay=%ums",
+					nanny->debounce.window, nanny->debounce.max_delay);
 		}
 
 skip_option: ;
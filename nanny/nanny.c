@@ -8,6 +8,7 @@
 #endif
 
 #include <sys/poll.h>
+#include <sys/time.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
@@ -81,6 +82,8 @@ ni_nanny_new(void)
 	ni_nanny_t *mgr;
 
 	mgr = xcalloc(1, sizeof(*mgr));
+	mgr->debounce.window = NI_NANNY_DEBOUNCE_WINDOW;
+	mgr->debounce.max_delay = NI_NANNY_DEBOUNCE_MAX_DELAY;
 	return mgr;
 }
 
@@ -152,9 +155,11 @@ ni_nanny_free(ni_nanny_t *mgr)
  * One, devices can be scheduled for a recheck explicitly (eg when they
  * appear via hotplug).
  *
- * Two, all enabled devices are checked when policies have been updated.
+ * Two, monitored devices are checked when policies have been updated and
+ * the policy applicable to them is not the one they are using.
  *
- * Both checks happen once per mainloop iteration.
+ * Both checks happen once per mainloop iteration; workers are removed
+ * from the recheck queue once they have been checked.
  */
 void
 ni_nanny_schedule_recheck(ni_ifworker_array_t *array, ni_ifworker_t *w)
@@ -169,6 +174,67 @@ ni_nanny_unschedule(ni_ifworker_array_t *array, ni_ifworker_t *w)
 	ni_ifworker_array_remove_with_children(array, w);
 }
 
+/*
+ * Policy updates are debounced: the recheck of an affected device is
+ * deferred until no further update arrived within the debounce window,
+ * but at most max-delay after the first one, coalescing a burst of
+ * policy changes into a single recheck.
+ */
+static void
+ni_nanny_recheck_debounce_timeout(void *user_data, const ni_timer_t *timer)
+{
+	ni_managed_device_t *mdev = user_data;
+	ni_nanny_t *mgr = mdev->nanny;
+
+	if (mdev->recheck_timer != timer)
+		return;
+
+	mdev->recheck_timer = NULL;
+	if (mdev->worker) {
+		ni_debug_nanny("%s: recheck after %u coalesced event(s)",
+				mdev->worker->name, mdev->recheck_events);
+		ni_nanny_schedule_recheck(&mgr->recheck, mdev->worker);
+	}
+	mdev->recheck_events = 0;
+}
+
+void
+ni_nanny_schedule_recheck_debounced(ni_managed_device_t *mdev)
+{
+	ni_nanny_t *mgr = mdev->nanny;
+	struct timeval now, delta;
+	unsigned long elapsed;
+
+	if (!mgr->debounce.window) {
+		ni_nanny_schedule_recheck(&mgr->recheck, mdev->worker);
+		return;
+	}
+
+	ni_timer_get_time(&now);
+	mdev->recheck_events++;
+	if (!mdev->recheck_timer) {
+		mdev->recheck_since = now;
+		mdev->recheck_timer = ni_timer_register(mgr->debounce.window,
+				ni_nanny_recheck_debounce_timeout, mdev);
+		return;
+	}
+
+	timersub(&now, &mdev->recheck_since, &delta);
+	elapsed = delta.tv_sec * 1000 + delta.tv_usec / 1000;
+	if (elapsed + mgr->debounce.window <= mgr->debounce.max_delay)
+		mdev->recheck_timer = ni_timer_rearm(mdev->recheck_timer, mgr->debounce.window);
+}
+
+void
+ni_nanny_unschedule_recheck_debounced(ni_managed_device_t *mdev)
+{
+	if (mdev->recheck_timer) {
+		ni_timer_cancel(mdev->recheck_timer);
+		mdev->recheck_timer = NULL;
+	}
+	mdev->recheck_events = 0;
+}
+
 /*
  * Check whether a given interface should be reconfigured
  */
@@ -220,31 +286,68 @@ ni_nanny_recheck(ni_nanny_t *mgr, ni_ifworker_t *w)
 	return count;
 }
 
+/*
+ * Check whether the policy applicable to a device differs from the one
+ * (or the revision of the one) it is currently using.
+ */
+static ni_bool_t
+ni_nanny_policy_changed(ni_nanny_t *mgr, ni_managed_device_t *mdev)
+{
+	static const unsigned int MAX_POLICIES = 20;
+	const ni_fsm_policy_t *policies[MAX_POLICIES];
+	ni_managed_policy_t *mpolicy = NULL;
+	ni_ifworker_t *w = mdev->worker;
+	unsigned int count;
+
+	if (!w)
+		return FALSE;
+
+	w->use_default_policies = TRUE;
+	count = ni_fsm_policy_get_applicable_policies(mgr->fsm, w, policies, MAX_POLICIES);
+	if (count)
+		mpolicy = ni_nanny_get_policy(mgr, policies[count-1]);
+
+	if (mpolicy == mdev->selected_policy &&
+	    (!mpolicy || mpolicy->seqno == mdev->selected_policy_seq))
+		return FALSE;
+
+	ni_debug_nanny("%s: applicable policy changed to %s", w->name,
+			mpolicy ? ni_fsm_policy_name(mpolicy->fsm_policy) : "<none>");
+	return TRUE;
+}
+
 unsigned int
 ni_nanny_recheck_do(ni_nanny_t *mgr)
 {
+	ni_ifworker_array_t ready = NI_IFWORKER_ARRAY_INIT;
 	unsigned int i, count = 0;
 	ni_fsm_t *fsm = mgr->fsm;
 
 	ni_assert(fsm);
-#if 0
 	if (ni_fsm_policies_changed_since(fsm, &mgr->last_policy_seq)) {
 		ni_managed_device_t *mdev;
 
 		for (mdev = mgr->device_list; mdev; mdev = mdev->next) {
-			if (mdev->monitor)
-				ni_nanny_schedule_recheck(&mgr->recheck, mdev->worker);
+			if (mdev->monitor && ni_nanny_policy_changed(mgr, mdev))
+				ni_nanny_schedule_recheck_debounced(mdev);
 		}
 	}
-#endif
 
-	for (i = 0; i < mgr->recheck.count; ++i) {
+	/* Take the workers ready for a recheck off the queue */
+	for (i = 0; i < mgr->recheck.count; ) {
 		ni_ifworker_t *w = mgr->recheck.data[i];
 
-		if (!w->failed && !w->done && !w->pending && !ni_ifworker_active(w))
-			count += ni_nanny_recheck(mgr, w);
+		if (!w->failed && !w->done && !w->pending && !ni_ifworker_active(w)) {
+			ni_ifworker_array_append(&ready, w);
+			ni_ifworker_array_remove(&mgr->recheck, w);
+		} else
+			++i;
 	}
 
+	for (i = 0; i < ready.count; ++i)
+		count += ni_nanny_recheck(mgr, ready.data[i]);
+
+	ni_ifworker_array_destroy(&ready);
 	return count;
 }
 
@@ -338,8 +441,9 @@ ni_nanny_rfkill_event(ni_nanny_t *mgr, ni_rfkill_type_t type, ni_bool_t blocked)
  *      0 - policy already exists
  *      1 - policy created and registered
  */
-int
-ni_nanny_create_policy(ni_dbus_object_t **policy_object, ni_nanny_t *mgr, const char *doc_string, ni_bool_t schedule)
+static int
+__ni_nanny_create_policy(ni_dbus_object_t **policy_object, ni_nanny_t *mgr, const char *doc_string,
+				ni_bool_t schedule, ni_bool_t deferred)
 {
 	xml_node_t *root, *pnode, *config = NULL;
 	ni_fsm_policy_t *policy = NULL;
@@ -399,6 +503,10 @@ ni_nanny_create_policy(ni_dbus_object_t **policy_object, ni_nanny_t *mgr, const
 		goto error;
 	}
 
+	/* Hierarchy and rechecks are done once after a bulk load */
+	if (deferred)
+		goto do_register;
+
 	/* Rebuild the hierarchy cause new policy may hit some matches */
 	ni_fsm_build_hierarchy(fsm, FALSE);
 
@@ -412,10 +520,17 @@ ni_nanny_create_policy(ni_dbus_object_t **policy_object, ni_nanny_t *mgr, const
 	if (!w->kickstarted) {
 		if (ni_ifworker_is_factory_device(w))
 			ni_nanny_schedule_recheck(&mgr->recheck, w);
-		else if (schedule && w->device)
-			ni_nanny_schedule_recheck(&mgr->recheck, w);
+		else if (schedule && w->device) {
+			ni_managed_device_t *mdev;
+
+			if ((mdev = ni_nanny_get_device(mgr, w)))
+				ni_nanny_schedule_recheck_debounced(mdev);
+			else
+				ni_nanny_schedule_recheck(&mgr->recheck, w);
+		}
 	}
 
+do_register:
 	/* Register the policy */
 	if (rv > 0) {
 		ni_managed_policy_t *mpolicy;
@@ -442,6 +557,44 @@ error:
 	return -1;
 }
 
+int
+ni_nanny_create_policy(ni_dbus_object_t **policy_object, ni_nanny_t *mgr, const char *doc_string, ni_bool_t schedule)
+{
+	return __ni_nanny_create_policy(policy_object, mgr, doc_string, schedule, FALSE);
+}
+
+/*
+ * Create a policy without rebuilding the worker hierarchy and scheduling
+ * its worker for a recheck; used to bulk load the stored policies, that
+ * are followed by a single ni_nanny_schedule_policy_workers() pass.
+ */
+int
+ni_nanny_create_policy_deferred(ni_nanny_t *mgr, const char *doc_string)
+{
+	return __ni_nanny_create_policy(NULL, mgr, doc_string, TRUE, TRUE);
+}
+
+void
+ni_nanny_schedule_policy_workers(ni_nanny_t *mgr)
+{
+	ni_fsm_t *fsm = mgr->fsm;
+	unsigned int i;
+
+	ni_fsm_build_hierarchy(fsm, FALSE);
+
+	for (i = 0; i < fsm->workers.count; ++i) {
+		ni_ifworker_t *w = fsm->workers.data[i];
+
+		if (w->type != NI_IFWORKER_TYPE_NETDEV || w->kickstarted)
+			continue;
+		if (!w->config.node)
+			continue;
+
+		if (ni_ifworker_is_factory_device(w) || w->device)
+			ni_nanny_schedule_recheck(&mgr->recheck, w);
+	}
+}
+
 static ni_bool_t
 ni_managed_device_send_progress_info(ni_managed_device_t *mdev, ni_ifworker_t *w, ni_fsm_state_t state)
 {
@@ -572,10 +725,11 @@ ni_nanny_unregister_device(ni_nanny_t *mgr, ni_ifworker_t *w)
 		return;
 	}
 
+	ni_nanny_unschedule_recheck_debounced(mdev);
 	ni_nanny_remove_device(mgr, mdev);
 	ni_objectmodel_unregister_managed_device(mdev);
 	ni_nanny_unschedule(&mgr->recheck, w);
-	ni_nanny_policy_drop(w->name);
+	ni_nanny_policy_drop(mgr, w->name);
 	ni_fsm_destroy_worker(mgr->fsm, w);
 }
 
@@ -1047,20 +1201,9 @@ ni_objectmodel_nanny_create_policy(ni_dbus_object_t *object, const ni_dbus_metho
 }
 
 ni_bool_t
-ni_nanny_policy_drop(const char *pname)
+ni_nanny_policy_drop(ni_nanny_t *mgr, const char *pname)
 {
-	char path[PATH_MAX] = {'\0'};
-
-	ni_managed_policy_filename(pname, path, sizeof(path));
-
-	if (unlink(path) < 0) {
-		if (errno == ENOENT)
-			return TRUE;
-
-		ni_error("Cannot remove policy file '%s': %m", path);
-		return FALSE;
-	}
-	return TRUE;
+	return ni_nanny_policy_store_drop(mgr->policy_store, pname);
 }
 
 /*
@@ -1111,7 +1254,7 @@ ni_objectmodel_nanny_delete_policy(ni_dbus_object_t *object, const ni_dbus_metho
 				if (!ni_objectmodel_unregister_managed_policy(server, cur, name))
 					return FALSE;
 
-				ni_nanny_policy_drop(name);
+				ni_nanny_policy_drop(mgr, name);
 
 				ni_dbus_message_append_object_path(reply,
 					ni_dbus_object_get_path(object));
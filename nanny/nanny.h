@@ -12,11 +12,13 @@
 
 #include <wicked/fsm.h>
 #include <wicked/secret.h>
+#include <wicked/socket.h>
 #include "appconfig.h"
 
 typedef struct ni_nanny		ni_nanny_t;
 typedef struct ni_managed_device ni_managed_device_t;
 typedef struct ni_managed_policy ni_managed_policy_t;
+typedef struct ni_nanny_policy_store ni_nanny_policy_store_t;
 
 typedef enum ni_managed_state {
 	NI_MANAGED_STATE_STOPPED,
@@ -52,6 +54,10 @@ struct ni_managed_device {
 	xml_node_t *		selected_config;
 
 	ni_secret_array_t	secrets;
+
+	const ni_timer_t *	recheck_timer;	// debounced recheck
+	struct timeval		recheck_since;	// first coalesced event
+	unsigned int		recheck_events;
 };
 
 typedef struct ni_nanny_user	ni_nanny_user_t;
@@ -64,6 +70,7 @@ struct ni_nanny_user {
 
 struct ni_managed_policy {
 	ni_managed_policy_t *	next;
+	ni_nanny_t *		nanny;		// back pointer at mgr
 
 	uid_t			owner;
 	unsigned int		seqno;
@@ -71,6 +78,30 @@ struct ni_managed_policy {
 	xml_document_t *	doc;
 };
 
+/*
+ * Append-only store of the policies created via dbus, with an
+ * in-memory index of the last (live) record per policy name.
+ */
+typedef struct ni_nanny_policy_record {
+	char *			name;
+	off_t			offset;		// of the policy document
+	size_t			length;
+	ni_bool_t		deleted;	// delete record, while scanning
+} ni_nanny_policy_record_t;
+
+struct ni_nanny_policy_store {
+	char *			path;
+	int			fd;
+	off_t			size;		// committed file size
+
+	unsigned int		count;		// sorted by name
+	ni_nanny_policy_record_t *data;
+	unsigned int		dead;		// obsolete records in file
+
+	ni_stringbuf_t		pending;	// records to append on flush
+	const ni_timer_t *	timer;
+};
+
 typedef struct ni_nanny_devmatch ni_nanny_devmatch_t;
 enum {
 	NI_NANNY_DEVMATCH_CLASS,
@@ -87,17 +118,26 @@ struct ni_nanny_devmatch {
 	 const ni_dbus_class_t *class;	/* if type is NI_NANNY_DEVMATCH_CLASS */
 };
 
+#define NI_NANNY_DEBOUNCE_WINDOW	250	/* msec */
+#define NI_NANNY_DEBOUNCE_MAX_DELAY	2000	/* msec */
+
 struct ni_nanny {
 	ni_dbus_server_t *	server;
 	ni_fsm_t *		fsm;
 
 	ni_managed_device_t *	device_list;
 	ni_managed_policy_t *	policy_list;
+	ni_nanny_policy_store_t *policy_store;
 
 	unsigned int		last_policy_seq;
 	ni_ifworker_array_t	recheck;
 	ni_ifworker_array_t	down;
 
+	struct {
+		unsigned int	window;		// msec since the last event
+		unsigned int	max_delay;	// msec since the first event
+	} debounce;
+
 	ni_nanny_user_t *	users;
 
 	ni_nanny_devmatch_t *	enable;
@@ -118,6 +158,8 @@ extern void			ni_nanny_free(ni_nanny_t *);
 extern const char *		ni_nanny_statedir(void);
 extern void			ni_nanny_schedule_recheck(ni_ifworker_array_t *, ni_ifworker_t *);
 extern void			ni_nanny_unschedule(ni_ifworker_array_t *, ni_ifworker_t *);
+extern void			ni_nanny_schedule_recheck_debounced(ni_managed_device_t *);
+extern void			ni_nanny_unschedule_recheck_debounced(ni_managed_device_t *);
 extern unsigned int		ni_nanny_recheck_do(ni_nanny_t *mgr);
 extern unsigned int		ni_nanny_down_do(ni_nanny_t *mgr);
 extern void			ni_nanny_register_device(ni_nanny_t *, ni_ifworker_t *);
@@ -133,7 +175,9 @@ extern void			ni_nanny_clear_secrets(ni_nanny_t *mgr,
 extern ni_secret_t *		ni_nanny_get_secret(ni_nanny_t *, uid_t, const ni_security_id_t *, const char *);
 extern void			ni_nanny_rfkill_event(ni_nanny_t *mgr, ni_rfkill_type_t type, ni_bool_t blocked);
 extern int			ni_nanny_create_policy(ni_dbus_object_t **, ni_nanny_t *, const char *, ni_bool_t);
-extern ni_bool_t		ni_nanny_policy_drop(const char *);
+extern int			ni_nanny_create_policy_deferred(ni_nanny_t *, const char *);
+extern void			ni_nanny_schedule_policy_workers(ni_nanny_t *);
+extern ni_bool_t		ni_nanny_policy_drop(ni_nanny_t *, const char *);
 
 extern ni_bool_t		ni_managed_netdev_enable(ni_managed_device_t *);
 extern void			ni_managed_netdev_apply_policy(ni_managed_device_t *, ni_managed_policy_t *, ni_fsm_t *);
@@ -148,7 +192,13 @@ extern int			ni_factory_device_apply_policy(ni_fsm_t *, ni_ifworker_t *, ni_mana
 extern int			ni_managed_device_apply_policy(ni_managed_device_t *mdev, ni_managed_policy_t *mpolicy);
 extern void			ni_managed_device_set_policy(ni_managed_device_t *, ni_managed_policy_t *, xml_node_t *);
 extern void			ni_managed_device_down(ni_managed_device_t *mdev);
-extern ni_bool_t		ni_managed_policy_filename(const char *, char *, size_t);
+
+extern ni_nanny_policy_store_t *ni_nanny_policy_store_open(const char *);
+extern void			ni_nanny_policy_store_close(ni_nanny_policy_store_t *);
+extern char *			ni_nanny_policy_store_get(ni_nanny_policy_store_t *, unsigned int);
+extern ni_bool_t		ni_nanny_policy_store_put(ni_nanny_policy_store_t *, const char *, const char *);
+extern ni_bool_t		ni_nanny_policy_store_drop(ni_nanny_policy_store_t *, const char *);
+extern ni_bool_t		ni_nanny_policy_store_flush(ni_nanny_policy_store_t *);
 
 extern ni_managed_policy_t *	ni_managed_policy_new(ni_nanny_t *, ni_fsm_policy_t *, xml_document_t *);
 extern void			ni_managed_policy_free(ni_managed_policy_t *);
@@ -0,0 +1,482 @@
+/*
+ * Append-only store of the policies created via dbus
+ *
+ * Copyright (C) 2014 SUSE LINUX Products GmbH, Nuernberg, Germany.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/stat.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include <wicked/netinfo.h>
+#include <wicked/logging.h>
+#include <wicked/socket.h>
+#include <wicked/fsm.h>
+
+#include "util_priv.h"
+#include "nanny.h"
+#include "client/ifconfig.h"
+
+/*
+ * The policy store is an append-only file with one record per change:
+ *
+ *	"policy <length> <name>\n" <length bytes of policy xml> "\n"
+ *	"delete 0 <name>\n"
+ *
+ * Changes are collected in memory and appended/fsync'ed in batches.
+ * At open, the record headers are scanned to build a sorted index of
+ * the last record of each policy; the documents are read on demand.
+ * A policy whose last record is a delete is not in the index.
+ */
+#define NI_NANNY_POLICY_STORE_FLUSH_DELAY	100	/* msec */
+#define NI_NANNY_POLICY_STORE_COMPACT_MIN	64	/* dead records */
+#define NI_NANNY_POLICY_STORE_PUT		"policy"
+#define NI_NANNY_POLICY_STORE_DROP		"delete"
+
+static void
+ni_nanny_policy_record_destroy(ni_nanny_policy_record_t *rec)
+{
+	ni_string_free(&rec->name);
+}
+
+static int
+ni_nanny_policy_record_cmp(const void *a, const void *b)
+{
+	const ni_nanny_policy_record_t *ra = a;
+	const ni_nanny_policy_record_t *rb = b;
+	int ret;
+
+	if ((ret = strcmp(ra->name, rb->name)))
+		return ret;
+	/* records of a policy in file order */
+	return ra->offset < rb->offset ? -1 : ra->offset > rb->offset;
+}
+
+static ni_nanny_policy_record_t *
+ni_nanny_policy_store_find(ni_nanny_policy_store_t *store, const char *name, unsigned int *pos)
+{
+	unsigned int lo = 0, hi = store->count;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		int ret = strcmp(name, store->data[mid].name);
+
+		if (ret == 0) {
+			*pos = mid;
+			return &store->data[mid];
+		}
+		if (ret < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	*pos = lo;
+	return NULL;
+}
+
+static void
+ni_nanny_policy_store_index_clear(ni_nanny_policy_store_t *store)
+{
+	unsigned int i;
+
+	for (i = 0; i < store->count; ++i)
+		ni_nanny_policy_record_destroy(&store->data[i]);
+	free(store->data);
+	store->data = NULL;
+	store->count = 0;
+	store->dead = 0;
+}
+
+/*
+ * Scan the record headers and build the index. A truncated or broken
+ * tail (e.g. after a crash while appending) is cut off.
+ */
+static ni_bool_t
+ni_nanny_policy_store_scan(ni_nanny_policy_store_t *store)
+{
+	ni_nanny_policy_record_t *recs = NULL;
+	unsigned int nrecs = 0, i, j;
+	char *data = NULL, *pos, *end;
+	struct stat st;
+	ssize_t len = 0;
+
+	if (fstat(store->fd, &st) < 0) {
+		ni_error("Cannot stat policy store %s: %m", store->path);
+		return FALSE;
+	}
+
+	if (st.st_size > 0) {
+		data = xcalloc(1, st.st_size + 1);
+		len = pread(store->fd, data, st.st_size, 0);
+		if (len < 0) {
+			ni_error("Cannot read policy store %s: %m", store->path);
+			free(data);
+			return FALSE;
+		}
+	}
+
+	pos = data;
+	end = data + len;
+	while (pos && pos < end) {
+		char type[8], name[256], *eol;
+		unsigned long length;
+		ni_bool_t deleted;
+		off_t offset;
+
+		if (!(eol = memchr(pos, '\n', end - pos)))
+			break;
+		*eol = '\0';
+		if (sscanf(pos, "%7s %lu %255s", type, &length, name) != 3 ||
+		    !ni_ifpolicy_name_is_valid(name))
+			break;
+
+		offset = eol + 1 - data;
+		if (ni_string_eq(type, NI_NANNY_POLICY_STORE_PUT)) {
+			if (length >= (unsigned long)(end - eol - 1) ||
+			    eol[1 + length] != '\n')
+				break;
+			deleted = FALSE;
+			pos = eol + 1 + length + 1;
+		} else
+		if (ni_string_eq(type, NI_NANNY_POLICY_STORE_DROP)) {
+			length = 0;
+			deleted = TRUE;
+			pos = eol + 1;
+		} else
+			break;
+
+		if ((nrecs % 64) == 0)
+			recs = xrealloc(recs, (nrecs + 64) * sizeof(recs[0]));
+		recs[nrecs].name = xstrdup(name);
+		recs[nrecs].offset = offset;
+		recs[nrecs].length = length;
+		recs[nrecs].deleted = deleted;
+		nrecs++;
+	}
+
+	store->size = pos ? pos - data : 0;
+	if (store->size < len) {
+		ni_warn("Policy store %s: discarding %lu bytes of broken records",
+			store->path, (unsigned long)(len - store->size));
+		if (ftruncate(store->fd, store->size) < 0)
+			ni_error("Cannot truncate policy store %s: %m", store->path);
+	}
+	free(data);
+
+	/* Keep the last record of each policy, deleted ones drop out */
+	if (nrecs)
+		qsort(recs, nrecs, sizeof(recs[0]), ni_nanny_policy_record_cmp);
+	for (i = j = 0; i < nrecs; ++i) {
+		if (i + 1 < nrecs && ni_string_eq(recs[i].name, recs[i + 1].name)) {
+			ni_nanny_policy_record_destroy(&recs[i]);
+			continue;
+		}
+		if (recs[i].deleted) {
+			ni_nanny_policy_record_destroy(&recs[i]);
+			continue;
+		}
+		recs[j++] = recs[i];
+	}
+	store->data = recs;
+	store->count = j;
+	store->dead = nrecs - j;
+	return TRUE;
+}
+
+ni_nanny_policy_store_t *
+ni_nanny_policy_store_open(const char *path)
+{
+	ni_nanny_policy_store_t *store;
+
+	store = xcalloc(1, sizeof(*store));
+	ni_string_dup(&store->path, path);
+	ni_stringbuf_init(&store->pending);
+
+	store->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+	if (store->fd < 0) {
+		ni_error("Cannot open policy store %s: %m", path);
+		goto failure;
+	}
+
+	if (!ni_nanny_policy_store_scan(store))
+		goto failure;
+
+	ni_debug_nanny("Opened policy store %s: %u policies, %u obsolete records",
+			path, store->count, store->dead);
+	return store;
+
+failure:
+	ni_nanny_policy_store_close(store);
+	return NULL;
+}
+
+void
+ni_nanny_policy_store_close(ni_nanny_policy_store_t *store)
+{
+	if (!store)
+		return;
+
+	if (store->timer) {
+		ni_timer_cancel(store->timer);
+		store->timer = NULL;
+	}
+	if (store->fd >= 0 && store->pending.len)
+		ni_nanny_policy_store_flush(store);
+	if (store->fd >= 0)
+		close(store->fd);
+
+	ni_nanny_policy_store_index_clear(store);
+	ni_stringbuf_destroy(&store->pending);
+	ni_string_free(&store->path);
+	free(store);
+}
+
+/*
+ * Read the policy document of the n-th index entry
+ */
+char *
+ni_nanny_policy_store_get(ni_nanny_policy_store_t *store, unsigned int n)
+{
+	ni_nanny_policy_record_t *rec;
+	char *doc;
+	ssize_t len;
+
+	if (!store || n >= store->count)
+		return NULL;
+
+	rec = &store->data[n];
+	doc = xcalloc(1, rec->length + 1);
+	if (rec->offset >= store->size) {
+		/* not flushed yet */
+		size_t pos = rec->offset - store->size;
+
+		if (pos + rec->length > store->pending.len) {
+			free(doc);
+			return NULL;
+		}
+		memcpy(doc, store->pending.string + pos, rec->length);
+		return doc;
+	}
+
+	len = pread(store->fd, doc, rec->length, rec->offset);
+	if (len < 0 || (size_t)len != rec->length) {
+		ni_error("Cannot read policy %s from store %s: %m",
+				rec->name, store->path);
+		free(doc);
+		return NULL;
+	}
+	return doc;
+}
+
+static void
+ni_nanny_policy_store_timeout(void *user_data, const ni_timer_t *timer)
+{
+	ni_nanny_policy_store_t *store = user_data;
+
+	if (store->timer != timer)
+		return;
+
+	store->timer = NULL;
+	ni_nanny_policy_store_flush(store);
+}
+
+static void
+ni_nanny_policy_store_schedule(ni_nanny_policy_store_t *store)
+{
+	if (!store->timer) {
+		store->timer = ni_timer_register(NI_NANNY_POLICY_STORE_FLUSH_DELAY,
+				ni_nanny_policy_store_timeout, store);
+	}
+}
+
+ni_bool_t
+ni_nanny_policy_store_put(ni_nanny_policy_store_t *store, const char *name, const char *doc)
+{
+	ni_nanny_policy_record_t *rec;
+	unsigned int pos;
+	size_t length;
+
+	if (!store || !ni_ifpolicy_name_is_valid(name) || ni_string_empty(doc))
+		return FALSE;
+
+	length = strlen(doc);
+	ni_stringbuf_printf(&store->pending, "%s %zu %s\n",
+			NI_NANNY_POLICY_STORE_PUT, length, name);
+
+	if ((rec = ni_nanny_policy_store_find(store, name, &pos))) {
+		store->dead++;
+	} else {
+		store->data = xrealloc(store->data, (store->count + 1) * sizeof(*rec));
+		memmove(&store->data[pos + 1], &store->data[pos],
+				(store->count - pos) * sizeof(*rec));
+		store->count++;
+
+		rec = &store->data[pos];
+		rec->name = xstrdup(name);
+	}
+	rec->offset = store->size + store->pending.len;
+	rec->length = length;
+	rec->deleted = FALSE;
+
+	ni_stringbuf_puts(&store->pending, doc);
+	ni_stringbuf_putc(&store->pending, '\n');
+
+	ni_nanny_policy_store_schedule(store);
+	return TRUE;
+}
+
+ni_bool_t
+ni_nanny_policy_store_drop(ni_nanny_policy_store_t *store, const char *name)
+{
+	unsigned int pos;
+
+	if (!store || !ni_nanny_policy_store_find(store, name, &pos))
+		return TRUE;
+
+	ni_nanny_policy_record_destroy(&store->data[pos]);
+	store->count--;
+	memmove(&store->data[pos], &store->data[pos + 1],
+			(store->count - pos) * sizeof(store->data[0]));
+
+	ni_stringbuf_printf(&store->pending, "%s 0 %s\n",
+			NI_NANNY_POLICY_STORE_DROP, name);
+	store->dead += 2;
+
+	ni_nanny_policy_store_schedule(store);
+	return TRUE;
+}
+
+static ni_bool_t
+ni_nanny_policy_store_write(int fd, const char *data, size_t len)
+{
+	while (len) {
+		ssize_t ret = write(fd, data, len);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return FALSE;
+		}
+		data += ret;
+		len -= ret;
+	}
+	return TRUE;
+}
+
+/*
+ * Rewrite the store with the live records only
+ */
+static ni_bool_t
+ni_nanny_policy_store_compact(ni_nanny_policy_store_t *store)
+{
+	char temp[PATH_MAX] = {'\0'};
+	off_t *offsets = NULL;
+	off_t size = 0;
+	unsigned int i;
+	int fd;
+
+	snprintf(temp, sizeof(temp), "%s.XXXXXX", store->path);
+	if ((fd = mkstemp(temp)) < 0) {
+		ni_error("Cannot create %s policy store temp file", store->path);
+		return FALSE;
+	}
+
+	offsets = xcalloc(store->count + 1, sizeof(offsets[0]));
+	for (i = 0; i < store->count; ++i) {
+		ni_nanny_policy_record_t *rec = &store->data[i];
+		char head[300];
+		char *doc;
+		int len;
+
+		if (!(doc = ni_nanny_policy_store_get(store, i)))
+			goto failure;
+
+		len = snprintf(head, sizeof(head), "%s %zu %s\n",
+				NI_NANNY_POLICY_STORE_PUT, rec->length, rec->name);
+		if (!ni_nanny_policy_store_write(fd, head, len) ||
+		    !ni_nanny_policy_store_write(fd, doc, rec->length) ||
+		    !ni_nanny_policy_store_write(fd, "\n", 1)) {
+			ni_error("Cannot write into %s policy store temp file: %m",
+					store->path);
+			free(doc);
+			goto failure;
+		}
+		free(doc);
+
+		offsets[i] = size + len;
+		size += len + rec->length + 1;
+	}
+
+	if (fsync(fd) < 0 || rename(temp, store->path) < 0) {
+		ni_error("Cannot replace policy store %s: %m", store->path);
+		goto failure;
+	}
+
+	close(store->fd);
+	store->fd = open(store->path, O_RDWR | O_APPEND | O_CLOEXEC);
+	close(fd);
+	if (store->fd < 0) {
+		ni_error("Cannot reopen policy store %s: %m", store->path);
+		free(offsets);
+		return FALSE;
+	}
+
+	for (i = 0; i < store->count; ++i)
+		store->data[i].offset = offsets[i];
+	store->size = size;
+	store->dead = 0;
+	free(offsets);
+
+	ni_debug_nanny("Compacted policy store %s: %u policies",
+			store->path, store->count);
+	return TRUE;
+
+failure:
+	free(offsets);
+	close(fd);
+	unlink(temp);
+	return FALSE;
+}
+
+/*
+ * Append all pending records to the store and sync it to disk
+ */
+ni_bool_t
+ni_nanny_policy_store_flush(ni_nanny_policy_store_t *store)
+{
+	if (!store || store->fd < 0)
+		return FALSE;
+
+	if (store->timer) {
+		ni_timer_cancel(store->timer);
+		store->timer = NULL;
+	}
+
+	if (store->pending.len) {
+		if (!ni_nanny_policy_store_write(store->fd, store->pending.string,
+						store->pending.len) ||
+		    fdatasync(store->fd) < 0) {
+			ni_error("Cannot write policy store %s: %m", store->path);
+			/* retry later from the last committed record */
+			if (ftruncate(store->fd, store->size) < 0)
+				ni_error("Cannot truncate policy store %s: %m", store->path);
+			ni_nanny_policy_store_schedule(store);
+			return FALSE;
+		}
+		store->size += store->pending.len;
+		ni_stringbuf_clear(&store->pending);
+	}
+
+	if (store->dead > NI_NANNY_POLICY_STORE_COMPACT_MIN && store->dead > store->count)
+		ni_nanny_policy_store_compact(store);
+
+	return TRUE;
+}
@@ -33,68 +33,29 @@
 #include "nanny.h"
 #include "client/ifconfig.h"
 
-ni_bool_t
-ni_managed_policy_filename(const char *name, char *path, size_t size)
-{
-	if (path && !ni_string_empty(name)) {
-		snprintf(path, size, "%s/%s.xml", ni_nanny_statedir(), name);
-		return TRUE;
-	}
-
-	return FALSE;
-}
-
 static ni_bool_t
-ni_managed_policy_save(xml_node_t *pnode)
+ni_managed_policy_save(ni_managed_policy_t *mpolicy, xml_node_t *pnode)
 {
-	char path[PATH_MAX] = {'\0'};
-	char temp[PATH_MAX] = {'\0'};
+	ni_nanny_t *mgr = mpolicy->nanny;
 	const char *pname;
-	FILE *fp;
-	int fd;
+	ni_bool_t ret;
+	char *doc;
 
-	if (xml_node_is_empty(pnode))
+	if (!mgr || xml_node_is_empty(pnode))
 		return FALSE;
 
 	pname = ni_ifpolicy_get_name(pnode);
 	if (ni_string_empty(pname))
 		return FALSE;
 
-	ni_managed_policy_filename(pname, path, sizeof(path));
-	snprintf(temp, sizeof(temp), "%s.XXXXXX", path);
-
-	if ((fd = mkstemp(temp)) < 0) {
-		ni_error("Cannot create %s policy temp file", path);
+	if (!(doc = xml_node_sprint(pnode))) {
+		ni_error("Cannot format policy %s", pname);
 		return FALSE;
 	}
 
-	if (!(fp = fdopen(fd, "we"))) {
-		close(fd);
-		ni_error("Cannot create %s policy temp file", path);
-		goto failure;
-	}
-
-	if (xml_node_print(pnode, fp) < 0) {
-		ni_error("Cannot write into %s policy temp file", path);
-		xml_node_free(pnode);
-		goto failure;
-	}
-
-	if (rename(temp, path) < 0) {
-		ni_error("Cannot move temp file to policy file %s", path);
-		goto failure;
-	}
-
-	fclose(fp);
-
-	return TRUE;
-
-failure:
-	if (fp) {
-		fclose(fp);
-	}
-	unlink(temp);
-	return FALSE;
+	ret = ni_nanny_policy_store_put(mgr->policy_store, pname, doc);
+	free(doc);
+	return ret;
 }
 
 void
@@ -118,6 +79,7 @@ ni_managed_policy_new(ni_nanny_t *mgr, ni_fsm_policy_t *policy, xml_document_t *
 	ni_managed_policy_t *mpolicy;
 
 	mpolicy = xcalloc(1, sizeof(*mpolicy));
+	mpolicy->nanny = mgr;
 	mpolicy->fsm_policy = policy;
 	mpolicy->doc = doc;
 
@@ -235,7 +197,7 @@ ni_objectmodel_managed_policy_update(ni_dbus_object_t *object, const ni_dbus_met
 	mpolicy->doc = doc;
 	mpolicy->seqno++;
 
-	ni_managed_policy_save(node);
+	ni_managed_policy_save(mpolicy, node);
 	return TRUE;
 }
 
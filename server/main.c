@@ -29,6 +29,9 @@
 #include <wicked/wireless.h>
 #include <wicked/modem.h>
 #include "udev-utils.h"
+#include "appconfig.h"
+#include "dbus-common.h"
+#include "netif-snapshot.h"
 
 enum {
 	OPT_HELP,
@@ -237,6 +240,20 @@ run_interface_server(void)
 	if (schema == NULL)
 		ni_fatal("Cannot initialize objectmodel, giving up.");
 
+	if (ni_global.config)
+		ni_dbus_stats_set_slow_threshold(ni_global.config->dbus_slow_call_threshold);
+
+	if (ni_global.config && ni_global.config->dbus_peer_socket) {
+		if (!ni_dbus_server_listen_peers(dbus_server, ni_global.config->dbus_peer_socket))
+			ni_error("unable to listen for direct dbus connections");
+	}
+
+	if (ni_global.config && ni_global.config->netif_events.batch) {
+		const struct ni_config_netif_events *conf = &ni_global.config->netif_events;
+
+		ni_objectmodel_netif_events_batch(dbus_server, conf->rate, conf->burst);
+	}
+
 	/* open global RTNL socket to listen for kernel events */
 	if (ni_server_listen_interface_events(handle_interface_event) < 0)
 		ni_fatal("unable to initialize netlink listener");
@@ -266,6 +283,11 @@ run_interface_server(void)
 	if (opt_recover_state)
 		recover_state(opt_state_file);
 
+	if (ni_global.config && ni_global.config->netif_snapshot) {
+		if (!ni_netif_snapshot_open(ni_global.config->netif_snapshot))
+			ni_error("unable to publish the interface state snapshot");
+	}
+
 	while (!ni_caught_terminal_signal()) {
 		long timeout;
 
@@ -280,6 +302,7 @@ run_interface_server(void)
 	if (opt_recover_state)
 		ni_objectmodel_save_state(opt_state_file);
 
+	ni_netif_snapshot_close();
 	exit(0);
 }
 
@@ -77,6 +77,13 @@ typedef struct ni_config {
 	struct {
 	    unsigned int		default_allow_update;
 
+	    /* dhcp supplicants: spreading of lease (re)starts, renewals and rebinds */
+	    struct ni_config_tx_schedule {
+		unsigned int		window;		/* max random delay in msec */
+		unsigned int		rate;		/* starts per second, 0: unlimited */
+		unsigned int		burst;
+	    } tx_schedule;
+
 	    struct ni_config_dhcp4 {
 	        unsigned int		allow_update;
 		char *			vendor_class;
@@ -85,6 +92,9 @@ typedef struct ni_config {
 
 		unsigned int		num_preferred_servers;
 		ni_server_preference_t	preferred_server[NI_DHCP_SERVER_PREFERENCES_MAX];
+
+		ni_bool_t		shared_capture;
+		ni_bool_t		rapid_commit;
 	    } dhcp4;
 
 	    struct ni_config_dhcp6 {
@@ -101,6 +111,8 @@ typedef struct ni_config {
 		ni_string_array_t	ignore_servers;
 		unsigned int		num_preferred_servers;
 		ni_server_preference_t	preferred_server[NI_DHCP_SERVER_PREFERENCES_MAX];
+
+		ni_bool_t		shared_socket;
 	    } dhcp6;
 
 	    struct ni_config_autoip {
@@ -108,6 +120,16 @@ typedef struct ni_config {
 	    } autoip;
 	} addrconf;
 
+	/* wickedd: batching and rate limiting of interface event signals */
+	struct ni_config_netif_events {
+		ni_bool_t		batch;
+		unsigned int		rate;		/* signals per second, 0: unlimited */
+		unsigned int		burst;
+	} netif_events;
+
+	/* wickedd: interface state snapshot file for ifstatus --snapshot */
+	char *			netif_snapshot;
+
 	char *			dbus_xml_schema_file;
 	ni_extension_t *	dbus_extensions;
 	ni_extension_t *	ns_extensions;
@@ -120,6 +142,8 @@ typedef struct ni_config {
 
 	char *			dbus_name;
 	char *			dbus_type;
+	char *			dbus_peer_socket;
+	unsigned int		dbus_slow_call_threshold;	/* msec, 0: off */
 } ni_config_t;
 
 extern ni_config_t *	ni_config_new();
@@ -22,6 +22,7 @@
 #include <wicked/dbus-service.h>
 
 #include "client/wicked-client.h"
+#include "util_priv.h"
 
 /*
  * Error context - this is an opaque type.
@@ -408,6 +409,420 @@ out:
 	return rv;
 }
 
+/*
+ * Asynchronous variant of ni_call_common_xml(). The call is sent and the
+ * callback invoked with the result once the reply arrived, so that the
+ * caller can keep several calls in flight. Errors are passed through the
+ * error handler as in the synchronous case, including retries.
+ */
+typedef struct ni_call_async {
+	ni_dbus_object_t *		object;
+	const ni_dbus_service_t *	service;
+	const ni_dbus_method_t *	method;
+	xml_node_t *			config;
+	ni_call_error_context_t		error_context;
+
+	ni_call_async_callback_t *	callback;
+	void *				user_data;
+} ni_call_async_t;
+
+static void	ni_call_common_xml_async_reply(ni_dbus_message_t *, void *);
+
+static void
+ni_call_async_free(ni_call_async_t *call)
+{
+	ni_call_error_context_destroy(&call->error_context);
+	xml_node_free(call->config);
+	free(call);
+}
+
+static int
+ni_call_async_serialize_args(ni_call_async_t *call, ni_dbus_variant_t *argv)
+{
+	int argc = 0;
+
+	if (ni_dbus_xml_method_num_args(call->method)) {
+		ni_dbus_variant_t *dict = &argv[argc++];
+
+		ni_dbus_variant_init_dict(dict);
+		if (call->error_context.config &&
+		    !ni_dbus_xml_serialize_arg(call->method, 0, dict, call->error_context.config)) {
+			ni_error("%s.%s: error serializing argument",
+					call->service->name, call->method->name);
+			ni_dbus_variant_destroy(dict);
+			return -NI_ERROR_CANNOT_MARSHAL;
+		}
+	}
+	return argc;
+}
+
+static int
+ni_call_async_send(ni_call_async_t *call)
+{
+	DBusError error = DBUS_ERROR_INIT;
+	ni_dbus_variant_t argv[1];
+	int rv, argc;
+
+	memset(argv, 0, sizeof(argv));
+	if ((argc = ni_call_async_serialize_args(call, argv)) < 0)
+		return argc;
+
+	rv = ni_dbus_object_call_variant_async(call->object, call->service->name,
+			call->method->name, argc, argv,
+			ni_call_common_xml_async_reply, call, &error);
+	if (rv < 0) {
+		ni_dbus_print_error(&error, "%s.%s() failed",
+				call->service->name, call->method->name);
+		rv = ni_dbus_get_error(&error, NULL);
+	}
+
+	while (argc--)
+		ni_dbus_variant_destroy(&argv[argc]);
+	dbus_error_free(&error);
+	return rv;
+}
+
+/*
+ * Complete an asynchronous call with either an error or the result
+ * variant of the method; consumes the call unless it is retried.
+ */
+static void
+ni_call_async_complete(ni_call_async_t *call, const DBusError *error, const ni_dbus_variant_t *result)
+{
+	ni_objectmodel_callback_info_t *callback_list = NULL;
+	int rv = 0;
+
+	if (error && dbus_error_is_set(error)) {
+		ni_call_error_context_t *error_ctx = &call->error_context;
+
+		ni_debug_dbus("dbus error reply = %s (%s)", error->name, error->message);
+		if (error_ctx->handler) {
+			rv = error_ctx->handler(error_ctx, error);
+			if (rv > 0) {
+				ni_warn("Whaaah. Error context handler returns positive code. "
+					"Assuming programmer mistake");
+				rv = -rv;
+			}
+		} else {
+			ni_dbus_print_error(error, "%s.%s() failed",
+					call->service->name, call->method->name);
+			rv = ni_dbus_get_error(error, NULL);
+		}
+
+		/* The error handler may have fixed up the config; try again */
+		if (rv == -NI_ERROR_RETRY_OPERATION && error_ctx->config) {
+			if ((rv = ni_call_async_send(call)) == 0)
+				return;
+		}
+	} else
+	if (result) {
+		callback_list = ni_objectmodel_callback_info_from_dict(result);
+	}
+
+	call->callback(rv, callback_list, call->user_data);
+	ni_call_async_free(call);
+}
+
+static void
+ni_call_common_xml_async_reply(ni_dbus_message_t *reply, void *user_data)
+{
+	ni_dbus_variant_t result = NI_DBUS_VARIANT_INIT;
+	DBusError error = DBUS_ERROR_INIT;
+	ni_call_async_t *call = user_data;
+
+	if (dbus_set_error_from_message(&error, reply)) {
+		ni_call_async_complete(call, &error, NULL);
+	} else
+	if (ni_dbus_message_get_args_variants(reply, &result, 1) < 0) {
+		ni_error("%s.%s(): unable to parse response",
+				call->service->name, call->method->name);
+		call->callback(-NI_ERROR_CANNOT_MARSHAL, NULL, call->user_data);
+		ni_call_async_free(call);
+	} else {
+		ni_call_async_complete(call, NULL, &result);
+	}
+
+	ni_dbus_variant_destroy(&result);
+	dbus_error_free(&error);
+}
+
+static ni_call_async_t *
+ni_call_async_new(ni_dbus_object_t *object, const ni_dbus_service_t *service,
+			const ni_dbus_method_t *method, xml_node_t *config,
+			ni_call_error_handler_t *error_handler,
+			ni_call_async_callback_t *callback, void *user_data)
+{
+	ni_call_async_t *call;
+
+	call = xcalloc(1, sizeof(*call));
+	call->object = object;
+	call->service = service;
+	call->method = method;
+	call->config = config ? xml_node_clone_ref(config) : NULL;
+	call->error_context.handler = error_handler;
+	call->error_context.config = call->config;
+	call->callback = callback;
+	call->user_data = user_data;
+	return call;
+}
+
+int
+ni_call_common_xml_async(ni_dbus_object_t *object, const ni_dbus_service_t *service,
+			const ni_dbus_method_t *method, xml_node_t *config,
+			ni_call_error_handler_t *error_handler,
+			ni_call_async_callback_t *callback, void *user_data)
+{
+	ni_call_async_t *call;
+	int rv;
+
+	if (!object || !service || !method || !callback)
+		return -NI_ERROR_INVALID_ARGS;
+
+	call = ni_call_async_new(object, service, method, config,
+				error_handler, callback, user_data);
+	if ((rv = ni_call_async_send(call)) < 0)
+		ni_call_async_free(call);
+	return rv;
+}
+
+/*
+ * Bulk variant: the same method is called on several devices with a
+ * single InterfaceList.callDevices() round trip. Each device gets its
+ * own result (or error), which is passed through the error handler and
+ * callback exactly as for an individual asynchronous call. When the
+ * bulk call could not be sent or the server does not implement it (e.g.
+ * an older wickedd), the devices are called individually; any other
+ * failure is passed to the callback of each device.
+ */
+struct ni_call_bulk {
+	const ni_dbus_service_t *	service;
+	const ni_dbus_method_t *	method;
+
+	unsigned int			count;
+	struct ni_call_bulk_entry {
+		unsigned int		ifindex;
+		ni_call_async_t *	call;
+	} *				data;
+};
+
+ni_call_bulk_t *
+ni_call_bulk_new(const ni_dbus_service_t *service, const ni_dbus_method_t *method)
+{
+	ni_call_bulk_t *bulk;
+
+	if (!service || !method)
+		return NULL;
+
+	bulk = xcalloc(1, sizeof(*bulk));
+	bulk->service = service;
+	bulk->method = method;
+	return bulk;
+}
+
+static void
+ni_call_bulk_free(ni_call_bulk_t *bulk)
+{
+	unsigned int i;
+
+	for (i = 0; i < bulk->count; ++i) {
+		if (bulk->data[i].call)
+			ni_call_async_free(bulk->data[i].call);
+	}
+	free(bulk->data);
+	free(bulk);
+}
+
+int
+ni_call_bulk_add(ni_call_bulk_t *bulk, ni_dbus_object_t *object, unsigned int ifindex,
+			xml_node_t *config, ni_call_error_handler_t *error_handler,
+			ni_call_async_callback_t *callback, void *user_data)
+{
+	struct ni_call_bulk_entry *entry;
+
+	if (!bulk || !object || !ifindex || !callback)
+		return -NI_ERROR_INVALID_ARGS;
+
+	if ((bulk->count % 16) == 0)
+		bulk->data = xrealloc(bulk->data, (bulk->count + 16) * sizeof(bulk->data[0]));
+
+	entry = &bulk->data[bulk->count++];
+	entry->ifindex = ifindex;
+	entry->call = ni_call_async_new(object, bulk->service, bulk->method, config,
+					error_handler, callback, user_data);
+	return 0;
+}
+
+static void
+ni_call_bulk_fallback(struct ni_call_bulk_entry *entry)
+{
+	ni_call_async_t *call = entry->call;
+	int rv;
+
+	entry->call = NULL;
+	if ((rv = ni_call_async_send(call)) < 0) {
+		call->callback(rv, NULL, call->user_data);
+		ni_call_async_free(call);
+	}
+}
+
+static void
+ni_call_bulk_reply(ni_dbus_message_t *reply, void *user_data)
+{
+	ni_dbus_variant_t result = NI_DBUS_VARIANT_INIT;
+	DBusError error = DBUS_ERROR_INIT;
+	ni_call_bulk_t *bulk = user_data;
+	unsigned int i, n = 0;
+
+	if (dbus_set_error_from_message(&error, reply)) {
+		/* Only a server without callDevices did not run the methods */
+		if (dbus_error_has_name(&error, DBUS_ERROR_UNKNOWN_METHOD)
+		 || dbus_error_has_name(&error, DBUS_ERROR_UNKNOWN_INTERFACE)) {
+			ni_debug_dbus("%s.%s(): bulk call not supported (%s), calling devices individually",
+					bulk->service->name, bulk->method->name, error.message);
+			for (i = 0; i < bulk->count; ++i)
+				ni_call_bulk_fallback(&bulk->data[i]);
+		} else {
+			ni_debug_dbus("%s.%s(): bulk call failed (%s)",
+					bulk->service->name, bulk->method->name, error.message);
+			for (i = 0; i < bulk->count; ++i) {
+				ni_call_async_t *call = bulk->data[i].call;
+
+				bulk->data[i].call = NULL;
+				ni_call_async_complete(call, &error, NULL);
+			}
+		}
+		goto out;
+	}
+
+	if (ni_dbus_message_get_args_variants(reply, &result, 1) < 0
+	 || !ni_dbus_variant_is_dict_array(&result)) {
+		ni_error("%s.%s(): unable to parse bulk response",
+				bulk->service->name, bulk->method->name);
+	} else {
+		n = result.array.len;
+	}
+
+	for (i = 0; i < bulk->count; ++i) {
+		struct ni_call_bulk_entry *entry = &bulk->data[i];
+		const ni_dbus_variant_t *dict = i < n ? &result.variant_array_value[i] : NULL;
+		const char *error_name, *error_message;
+		DBusError call_error = DBUS_ERROR_INIT;
+		uint32_t ifindex;
+		ni_call_async_t *call;
+
+		call = entry->call;
+		entry->call = NULL;
+		if (!dict || !ni_dbus_dict_get_uint32(dict, "ifindex", &ifindex)
+		 || ifindex != entry->ifindex) {
+			call->callback(-NI_ERROR_CANNOT_MARSHAL, NULL, call->user_data);
+			ni_call_async_free(call);
+			continue;
+		}
+
+		if (ni_dbus_dict_get_string(dict, "error-name", &error_name)) {
+			if (!ni_dbus_dict_get_string(dict, "error-message", &error_message))
+				error_message = NULL;
+			dbus_set_error(&call_error, error_name, "%s",
+					error_message ? error_message : "");
+			ni_call_async_complete(call, &call_error, NULL);
+			dbus_error_free(&call_error);
+		} else {
+			ni_call_async_complete(call, NULL, ni_dbus_dict_get(dict, "result"));
+		}
+	}
+
+out:
+	ni_dbus_variant_destroy(&result);
+	dbus_error_free(&error);
+	ni_call_bulk_free(bulk);
+}
+
+/*
+ * Send the bulk call and release the handle. Callbacks of calls that
+ * could not be sent are invoked before this returns.
+ */
+int
+ni_call_bulk_send(ni_call_bulk_t *bulk)
+{
+	DBusError error = DBUS_ERROR_INIT;
+	ni_dbus_object_t *list_object;
+	ni_dbus_variant_t argv[3];
+	unsigned int i;
+	int rv = 0;
+
+	if (!bulk)
+		return -NI_ERROR_INVALID_ARGS;
+
+	memset(argv, 0, sizeof(argv));
+	ni_dbus_variant_set_string(&argv[0], bulk->service->name);
+	ni_dbus_variant_set_string(&argv[1], bulk->method->name);
+	ni_dbus_dict_array_init(&argv[2]);
+
+	for (i = 0; i < bulk->count; ++i) {
+		struct ni_call_bulk_entry *entry = &bulk->data[i];
+		ni_dbus_variant_t args[1], *dict;
+		int argc;
+
+		memset(args, 0, sizeof(args));
+		if ((argc = ni_call_async_serialize_args(entry->call, args)) < 0) {
+			entry->call->callback(argc, NULL, entry->call->user_data);
+			ni_call_async_free(entry->call);
+			entry->call = NULL;
+			continue;
+		}
+
+		dict = ni_dbus_dict_array_add(&argv[2]);
+		ni_dbus_dict_add_uint32(dict, "ifindex", entry->ifindex);
+		if (argc) {
+			ni_dbus_variant_t *arg = ni_dbus_dict_add(dict, "argument");
+
+			/* move the serialized argument into the entry */
+			*arg = args[0];
+		}
+	}
+
+	/* Drop the entries which failed to serialize */
+	for (i = 0; i < bulk->count; ) {
+		if (bulk->data[i].call == NULL) {
+			memmove(&bulk->data[i], &bulk->data[i + 1],
+				(bulk->count - i - 1) * sizeof(bulk->data[0]));
+			bulk->count--;
+		} else {
+			i++;
+		}
+	}
+
+	if (bulk->count == 0) {
+		ni_call_bulk_free(bulk);
+		goto out;
+	}
+
+	ni_debug_dbus("%s.%s(): calling %u devices in bulk",
+			bulk->service->name, bulk->method->name, bulk->count);
+
+	if (!(list_object = ni_call_get_netif_list_object())) {
+		rv = -NI_ERROR_DEVICE_NOT_KNOWN;
+	} else {
+		rv = ni_dbus_object_call_variant_async(list_object,
+				NI_OBJECTMODEL_NETIFLIST_INTERFACE, "callDevices",
+				3, argv, ni_call_bulk_reply, bulk, &error);
+	}
+	if (rv < 0) {
+		ni_debug_dbus("%s.%s(): unable to send bulk call, calling devices individually",
+				bulk->service->name, bulk->method->name);
+		for (i = 0; i < bulk->count; ++i)
+			ni_call_bulk_fallback(&bulk->data[i]);
+		ni_call_bulk_free(bulk);
+		rv = 0;
+	}
+
+out:
+	for (i = 0; i < 3; ++i)
+		ni_dbus_variant_destroy(&argv[i]);
+	dbus_error_free(&error);
+	return rv;
+}
+
 static int
 ni_get_device_method(ni_dbus_object_t *object, const char *method_name, const ni_dbus_service_t **service_ret, const ni_dbus_method_t **method_ret)
 {
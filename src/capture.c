@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
+#include <sys/mman.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -49,6 +50,14 @@
 #define MTU_MAX			1500
 #define DHCP_CLIENT_PORT	68
 
+/* Offsets into the DHCP message, following the UDP header */
+#define UDP_HLEN		8
+#define DHCP_OP_OFFSET		0
+#define DHCP_XID_OFFSET		4
+#define DHCP_CHADDR_OFFSET	28
+#define DHCP_CHADDR_LEN		16
+#define DHCP_BOOTREPLY		2
+
 #ifndef ETHERTYPE_LLDP
 # define ETHERTYPE_LLDP		0x88CC
 #endif
@@ -70,7 +79,7 @@ struct tpacket_auxdata {
  * Credit where credit is due :)
  * The below BPF filter is taken from ISC DHCP
  */
-static struct bpf_insn std_ipv4_bpf_filter [] = {
+static const struct bpf_insn std_ipv4_bpf_filter [] = {
 	/* Make sure it's a UDP packet... */
 	BPF_STMT(BPF_LD + BPF_B + BPF_ABS, 9),
 	BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, IPPROTO_UDP, 0, 6),
@@ -106,6 +115,36 @@ typedef union ni_packetaddr {
 	struct sockaddr_ll	sll;
 } ni_packetaddr_t;
 
+/*
+ * A PACKET_MMAP (TPACKET_V3) receive ring bound to all interfaces,
+ * shared by the captures of all devices using the same protocol.
+ * Received packets are passed to the capture of their sll_ifindex.
+ */
+typedef struct ni_capture_ring ni_capture_ring_t;
+
+#define NI_CAPTURE_RING_BLOCK_SIZE	(1 << 16)
+#define NI_CAPTURE_RING_BLOCK_NR	8
+#define NI_CAPTURE_RING_FRAME_SIZE	2048
+#define NI_CAPTURE_RING_RETIRE_TMO	10	/* msec */
+
+struct ni_capture_ring {
+	ni_capture_ring_t *	next;
+	unsigned int		refcount;
+
+	ni_socket_t *		sock;
+	ni_capture_protinfo_t	protinfo;
+
+	unsigned char *		map;
+	size_t			map_size;
+	unsigned int		block_size;
+	unsigned int		block_nr;
+	unsigned int		block;
+
+	ni_capture_t *		members;
+};
+
+static ni_capture_ring_t *	ni_capture_rings;
+
 /*
  * Platform specific
  */
@@ -113,52 +152,109 @@ struct ni_capture {
 	ni_socket_t *		sock;
 	ni_packetaddr_t		addr;
 	int			protocol;
+	ni_capture_protinfo_t	protinfo;
 
 	char *			ifname;
+	unsigned int		ifindex;
+
+	/* DHCP client filter, see ni_capture_set_client_filter */
+	ni_bool_t		client_filter;
+	ni_capture_client_filter_t client;
 
 	void *			buffer;
 	size_t			mtu;
 
 	struct {
 		struct timeval		deadline;
-		const ni_buffer_t *	buffer;
+		ni_buffer_t *		buffer;
 		ni_timeout_param_t	timeout;
+		struct timeval		sent;
+		int			secs_offset;
+		uint16_t		secs;
 	} retrans;
 
+	/* Shared capture mode */
+	ni_capture_ring_t *	ring;
+	ni_capture_t *		ring_next;
+	ni_capture_recv_handler_t *handler;
+
 	void *			user_data;
 };
 
-static int		ni_capture_set_filter(ni_capture_t *, const ni_capture_protinfo_t *);
+static int		ni_capture_set_filter(int, const ni_capture_protinfo_t *,
+					const ni_capture_client_filter_t *, unsigned int);
 static ssize_t		__ni_capture_send(const ni_capture_t *, const ni_buffer_t *);
+static void		ni_capture_ring_put(ni_capture_ring_t *);
+static int		ni_capture_ring_set_filter(ni_capture_ring_t *);
 
-static uint32_t
-checksum_partial(uint32_t sum, const void *data, uint16_t len)
+/*
+ * Internet checksum (RFC 1071), summing 32bit words into a 64bit
+ * accumulator, four at a time; the carries are folded back in at
+ * the end. As the ones' complement sum is independent of the byte
+ * order, we sum in host order and don't need to swap anything.
+ *
+ * The result is a 32bit partial sum which can be passed on to sum
+ * further data, and has to be folded using ni_capture_checksum_fold.
+ */
+static inline uint64_t
+__ni_capture_load64(const unsigned char *p)
 {
-	union {
-		const uint16_t *s;
-		const uint8_t *c;
-	} u;
+	uint64_t v;
 
-	u.s = data;
-	while (len > 1) {
-		sum += *u.s++;
+	memcpy(&v, p, sizeof(v));
+	return (v & 0xffffffffU) + (v >> 32);
+}
+
+uint32_t
+ni_capture_checksum_partial(uint32_t sum, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	uint64_t acc = sum;
+	uint32_t w32;
+	uint16_t w16;
+
+	while (len >= 32) {
+		acc += __ni_capture_load64(p);
+		acc += __ni_capture_load64(p + 8);
+		acc += __ni_capture_load64(p + 16);
+		acc += __ni_capture_load64(p + 24);
+		p += 32;
+		len -= 32;
+	}
+	while (len >= 8) {
+		acc += __ni_capture_load64(p);
+		p += 8;
+		len -= 8;
+	}
+	if (len >= 4) {
+		memcpy(&w32, p, sizeof(w32));
+		acc += w32;
+		p += 4;
+		len -= 4;
+	}
+	if (len >= 2) {
+		memcpy(&w16, p, sizeof(w16));
+		acc += w16;
+		p += 2;
 		len -= 2;
 	}
-
 	if (len == 1) {
 		union {
 			uint8_t c[2];
 			uint16_t s;
 		} bs;
-		bs.c[0] = u.c[0];
+		bs.c[0] = p[0];
 		bs.c[1] = 0;
-		sum += bs.s;
+		acc += bs.s;
 	}
-	return sum;
+
+	while (acc >> 32)
+		acc = (acc & 0xffffffffU) + (acc >> 32);
+	return acc;
 }
 
-static inline uint16_t
-checksum_fold(uint32_t sum)
+uint16_t
+ni_capture_checksum_fold(uint32_t sum)
 {
 	sum = (sum >> 16) + (sum & 0xffff);
 	sum +=(sum >> 16);
@@ -171,10 +267,14 @@ checksum(const void *data, uint16_t length)
 {
 	uint32_t sum;
 
-	sum = checksum_partial(0, data, length);
-	return checksum_fold(sum);
+	sum = ni_capture_checksum_partial(0, data, length);
+	return ni_capture_checksum_fold(sum);
 }
 
+/*
+ * The UDP header has to be summed before the payload, which may
+ * have an odd length.
+ */
 static uint16_t
 ipudp_checksum(const struct ip *iph, const struct udphdr *uhp,
 		const void *data, size_t length)
@@ -192,11 +292,11 @@ ipudp_checksum(const struct ip *iph, const struct udphdr *uhp,
 	bs.c[0] = 0;
 	bs.c[1] = IPPROTO_UDP;
 
-	csum = checksum_partial(bs.s + uh.uh_ulen, &iph->ip_src, 2* sizeof(iph->ip_src));
-	csum = checksum_partial(csum, data, length);
-	csum = checksum_partial(csum, &uh, sizeof(uh));
+	csum = ni_capture_checksum_partial(bs.s + uh.uh_ulen, &iph->ip_src, 2* sizeof(iph->ip_src));
+	csum = ni_capture_checksum_partial(csum, &uh, sizeof(uh));
+	csum = ni_capture_checksum_partial(csum, data, length);
 
-	return checksum_fold(csum);
+	return ni_capture_checksum_fold(csum);
 }
 
 int
@@ -249,13 +349,89 @@ ni_capture_build_udp_header(ni_buffer_t *bp,
 	/* Finally, do the checksums */
 	ip->ip_sum = checksum( ip, sizeof(*ip));
 	udp->uh_sum = ipudp_checksum(ip, udp, payload, payload_len);
+	if (udp->uh_sum == 0)
+		udp->uh_sum = 0xffff;
 
 	return 0;
 }
 
+static int
+__ni_capture_get_udp_payload(const ni_buffer_t *bp, unsigned int offset, void *data, size_t len)
+{
+	const unsigned char *head = ni_buffer_head(bp);
+	unsigned int count = ni_buffer_count(bp);
+	unsigned int ihl;
+
+	if (count < sizeof(struct ip))
+		return -1;
+
+	ihl = ((const struct ip *) head)->ip_hl << 2;
+	if (count < ihl + UDP_HLEN + offset + len)
+		return -1;
+
+	memcpy(data, head + ihl + UDP_HLEN + offset, len);
+	return 0;
+}
+
+/*
+ * Overwrite payload data of a packet built by ni_capture_build_udp_header,
+ * updating the UDP checksum incrementally (RFC 1624, eqn. 3) instead of
+ * summing the whole packet again. Offset and length have to be even.
+ */
+int
+ni_capture_update_udp_payload(ni_buffer_t *bp, unsigned int offset, const void *data, size_t len)
+{
+	unsigned char *head = ni_buffer_head(bp);
+	unsigned int count = ni_buffer_count(bp);
+	const unsigned char *new = data;
+	struct udphdr *udp;
+	unsigned char *old;
+	unsigned int ihl, i;
+	uint32_t sum;
+	uint16_t m, n;
+
+	if ((offset | len) & 1 || count < sizeof(struct ip))
+		return -1;
+
+	ihl = ((struct ip *) head)->ip_hl << 2;
+	if (count < ihl + sizeof(*udp) + offset + len)
+		return -1;
+
+	udp = (struct udphdr *) (head + ihl);
+	old = head + ihl + sizeof(*udp) + offset;
+
+	/* A zero checksum means there is none */
+	if (udp->uh_sum) {
+		sum = (uint16_t) ~udp->uh_sum;
+		for (i = 0; i < len; i += 2) {
+			memcpy(&m, old + i, 2);
+			memcpy(&n, new + i, 2);
+			sum += (uint16_t) ~m;
+			sum += n;
+		}
+		udp->uh_sum = ni_capture_checksum_fold(sum);
+		if (udp->uh_sum == 0)
+			udp->uh_sum = 0xffff;
+	}
+
+	memcpy(old, new, len);
+	return 0;
+}
+
+/*
+ * Checksum state of a received packet, as reported by the kernel.
+ * Partial checksums of locally sent packets cannot be verified, and
+ * checksums the kernel (or device) verified already need not be.
+ */
+typedef enum {
+	NI_CAPTURE_CSUM_UNKNOWN,
+	NI_CAPTURE_CSUM_PARTIAL,
+	NI_CAPTURE_CSUM_VALID,
+} ni_capture_csum_t;
+
 static void *
 ni_capture_inspect_udp_header(void *data, size_t bytes, size_t *payload_len,
-				ni_bool_t partial_checksum)
+				ni_capture_csum_t csum)
 {
 	struct ip *iph = data;
 	struct udphdr *uh;
@@ -305,13 +481,13 @@ ni_capture_inspect_udp_header(void *data, size_t bytes, size_t *payload_len,
 	data += sizeof(*uh);
 	bytes -= sizeof(*uh);
 
-	if (!partial_checksum && uh->uh_sum &&
+	if (csum == NI_CAPTURE_CSUM_UNKNOWN && uh->uh_sum &&
 		ipudp_checksum(iph, uh, data, bytes) != uh->uh_sum) {
 		ni_debug_socket("bad UDP checksum, ignoring");
 		return NULL;
 	}
 
-	*payload_len = ip_len;
+	*payload_len = bytes;
 	return data;
 }
 
@@ -344,7 +520,35 @@ ni_capture_force_retransmit(ni_capture_t *capture, unsigned int delay)
 
 /*
  * Retransmit handling
+ *
+ * Retransmitted DHCP messages keep their xid, but have to report the
+ * time elapsed since we started in the secs field. The caller tells us
+ * where that field is (see ni_capture_send_update_secs); all we need to
+ * do is to patch it and the UDP checksum.
  */
+static void
+ni_capture_retransmit_update_secs(ni_capture_t *capture)
+{
+	struct timeval now;
+	uint16_t secs;
+	long elapsed;
+
+	gettimeofday(&now, NULL);
+	elapsed = now.tv_sec - capture->retrans.sent.tv_sec;
+	if (elapsed <= 0)
+		return;
+
+	if (ntohs(capture->retrans.secs) + elapsed < 0xffff)
+		secs = htons(ntohs(capture->retrans.secs) + elapsed);
+	else
+		secs = htons(0xffff);
+
+	if (ni_capture_update_udp_payload(capture->retrans.buffer,
+				capture->retrans.secs_offset, &secs, sizeof(secs)) < 0)
+		ni_debug_socket("%s: cannot update secs of retransmitted message",
+				capture->ifname);
+}
+
 void
 ni_capture_retransmit(ni_capture_t *capture)
 {
@@ -358,6 +562,9 @@ ni_capture_retransmit(ni_capture_t *capture)
 		return;
 	}
 
+	if (capture->retrans.secs_offset >= 0)
+		ni_capture_retransmit_update_secs(capture);
+
 	ni_timeout_recompute(&capture->retrans.timeout);
 	rv = __ni_capture_send(capture, capture->retrans.buffer);
 
@@ -407,8 +614,22 @@ __ni_capture_socket_check_timeout(ni_socket_t *sock, const struct timeval *now)
 /*
  * Capture receive handling
  */
-int
-__ni_capture_recv(int fd, void *buf, size_t len, ni_bool_t *partial_csum)
+#if defined(PACKET_AUXDATA) || defined(TPACKET3_HDRLEN)
+static ni_capture_csum_t
+__ni_capture_csum_status(unsigned int tp_status)
+{
+	if (tp_status & TP_STATUS_CSUMNOTREADY)
+		return NI_CAPTURE_CSUM_PARTIAL;
+#if defined(TP_STATUS_CSUM_VALID)
+	if (tp_status & TP_STATUS_CSUM_VALID)
+		return NI_CAPTURE_CSUM_VALID;
+#endif
+	return NI_CAPTURE_CSUM_UNKNOWN;
+}
+#endif
+
+static int
+__ni_capture_recv(int fd, void *buf, size_t len, ni_capture_csum_t *csum)
 {
 #if defined(PACKET_AUXDATA)
 	/* use 2 times bigger buffer to catch possible additions... */
@@ -427,7 +648,7 @@ __ni_capture_recv(int fd, void *buf, size_t len, ni_bool_t *partial_csum)
 	struct tpacket_auxdata *aux;
 	ssize_t bytes;
 
-	*partial_csum = FALSE;
+	*csum = NI_CAPTURE_CSUM_UNKNOWN;
 	memset(cbuf, 0, sizeof(cbuf));
 
 	if ((bytes = recvmsg (fd, &msg, 0)) < 0)
@@ -438,44 +659,35 @@ __ni_capture_recv(int fd, void *buf, size_t len, ni_bool_t *partial_csum)
 		    cmsg->cmsg_type == PACKET_AUXDATA &&
 		    cmsg->cmsg_len >= CMSG_LEN(sizeof(struct tpacket_auxdata))) {
 			aux = (void *)CMSG_DATA(cmsg);
-			if (aux->tp_status & TP_STATUS_CSUMNOTREADY)
-				*partial_csum = TRUE;
+			*csum = __ni_capture_csum_status(aux->tp_status);
 			break;
 		}
 	}
 
 	return bytes;
 #else
-	*partial_csum = FALSE;
+	*csum = NI_CAPTURE_CSUM_UNKNOWN;
 
 	return read(fd, buf, len);
 #endif
 }
 
-int
-ni_capture_recv(ni_capture_t *capture, ni_buffer_t *bp)
+static int
+__ni_capture_payload(const ni_capture_t *capture, void *data, size_t bytes,
+			ni_capture_csum_t csum, ni_buffer_t *bp)
 {
 	void *payload;
 	size_t payload_len;
-	ssize_t bytes;
-	ni_bool_t partial_checksum = FALSE;
-
-	bytes = __ni_capture_recv(capture->sock->__fd, capture->buffer,
-				  capture->mtu, &partial_checksum);
-
-	if (bytes < 0) {
-		ni_error("%s: cannot read from socket: %m", __FUNCTION__);
-		return -1;
-	}
 
 	ni_debug_socket("%s: incoming packet%s", capture->ifname,
-			(partial_checksum ? " with partial checksum" : ""));
+			csum == NI_CAPTURE_CSUM_PARTIAL ? " with partial checksum" :
+			csum == NI_CAPTURE_CSUM_VALID ? " with verified checksum" : "");
 
 	switch (capture->protocol) {
 	case ETHERTYPE_IP:
 		/* Make sure IP and UDP header are sane */
-		payload = ni_capture_inspect_udp_header(capture->buffer, bytes,
-						&payload_len, partial_checksum);
+		payload = ni_capture_inspect_udp_header(data, bytes,
+						&payload_len, csum);
 		if (payload == NULL) {
 			ni_debug_socket("bad IP/UDP packet header");
 			return -1;
@@ -484,7 +696,7 @@ ni_capture_recv(ni_capture_t *capture, ni_buffer_t *bp)
 
 	case ETHERTYPE_ARP:
 	case ETHERTYPE_LLDP:
-		payload = capture->buffer;
+		payload = data;
 		payload_len = bytes;
 		break;
 
@@ -497,6 +709,23 @@ ni_capture_recv(ni_capture_t *capture, ni_buffer_t *bp)
 	return payload_len;
 }
 
+int
+ni_capture_recv(ni_capture_t *capture, ni_buffer_t *bp)
+{
+	ni_capture_csum_t csum;
+	ssize_t bytes;
+
+	bytes = __ni_capture_recv(capture->sock->__fd, capture->buffer,
+				  capture->mtu, &csum);
+
+	if (bytes < 0) {
+		ni_error("%s: cannot read from socket: %m", __FUNCTION__);
+		return -1;
+	}
+
+	return __ni_capture_payload(capture, capture->buffer, bytes, csum, bp);
+}
+
 /*
  * Get/set user data
  */
@@ -609,15 +838,12 @@ __ni_capture_enable_packet_auxdata(int fd)
 #endif
 }
 
-ni_capture_t *
-ni_capture_open(const ni_capture_devinfo_t *devinfo, const ni_capture_protinfo_t *protinfo, void (*receive)(ni_socket_t *))
+static ni_capture_t *
+__ni_capture_new(const ni_capture_devinfo_t *devinfo, const ni_capture_protinfo_t *protinfo)
 {
-	ni_packetaddr_t	addr;
-	ni_capture_t *capture = NULL;
+	ni_capture_t *capture;
 	ni_hwaddr_t destaddr;
 
-	int fd = -1;
-
 	if (devinfo->ifindex == 0) {
 		ni_error("no ifindex for interface `%s'", devinfo->ifname);
 		return NULL;
@@ -636,18 +862,13 @@ ni_capture_open(const ni_capture_devinfo_t *devinfo, const ni_capture_protinfo_t
 		return NULL;
 	}
 
-	if ((fd = socket (PF_PACKET, SOCK_DGRAM, htons(protinfo->eth_protocol))) < 0) {
-		ni_error("socket: %m");
-		return NULL;
-	}
-	fcntl(fd, F_SETFD, FD_CLOEXEC);
-
 	capture = calloc(1, sizeof(*capture));
 	if (!capture)
-		goto failed;
+		return NULL;
 	ni_string_dup(&capture->ifname, devinfo->ifname);
-	capture->sock = ni_socket_wrap(fd, SOCK_DGRAM);
+	capture->ifindex = devinfo->ifindex;
 	capture->protocol = protinfo->eth_protocol;
+	capture->protinfo = *protinfo;
 
 	capture->addr.sll.sll_family = AF_PACKET;
 	capture->addr.sll.sll_protocol = htons(protinfo->eth_protocol);
@@ -656,7 +877,27 @@ ni_capture_open(const ni_capture_devinfo_t *devinfo, const ni_capture_protinfo_t
 	capture->addr.sll.sll_halen = destaddr.len;
 	memcpy(&capture->addr.sll.sll_addr, destaddr.data, destaddr.len);
 
-	if (ni_capture_set_filter(capture, protinfo) < 0)
+	return capture;
+}
+
+ni_capture_t *
+ni_capture_open(const ni_capture_devinfo_t *devinfo, const ni_capture_protinfo_t *protinfo, void (*receive)(ni_socket_t *))
+{
+	ni_packetaddr_t	addr;
+	ni_capture_t *capture = NULL;
+	int fd = -1;
+
+	if (!(capture = __ni_capture_new(devinfo, protinfo)))
+		return NULL;
+
+	if ((fd = socket (PF_PACKET, SOCK_DGRAM, htons(protinfo->eth_protocol))) < 0) {
+		ni_error("socket: %m");
+		goto failed;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	capture->sock = ni_socket_wrap(fd, SOCK_DGRAM);
+
+	if (ni_capture_set_filter(fd, protinfo, NULL, 0) < 0)
 		goto failed;
 
 	memset(&addr, 0, sizeof(addr));
@@ -685,19 +926,105 @@ ni_capture_open(const ni_capture_devinfo_t *devinfo, const ni_capture_protinfo_t
 
 failed:
 	ni_capture_free(capture);
-	if (fd >= 0)
-		close(fd);
 	return NULL;
 }
 
 static int
-ni_capture_set_filter(ni_capture_t *cap, const ni_capture_protinfo_t *protinfo)
+ni_capture_build_filter_std(const ni_capture_protinfo_t *protinfo, struct sock_filter **result)
 {
-	struct sock_fprog pf;
+	unsigned int len = sizeof(std_ipv4_bpf_filter) / sizeof(std_ipv4_bpf_filter[0]);
 
-	/* Install the DHCP filter */
-	memset(&pf, 0, sizeof(pf));
+	*result = xcalloc(len, sizeof(std_ipv4_bpf_filter[0]));
+	memcpy(*result, std_ipv4_bpf_filter, sizeof(std_ipv4_bpf_filter));
+	(*result)[1].k = protinfo->ip_protocol;
+	(*result)[6].k = protinfo->ip_port;
+	return len;
+}
+
+/*
+ * Build the BPF program for a capture socket.
+ *
+ * For IP, the program passes unfragmented packets of the given IP
+ * protocol and destination port. With client filters, it additionally
+ * requires a DHCP reply (BOOTREPLY) carrying the xid and chaddr of one
+ * of the clients, so other clients' traffic on the segment doesn't wake
+ * us. Each client gets a block of its own, which falls through to the
+ * next one on mismatch; this keeps all jumps short.
+ *
+ * Returns the number of instructions (0 when no filter is needed),
+ * or -1 on error.
+ */
+#define NI_CAPTURE_FILTER_HEAD		13
+#define NI_CAPTURE_FILTER_CLIENT	(2 + 2 * (DHCP_CHADDR_LEN / 4) + 1)
 
+static inline void
+__ni_capture_filter_stmt(struct bpf_insn *prog, unsigned int *len,
+			unsigned short code, uint32_t k)
+{
+	struct bpf_insn insn = BPF_STMT(code, k);
+
+	prog[(*len)++] = insn;
+}
+
+static inline void
+__ni_capture_filter_jump(struct bpf_insn *prog, unsigned int *len,
+			unsigned short code, uint32_t k, uint8_t jt, uint8_t jf)
+{
+	struct bpf_insn insn = BPF_JUMP(code, k, jt, jf);
+
+	prog[(*len)++] = insn;
+}
+
+static void
+__ni_capture_filter_client(struct bpf_insn *prog, unsigned int *len,
+			const ni_capture_client_filter_t *client)
+{
+	const unsigned char *chaddr = client->chaddr.data;
+	unsigned int start = *len, chlen, off, i;
+
+	__ni_capture_filter_stmt(prog, len, BPF_LD + BPF_W + BPF_IND, UDP_HLEN + DHCP_XID_OFFSET);
+	__ni_capture_filter_jump(prog, len, BPF_JMP + BPF_JEQ + BPF_K, ntohl(client->xid), 0, 0);
+
+	chlen = client->chaddr.len <= DHCP_CHADDR_LEN ? client->chaddr.len : 0;
+	for (off = 0; off < chlen; ) {
+		if (chlen - off >= 4) {
+			__ni_capture_filter_stmt(prog, len, BPF_LD + BPF_W + BPF_IND,
+					UDP_HLEN + DHCP_CHADDR_OFFSET + off);
+			__ni_capture_filter_jump(prog, len, BPF_JMP + BPF_JEQ + BPF_K,
+					(chaddr[off] << 24) | (chaddr[off + 1] << 16) |
+					(chaddr[off + 2] << 8) | chaddr[off + 3], 0, 0);
+			off += 4;
+		} else
+		if (chlen - off >= 2) {
+			__ni_capture_filter_stmt(prog, len, BPF_LD + BPF_H + BPF_IND,
+					UDP_HLEN + DHCP_CHADDR_OFFSET + off);
+			__ni_capture_filter_jump(prog, len, BPF_JMP + BPF_JEQ + BPF_K,
+					(chaddr[off] << 8) | chaddr[off + 1], 0, 0);
+			off += 2;
+		} else {
+			__ni_capture_filter_stmt(prog, len, BPF_LD + BPF_B + BPF_IND,
+					UDP_HLEN + DHCP_CHADDR_OFFSET + off);
+			__ni_capture_filter_jump(prog, len, BPF_JMP + BPF_JEQ + BPF_K,
+					chaddr[off], 0, 0);
+			off += 1;
+		}
+	}
+	__ni_capture_filter_stmt(prog, len, BPF_RET + BPF_K, ~0U);
+
+	/* On mismatch, continue with the next block */
+	for (i = start + 1; i < *len; i += 2)
+		prog[i].jf = *len - (i + 1);
+}
+
+int
+ni_capture_build_filter(const ni_capture_protinfo_t *protinfo,
+			const ni_capture_client_filter_t *clients, unsigned int count,
+			struct sock_filter **result)
+{
+	struct bpf_insn *prog;
+	unsigned int len = 0, max, i;
+
+	*result = NULL;
 	switch (protinfo->eth_protocol) {
 	case ETHERTYPE_ARP:
 	case ETHERTYPE_LLDP:
@@ -712,12 +1039,6 @@ ni_capture_set_filter(ni_capture_t *cap, const ni_capture_protinfo_t *protinfo)
 					protinfo->ip_protocol, protinfo->ip_port);
 			return -1;
 		}
-
-		std_ipv4_bpf_filter[1].k = protinfo->ip_protocol;
-		std_ipv4_bpf_filter[6].k = protinfo->ip_port;
-
-		pf.filter = std_ipv4_bpf_filter;
-		pf.len = sizeof(std_ipv4_bpf_filter) / sizeof(std_ipv4_bpf_filter[0]);
 		break;
 
 	default:
@@ -725,14 +1046,387 @@ ni_capture_set_filter(ni_capture_t *cap, const ni_capture_protinfo_t *protinfo)
 		return -1;
 	}
 
-	if (setsockopt(cap->sock->__fd, SOL_SOCKET, SO_ATTACH_FILTER, &pf, sizeof(pf)) < 0) {
+	max = NI_CAPTURE_FILTER_HEAD + count * NI_CAPTURE_FILTER_CLIENT + 1;
+	if (count && max > BPF_MAXINSNS) {
+		ni_debug_socket("too many capture clients (%u) to filter for", count);
+		count = 0;
+	}
+	if (count == 0)
+		return ni_capture_build_filter_std(protinfo, result);
+
+	prog = xcalloc(max, sizeof(*prog));
+
+	/* Make sure it's an unfragmented packet to the right port... */
+	__ni_capture_filter_stmt(prog, &len, BPF_LD + BPF_B + BPF_ABS, 9);
+	__ni_capture_filter_jump(prog, &len, BPF_JMP + BPF_JEQ + BPF_K, protinfo->ip_protocol, 1, 0);
+	__ni_capture_filter_stmt(prog, &len, BPF_RET + BPF_K, 0);
+	__ni_capture_filter_stmt(prog, &len, BPF_LD + BPF_H + BPF_ABS, 6);
+	__ni_capture_filter_jump(prog, &len, BPF_JMP + BPF_JSET + BPF_K, 0x1fff, 0, 1);
+	__ni_capture_filter_stmt(prog, &len, BPF_RET + BPF_K, 0);
+	__ni_capture_filter_stmt(prog, &len, BPF_LDX + BPF_B + BPF_MSH, 0);
+	__ni_capture_filter_stmt(prog, &len, BPF_LD + BPF_H + BPF_IND, 2);
+	__ni_capture_filter_jump(prog, &len, BPF_JMP + BPF_JEQ + BPF_K, protinfo->ip_port, 1, 0);
+	__ni_capture_filter_stmt(prog, &len, BPF_RET + BPF_K, 0);
+
+	/* ... carrying a DHCP reply ... */
+	__ni_capture_filter_stmt(prog, &len, BPF_LD + BPF_B + BPF_IND, UDP_HLEN + DHCP_OP_OFFSET);
+	__ni_capture_filter_jump(prog, &len, BPF_JMP + BPF_JEQ + BPF_K, DHCP_BOOTREPLY, 1, 0);
+	__ni_capture_filter_stmt(prog, &len, BPF_RET + BPF_K, 0);
+
+	/* ... to one of our clients. */
+	for (i = 0; i < count; ++i)
+		__ni_capture_filter_client(prog, &len, &clients[i]);
+
+	/* Otherwise, drop it. */
+	__ni_capture_filter_stmt(prog, &len, BPF_RET + BPF_K, 0);
+
+	*result = prog;
+	return len;
+}
+
+static int
+ni_capture_set_filter(int fd, const ni_capture_protinfo_t *protinfo,
+			const ni_capture_client_filter_t *clients, unsigned int count)
+{
+	struct sock_fprog pf;
+	struct bpf_insn *prog;
+	int len;
+
+	if ((len = ni_capture_build_filter(protinfo, clients, count, &prog)) <= 0)
+		return len;
+
+	/* Attaching replaces any filter installed before atomically */
+	memset(&pf, 0, sizeof(pf));
+	pf.filter = prog;
+	pf.len = len;
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &pf, sizeof(pf)) < 0) {
 		ni_error("SO_ATTACH_FILTER: %m");
+		free(prog);
 		return -1;
 	}
 
+	free(prog);
 	return 0;
 }
 
+/*
+ * Restrict a DHCP capture to the replies to the given transaction
+ * and client hardware address (NULL to not match chaddr).
+ */
+int
+ni_capture_set_client_filter(ni_capture_t *capture, uint32_t xid, const ni_hwaddr_t *chaddr)
+{
+	if (capture->protocol != ETHERTYPE_IP)
+		return -1;
+
+	memset(&capture->client, 0, sizeof(capture->client));
+	capture->client.xid = xid;
+	if (chaddr)
+		capture->client.chaddr = *chaddr;
+	capture->client_filter = TRUE;
+
+	if (capture->ring)
+		return ni_capture_ring_set_filter(capture->ring);
+	return ni_capture_set_filter(capture->sock->__fd, &capture->protinfo,
+					&capture->client, 1);
+}
+
+/*
+ * Shared capture ring handling
+ */
+#if defined(TPACKET3_HDRLEN)
+static ni_capture_t *
+ni_capture_ring_find_member(const ni_capture_ring_t *ring, int ifindex)
+{
+	ni_capture_t *capture;
+
+	for (capture = ring->members; capture; capture = capture->ring_next) {
+		if ((int) capture->ifindex == ifindex)
+			return capture;
+	}
+	return NULL;
+}
+
+static void
+ni_capture_ring_process_block(ni_capture_ring_t *ring, struct tpacket_block_desc *bd)
+{
+	struct tpacket3_hdr *hdr;
+	unsigned int i;
+
+	hdr = (void *) ((unsigned char *) bd + bd->hdr.bh1.offset_to_first_pkt);
+	for (i = 0; i < bd->hdr.bh1.num_pkts; ++i) {
+		const struct sockaddr_ll *sll;
+		ni_capture_t *capture;
+		ni_buffer_t buf;
+
+		sll = (void *) ((unsigned char *) hdr + TPACKET_ALIGN(sizeof(*hdr)));
+		if (sll->sll_pkttype != PACKET_OUTGOING
+		 && (capture = ni_capture_ring_find_member(ring, sll->sll_ifindex)) != NULL
+		 && __ni_capture_payload(capture, (unsigned char *) hdr + hdr->tp_net,
+					hdr->tp_snaplen,
+					__ni_capture_csum_status(hdr->tp_status),
+					&buf) >= 0)
+			capture->handler(capture, &buf);
+
+		hdr = (void *) ((unsigned char *) hdr + hdr->tp_next_offset);
+	}
+}
+
+static void
+ni_capture_ring_recv(ni_socket_t *sock)
+{
+	ni_capture_ring_t *ring = sock->user_data;
+	struct tpacket_block_desc *bd;
+
+	/* The handlers may close the last capture using this ring */
+	ring->refcount++;
+	while (ring->map) {
+		bd = (void *) (ring->map + ring->block * ring->block_size);
+		if (!(bd->hdr.bh1.block_status & TP_STATUS_USER))
+			break;
+
+		ni_capture_ring_process_block(ring, bd);
+
+		__sync_synchronize();
+		bd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+		ring->block = (ring->block + 1) % ring->block_nr;
+	}
+	ni_capture_ring_put(ring);
+}
+
+static int
+ni_capture_ring_get_timeout(const ni_socket_t *sock, struct timeval *tv)
+{
+	const ni_capture_ring_t *ring = sock->user_data;
+	const ni_capture_t *capture;
+
+	timerclear(tv);
+	for (capture = ring->members; capture; capture = capture->ring_next) {
+		const struct timeval *deadline = &capture->retrans.deadline;
+
+		if (timerisset(deadline) && (!timerisset(tv) || timercmp(deadline, tv, <)))
+			*tv = *deadline;
+	}
+	return timerisset(tv)? 0 : -1;
+}
+
+static void
+ni_capture_ring_check_timeout(ni_socket_t *sock, const struct timeval *now)
+{
+	ni_capture_ring_t *ring = sock->user_data;
+	ni_capture_t *capture;
+
+	for (capture = ring->members; capture; capture = capture->ring_next) {
+		if (timerisset(&capture->retrans.deadline)
+		 && timercmp(&capture->retrans.deadline, now, <))
+			ni_capture_retransmit(capture);
+	}
+}
+
+static ni_capture_ring_t *
+ni_capture_ring_open(const ni_capture_protinfo_t *protinfo)
+{
+	ni_capture_ring_t *ring;
+	struct tpacket_req3 req;
+	ni_packetaddr_t addr;
+	int version = TPACKET_V3;
+	int fd;
+
+	/* Bind without a protocol first, so nothing is queued before
+	 * the filter and the ring are in place. */
+	if ((fd = socket(PF_PACKET, SOCK_DGRAM, 0)) < 0) {
+		ni_error("socket: %m");
+		return NULL;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+		ni_debug_socket("TPACKET_V3 not supported: %m");
+		close(fd);
+		return NULL;
+	}
+
+	if (ni_capture_set_filter(fd, protinfo, NULL, 0) < 0) {
+		close(fd);
+		return NULL;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = NI_CAPTURE_RING_BLOCK_SIZE;
+	req.tp_block_nr = NI_CAPTURE_RING_BLOCK_NR;
+	req.tp_frame_size = NI_CAPTURE_RING_FRAME_SIZE;
+	req.tp_frame_nr = req.tp_block_size / req.tp_frame_size * req.tp_block_nr;
+	req.tp_retire_blk_tov = NI_CAPTURE_RING_RETIRE_TMO;
+	if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+		ni_error("PACKET_RX_RING: %m");
+		close(fd);
+		return NULL;
+	}
+
+	ring = xcalloc(1, sizeof(*ring));
+	ring->refcount = 1;
+	ring->protinfo = *protinfo;
+	ring->block_size = req.tp_block_size;
+	ring->block_nr = req.tp_block_nr;
+	ring->map_size = (size_t) req.tp_block_size * req.tp_block_nr;
+	ring->sock = ni_socket_wrap(fd, SOCK_DGRAM);
+
+	ring->map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ring->map == MAP_FAILED) {
+		ni_error("cannot map capture ring: %m");
+		ring->map = NULL;
+		goto failed;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sll.sll_family = PF_PACKET;
+	addr.sll.sll_protocol = htons(protinfo->eth_protocol);
+	addr.sll.sll_ifindex = 0;
+	if (bind(fd, &addr.sa, sizeof(addr)) == -1) {
+		ni_error("bind: %m");
+		goto failed;
+	}
+
+	ring->sock->receive = ni_capture_ring_recv;
+	ring->sock->get_timeout = ni_capture_ring_get_timeout;
+	ring->sock->check_timeout = ni_capture_ring_check_timeout;
+	ring->sock->user_data = ring;
+	ni_socket_activate(ring->sock);
+
+	ring->next = ni_capture_rings;
+	ni_capture_rings = ring;
+
+	ni_debug_socket("opened shared capture ring for ethertype 0x%04x, port %u",
+			ring->protinfo.eth_protocol, ring->protinfo.ip_port);
+	return ring;
+
+failed:
+	ni_capture_ring_put(ring);
+	return NULL;
+}
+#else
+static ni_capture_ring_t *
+ni_capture_ring_open(const ni_capture_protinfo_t *protinfo)
+{
+	return NULL;
+}
+#endif
+
+/*
+ * Combine the client filters of all ring members; as long as one
+ * member has none, the ring has to pass all DHCP packets.
+ */
+static int
+ni_capture_ring_set_filter(ni_capture_ring_t *ring)
+{
+	ni_capture_client_filter_t *clients;
+	const ni_capture_t *capture;
+	unsigned int count = 0;
+	int rv;
+
+	for (capture = ring->members; capture; capture = capture->ring_next) {
+		if (!capture->client_filter)
+			return ni_capture_set_filter(ring->sock->__fd, &ring->protinfo, NULL, 0);
+		count++;
+	}
+
+	clients = xcalloc(count ? count : 1, sizeof(*clients));
+	for (count = 0, capture = ring->members; capture; capture = capture->ring_next)
+		clients[count++] = capture->client;
+
+	rv = ni_capture_set_filter(ring->sock->__fd, &ring->protinfo, clients, count);
+	free(clients);
+	return rv;
+}
+
+static ni_capture_ring_t *
+ni_capture_ring_get(const ni_capture_protinfo_t *protinfo)
+{
+	ni_capture_ring_t *ring;
+
+	for (ring = ni_capture_rings; ring; ring = ring->next) {
+		if (ring->protinfo.eth_protocol == protinfo->eth_protocol
+		 && ring->protinfo.ip_protocol == protinfo->ip_protocol
+		 && ring->protinfo.ip_port == protinfo->ip_port
+		 && !ring->sock->error) {
+			ring->refcount++;
+			return ring;
+		}
+	}
+	return ni_capture_ring_open(protinfo);
+}
+
+static void
+ni_capture_ring_put(ni_capture_ring_t *ring)
+{
+	ni_capture_ring_t **pos;
+
+	ni_assert(ring->refcount);
+	if (--ring->refcount)
+		return;
+
+	for (pos = &ni_capture_rings; *pos; pos = &(*pos)->next) {
+		if (*pos == ring) {
+			*pos = ring->next;
+			break;
+		}
+	}
+
+	if (ring->map)
+		munmap(ring->map, ring->map_size);
+	ring->map = NULL;
+	if (ring->sock)
+		ni_socket_close(ring->sock);
+	free(ring);
+}
+
+static void
+__ni_capture_shared_fallback_recv(ni_socket_t *sock)
+{
+	ni_capture_t *capture = sock->user_data;
+	ni_buffer_t buf;
+
+	if (ni_capture_recv(capture, &buf) >= 0)
+		capture->handler(capture, &buf);
+}
+
+/*
+ * Open a capture receiving via the shared ring of its protocol.
+ * Sending and retransmits still happen per capture, addressed to
+ * its interface. When no ring can be set up, we fall back to a
+ * capture socket of its own, calling the same handler.
+ */
+ni_capture_t *
+ni_capture_open_shared(const ni_capture_devinfo_t *devinfo, const ni_capture_protinfo_t *protinfo,
+			ni_capture_recv_handler_t *handler)
+{
+	ni_capture_ring_t *ring = NULL;
+	ni_capture_t *capture;
+
+	if (protinfo->eth_protocol == ETHERTYPE_IP)
+		ring = ni_capture_ring_get(protinfo);
+
+	if (ring == NULL) {
+		capture = ni_capture_open(devinfo, protinfo, __ni_capture_shared_fallback_recv);
+		if (capture)
+			capture->handler = handler;
+		return capture;
+	}
+
+	if (!(capture = __ni_capture_new(devinfo, protinfo))) {
+		ni_capture_ring_put(ring);
+		return NULL;
+	}
+
+	capture->ring = ring;
+	capture->sock = ring->sock;
+	capture->handler = handler;
+	capture->ring_next = ring->members;
+	ring->members = capture;
+	ni_capture_ring_set_filter(ring);
+	return capture;
+}
+
 ssize_t
 __ni_capture_send(const ni_capture_t *capture, const ni_buffer_t *buf)
 {
@@ -751,8 +1445,9 @@ __ni_capture_send(const ni_capture_t *capture, const ni_buffer_t *buf)
 	return rv;
 }
 
-ssize_t
-ni_capture_send(ni_capture_t *capture, const ni_buffer_t *buf, const ni_timeout_param_t *tmo)
+static ssize_t
+__ni_capture_send_retransmit(ni_capture_t *capture, ni_buffer_t *buf,
+				const ni_timeout_param_t *tmo, int secs_offset)
 {
 	ssize_t rv;
 
@@ -760,6 +1455,12 @@ ni_capture_send(ni_capture_t *capture, const ni_buffer_t *buf, const ni_timeout_
 	if (tmo) {
 		capture->retrans.buffer = buf;
 		capture->retrans.timeout = *tmo;
+		gettimeofday(&capture->retrans.sent, NULL);
+		capture->retrans.secs_offset = -1;
+		capture->retrans.secs = 0;
+		if (secs_offset >= 0 && __ni_capture_get_udp_payload(buf, secs_offset,
+				&capture->retrans.secs, sizeof(capture->retrans.secs)) >= 0)
+			capture->retrans.secs_offset = secs_offset;
 		ni_capture_arm_retransmit(capture);
 	} else {
 		ni_capture_disarm_retransmit(capture);
@@ -767,11 +1468,52 @@ ni_capture_send(ni_capture_t *capture, const ni_buffer_t *buf, const ni_timeout_
 	return rv;
 }
 
+ssize_t
+ni_capture_send(ni_capture_t *capture, ni_buffer_t *buf, const ni_timeout_param_t *tmo)
+{
+	return __ni_capture_send_retransmit(capture, buf, tmo, -1);
+}
+
+/*
+ * Same as ni_capture_send, but each retransmit advances the 16bit
+ * seconds counter at secs_offset of the UDP payload by the time
+ * elapsed since the initial send (as the DHCP4 secs field requires).
+ */
+ssize_t
+ni_capture_send_update_secs(ni_capture_t *capture, ni_buffer_t *buf,
+				const ni_timeout_param_t *tmo, unsigned int secs_offset)
+{
+	return __ni_capture_send_retransmit(capture, buf, tmo, secs_offset);
+}
+
+static void
+ni_capture_ring_leave(ni_capture_t *capture)
+{
+	ni_capture_ring_t *ring = capture->ring;
+	ni_capture_t **pos;
+
+	for (pos = &ring->members; *pos; pos = &(*pos)->ring_next) {
+		if (*pos == capture) {
+			*pos = capture->ring_next;
+			break;
+		}
+	}
+	capture->ring = NULL;
+	capture->ring_next = NULL;
+	capture->sock = NULL;
+	if (ring->members && capture->client_filter)
+		ni_capture_ring_set_filter(ring);
+	ni_capture_ring_put(ring);
+}
+
 void
 ni_capture_free(ni_capture_t *capture)
 {
 	if (!capture)
 		return;
+	if (capture->ring) {
+		ni_capture_ring_leave(capture);
+	} else
 	if (capture->sock)
 		ni_socket_close(capture->sock);
 	if (capture->buffer)
@@ -91,6 +91,29 @@ ni_client_state_control_print_xml(const ni_client_state_control_t *ctrl, xml_nod
 	return TRUE;
 }
 
+static ni_bool_t
+ni_client_state_subtrees_print_xml(const ni_client_state_subtree_array_t *subtrees, xml_node_t *node)
+{
+	const ni_client_state_subtree_t *st;
+	xml_node_t *parent, *child;
+	unsigned int i;
+
+	if (!(parent = xml_node_new(NI_CLIENT_STATE_XML_CONFIG_SUBTREES_NODE, node)))
+		return FALSE;
+
+	for (i = 0; i < subtrees->count; ++i) {
+		st = &subtrees->data[i];
+
+		child = xml_node_new_element(NI_CLIENT_STATE_XML_CONFIG_SUBTREE_NODE,
+				parent, ni_uuid_print(&st->uuid));
+		if (!child)
+			return FALSE;
+		xml_node_add_attr(child, NI_CLIENT_STATE_XML_CONFIG_SUBTREE_NAME, st->name);
+	}
+
+	return TRUE;
+}
+
 ni_bool_t
 ni_client_state_config_print_xml(const ni_client_state_config_t *conf, xml_node_t *node)
 {
@@ -119,6 +142,10 @@ ni_client_state_config_print_xml(const ni_client_state_config_t *conf, xml_node_
 	}
 	ni_string_free(&tmp);
 
+	if (conf->subtrees.count &&
+	    !ni_client_state_subtrees_print_xml(&conf->subtrees, parent))
+		return FALSE;
+
 	return TRUE;
 }
 
@@ -165,6 +192,33 @@ ni_client_state_control_parse_xml(const xml_node_t *node, ni_client_state_contro
 	return TRUE;
 }
 
+static ni_bool_t
+ni_client_state_subtrees_parse_xml(const xml_node_t *node, ni_client_state_subtree_array_t *subtrees)
+{
+	const xml_node_t *child;
+	const char *name;
+	ni_uuid_t uuid;
+
+	ni_client_state_subtree_array_destroy(subtrees);
+	for (child = node->children; child; child = child->next) {
+		if (!ni_string_eq(child->name, NI_CLIENT_STATE_XML_CONFIG_SUBTREE_NODE))
+			continue;
+
+		name = xml_node_get_attr(child, NI_CLIENT_STATE_XML_CONFIG_SUBTREE_NAME);
+		if (ni_string_empty(name) || !child->cdata ||
+		    ni_uuid_parse(&uuid, child->cdata))
+			goto failure;
+
+		if (!ni_client_state_subtree_array_append(subtrees, name, &uuid))
+			goto failure;
+	}
+	return TRUE;
+
+failure:
+	ni_client_state_subtree_array_destroy(subtrees);
+	return FALSE;
+}
+
 ni_bool_t
 ni_client_state_config_parse_xml(const xml_node_t *node, ni_client_state_config_t *conf)
 {
@@ -192,6 +246,11 @@ ni_client_state_config_parse_xml(const xml_node_t *node, ni_client_state_config_
 	if (!child || !child->cdata || ni_parse_uint(child->cdata, &conf->owner, 10))
 		return FALSE;
 
+	/* <subtrees> node is optional, written by newer clients only */
+	child = xml_node_get_child(parent, NI_CLIENT_STATE_XML_CONFIG_SUBTREES_NODE);
+	if (child && !ni_client_state_subtrees_parse_xml(child, &conf->subtrees))
+		return FALSE;
+
 	return TRUE;
 }
 
@@ -289,7 +348,7 @@ void
 ni_client_state_free(ni_client_state_t *cs)
 {
 	if (cs) {
-		ni_string_free(&cs->config.origin);
+		ni_client_state_config_reset(&cs->config);
 		free(cs);
 	}
 }
@@ -308,6 +367,7 @@ ni_client_state_config_reset(ni_client_state_config_t *conf)
 {
 	if (conf) {
 		ni_string_free(&conf->origin);
+		ni_client_state_subtree_array_destroy(&conf->subtrees);
 		ni_client_state_config_init(conf);
 	}
 }
@@ -321,12 +381,143 @@ ni_client_state_config_copy(ni_client_state_config_t *conf,
 			conf->uuid = src->uuid;
 			conf->owner = src->owner;
 			ni_string_dup(&conf->origin, src->origin);
+			ni_client_state_subtree_array_copy(&conf->subtrees, &src->subtrees);
 		} else {
 			ni_client_state_config_reset(conf);
 		}
 	}
 }
 
+/*
+ * Config subtree fingerprints
+ */
+void
+ni_client_state_subtree_array_init(ni_client_state_subtree_array_t *array)
+{
+	if (array)
+		memset(array, 0, sizeof(*array));
+}
+
+void
+ni_client_state_subtree_array_destroy(ni_client_state_subtree_array_t *array)
+{
+	unsigned int i;
+
+	if (!array)
+		return;
+
+	for (i = 0; i < array->count; ++i)
+		ni_string_free(&array->data[i].name);
+	free(array->data);
+	ni_client_state_subtree_array_init(array);
+}
+
+void
+ni_client_state_subtree_array_copy(ni_client_state_subtree_array_t *dst,
+			const ni_client_state_subtree_array_t *src)
+{
+	unsigned int i;
+
+	if (!dst || dst == src)
+		return;
+
+	ni_client_state_subtree_array_destroy(dst);
+	for (i = 0; src && i < src->count; ++i) {
+		ni_client_state_subtree_array_append(dst,
+				src->data[i].name, &src->data[i].uuid);
+	}
+}
+
+ni_bool_t
+ni_client_state_subtree_array_append(ni_client_state_subtree_array_t *array,
+			const char *name, const ni_uuid_t *uuid)
+{
+	ni_client_state_subtree_t *st;
+
+	if (!array || ni_string_empty(name) || !uuid)
+		return FALSE;
+
+	array->data = xrealloc(array->data, (array->count + 1) * sizeof(array->data[0]));
+	st = &array->data[array->count++];
+	st->name = xstrdup(name);
+	st->uuid = *uuid;
+	return TRUE;
+}
+
+/*
+ * Find the n-th subtree with the given name; nodes such as <route>
+ * or <address> may appear multiple times under the same parent.
+ */
+const ni_client_state_subtree_t *
+ni_client_state_subtree_array_find(const ni_client_state_subtree_array_t *array,
+			const char *name, unsigned int nth)
+{
+	unsigned int i;
+
+	if (!array)
+		return NULL;
+
+	for (i = 0; i < array->count; ++i) {
+		if (!ni_string_eq(array->data[i].name, name))
+			continue;
+		if (nth-- == 0)
+			return &array->data[i];
+	}
+	return NULL;
+}
+
+static unsigned int
+ni_client_state_subtree_array_nth(const ni_client_state_subtree_array_t *array, unsigned int pos)
+{
+	unsigned int i, nth = 0;
+
+	for (i = 0; i < pos; ++i) {
+		if (ni_string_eq(array->data[i].name, array->data[pos].name))
+			nth++;
+	}
+	return nth;
+}
+
+/*
+ * Compare two subtree fingerprint sets and report the names of
+ * new or modified subtrees in @changed and of the subtrees which
+ * exist in @old only in @removed. Returns the number of differences.
+ */
+unsigned int
+ni_client_state_subtree_array_diff(const ni_client_state_subtree_array_t *old,
+			const ni_client_state_subtree_array_t *new,
+			ni_string_array_t *changed, ni_string_array_t *removed)
+{
+	const ni_client_state_subtree_t *st, *match;
+	unsigned int i, count = 0;
+
+	for (i = 0; new && i < new->count; ++i) {
+		st = &new->data[i];
+		match = ni_client_state_subtree_array_find(old, st->name,
+				ni_client_state_subtree_array_nth(new, i));
+
+		if (match && ni_uuid_equal(&match->uuid, &st->uuid))
+			continue;
+
+		count++;
+		if (changed && ni_string_array_index(changed, st->name) < 0)
+			ni_string_array_append(changed, st->name);
+	}
+
+	for (i = 0; old && i < old->count; ++i) {
+		st = &old->data[i];
+		match = ni_client_state_subtree_array_find(new, st->name,
+				ni_client_state_subtree_array_nth(old, i));
+		if (match)
+			continue;
+
+		count++;
+		if (removed && ni_string_array_index(removed, st->name) < 0)
+			ni_string_array_append(removed, st->name);
+	}
+	return count;
+}
+
 ni_bool_t
 ni_client_state_save(const ni_client_state_t *client_state, unsigned int ifindex)
 {
@@ -523,12 +714,13 @@ ni_client_state_config_debug(const char *name, const ni_client_state_config_t *c
 	if (!conf)
 		return;
 
-	ni_debug_application("%s: %s <%s> %s: %s=%s, %s=%s, %s=%u",
+	ni_debug_application("%s: %s <%s> %s: %s=%s, %s=%s, %s=%u, %s=%u",
 		name ? name : "unknown", action ? action : "unknown",
 		NI_CLIENT_STATE_XML_NODE, NI_CLIENT_STATE_XML_CONFIG_NODE,
 		NI_CLIENT_STATE_XML_CONFIG_ORIGIN_NODE, conf->origin,
 		NI_CLIENT_STATE_XML_CONFIG_UUID_NODE, ni_uuid_print(&conf->uuid),
-		NI_CLIENT_STATE_XML_CONFIG_OWNER_NODE, conf->owner
+		NI_CLIENT_STATE_XML_CONFIG_OWNER_NODE, conf->owner,
+		NI_CLIENT_STATE_XML_CONFIG_SUBTREES_NODE, conf->subtrees.count
 	);
 }
 
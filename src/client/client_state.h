@@ -22,18 +22,38 @@
 #define NI_CLIENT_STATE_XML_CONFIG_UUID_NODE	"uuid"
 #define NI_CLIENT_STATE_XML_CONFIG_ORIGIN_NODE	"origin"
 #define NI_CLIENT_STATE_XML_CONFIG_OWNER_NODE	"owner-uid"
+#define NI_CLIENT_STATE_XML_CONFIG_SUBTREES_NODE	"subtrees"
+#define NI_CLIENT_STATE_XML_CONFIG_SUBTREE_NODE	"subtree"
+#define NI_CLIENT_STATE_XML_CONFIG_SUBTREE_NAME	"name"
 
 typedef struct ni_client_state_control {
 	ni_bool_t persistent;   /* allowing/disallowing ifdown flag */
 	ni_bool_t usercontrol;  /* allowing/disallowing user to change the config */
 } ni_client_state_control_t;
 
+/*
+ * Fingerprint of a single top-level config subtree, e.g. <ipv4:static>,
+ * used by ifreload to find out which parts of a config have changed.
+ */
+typedef struct ni_client_state_subtree {
+	char *		name;	/* Name of the top-level config node      */
+	ni_uuid_t	uuid;	/* UUIDv5 hash of the config node content */
+} ni_client_state_subtree_t;
+
+typedef struct ni_client_state_subtree_array {
+	unsigned int			count;
+	ni_client_state_subtree_t *	data;
+} ni_client_state_subtree_array_t;
+#define NI_CLIENT_STATE_SUBTREE_ARRAY_INIT { .count = 0, .data = NULL }
+
 typedef struct ni_client_state_config {
 	ni_uuid_t	uuid;   /* Configuration UUID marker of the interface */
 	char *	origin; /* Source of the configuration of the interface */
 	uid_t	owner;  /* User's UID who has initiated the given configuration */
+	ni_client_state_subtree_array_t subtrees; /* Per-subtree fingerprints */
 } ni_client_state_config_t;
-#define NI_CLIENT_STATE_CONFIG_INIT { .uuid = NI_UUID_INIT, .origin = NULL, .owner = -1U }
+#define NI_CLIENT_STATE_CONFIG_INIT { .uuid = NI_UUID_INIT, .origin = NULL, .owner = -1U, \
+				      .subtrees = NI_CLIENT_STATE_SUBTREE_ARRAY_INIT }
 
 typedef struct ni_client_state {
 	ni_client_state_control_t	control;
@@ -50,6 +70,19 @@ extern void		ni_client_state_config_reset(ni_client_state_config_t *);
 extern void		ni_client_state_config_copy(ni_client_state_config_t *,
 						const ni_client_state_config_t *);
 
+extern void		ni_client_state_subtree_array_init(ni_client_state_subtree_array_t *);
+extern void		ni_client_state_subtree_array_destroy(ni_client_state_subtree_array_t *);
+extern void		ni_client_state_subtree_array_copy(ni_client_state_subtree_array_t *,
+						const ni_client_state_subtree_array_t *);
+extern ni_bool_t	ni_client_state_subtree_array_append(ni_client_state_subtree_array_t *,
+						const char *, const ni_uuid_t *);
+extern const ni_client_state_subtree_t *
+			ni_client_state_subtree_array_find(const ni_client_state_subtree_array_t *,
+						const char *, unsigned int);
+extern unsigned int	ni_client_state_subtree_array_diff(const ni_client_state_subtree_array_t *,
+						const ni_client_state_subtree_array_t *,
+						ni_string_array_t *, ni_string_array_t *);
+
 extern ni_bool_t	ni_client_state_control_is_valid(const ni_client_state_control_t *);
 extern ni_bool_t	ni_client_state_config_is_valid(const ni_client_state_config_t *);
 extern ni_bool_t	ni_client_state_is_valid(const ni_client_state_t *);
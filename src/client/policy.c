@@ -44,22 +44,55 @@
  * We do this by hashing the XML configuration using a reasonably
  * collision free SHA hash algorithm, and storing that in a UUIDv5.
  */
+/* UUIDv5 of https://github.com/openSUSE/wicked in the URL
+ * namespace as our private namespace for the config UUIDs:
+ *      c89756cc-b7fb-569b-b7f0-49a400fa41fe
+ */
+static const ni_uuid_t	ni_ifconfig_uuid_ns = {
+	.octets = {
+		0xc8, 0x97, 0x56, 0xcc, 0xb7, 0xfb, 0x56, 0x9b,
+		0xb7, 0xf0, 0x49, 0xa4, 0x00, 0xfa, 0x41, 0xfe
+	}
+};
+
 ni_bool_t
 ni_ifconfig_generate_uuid(const xml_node_t *config, ni_uuid_t *uuid)
 {
-	/* UUIDv5 of https://github.com/openSUSE/wicked in the URL
-	 * namespace as our private namespace for the config UUIDs:
-	 *      c89756cc-b7fb-569b-b7f0-49a400fa41fe
-	 */
-	static const ni_uuid_t ns = {
-		.octets = {
-			0xc8, 0x97, 0x56, 0xcc, 0xb7, 0xfb, 0x56, 0x9b,
-			0xb7, 0xf0, 0x49, 0xa4, 0x00, 0xfa, 0x41, 0xfe
-		}
-	};
 	memset(uuid, 0, sizeof(*uuid));
 	/* Generate a version 5 (SHA1) UUID */
-	return xml_node_uuid(config, 5, &ns, uuid) == 0;
+	return xml_node_uuid(config, 5, &ni_ifconfig_uuid_ns, uuid) == 0;
+}
+
+/*
+ * Generate a UUID for each top-level node of the configuration,
+ * e.g. <link>, <ethernet>, <ipv4:static>, <bond>, ...
+ *
+ * ifreload compares these against the fingerprints recorded in the
+ * client-state of the device to find out, which parts of the config
+ * changed and whether they can be applied without an ifdown.
+ */
+ni_bool_t
+ni_ifconfig_generate_subtree_uuids(const xml_node_t *config, ni_client_state_subtree_array_t *subtrees)
+{
+	const xml_node_t *child;
+	ni_uuid_t uuid;
+
+	ni_client_state_subtree_array_destroy(subtrees);
+	if (xml_node_is_empty(config))
+		return FALSE;
+
+	for (child = config->children; child; child = child->next) {
+		if (ni_string_empty(child->name) ||
+		    ni_string_eq(child->name, NI_CLIENT_STATE_XML_NODE))
+			continue;
+
+		if (xml_node_uuid(child, 5, &ni_ifconfig_uuid_ns, &uuid) != 0 ||
+		    !ni_client_state_subtree_array_append(subtrees, child->name, &uuid)) {
+			ni_client_state_subtree_array_destroy(subtrees);
+			return FALSE;
+		}
+	}
+	return TRUE;
 }
 
 static xml_node_t *
@@ -36,6 +36,8 @@ static ni_bool_t	ni_config_parse_addrconf_dhcp4(struct ni_config_dhcp4 *, xml_no
 static ni_bool_t	ni_config_parse_addrconf_dhcp6(struct ni_config_dhcp6 *, xml_node_t *);
 static void		ni_config_parse_update_targets(unsigned int *, const xml_node_t *);
 static void		ni_config_parse_fslocation(ni_config_fslocation_t *, xml_node_t *);
+static void		ni_config_parse_netif_events(struct ni_config_netif_events *, const xml_node_t *);
+static void		ni_config_parse_tx_schedule(struct ni_config_tx_schedule *, const xml_node_t *);
 static ni_bool_t	ni_config_parse_objectmodel_extension(ni_extension_t **, xml_node_t *);
 static ni_bool_t	ni_config_parse_objectmodel_netif_ns(ni_extension_t **, xml_node_t *);
 static ni_bool_t	ni_config_parse_objectmodel_firmware_discovery(ni_extension_t **, xml_node_t *);
@@ -61,6 +63,10 @@ ni_config_new()
 	conf->addrconf.dhcp6.allow_update   = conf->addrconf.default_allow_update;
 	conf->addrconf.autoip.allow_update  = conf->addrconf.default_allow_update;
 
+	conf->addrconf.tx_schedule.window = 1000;
+	conf->addrconf.tx_schedule.rate = 20;
+	conf->addrconf.tx_schedule.burst = 50;
+
 	conf->recv_max = 64 * 1024;
 
 	ni_config_fslocation_init(&conf->piddir,   WICKED_PIDDIR,   0755);
@@ -69,6 +75,12 @@ ni_config_new()
 
 	conf->use_nanny = FALSE;
 
+	conf->netif_events.batch = FALSE;
+	conf->netif_events.rate = 1000;
+	conf->netif_events.burst = 2000;
+
+	conf->dbus_slow_call_threshold = 500;
+
 	return conf;
 }
 
@@ -82,6 +94,8 @@ ni_config_free(ni_config_t *conf)
 	ni_extension_list_destroy(&conf->updater_extensions);
 	ni_string_free(&conf->dbus_name);
 	ni_string_free(&conf->dbus_type);
+	ni_string_free(&conf->dbus_peer_socket);
+	ni_string_free(&conf->netif_snapshot);
 	ni_string_free(&conf->dbus_xml_schema_file);
 	ni_config_fslocation_destroy(&conf->piddir);
 	ni_config_fslocation_destroy(&conf->storedir);
@@ -146,7 +160,24 @@ __ni_config_parse(ni_config_t *conf, const char *filename, ni_init_appdata_callb
 				ni_string_dup(&conf->dbus_name, attrval);
 			if ((attrval = xml_node_get_attr(child, "type")) != NULL)
 				ni_string_dup(&conf->dbus_type, attrval);
+			if ((attrval = xml_node_get_attr(child, "peer-socket")) != NULL)
+				ni_string_dup(&conf->dbus_peer_socket, attrval);
+			if ((attrval = xml_node_get_attr(child, "slow-call-threshold")) != NULL
+			 && ni_parse_uint(attrval, &conf->dbus_slow_call_threshold, 10) < 0) {
+				ni_error("%s: invalid dbus slow-call-threshold \"%s\"",
+					xml_node_location(child), attrval);
+				goto failed;
+			}
 		} else 
+		if (strcmp(child->name, "netif-events") == 0) {
+			ni_config_parse_netif_events(&conf->netif_events, child);
+		} else
+		if (strcmp(child->name, "netif-snapshot") == 0) {
+			const char *attrval;
+
+			if ((attrval = xml_node_get_attr(child, "path")) != NULL)
+				ni_string_dup(&conf->netif_snapshot, attrval);
+		} else
 		if (strcmp(child->name, "schema") == 0) {
 			const char *attrval;
 
@@ -160,6 +191,9 @@ __ni_config_parse(ni_config_t *conf, const char *filename, ni_init_appdata_callb
 				if (!strcmp(gchild->name, "default-allow-update"))
 					ni_config_parse_update_targets(&conf->addrconf.default_allow_update, gchild);
 
+				if (!strcmp(gchild->name, "tx-schedule"))
+					ni_config_parse_tx_schedule(&conf->addrconf.tx_schedule, gchild);
+
 				if (!strcmp(gchild->name, "dhcp4")
 				 && !ni_config_parse_addrconf_dhcp4(&conf->addrconf.dhcp4, gchild))
 					goto failed;
@@ -305,6 +339,18 @@ ni_config_parse_addrconf_dhcp4(struct ni_config_dhcp4 *dhcp4, xml_node_t *node)
 		}
 		if (!strcmp(child->name, "allow-update"))
 			ni_config_parse_update_targets(&dhcp4->allow_update, child);
+		if (!strcmp(child->name, "shared-capture")
+		 && ni_parse_boolean(child->cdata, &dhcp4->shared_capture)) {
+			ni_error("config: invalid <shared-capture> value \"%s\"",
+					child->cdata);
+			return FALSE;
+		}
+		if (!strcmp(child->name, "rapid-commit")
+		 && ni_parse_boolean(child->cdata, &dhcp4->rapid_commit)) {
+			ni_error("config: invalid <rapid-commit> value \"%s\"",
+					child->cdata);
+			return FALSE;
+		}
 	}
 	return TRUE;
 }
@@ -553,6 +599,13 @@ ni_config_parse_addrconf_dhcp6(struct ni_config_dhcp6 *dhcp6, xml_node_t *node)
 		if (!strcmp(child->name, "lease-time") && child->cdata) {
 			dhcp6->lease_time = strtoul(child->cdata, NULL, 0);
 		} else
+		if (!strcmp(child->name, "shared-socket")) {
+			if (ni_parse_boolean(child->cdata, &dhcp6->shared_socket)) {
+				ni_error("config: invalid <shared-socket> value \"%s\"",
+						child->cdata);
+				return FALSE;
+			}
+		} else
 		if (!strcmp(child->name, "ignore-server")
 		 && (attrval = xml_node_get_attr(child, "ip")) != NULL) {
 			ni_string_array_append(&dhcp6->ignore_servers, attrval);
@@ -656,6 +709,38 @@ ni_config_parse_fslocation(ni_config_fslocation_t *fsloc, xml_node_t *node)
 		ni_parse_uint(attrval, &fsloc->mode, 8);
 }
 
+/*
+ * <netif-events batch="false" rate="1000" burst="2000"/>
+ */
+static void
+ni_config_parse_netif_events(struct ni_config_netif_events *events, const xml_node_t *node)
+{
+	const char *attrval;
+
+	if ((attrval = xml_node_get_attr(node, "batch")) != NULL)
+		ni_parse_boolean(attrval, &events->batch);
+	if ((attrval = xml_node_get_attr(node, "rate")) != NULL)
+		ni_parse_uint(attrval, &events->rate, 10);
+	if ((attrval = xml_node_get_attr(node, "burst")) != NULL)
+		ni_parse_uint(attrval, &events->burst, 10);
+}
+
+/*
+ * <tx-schedule window="1000" rate="20" burst="50"/>
+ */
+static void
+ni_config_parse_tx_schedule(struct ni_config_tx_schedule *sched, const xml_node_t *node)
+{
+	const char *attrval;
+
+	if ((attrval = xml_node_get_attr(node, "window")) != NULL)
+		ni_parse_uint(attrval, &sched->window, 10);
+	if ((attrval = xml_node_get_attr(node, "rate")) != NULL)
+		ni_parse_uint(attrval, &sched->rate, 10);
+	if ((attrval = xml_node_get_attr(node, "burst")) != NULL)
+		ni_parse_uint(attrval, &sched->burst, 10);
+}
+
 /*
  * Object model extensions let you implement parts of a dbus interface separately
  * from the main wicked body of code; either through a shared library or an
@@ -29,18 +29,24 @@ struct ni_dbus_client {
 struct ni_dbus_client_object {
 	ni_dbus_client_t *	client;
 	char *			default_interface;
+	ni_dbus_generation_array_t generations;	/* of the applied property dicts */
 };
 
 
-static dbus_bool_t	__ni_dbus_object_get_managed_object_interfaces(ni_dbus_object_t *, DBusMessageIter *);
+static dbus_bool_t	__ni_dbus_object_get_managed_object_list(ni_dbus_object_t *, DBusMessageIter *,
+					const ni_dbus_variant_t *generations);
+static dbus_bool_t	__ni_dbus_object_get_managed_object_interfaces(ni_dbus_object_t *, DBusMessageIter *,
+					const ni_dbus_variant_t *generations);
 static dbus_bool_t	__ni_dbus_object_get_managed_object_properties(ni_dbus_object_t *proxy,
 					const ni_dbus_service_t *service,
+					const ni_dbus_variant_t *generations,
 					DBusMessageIter *iter);
 static dbus_bool_t	__ni_dbus_object_refresh_property(ni_dbus_object_t *obj, const ni_dbus_service_t *service,
 				const ni_dbus_property_t *property_list,
 				const char *name, const ni_dbus_variant_t *value);
 static dbus_bool_t	__ni_dbus_object_refresh_properties(ni_dbus_object_t *proxy,
 					const ni_dbus_service_t *service,
+					uint64_t generation,
 					DBusMessageIter *iter);
 static void		__ni_dbus_object_mark_stale(ni_dbus_object_t *);
 static void		__ni_dbus_object_purge_stale(ni_dbus_object_t *);
@@ -67,6 +73,39 @@ ni_dbus_client_open(const char *bus_type, const char *bus_name)
 	return dbc;
 }
 
+/*
+ * Constructor for a DBus client handle talking directly to the
+ * server listening on the given unix socket instead of via the bus.
+ * The bus name is still used as destination of our calls, but the
+ * server ignores it.
+ */
+ni_dbus_client_t *
+ni_dbus_client_open_peer(const char *socket_path, const char *bus_name)
+{
+	ni_dbus_connection_t *peerconn;
+	ni_dbus_client_t *dbc;
+	char *address, *escaped;
+
+	NI_TRACE_ENTER_ARGS("socket_path=%s, bus_name=%s", socket_path, bus_name);
+	if (!(escaped = dbus_address_escape_value(socket_path)))
+		return NULL;
+
+	address = NULL;
+	ni_string_printf(&address, "unix:path=%s", escaped);
+	dbus_free(escaped);
+
+	peerconn = ni_dbus_connection_open_peer(address);
+	ni_string_free(&address);
+	if (peerconn == NULL)
+		return NULL;
+
+	dbc = xcalloc(1, sizeof(*dbc));
+	ni_string_dup(&dbc->bus_name, bus_name);
+	dbc->connection = peerconn;
+	dbc->call_timeout = 10000;
+	return dbc;
+}
+
 /*
  * Destructor for DBus client handle
  */
@@ -116,6 +155,7 @@ __ni_dbus_client_object_destroy(ni_dbus_object_t *object)
 
 	if ((cob = object->client_object) != NULL) {
 		ni_string_free(&cob->default_interface);
+		ni_dbus_generation_array_destroy(&cob->generations);
 		cob->client = NULL;
 	}
 }
@@ -222,6 +262,20 @@ ni_dbus_client_add_signal_handler(ni_dbus_client_t *client,
 					callback, user_data);
 }
 
+void
+ni_dbus_client_add_signal_handler_ex(ni_dbus_client_t *client,
+					const char *sender,
+					const char *object_path,
+					const char *object_interface,
+					const char *member,
+					ni_dbus_signal_handler_t *callback,
+					void *user_data)
+{
+	ni_dbus_add_signal_handler_ex(client->connection,
+					sender, object_path, object_interface,
+					member, callback, user_data);
+}
+
 /*
  * Proxy objects, and calling through proxies
  */
@@ -349,17 +403,14 @@ out:
 	return rv;
 }
 
-dbus_bool_t
-ni_dbus_object_call_variant(const ni_dbus_object_t *proxy,
+static ni_dbus_message_t *
+__ni_dbus_object_call_variant_new(const ni_dbus_object_t *proxy,
 					const char *interface_name, const char *method,
 					unsigned int nargs, const ni_dbus_variant_t *args,
-					unsigned int maxres, ni_dbus_variant_t *res,
-					DBusError *error)
+					ni_dbus_client_t **client_ret, DBusError *error)
 {
-	ni_dbus_message_t *call = NULL, *reply = NULL;
+	ni_dbus_message_t *call = NULL;
 	ni_dbus_client_t *client;
-	dbus_bool_t rv = FALSE;
-	int nres;
 
 	if (!interface_name) {
 		const ni_dbus_service_t **pos, *service, *best = NULL;
@@ -383,7 +434,7 @@ ni_dbus_object_call_variant(const ni_dbus_object_t *proxy,
 					dbus_set_error(error, DBUS_ERROR_UNKNOWN_METHOD,
 							"%s: several dbus interfaces provide method %s",
 							proxy->path, method);
-					return FALSE;
+					return NULL;
 				}
 			}
 		}
@@ -399,22 +450,45 @@ ni_dbus_object_call_variant(const ni_dbus_object_t *proxy,
 		dbus_set_error(error, DBUS_ERROR_UNKNOWN_METHOD,
 				"%s: no registered dbus interface provides method %s",
 				proxy->path, method);
-		return FALSE;
+		return NULL;
 	}
 
 	if (!proxy || !(client = ni_dbus_object_get_client(proxy)) || !interface_name) {
 		dbus_set_error(error, DBUS_ERROR_INVALID_ARGS, "%s: bad proxy object", __FUNCTION__);
-		return FALSE;
+		return NULL;
 	}
 
 	NI_TRACE_ENTER_ARGS("%s, if=%s, method=%s", proxy->path, interface_name, method);
 	call = dbus_message_new_method_call(client->bus_name, proxy->path, interface_name, method);
 	if (call == NULL) {
 		dbus_set_error(error, DBUS_ERROR_FAILED, "%s: unable to build %s() message", __FUNCTION__, method);
-		goto out;
+		return NULL;
+	}
+
+	if (nargs && !ni_dbus_message_serialize_variants(call, nargs, args, error)) {
+		dbus_message_unref(call);
+		return NULL;
 	}
 
-	if (nargs && !ni_dbus_message_serialize_variants(call, nargs, args, error))
+	*client_ret = client;
+	return call;
+}
+
+dbus_bool_t
+ni_dbus_object_call_variant(const ni_dbus_object_t *proxy,
+					const char *interface_name, const char *method,
+					unsigned int nargs, const ni_dbus_variant_t *args,
+					unsigned int maxres, ni_dbus_variant_t *res,
+					DBusError *error)
+{
+	ni_dbus_message_t *call = NULL, *reply = NULL;
+	ni_dbus_client_t *client = NULL;
+	dbus_bool_t rv = FALSE;
+	int nres;
+
+	call = __ni_dbus_object_call_variant_new(proxy, interface_name, method,
+						nargs, args, &client, error);
+	if (call == NULL)
 		goto out;
 
 	if ((reply = ni_dbus_client_call(client, call, error)) == NULL)
@@ -468,17 +542,59 @@ ni_dbus_object_call_async(ni_dbus_object_t *proxy,
 	return rv;
 }
 
+/*
+ * Asynchronous variant call. The callback receives the reply message,
+ * which is either a method return or an error (e.g. on timeout).
+ * Returns 0 when the call has been sent; the callback is not invoked
+ * when sending failed or the call is canceled.
+ */
+int
+ni_dbus_object_call_variant_async(const ni_dbus_object_t *proxy,
+					const char *interface_name, const char *method,
+					unsigned int nargs, const ni_dbus_variant_t *args,
+					ni_dbus_async_reply_callback_t *callback, void *user_data,
+					DBusError *error)
+{
+	ni_dbus_client_t *client = NULL;
+	ni_dbus_message_t *call;
+	int rv;
+
+	call = __ni_dbus_object_call_variant_new(proxy, interface_name, method,
+						nargs, args, &client, error);
+	if (call == NULL)
+		return -NI_ERROR_INVALID_ARGS;
+
+	rv = ni_dbus_connection_call_async_reply(client->connection, call,
+			client->call_timeout, callback, user_data);
+	if (rv < 0)
+		dbus_set_error(error, DBUS_ERROR_FAILED, "%s: unable to send %s() message",
+				proxy->path, method);
+	dbus_message_unref(call);
+	return rv;
+}
+
+unsigned int
+ni_dbus_object_cancel_async(const ni_dbus_object_t *proxy, const void *user_data)
+{
+	ni_dbus_client_t *client;
+
+	if (!proxy || !(client = ni_dbus_object_get_client(proxy)))
+		return 0;
+
+	return ni_dbus_connection_cancel_async_reply(client->connection, user_data);
+}
+
 /*
  * Use ObjectManager.GetManagedObjects to retrieve (part of)
  * the server's object hierarchy
  */
-dbus_bool_t
-ni_dbus_object_get_managed_objects(ni_dbus_object_t *proxy, DBusError *error, ni_bool_t purge)
+static dbus_bool_t
+__ni_dbus_object_get_managed_objects_all(ni_dbus_object_t *proxy, DBusError *error)
 {
 	ni_dbus_client_t *client;
 	ni_dbus_object_t *objmgr;
 	ni_dbus_message_t *call = NULL, *reply = NULL;
-	DBusMessageIter iter, iter_dict;
+	DBusMessageIter iter;
 	dbus_bool_t rv = FALSE;
 
 	if (!(client = ni_dbus_object_get_client(proxy))) {
@@ -486,9 +602,6 @@ ni_dbus_object_get_managed_objects(ni_dbus_object_t *proxy, DBusError *error, ni
 		return FALSE;
 	}
 
-	if (purge)
-		__ni_dbus_object_mark_stale(proxy);
-
 	objmgr = ni_dbus_client_object_new(client, &ni_dbus_anonymous_class, proxy->path,
 			NI_DBUS_INTERFACE ".ObjectManager",
 			NULL);
@@ -498,8 +611,175 @@ ni_dbus_object_get_managed_objects(ni_dbus_object_t *proxy, DBusError *error, ni
 		goto out;
 
 	dbus_message_iter_init(reply, &iter);
-	if (!ni_dbus_message_open_dict_read(&iter, &iter_dict))
+	if (!__ni_dbus_object_get_managed_object_list(proxy, &iter, NULL))
 		goto bad_reply;
+
+	rv = TRUE;
+
+out:
+	if (call)
+		dbus_message_unref(call);
+	if (reply)
+		dbus_message_unref(reply);
+	ni_dbus_object_free(objmgr);
+	return rv;
+
+bad_reply:
+	dbus_set_error(error, DBUS_ERROR_FAILED, "%s: failed to parse reply", __FUNCTION__);
+	goto out;
+}
+
+/*
+ * Retrieve the server's object hierarchy below the proxy. This uses
+ * GetManagedObjectsFiltered without a filter, which also returns the
+ * generations of the property dicts, so unchanged ones are skipped.
+ */
+dbus_bool_t
+ni_dbus_object_get_managed_objects(ni_dbus_object_t *proxy, DBusError *error, ni_bool_t purge)
+{
+	ni_dbus_object_filter_t filter = NI_DBUS_OBJECT_FILTER_INIT;
+
+	if (!ni_dbus_object_get_client(proxy)) {
+		dbus_set_error(error, DBUS_ERROR_FAILED, "%s: not a client object", __FUNCTION__);
+		return FALSE;
+	}
+
+	if (purge)
+		__ni_dbus_object_mark_stale(proxy);
+
+	if (!ni_dbus_object_get_managed_objects_filtered(proxy, &filter, error))
+		return FALSE;
+
+	if (purge)
+		__ni_dbus_object_purge_stale(proxy);
+
+	return TRUE;
+}
+
+/*
+ * Use ObjectManager.GetManagedObjectsFiltered to refresh only the objects,
+ * interfaces and properties given by the filter, fetching chunk_size
+ * objects per call. Falls back to GetManagedObjects when the server does
+ * not know the filtered variant. Objects not returned are left alone.
+ * Property dicts with the generation applied last are skipped.
+ */
+dbus_bool_t
+ni_dbus_object_get_managed_objects_filtered(ni_dbus_object_t *proxy,
+				const ni_dbus_object_filter_t *filter, DBusError *error)
+{
+	ni_dbus_variant_t arg = NI_DBUS_VARIANT_INIT;
+	ni_dbus_variant_t generations = NI_DBUS_VARIANT_INIT;
+	ni_dbus_client_t *client;
+	ni_dbus_object_t *objmgr;
+	ni_dbus_message_t *call = NULL, *reply = NULL;
+	DBusMessageIter iter, iter_gen;
+	uint32_t offset = 0;
+	dbus_bool_t rv = FALSE;
+	unsigned int i;
+
+	if (!(client = ni_dbus_object_get_client(proxy))) {
+		dbus_set_error(error, DBUS_ERROR_FAILED, "%s: not a client object", __FUNCTION__);
+		return FALSE;
+	}
+
+	objmgr = ni_dbus_client_object_new(client, &ni_dbus_anonymous_class, proxy->path,
+			NI_DBUS_INTERFACE ".ObjectManager",
+			NULL);
+
+	ni_dbus_variant_init_dict(&arg);
+	if (filter->paths.count) {
+		ni_dbus_variant_t *var = ni_dbus_dict_add(&arg, "paths");
+
+		ni_dbus_variant_init_string_array(var);
+		for (i = 0; i < filter->paths.count; ++i)
+			ni_dbus_variant_append_string_array(var, filter->paths.data[i]);
+	}
+	if (filter->interfaces.count) {
+		ni_dbus_variant_t *var = ni_dbus_dict_add(&arg, "interfaces");
+
+		ni_dbus_variant_init_string_array(var);
+		for (i = 0; i < filter->interfaces.count; ++i)
+			ni_dbus_variant_append_string_array(var, filter->interfaces.data[i]);
+	}
+	if (filter->properties.count) {
+		ni_dbus_variant_t *var = ni_dbus_dict_add(&arg, "properties");
+
+		ni_dbus_variant_init_string_array(var);
+		for (i = 0; i < filter->properties.count; ++i)
+			ni_dbus_variant_append_string_array(var, filter->properties.data[i]);
+	}
+	ni_dbus_dict_add_uint32(&arg, "limit", filter->chunk_size);
+
+	do {
+		ni_dbus_dict_delete_entry(&arg, "offset");
+		ni_dbus_dict_add_uint32(&arg, "offset", offset);
+
+		call = ni_dbus_object_call_new(objmgr, "GetManagedObjectsFiltered", 0);
+		if (!ni_dbus_message_serialize_variants(call, 1, &arg, error))
+			goto out;
+
+		if ((reply = ni_dbus_client_call(client, call, error)) == NULL) {
+			if (offset == 0 && dbus_error_has_name(error, DBUS_ERROR_UNKNOWN_METHOD)) {
+				ni_debug_dbus("%s: no filtered GetManagedObjects, fetching all",
+						proxy->path);
+				dbus_error_free(error);
+				rv = __ni_dbus_object_get_managed_objects_all(proxy, error);
+			}
+			goto out;
+		}
+
+		/* The generations follow the objects; we need them first */
+		dbus_message_iter_init(reply, &iter);
+		iter_gen = iter;
+		if (!dbus_message_iter_next(&iter_gen)
+		 || dbus_message_iter_get_arg_type(&iter_gen) != DBUS_TYPE_UINT32) {
+			dbus_set_error(error, DBUS_ERROR_FAILED, "%s: failed to parse reply", __FUNCTION__);
+			goto out;
+		}
+		dbus_message_iter_get_basic(&iter_gen, &offset);
+
+		if (dbus_message_iter_next(&iter_gen)
+		 && (!ni_dbus_message_iter_get_variant_data(&iter_gen, &generations)
+		  || !ni_dbus_variant_is_dict(&generations)))
+			ni_dbus_variant_destroy(&generations);
+
+		if (!__ni_dbus_object_get_managed_object_list(proxy, &iter,
+				generations.type != DBUS_TYPE_INVALID ? &generations : NULL)) {
+			dbus_set_error(error, DBUS_ERROR_FAILED, "%s: failed to parse reply", __FUNCTION__);
+			goto out;
+		}
+		ni_dbus_variant_destroy(&generations);
+
+		dbus_message_unref(call);
+		dbus_message_unref(reply);
+		call = reply = NULL;
+	} while (offset != 0);
+
+	rv = TRUE;
+
+out:
+	if (call)
+		dbus_message_unref(call);
+	ni_dbus_variant_destroy(&generations);
+	if (reply)
+		dbus_message_unref(reply);
+	ni_dbus_variant_destroy(&arg);
+	ni_dbus_object_free(objmgr);
+	return rv;
+}
+
+/*
+ * Parse the object dict returned by GetManagedObjects, creating the
+ * proxy objects as needed
+ */
+static dbus_bool_t
+__ni_dbus_object_get_managed_object_list(ni_dbus_object_t *proxy, DBusMessageIter *iter,
+				const ni_dbus_variant_t *generations)
+{
+	DBusMessageIter iter_dict;
+
+	if (!ni_dbus_message_open_dict_read(iter, &iter_dict))
+		return FALSE;
 	while (dbus_message_iter_get_arg_type(&iter_dict) == DBUS_TYPE_DICT_ENTRY) {
 		DBusMessageIter iter_dict_entry;
 		ni_dbus_object_t *descendant;
@@ -509,11 +789,11 @@ ni_dbus_object_get_managed_objects(ni_dbus_object_t *proxy, DBusError *error, ni
 		dbus_message_iter_next(&iter_dict);
 
 		if (dbus_message_iter_get_arg_type(&iter_dict_entry) != DBUS_TYPE_STRING)
-			goto bad_reply;
+			return FALSE;
 		dbus_message_iter_get_basic(&iter_dict_entry, &object_path);
 
 		if (!dbus_message_iter_next(&iter_dict_entry))
-			goto bad_reply;
+			return FALSE;
 
 		descendant = ni_dbus_object_create(proxy, object_path, NULL, NULL);
 
@@ -535,32 +815,19 @@ ni_dbus_object_get_managed_objects(ni_dbus_object_t *proxy, DBusError *error, ni
 		if (descendant->class && descendant->handle == NULL && descendant->class->initialize)
 			descendant->class->initialize(descendant);
 
-		if (!__ni_dbus_object_get_managed_object_interfaces(descendant, &iter_dict_entry))
-			goto bad_reply;
+		if (!__ni_dbus_object_get_managed_object_interfaces(descendant, &iter_dict_entry,
+					generations ? ni_dbus_dict_get(generations, object_path) : NULL))
+			return FALSE;
 
 		descendant->stale = FALSE;
 	}
 
-	if (purge)
-		__ni_dbus_object_purge_stale(proxy);
-
-	rv = TRUE;
-
-out:
-	if (call)
-		dbus_message_unref(call);
-	if (reply)
-		dbus_message_unref(reply);
-	ni_dbus_object_free(objmgr);
-	return rv;
-
-bad_reply:
-	dbus_set_error(error, DBUS_ERROR_FAILED, "%s: failed to parse reply", __FUNCTION__);
-	goto out;
+	return TRUE;
 }
 
 static dbus_bool_t
-__ni_dbus_object_get_managed_object_interfaces(ni_dbus_object_t *proxy, DBusMessageIter *iter)
+__ni_dbus_object_get_managed_object_interfaces(ni_dbus_object_t *proxy, DBusMessageIter *iter,
+				const ni_dbus_variant_t *generations)
 {
 	DBusMessageIter iter_variant, iter_dict;
 
@@ -620,7 +887,8 @@ __ni_dbus_object_get_managed_object_interfaces(ni_dbus_object_t *proxy, DBusMess
 		ni_dbus_object_register_service(proxy, service);
 
 		/* The value of this dict entry is the property dict */
-		if (!__ni_dbus_object_get_managed_object_properties(proxy, service, &iter_dict_entry))
+		if (!__ni_dbus_object_get_managed_object_properties(proxy, service,
+					generations, &iter_dict_entry))
 			return FALSE;
 	}
 
@@ -630,15 +898,20 @@ __ni_dbus_object_get_managed_object_interfaces(ni_dbus_object_t *proxy, DBusMess
 static dbus_bool_t
 __ni_dbus_object_get_managed_object_properties(ni_dbus_object_t *proxy,
 				const ni_dbus_service_t *service,
+				const ni_dbus_variant_t *generations,
 				DBusMessageIter *iter)
 {
 	DBusMessageIter iter_variant;
+	uint64_t generation = 0;
 
 	if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_VARIANT)
 		return FALSE;
 	dbus_message_iter_recurse(iter, &iter_variant);
 
-	return __ni_dbus_object_refresh_properties(proxy, service, &iter_variant);
+	if (generations)
+		ni_dbus_dict_get_uint64(generations, service->name, &generation);
+
+	return __ni_dbus_object_refresh_properties(proxy, service, generation, &iter_variant);
 }
 
 dbus_bool_t
@@ -703,11 +976,25 @@ __ni_dbus_object_refresh_property(ni_dbus_object_t *obj, const ni_dbus_service_t
 	return TRUE;
 }
 
+/*
+ * Apply a property dict to the proxy object. We remember the generation
+ * the server gave the dict applied last, and skip a dict with the same
+ * generation without even deserializing it.
+ */
 static dbus_bool_t
-__ni_dbus_object_refresh_properties(ni_dbus_object_t *proxy, const ni_dbus_service_t *service, DBusMessageIter *iter)
+__ni_dbus_object_refresh_properties(ni_dbus_object_t *proxy, const ni_dbus_service_t *service,
+				uint64_t generation, DBusMessageIter *iter)
 {
+	ni_dbus_client_object_t *cob = proxy->client_object;
+	ni_dbus_generation_t *gen = NULL;
 	DBusMessageIter iter_dict;
-	DBusError error = DBUS_ERROR_INIT;
+
+	if (cob) {
+		gen = ni_dbus_generation_array_get(&cob->generations, service);
+		if (generation && gen->generation == generation)
+			return TRUE;
+		gen->generation = 0;
+	}
 
 	if (!ni_dbus_message_open_dict_read(iter, &iter_dict))
 		return FALSE;
@@ -741,7 +1028,8 @@ __ni_dbus_object_refresh_properties(ni_dbus_object_t *proxy, const ni_dbus_servi
 		ni_dbus_variant_destroy(&value);
 	}
 
-	dbus_error_free(&error);
+	if (gen)
+		gen->generation = generation;
 	return TRUE;
 }
 
@@ -817,7 +1105,7 @@ ni_dbus_object_refresh_properties(ni_dbus_object_t *proxy, const ni_dbus_service
 		goto out;
 
 	dbus_message_iter_init(reply, &iter);
-	rv = __ni_dbus_object_refresh_properties(proxy, service, &iter);
+	rv = __ni_dbus_object_refresh_properties(proxy, service, 0, &iter);
 	if (!rv)
 		dbus_set_error(error, DBUS_ERROR_FAILED, "%s: failed to parse reply", __func__);
 
@@ -107,7 +107,7 @@ ni_dbus_message_get_args_variants(ni_dbus_message_t *msg, ni_dbus_variant_t *arg
 			iter_p = &iter_val;
 		}
 
-		if (!ni_dbus_message_iter_get_variant_data(iter_p, &argv[argc])) {
+		if (!ni_dbus_message_iter_get_pooled(msg, iter_p, &argv[argc])) {
 			do {
 				ni_dbus_variant_destroy(&argv[argc]);
 			} while (argc--);
@@ -116,8 +116,8 @@ ni_dbus_message_get_args_variants(ni_dbus_message_t *msg, ni_dbus_variant_t *arg
 
 		/* We keep a reference to the dbus message in this variant variable,
 		 * because the caller may decide to free the message (eg in
-		 * ni_dbus_object_call_variant()). However, some strings we use point
-		 * directly into the message; such as the dict keys.
+		 * ni_dbus_object_call_variant()). However, the strings we use point
+		 * directly into the message, and the arrays live in its variant pool.
 		 */
 		argv[argc].__message = dbus_message_ref(msg);
 		dbus_message_iter_next(&iter);
@@ -172,6 +172,8 @@ ni_dbus_variant_is_string_array(const ni_dbus_variant_t *var)
 static inline void
 __ni_dbus_variant_change_type(ni_dbus_variant_t *var, int new_type)
 {
+	if (var->__pooled)
+		ni_dbus_variant_destroy(var);
 	if (var->type == new_type)
 		return;
 	if (var->type != DBUS_TYPE_INVALID) {
@@ -574,12 +576,41 @@ ni_dbus_variant_is_byte_array(const ni_dbus_variant_t *var)
  */
 #define NI_DBUS_ARRAY_CHUNK		32
 #define NI_DBUS_ARRAY_ALLOCATION(len)	(((len) + NI_DBUS_ARRAY_CHUNK - 1) & ~(NI_DBUS_ARRAY_CHUNK - 1))
+/*
+ * Move the array of a variant deserialized into the variant pool of a
+ * message to the heap, before it is modified. The elements themselves
+ * stay in the pool, except for strings.
+ */
+static void
+__ni_dbus_array_unpool(ni_dbus_variant_t *var, size_t element_size)
+{
+	unsigned int max = NI_DBUS_ARRAY_ALLOCATION(var->array.len);
+	unsigned int i, len = var->array.len;
+	void *new_data;
+
+	new_data = xcalloc(max ?: NI_DBUS_ARRAY_CHUNK, element_size);
+	memcpy(new_data, var->byte_array_value, len * element_size);
+	var->byte_array_value = new_data;
+
+	if (var->array.element_type == DBUS_TYPE_STRING
+	 || var->array.element_type == DBUS_TYPE_OBJECT_PATH) {
+		for (i = 0; i < len; ++i)
+			var->string_array_value[i] = xstrdup(var->string_array_value[i]);
+	}
+	if (var->array.element_signature)
+		var->array.element_signature = xstrdup(var->array.element_signature);
+	var->__pooled = FALSE;
+}
+
 static inline void
 __ni_dbus_array_grow(ni_dbus_variant_t *var, size_t element_size, unsigned int grow_by)
 {
 	unsigned int max = NI_DBUS_ARRAY_ALLOCATION(var->array.len);
 	unsigned int len = var->array.len;
 
+	if (var->__pooled)
+		__ni_dbus_array_unpool(var, element_size);
+
 	if (len + grow_by >= max) {
 		void *new_data;
 
@@ -735,6 +766,42 @@ ni_dbus_variant_copy(ni_dbus_variant_t *dst, const ni_dbus_variant_t *src)
 	ni_fatal("%s: not implemented", __FUNCTION__);
 }
 
+/*
+ * A pooled variant owns no memory itself, but containers may hold
+ * values which were moved to the heap when they were modified (see
+ * __ni_dbus_array_unpool), while the container stayed in the pool.
+ */
+static void
+__ni_dbus_variant_destroy_pooled(ni_dbus_variant_t *var)
+{
+	unsigned int i;
+
+	if (var->type == DBUS_TYPE_STRUCT) {
+		for (i = 0; i < var->array.len; ++i)
+			ni_dbus_variant_destroy(&var->struct_value[i]);
+		return;
+	}
+	if (var->type != DBUS_TYPE_ARRAY)
+		return;
+
+	switch (var->array.element_type) {
+	case DBUS_TYPE_DICT_ENTRY:
+		for (i = 0; i < var->array.len; ++i)
+			ni_dbus_variant_destroy(&var->dict_array_value[i].datum);
+		break;
+	case DBUS_TYPE_INVALID:
+		if (var->array.element_signature == NULL)
+			break;
+		// fallthrough
+	case DBUS_TYPE_VARIANT:
+		for (i = 0; i < var->array.len; ++i)
+			ni_dbus_variant_destroy(&var->variant_array_value[i]);
+		break;
+	default:
+		break;
+	}
+}
+
 void
 ni_dbus_variant_destroy(ni_dbus_variant_t *var)
 {
@@ -743,6 +810,10 @@ ni_dbus_variant_destroy(ni_dbus_variant_t *var)
 				__func__, var->__magic);
 	}
 
+	if (var->__pooled) {
+		/* Released along with the message */
+		__ni_dbus_variant_destroy_pooled(var);
+	} else
 	if (var->type == DBUS_TYPE_STRING
 	 || var->type == DBUS_TYPE_OBJECT_PATH)
 		ni_string_free(&var->string_value);
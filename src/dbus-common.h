@@ -9,12 +9,15 @@
 #define __WICKED_DBUS_COMMON_H__
 
 
+#include <sys/time.h>
 #include <wicked/dbus.h>
 
 #define NI_DBUS_BUS_NAME	"org.freedesktop.DBus"
 #define NI_DBUS_OBJECT_PATH	"/org/freedesktop/DBus"
 #define NI_DBUS_INTERFACE	"org.freedesktop.DBus"
 
+#define NI_DBUS_HASH_INIT	2166136261U	/* FNV-1a offset basis */
+
 extern const char *		ni_dbus_object_get_path(const ni_dbus_object_t *);
 extern char *			ni_dbus_object_introspect(ni_dbus_object_t *object);
 extern const DBusObjectPathVTable *ni_dbus_object_get_vtable(const ni_dbus_object_t *);
@@ -24,6 +27,9 @@ extern const char *		ni_dbus_type_as_string(int type);
 
 extern dbus_bool_t		ni_dbus_message_iter_get_variant_data(DBusMessageIter *iter,
 					ni_dbus_variant_t *variant);
+extern dbus_bool_t		ni_dbus_message_iter_get_pooled(ni_dbus_message_t *msg,
+					DBusMessageIter *iter,
+					ni_dbus_variant_t *variant);
 extern dbus_bool_t		ni_dbus_message_iter_append_value(DBusMessageIter *iter,
 					const ni_dbus_variant_t *variant,
 					const char *signature);
@@ -33,9 +39,30 @@ extern dbus_bool_t		ni_dbus_message_iter_get_variant(DBusMessageIter *iter,
 					ni_dbus_variant_t *variant);
 extern dbus_bool_t		ni_dbus_message_iter_append_byte_array(DBusMessageIter *iter,
 						const unsigned char *value, unsigned int len);
+extern dbus_bool_t		ni_dbus_message_iter_append_dict_entry(DBusMessageIter *iter,
+						const ni_dbus_dict_entry_t *entry);
 
 extern const ni_dbus_property_t *__ni_dbus_service_get_property(const ni_dbus_property_t *, const char *);
 
+/*
+ * Latency statistics of method calls handled by our servers,
+ * and of the synchronous calls we make as a client.
+ */
+typedef enum {
+	NI_DBUS_STATS_SERVER,
+	NI_DBUS_STATS_CLIENT,
+
+	__NI_DBUS_STATS_SIDE_MAX
+} ni_dbus_stats_side_t;
+
+extern void			ni_dbus_stats_record(ni_dbus_stats_side_t, ni_dbus_message_t *,
+					const struct timeval *begin, const char *error);
+extern void			ni_dbus_stats_set_slow_threshold(unsigned int msec);
+extern void			ni_dbus_stats_reset(void);
+extern dbus_bool_t		ni_dbus_stats_get(ni_dbus_variant_t *);
+extern unsigned int		ni_dbus_stats_bucket(unsigned long usec);
+extern unsigned long		ni_dbus_stats_bucket_usec(unsigned int bucket);
+
 
 /*
  * Efficient handling of dbus dicts
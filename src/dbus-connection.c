@@ -8,6 +8,10 @@
 #endif
 
 #include <sys/poll.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <limits.h>
 #include <errno.h>
 
 #include <wicked/util.h>
@@ -16,6 +20,7 @@
 #include "socket_priv.h"
 #include "dbus-connection.h"
 #include "dbus-dict.h"
+#include "dbus-object.h"
 #include "process.h"
 #include "debug.h"
 
@@ -28,6 +33,9 @@ struct ni_dbus_async_client_call {
 	DBusPendingCall *	call;
 	ni_dbus_async_callback_t *callback;
 	ni_dbus_object_t *	proxy;
+
+	ni_dbus_async_reply_callback_t *reply_callback;
+	void *			user_data;
 };
 
 typedef struct ni_dbus_async_server_call ni_dbus_async_server_call_t;
@@ -45,17 +53,31 @@ struct ni_dbus_sigaction {
 	char *			sender;
 	char *			object_path;
 	char *			object_interface;
+	char *			member;
 	ni_dbus_signal_handler_t *signal_handler;
 	void *			user_data;
+
+	struct {
+		unsigned long	count;
+		unsigned long	total_usec;
+		unsigned long	max_usec;
+	} stats;
 };
 
+/*
+ * Signal handlers are chained in buckets hashed by their interface;
+ * the path and member filters are checked in the chain.
+ */
+#define NI_DBUS_SIGHANDLER_BUCKETS	32
+
 struct ni_dbus_connection {
 	DBusConnection *	conn;
 	ni_bool_t		private;
+	ni_bool_t		peer;		/* direct connection, no bus */
 
 	ni_dbus_async_client_call_t *async_client_calls;
 	ni_dbus_async_server_call_t *async_server_calls;
-	ni_dbus_sigaction_t *	sighandlers;
+	ni_dbus_sigaction_t *	sighandlers[NI_DBUS_SIGHANDLER_BUCKETS];
 
 	ni_bool_t		dispatching;
 };
@@ -79,14 +101,26 @@ struct ni_dbus_watch_data {
 };
 static ni_dbus_watch_data_t *	ni_dbus_watches;
 
+/*
+ * Listening socket for direct (peer-to-peer) connections
+ */
+struct ni_dbus_listener {
+	DBusServer *		server;
+	char *			socket_path;
+	ni_dbus_listener_accept_t *accept;
+	void *			user_data;
+};
+
 static void			__ni_dbus_sigaction_free(ni_dbus_sigaction_t *);
 static void			__ni_dbus_async_server_call_free(ni_dbus_async_server_call_t *);
 static void			__ni_dbus_async_client_call_free(ni_dbus_async_client_call_t *);
 static void			__ni_dbus_notify_async(DBusPendingCall *, void *);
 static dbus_bool_t		__ni_dbus_add_watch(DBusWatch *, void *);
 static void			__ni_dbus_remove_watch(DBusWatch *, void *);
+static void			__ni_dbus_toggle_watch(DBusWatch *, void *);
 static DBusHandlerResult	__ni_dbus_signal_filter(DBusConnection *, DBusMessage *, void *);
 static void			__ni_dbus_connection_dispatch(ni_dbus_connection_t *);
+static void			__ni_dbus_connection_setup(ni_dbus_connection_t *);
 
 static int			ni_dbus_use_socket_mainloop = 1;
 
@@ -189,25 +223,187 @@ ni_dbus_connection_open(const char *bus_type_string, const char *bus_name)
 		ni_debug_dbus("Successfully acquired bus name \"%s\"", bus_name);
 	}
 
+	__ni_dbus_connection_setup(connection);
+	return connection;
+
+failed_unexpectedly:
+	ni_error("%s: unexpected error", __FUNCTION__);
+
+failed:
+	ni_dbus_connection_free(connection);
+	dbus_error_free(&error);
+	return NULL;
+}
+
+static void
+__ni_dbus_connection_setup(ni_dbus_connection_t *connection)
+{
 	dbus_connection_add_filter(connection->conn, __ni_dbus_signal_filter, connection, NULL);
 	if (ni_dbus_use_socket_mainloop) {
 		dbus_connection_set_watch_functions(connection->conn,
 				__ni_dbus_add_watch,
 				__ni_dbus_remove_watch,
-				NULL,			/* toggle_function */
+				__ni_dbus_toggle_watch,	/* toggle_function */
 				connection,		/* data */
 				NULL);			/* free_data_function */
 	}
+}
+
+/*
+ * Open a direct connection to a peer listening on the given dbus
+ * address, bypassing the bus daemon. There are no bus names and
+ * no match rules on such a connection; the peer sends us all its
+ * signals and the signal handlers filter them locally.
+ */
+ni_dbus_connection_t *
+ni_dbus_connection_open_peer(const char *address)
+{
+	ni_dbus_connection_t *connection;
+	DBusError error = DBUS_ERROR_INIT;
+
+	NI_TRACE_ENTER_ARGS("address=%s", address);
+
+	connection = xcalloc(1, sizeof(*connection));
+	connection->private = TRUE;
+	connection->peer = TRUE;
+	connection->conn = dbus_connection_open_private(address, &error);
+	if (connection->conn == NULL) {
+		ni_debug_dbus("Cannot open dbus peer connection to %s (%s)",
+				address, error.message);
+		ni_dbus_connection_free(connection);
+		dbus_error_free(&error);
+		return NULL;
+	}
 
+	__ni_dbus_connection_setup(connection);
 	return connection;
+}
 
-failed_unexpectedly:
-	ni_error("%s: unexpected error", __FUNCTION__);
+ni_bool_t
+ni_dbus_connection_is_peer(const ni_dbus_connection_t *connection)
+{
+	return connection && connection->peer;
+}
 
-failed:
-	ni_dbus_connection_free(connection);
-	dbus_error_free(&error);
-	return NULL;
+ni_bool_t
+ni_dbus_connection_is_connected(const ni_dbus_connection_t *connection)
+{
+	return connection && connection->conn &&
+		dbus_connection_get_is_connected(connection->conn);
+}
+
+/*
+ * Register a handler for all object paths of a connection. Used for peer
+ * connections, where wickedd dispatches calls by looking up the path in
+ * its object tree, rather than registering every object on every peer.
+ */
+void
+ni_dbus_connection_register_fallback(ni_dbus_connection_t *connection,
+				const DBusObjectPathVTable *vtable, void *user_data)
+{
+	dbus_connection_register_fallback(connection->conn, "/", vtable, user_data);
+}
+
+/*
+ * Listen for direct connections on a unix socket, accessible to root
+ * only. The socket file permissions restrict connecting to it, and the
+ * EXTERNAL authentication accepts only peers with our own uid.
+ */
+static void
+__ni_dbus_listener_new_connection(DBusServer *server, DBusConnection *conn, void *user_data)
+{
+	ni_dbus_listener_t *listener = user_data;
+	ni_dbus_connection_t *connection;
+	unsigned long uid = -1;
+
+	dbus_connection_get_unix_user(conn, &uid);
+	ni_debug_dbus("%s: accepted peer connection from uid %lu",
+			listener->socket_path, uid);
+
+	connection = xcalloc(1, sizeof(*connection));
+	connection->conn = dbus_connection_ref(conn);
+	connection->private = TRUE;
+	connection->peer = TRUE;
+	__ni_dbus_connection_setup(connection);
+
+	if (!listener->accept(listener, connection, listener->user_data))
+		ni_dbus_connection_free(connection);
+}
+
+ni_dbus_listener_t *
+ni_dbus_listener_open(const char *socket_path, ni_dbus_listener_accept_t *accept, void *user_data)
+{
+	static const char *mechanisms[] = { "EXTERNAL", NULL };
+	DBusError error = DBUS_ERROR_INIT;
+	ni_dbus_listener_t *listener;
+	char address[3 * PATH_MAX + 16], *escaped;
+	mode_t omask;
+
+	if (ni_string_empty(socket_path) || accept == NULL)
+		return NULL;
+
+	if (unlink(socket_path) < 0 && errno != ENOENT) {
+		ni_error("Cannot remove stale dbus socket %s: %m", socket_path);
+		return NULL;
+	}
+
+	listener = xcalloc(1, sizeof(*listener));
+	ni_string_dup(&listener->socket_path, socket_path);
+	listener->accept = accept;
+	listener->user_data = user_data;
+
+	if (!(escaped = dbus_address_escape_value(socket_path))) {
+		ni_dbus_listener_free(listener);
+		return NULL;
+	}
+	snprintf(address, sizeof(address), "unix:path=%s", escaped);
+	dbus_free(escaped);
+
+	omask = umask(0077);
+	listener->server = dbus_server_listen(address, &error);
+	umask(omask);
+	if (listener->server == NULL) {
+		ni_error("Cannot listen for dbus peer connections on %s (%s)",
+				socket_path, error.message);
+		dbus_error_free(&error);
+		ni_dbus_listener_free(listener);
+		return NULL;
+	}
+
+	if (chmod(socket_path, 0600) < 0) {
+		ni_error("Cannot restrict access to dbus socket %s: %m", socket_path);
+		ni_dbus_listener_free(listener);
+		return NULL;
+	}
+
+	dbus_server_set_auth_mechanisms(listener->server, mechanisms);
+	dbus_server_set_new_connection_function(listener->server,
+				__ni_dbus_listener_new_connection, listener, NULL);
+	dbus_server_set_watch_functions(listener->server,
+				__ni_dbus_add_watch,
+				__ni_dbus_remove_watch,
+				__ni_dbus_toggle_watch,	/* toggle_function */
+				NULL,			/* data: no connection */
+				NULL);			/* free_data_function */
+
+	ni_debug_dbus("Listening for dbus peer connections on %s", socket_path);
+	return listener;
+}
+
+void
+ni_dbus_listener_free(ni_dbus_listener_t *listener)
+{
+	if (!listener)
+		return;
+
+	if (listener->server) {
+		dbus_server_disconnect(listener->server);
+		dbus_server_unref(listener->server);
+		listener->server = NULL;
+		unlink(listener->socket_path);
+	}
+	ni_string_free(&listener->socket_path);
+	free(listener);
 }
 
 /*
@@ -217,6 +413,7 @@ void
 ni_dbus_connection_free(ni_dbus_connection_t *dbc)
 {
 	ni_dbus_sigaction_t *sig;
+	unsigned int i;
 
 	if (!dbc)
 		return;
@@ -238,9 +435,13 @@ ni_dbus_connection_free(ni_dbus_connection_t *dbc)
 		__ni_dbus_async_server_call_free(async);
 	}
 
-	while ((sig = dbc->sighandlers) != NULL) {
-		dbc->sighandlers = sig->next;
-		__ni_dbus_sigaction_free(sig);
+	if (ni_debug_guard(NI_LOG_DEBUG, NI_TRACE_DBUS))
+		ni_dbus_connection_log_signal_stats(dbc);
+	for (i = 0; i < NI_DBUS_SIGHANDLER_BUCKETS; ++i) {
+		while ((sig = dbc->sighandlers[i]) != NULL) {
+			dbc->sighandlers[i] = sig->next;
+			__ni_dbus_sigaction_free(sig);
+		}
 	}
 
 	if (dbc->conn) {
@@ -273,6 +474,23 @@ ni_dbus_connection_add_pending(ni_dbus_connection_t *connection,
 	connection->async_client_calls = async;
 }
 
+static void
+ni_dbus_connection_add_pending_reply(ni_dbus_connection_t *connection,
+			DBusPendingCall *call,
+			ni_dbus_async_reply_callback_t *callback,
+			void *user_data)
+{
+	ni_dbus_async_client_call_t *async;
+
+	async = calloc(1, sizeof(*async));
+	async->call = call;
+	async->reply_callback = callback;
+	async->user_data = user_data;
+
+	async->next = connection->async_client_calls;
+	connection->async_client_calls = async;
+}
+
 static void
 __ni_dbus_async_client_call_free(ni_dbus_async_client_call_t *async)
 {
@@ -290,7 +508,10 @@ __ni_dbus_process_pending(ni_dbus_connection_t *dbc, DBusPendingCall *call)
 	for (pos = &dbc->async_client_calls; (async = *pos) != NULL; pos = &async->next) {
 		if (async->call == call) {
 			*pos = async->next;
-			async->callback(async->proxy, msg);
+			if (async->reply_callback)
+				async->reply_callback(msg, async->user_data);
+			else
+				async->callback(async->proxy, msg);
 			__ni_dbus_async_client_call_free(async);
 			rv = 1;
 			break;
@@ -310,11 +531,14 @@ ni_dbus_connection_call(ni_dbus_connection_t *connection,
 {
 	DBusPendingCall *pending;
 	DBusMessage *reply = NULL;
+	struct timeval begin;
 	int msgtype;
 
+	ni_timer_get_time(&begin);
 	if (!dbus_connection_send_with_reply(connection->conn, call, &pending, call_timeout)) {
 		dbus_set_error(error, DBUS_ERROR_FAILED,
 				"unable to send DBus message (errno=%d)", errno);
+		ni_dbus_stats_record(NI_DBUS_STATS_CLIENT, call, &begin, error->name);
 		return NULL;
 	}
 
@@ -326,15 +550,18 @@ ni_dbus_connection_call(ni_dbus_connection_t *connection,
 		__ni_dbus_connection_dispatch(connection);
 
 	reply = dbus_pending_call_steal_reply(pending);
+	dbus_pending_call_unref(pending);
 
-	if (call == NULL) {
+	if (reply == NULL) {
 		dbus_set_error(error, DBUS_ERROR_FAILED, "dbus: no reply");
+		ni_dbus_stats_record(NI_DBUS_STATS_CLIENT, call, &begin, error->name);
 		return NULL;
 	}
 
 	msgtype = dbus_message_get_type(reply);
 	if (msgtype == DBUS_MESSAGE_TYPE_METHOD_RETURN) {
 		/* All is well */
+		ni_dbus_stats_record(NI_DBUS_STATS_CLIENT, call, &begin, NULL);
 		return reply;
 	}
 
@@ -344,10 +571,9 @@ ni_dbus_connection_call(ni_dbus_connection_t *connection,
 	} else {
 		dbus_set_error(error, DBUS_ERROR_FAILED, "dbus: unexpected message type in reply");
 	}
+	ni_dbus_stats_record(NI_DBUS_STATS_CLIENT, call, &begin, error->name);
 
-
-	if (reply)
-		dbus_message_unref(reply);
+	dbus_message_unref(reply);
 	return NULL;
 }
 
@@ -372,6 +598,52 @@ ni_dbus_connection_call_async(ni_dbus_connection_t *connection,
 	return 0;
 }
 
+/*
+ * Do an asynchronous call across a DBus connection, passing the reply
+ * (a method return or an error message, e.g. on timeout) to a callback.
+ * This allows to keep several calls in flight at the same time.
+ */
+int
+ni_dbus_connection_call_async_reply(ni_dbus_connection_t *connection,
+			ni_dbus_message_t *call, unsigned int timeout,
+			ni_dbus_async_reply_callback_t *callback, void *user_data)
+{
+	DBusPendingCall *pending;
+
+	if (!dbus_connection_send_with_reply(connection->conn, call, &pending, timeout) || !pending) {
+		ni_error("dbus_connection_send_with_reply: %m");
+		return -NI_ERROR_DBUS_CALL_FAILED;
+	}
+
+	ni_dbus_connection_add_pending_reply(connection, pending, callback, user_data);
+	dbus_pending_call_set_notify(pending, __ni_dbus_notify_async, connection, NULL);
+
+	return 0;
+}
+
+/*
+ * Cancel all pending async calls for the given user data; their
+ * callbacks will not be invoked.
+ */
+unsigned int
+ni_dbus_connection_cancel_async_reply(ni_dbus_connection_t *connection, const void *user_data)
+{
+	ni_dbus_async_client_call_t *async, **pos;
+	unsigned int count = 0;
+
+	for (pos = &connection->async_client_calls; (async = *pos) != NULL; ) {
+		if (async->reply_callback && async->user_data == user_data) {
+			*pos = async->next;
+			dbus_pending_call_cancel(async->call);
+			__ni_dbus_async_client_call_free(async);
+			count++;
+		} else {
+			pos = &async->next;
+		}
+	}
+	return count;
+}
+
 static void
 __ni_dbus_notify_async(DBusPendingCall *pending, void *call_data)
 {
@@ -413,14 +685,17 @@ ni_dbus_connection_send_error(ni_dbus_connection_t *connection, ni_dbus_message_
  * Signal handling
  */
 static ni_dbus_sigaction_t *
-__ni_sigaction_new(const char *object_interface,
+__ni_sigaction_new(const char *object_path, const char *object_interface,
+				const char *member,
 				ni_dbus_signal_handler_t *callback,
 				void *user_data)
 {
 	ni_dbus_sigaction_t *s;
 
 	s = calloc(1, sizeof(*s));
+	ni_string_dup(&s->object_path, object_path);
 	ni_string_dup(&s->object_interface, object_interface);
+	ni_string_dup(&s->member, member);
 	s->signal_handler = callback;
 	s->user_data = user_data;
 
@@ -430,10 +705,27 @@ __ni_sigaction_new(const char *object_interface,
 static void
 __ni_dbus_sigaction_free(ni_dbus_sigaction_t *s)
 {
+	ni_string_free(&s->object_path);
 	ni_string_free(&s->object_interface);
+	ni_string_free(&s->member);
 	free(s);
 }
 
+static inline unsigned int
+__ni_dbus_sigaction_bucket(const char *interface)
+{
+	return __ni_dbus_hash_name(interface, strlen(interface)) % NI_DBUS_SIGHANDLER_BUCKETS;
+}
+
+static void
+__ni_dbus_match_rule_append(char *buf, size_t size, const char *key, const char *value)
+{
+	size_t len = strlen(buf);
+
+	if (value && len < size)
+		snprintf(buf + len, size - len, ",%s='%s'", key, value);
+}
+
 void
 ni_dbus_add_signal_handler(ni_dbus_connection_t *connection,
 					const char *sender,
@@ -441,35 +733,56 @@ ni_dbus_add_signal_handler(ni_dbus_connection_t *connection,
 					const char *object_interface,
 					ni_dbus_signal_handler_t *callback,
 					void *user_data)
+{
+	ni_dbus_add_signal_handler_ex(connection, sender, object_path,
+			object_interface, NULL, callback, user_data);
+}
+
+/*
+ * Add a signal handler, optionally restricted to the signals of one
+ * object path and/or one member. The filters are part of the match
+ * rule, so the bus daemon does not deliver other signals at all.
+ */
+void
+ni_dbus_add_signal_handler_ex(ni_dbus_connection_t *connection,
+					const char *sender,
+					const char *object_path,
+					const char *object_interface,
+					const char *member,
+					ni_dbus_signal_handler_t *callback,
+					void *user_data)
 {
 	DBusMessage *call = NULL, *reply = NULL;
 	DBusError error = DBUS_ERROR_INIT;
 	ni_dbus_sigaction_t *sigact;
 	char specbuf[1024], *arg;
+	unsigned int bucket;
 
-	if (sender && object_path && object_interface) {
-		snprintf(specbuf, sizeof(specbuf), "type='signal',sender='%s',path='%s',interface='%s'",
-			sender, object_path, object_interface);
-	} else if (sender && object_interface) {
-		snprintf(specbuf, sizeof(specbuf), "type='signal',sender='%s',interface='%s'",
-			sender, object_interface);
-	} else {
-		snprintf(specbuf, sizeof(specbuf), "type='signal',interface='%s'",
-			object_interface);
-	}
+	if (object_interface == NULL)
+		goto failed;
+
+	snprintf(specbuf, sizeof(specbuf), "type='signal'");
+	__ni_dbus_match_rule_append(specbuf, sizeof(specbuf), "sender", sender);
+	__ni_dbus_match_rule_append(specbuf, sizeof(specbuf), "path", object_path);
+	__ni_dbus_match_rule_append(specbuf, sizeof(specbuf), "interface", object_interface);
+	__ni_dbus_match_rule_append(specbuf, sizeof(specbuf), "member", member);
 	arg = specbuf;
 
-	call = dbus_message_new_method_call(NI_DBUS_BUS_NAME,
-			NI_DBUS_OBJECT_PATH, NI_DBUS_INTERFACE, "AddMatch");
-	if (!dbus_message_append_args(call, DBUS_TYPE_STRING, &arg, 0))
-		goto failed;
+	/* A peer sends us all its signals, there is no bus to filter them */
+	if (!connection->peer) {
+		call = dbus_message_new_method_call(NI_DBUS_BUS_NAME,
+				NI_DBUS_OBJECT_PATH, NI_DBUS_INTERFACE, "AddMatch");
+		if (!dbus_message_append_args(call, DBUS_TYPE_STRING, &arg, 0))
+			goto failed;
 
-	if ((reply = ni_dbus_connection_call(connection, call, 5000, &error)) == NULL)
-		goto out;
+		if ((reply = ni_dbus_connection_call(connection, call, 5000, &error)) == NULL)
+			goto out;
+	}
 
-	sigact = __ni_sigaction_new(object_interface, callback, user_data);
-	sigact->next = connection->sighandlers;
-	connection->sighandlers = sigact;
+	sigact = __ni_sigaction_new(object_path, object_interface, member, callback, user_data);
+	bucket = __ni_dbus_sigaction_bucket(object_interface);
+	sigact->next = connection->sighandlers[bucket];
+	connection->sighandlers[bucket] = sigact;
 
 out:
 	if (call)
@@ -488,8 +801,8 @@ static DBusHandlerResult
 __ni_dbus_signal_filter(DBusConnection *conn, DBusMessage *msg, void *user_data)
 {
 	ni_dbus_connection_t *connection = user_data;
+	const char *interface, *member, *path;
 	ni_dbus_sigaction_t *sigact;
-	const char *interface;
 	int handled = 0;
 
 	if (connection->conn != conn)
@@ -498,12 +811,34 @@ __ni_dbus_signal_filter(DBusConnection *conn, DBusMessage *msg, void *user_data)
 	if (dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_SIGNAL)
 		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 
-	interface = dbus_message_get_interface(msg);
-	for (sigact = connection->sighandlers; sigact; sigact = sigact->next) {
-		if (!strcmp(sigact->object_interface, interface)) {
-			sigact->signal_handler(connection, msg, sigact->user_data);
-			handled++;
-		}
+	if (!(interface = dbus_message_get_interface(msg)))
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+	member = dbus_message_get_member(msg);
+	path = dbus_message_get_path(msg);
+
+	sigact = connection->sighandlers[__ni_dbus_sigaction_bucket(interface)];
+	for ( ; sigact; sigact = sigact->next) {
+		struct timeval begin, end, delta;
+		unsigned long usec;
+
+		if (strcmp(sigact->object_interface, interface))
+			continue;
+		if (sigact->member && !ni_string_eq(sigact->member, member))
+			continue;
+		if (sigact->object_path && !ni_string_eq(sigact->object_path, path))
+			continue;
+
+		ni_timer_get_time(&begin);
+		sigact->signal_handler(connection, msg, sigact->user_data);
+		ni_timer_get_time(&end);
+
+		timersub(&end, &begin, &delta);
+		usec = delta.tv_sec * 1000000UL + delta.tv_usec;
+		sigact->stats.count++;
+		sigact->stats.total_usec += usec;
+		if (usec > sigact->stats.max_usec)
+			sigact->stats.max_usec = usec;
+		handled++;
 	}
 
 	if (handled)
@@ -511,6 +846,33 @@ __ni_dbus_signal_filter(DBusConnection *conn, DBusMessage *msg, void *user_data)
 	return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
 
+/*
+ * Log the dispatch count and handler run time of each signal handler
+ */
+void
+ni_dbus_connection_log_signal_stats(const ni_dbus_connection_t *connection)
+{
+	const ni_dbus_sigaction_t *sigact;
+	unsigned int i;
+
+	for (i = 0; i < NI_DBUS_SIGHANDLER_BUCKETS; ++i) {
+		for (sigact = connection->sighandlers[i]; sigact; sigact = sigact->next) {
+			if (!sigact->stats.count)
+				continue;
+			ni_debug_dbus("signal handler %s%s%s%s%s: %lu signals, "
+					"avg %lu usec, max %lu usec",
+					sigact->object_interface,
+					sigact->member ? "." : "",
+					sigact->member ? sigact->member : "",
+					sigact->object_path ? " at " : "",
+					sigact->object_path ? sigact->object_path : "",
+					sigact->stats.count,
+					sigact->stats.total_usec / sigact->stats.count,
+					sigact->stats.max_usec);
+		}
+	}
+}
+
 /*
  * Handle server-side objects and dispatch incoming call
  */
@@ -631,6 +993,17 @@ ni_dbus_connection_get_caller_uid(ni_dbus_connection_t *conn, const char *name,
 	uint32_t user_id;
 	int rv = 0;
 
+	if (conn->peer) {
+		unsigned long peer_uid;
+
+		/* The peer is the caller; its uid is known from authentication */
+		if (!dbus_connection_get_unix_user(conn->conn, &peer_uid))
+			return -NI_ERROR_DBUS_CALL_FAILED;
+		if (uidp)
+			*uidp = peer_uid;
+		return 0;
+	}
+
 	call = dbus_message_new_method_call("org.freedesktop.DBus",
 					"/org/freedesktop/DBus",
 					"org.freedesktop.DBus",
@@ -699,11 +1072,35 @@ __ni_dbus_watch_flags(int flags)
 	return "???";
 }
 
+/*
+ * Compute the poll flags of a socket from its enabled watches
+ */
+static int
+__ni_dbus_watch_poll_flags(const ni_socket_t *sock)
+{
+	ni_dbus_watch_data_t *wd;
+	int poll_flags = 0;
+
+	for (wd = ni_dbus_watches; wd; wd = wd->next) {
+		int watch_flags;
+
+		if (wd->socket != sock || !dbus_watch_get_enabled(wd->watch))
+			continue;
+
+		watch_flags = dbus_watch_get_flags(wd->watch);
+		if (watch_flags & DBUS_WATCH_READABLE)
+			poll_flags |= POLLIN;
+		if (watch_flags & DBUS_WATCH_WRITABLE)
+			poll_flags |= POLLOUT;
+	}
+	return poll_flags;
+}
+
 static inline void
 __ni_dbus_watch_handle(const char *func, ni_socket_t *sock, int flags)
 {
 	ni_dbus_watch_data_t *wd;
-	int found = 0, poll_flags = 0;
+	int found = 0;
 
 	/* All of this is somewhat more complicated than it may need to be.
 	 * For some odd reason, libdbus insists on maintaining two watches
@@ -712,9 +1109,8 @@ __ni_dbus_watch_handle(const char *func, ni_socket_t *sock, int flags)
 	 */
 restart:
 	for (wd = ni_dbus_watches; wd; wd = wd->next) {
-		int new_watch_flags;
 #ifdef DEBUG_WATCH_VERBOSE
-		int old_watch_flags;
+		int old_watch_flags, new_watch_flags;
 #endif
 
 		if (wd->socket != sock)
@@ -740,18 +1136,11 @@ restart:
 			goto restart;
 		}
 
-		if (flags & (DBUS_WATCH_READABLE | DBUS_WATCH_WRITABLE))
+		if (wd->connection && (flags & (DBUS_WATCH_READABLE | DBUS_WATCH_WRITABLE)))
 			__ni_dbus_connection_dispatch(wd->connection);
 
-		new_watch_flags = dbus_watch_get_flags(wd->watch);
-		if (dbus_watch_get_enabled(wd->watch)) {
-			if (new_watch_flags & DBUS_WATCH_READABLE)
-				poll_flags |= POLLIN;
-			if (new_watch_flags & DBUS_WATCH_WRITABLE)
-				poll_flags |= POLLOUT;
-		}
-
 #ifdef DEBUG_WATCH_VERBOSE
+		new_watch_flags = dbus_watch_get_flags(wd->watch);
 		if (old_watch_flags != new_watch_flags) {
 			ni_debug_dbus("%s: changing watch flags %s to %s",
 					__func__,
@@ -762,7 +1151,8 @@ restart:
 		__ni_put_dbus_watch_data(wd);
 	}
 
-	sock->poll_flags = poll_flags;
+	/* Handling one watch may toggle the others, so check them all */
+	sock->poll_flags = __ni_dbus_watch_poll_flags(sock);
 	if (!found)
 		ni_warn("%s: dead socket", func);
 }
@@ -823,7 +1213,7 @@ __ni_dbus_add_watch(DBusWatch *watch, void *data)
 	ni_dbus_watch_data_t *wd;
 	ni_socket_t *sock = NULL;
 
-	for (wd = ni_dbus_watches; wd; wd = wd->next) {
+	for (wd = ni_dbus_watches; connection && wd; wd = wd->next) {
 		if (wd->connection == connection) {
 			sock = wd->socket;
 			break;
@@ -887,6 +1277,26 @@ __ni_dbus_remove_watch(DBusWatch *watch, void *dummy)
 	ni_warn("%s(%p): watch not found", __FUNCTION__, watch);
 }
 
+/*
+ * libdbus enables and disables watches outside of dbus_watch_handle,
+ * e.g. while authenticating a new peer connection, where the reading
+ * is stopped until the reply is sent. Update the poll flags of the
+ * socket accordingly.
+ */
+void
+__ni_dbus_toggle_watch(DBusWatch *watch, void *dummy)
+{
+	ni_dbus_watch_data_t *wd;
+
+	for (wd = ni_dbus_watches; wd; wd = wd->next) {
+		if (wd->watch == watch) {
+			if (wd->socket)
+				wd->socket->poll_flags = __ni_dbus_watch_poll_flags(wd->socket);
+			break;
+		}
+	}
+}
+
 void
 __ni_dbus_connection_dispatch(ni_dbus_connection_t *connection)
 {
@@ -11,13 +11,30 @@
 #include <dbus/dbus.h>
 #include "dbus-common.h"
 
+typedef struct ni_dbus_listener	ni_dbus_listener_t;
+typedef ni_bool_t		ni_dbus_listener_accept_t(ni_dbus_listener_t *,
+					ni_dbus_connection_t *, void *user_data);
+
 extern ni_dbus_connection_t *	ni_dbus_connection_open(const char *bus_type, const char *bus_name);
+extern ni_dbus_connection_t *	ni_dbus_connection_open_peer(const char *address);
 extern void			ni_dbus_connection_free(ni_dbus_connection_t *);
+extern ni_bool_t		ni_dbus_connection_is_peer(const ni_dbus_connection_t *);
+extern ni_bool_t		ni_dbus_connection_is_connected(const ni_dbus_connection_t *);
+extern void			ni_dbus_connection_register_fallback(ni_dbus_connection_t *,
+					const DBusObjectPathVTable *, void *);
+extern ni_dbus_listener_t *	ni_dbus_listener_open(const char *socket_path,
+					ni_dbus_listener_accept_t *, void *user_data);
+extern void			ni_dbus_listener_free(ni_dbus_listener_t *);
 extern ni_dbus_message_t *	ni_dbus_connection_call(ni_dbus_connection_t *connection,
 					ni_dbus_message_t *call, unsigned int call_timeout, DBusError *error);
 extern int			ni_dbus_connection_call_async(ni_dbus_connection_t *connection,
 					ni_dbus_message_t *call, unsigned int timeout,
 					ni_dbus_async_callback_t *callback, ni_dbus_object_t *proxy);
+extern int			ni_dbus_connection_call_async_reply(ni_dbus_connection_t *connection,
+					ni_dbus_message_t *call, unsigned int timeout,
+					ni_dbus_async_reply_callback_t *callback, void *user_data);
+extern unsigned int		ni_dbus_connection_cancel_async_reply(ni_dbus_connection_t *,
+					const void *user_data);
 extern int			ni_dbus_connection_send_message(ni_dbus_connection_t *, ni_dbus_message_t *);
 extern void			ni_dbus_connection_send_error(ni_dbus_connection_t *, ni_dbus_message_t *, DBusError *);
 extern void			ni_dbus_add_signal_handler(ni_dbus_connection_t *conn,
@@ -26,6 +43,14 @@ extern void			ni_dbus_add_signal_handler(ni_dbus_connection_t *conn,
 					const char *object_interface,
 					ni_dbus_signal_handler_t *callback,
 					void *user_data);
+extern void			ni_dbus_add_signal_handler_ex(ni_dbus_connection_t *conn,
+					const char *sender,
+					const char *object_path,
+					const char *object_interface,
+					const char *member,
+					ni_dbus_signal_handler_t *callback,
+					void *user_data);
+extern void			ni_dbus_connection_log_signal_stats(const ni_dbus_connection_t *);
 extern void			ni_dbus_connection_register_object(ni_dbus_connection_t *, ni_dbus_object_t *);
 extern void			ni_dbus_connection_unregister_object(ni_dbus_connection_t *, ni_dbus_object_t *);
 extern int			ni_dbus_async_server_call_run_command(ni_dbus_connection_t *conn,
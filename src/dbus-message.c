@@ -23,19 +23,14 @@ ni_dbus_message_iter_append_byte_array(DBusMessageIter *iter,
 				const unsigned char *value, unsigned int len)
 {
 	DBusMessageIter iter_array;
-	unsigned int i;
 
 	if (!dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
 					      DBUS_TYPE_BYTE_AS_STRING,
 					      &iter_array))
 		return FALSE;
 
-	for (i = 0; i < len; i++) {
-		if (!dbus_message_iter_append_basic(&iter_array,
-						    DBUS_TYPE_BYTE,
-						    &(value[i])))
-			return FALSE;
-	}
+	if (!dbus_message_iter_append_fixed_array(&iter_array, DBUS_TYPE_BYTE, &value, len))
+		return FALSE;
 
 	if (!dbus_message_iter_close_container(iter, &iter_array))
 		return FALSE;
@@ -298,15 +293,12 @@ ni_dbus_message_iter_append_variant(DBusMessageIter *iter, const ni_dbus_variant
 dbus_bool_t
 ni_dbus_message_iter_get_byte_array(DBusMessageIter *iter, ni_dbus_variant_t *variant)
 {
-	ni_dbus_variant_init_byte_array(variant);
+	const unsigned char *data = NULL;
+	int len = 0;
 
-	while (dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_BYTE) {
-		unsigned char byte;
-
-		dbus_message_iter_get_basic(iter, &byte);
-		ni_dbus_variant_append_byte_array(variant, byte);
-		dbus_message_iter_next(iter);
-	}
+	if (dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_BYTE)
+		dbus_message_iter_get_fixed_array(iter, &data, &len);
+	ni_dbus_variant_set_byte_array(variant, data, len);
 
 	return TRUE;
 }
@@ -500,6 +492,352 @@ ni_dbus_message_iter_get_variant_data(DBusMessageIter *iter, ni_dbus_variant_t *
 	return TRUE;
 }
 
+/*
+ * Variant pool of a message
+ *
+ * Deserializing the arguments of a call or reply allocates every array
+ * and copies every string separately, only to free all of it again a
+ * moment later. Instead, ni_dbus_message_get_args_variants carves the
+ * arrays out of a few chunks of memory attached to the message, and
+ * lets strings and byte arrays point into the message itself. All of
+ * it is released with the last reference to the message, which the
+ * returned variants hold.
+ *
+ * Pooled variants are marked as such; ni_dbus_variant_destroy does not
+ * free their contents, and functions modifying an array move it to the
+ * heap first.
+ */
+#define NI_DBUS_VARIANT_POOL_CHUNK	4096
+
+typedef struct ni_dbus_variant_pool	ni_dbus_variant_pool_t;
+struct ni_dbus_variant_pool {
+	ni_dbus_variant_pool_t *next;
+	size_t			size;
+	size_t			used;
+	unsigned char		data[] __attribute__((aligned(8)));
+};
+
+static dbus_int32_t		__ni_dbus_variant_pool_slot = -1;
+
+static ni_dbus_variant_pool_t *
+__ni_dbus_variant_pool_chunk_new(size_t size)
+{
+	ni_dbus_variant_pool_t *chunk;
+
+	chunk = xmalloc(sizeof(*chunk) + size);
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
+	return chunk;
+}
+
+static void
+__ni_dbus_variant_pool_free(void *ptr)
+{
+	ni_dbus_variant_pool_t *pool = ptr, *chunk;
+
+	while ((chunk = pool) != NULL) {
+		pool = chunk->next;
+		free(chunk);
+	}
+}
+
+static ni_dbus_variant_pool_t *
+__ni_dbus_message_variant_pool(ni_dbus_message_t *msg)
+{
+	ni_dbus_variant_pool_t *pool;
+
+	if (__ni_dbus_variant_pool_slot < 0
+	 && !dbus_message_allocate_data_slot(&__ni_dbus_variant_pool_slot))
+		return NULL;
+
+	if ((pool = dbus_message_get_data(msg, __ni_dbus_variant_pool_slot)) == NULL) {
+		pool = __ni_dbus_variant_pool_chunk_new(NI_DBUS_VARIANT_POOL_CHUNK);
+		if (!dbus_message_set_data(msg, __ni_dbus_variant_pool_slot, pool,
+					__ni_dbus_variant_pool_free)) {
+			free(pool);
+			return NULL;
+		}
+	}
+	return pool;
+}
+
+/*
+ * Bump allocator. The first chunk stays at the head of the list, so
+ * that the message data slot keeps pointing to it; newer chunks are
+ * inserted right after it.
+ */
+static void *
+__ni_dbus_variant_pool_alloc(ni_dbus_variant_pool_t *pool, size_t size)
+{
+	ni_dbus_variant_pool_t *chunk;
+	void *ptr;
+
+	size = (size + 7) & ~(size_t) 7;
+	if (size == 0)
+		return NULL;
+
+	if (pool->used + size <= pool->size) {
+		chunk = pool;
+	} else
+	if (!(chunk = pool->next) || chunk->used + size > chunk->size) {
+		size_t chunk_size = chunk ? chunk->size * 2 : pool->size;
+
+		if (chunk_size < size)
+			chunk_size = size;
+		chunk = __ni_dbus_variant_pool_chunk_new(chunk_size);
+		chunk->next = pool->next;
+		pool->next = chunk;
+	}
+
+	ptr = chunk->data + chunk->used;
+	chunk->used += size;
+	memset(ptr, 0, size);
+	return ptr;
+}
+
+/*
+ * The number of elements of an array is not known until we have walked
+ * it. Completed elements are pushed onto a scratch stack instead, and
+ * moved into the pool in one piece once the array is done. Elements of
+ * nested arrays are pushed above those of the enclosing one.
+ */
+typedef struct ni_dbus_pool_decoder {
+	ni_dbus_variant_pool_t *pool;
+	unsigned char *		stack;
+	size_t			size;
+	size_t			top;
+	unsigned char		buffer[2048] __attribute__((aligned(8)));
+} ni_dbus_pool_decoder_t;
+
+static void
+__ni_dbus_pool_decoder_push(ni_dbus_pool_decoder_t *dec, const void *elem, size_t size)
+{
+	if (dec->top + size > dec->size) {
+		size_t new_size = dec->size * 2 + size;
+
+		if (dec->stack == dec->buffer) {
+			dec->stack = xmalloc(new_size);
+			memcpy(dec->stack, dec->buffer, dec->top);
+		} else {
+			dec->stack = xrealloc(dec->stack, new_size);
+		}
+		dec->size = new_size;
+	}
+	memcpy(dec->stack + dec->top, elem, size);
+	dec->top += size;
+}
+
+static void *
+__ni_dbus_pool_decoder_pop(ni_dbus_pool_decoder_t *dec, size_t base)
+{
+	void *array;
+
+	array = __ni_dbus_variant_pool_alloc(dec->pool, dec->top - base);
+	if (array)
+		memcpy(array, dec->stack + base, dec->top - base);
+	dec->top = base;
+	return array;
+}
+
+static dbus_bool_t	__ni_dbus_message_iter_get_pooled(DBusMessageIter *, ni_dbus_variant_t *,
+					ni_dbus_pool_decoder_t *);
+
+static dbus_bool_t
+__ni_dbus_message_iter_get_pooled_variant(DBusMessageIter *iter, ni_dbus_variant_t *variant,
+					ni_dbus_pool_decoder_t *dec)
+{
+	DBusMessageIter iter_val;
+
+	if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_VARIANT)
+		return FALSE;
+
+	dbus_message_iter_recurse(iter, &iter_val);
+	return __ni_dbus_message_iter_get_pooled(&iter_val, variant, dec);
+}
+
+static dbus_bool_t
+__ni_dbus_message_iter_get_pooled_dict(DBusMessageIter *iter_array, ni_dbus_variant_t *variant,
+					ni_dbus_pool_decoder_t *dec)
+{
+	size_t base = dec->top;
+
+	/* Like ni_dbus_message_iter_get_dict, stop at the first bad entry */
+	while (dbus_message_iter_get_arg_type(iter_array) == DBUS_TYPE_DICT_ENTRY) {
+		ni_dbus_dict_entry_t entry;
+		DBusMessageIter iter_dict_entry;
+
+		memset(&entry, 0, sizeof(entry));
+		dbus_message_iter_recurse(iter_array, &iter_dict_entry);
+		if (dbus_message_iter_get_arg_type(&iter_dict_entry) != DBUS_TYPE_STRING)
+			break;
+		dbus_message_iter_get_basic(&iter_dict_entry, &entry.key);
+
+		if (!dbus_message_iter_next(&iter_dict_entry)
+		 || !__ni_dbus_message_iter_get_pooled_variant(&iter_dict_entry, &entry.datum, dec))
+			break;
+
+		__ni_dbus_pool_decoder_push(dec, &entry, sizeof(entry));
+		variant->array.len++;
+		dbus_message_iter_next(iter_array);
+	}
+
+	variant->dict_array_value = __ni_dbus_pool_decoder_pop(dec, base);
+	return TRUE;
+}
+
+static dbus_bool_t
+__ni_dbus_message_iter_get_pooled_array(DBusMessageIter *iter, ni_dbus_variant_t *variant,
+					ni_dbus_pool_decoder_t *dec)
+{
+	int array_type = dbus_message_iter_get_element_type(iter);
+	DBusMessageIter iter_array;
+	size_t base = dec->top;
+
+	dbus_message_iter_recurse(iter, &iter_array);
+	variant->array.element_type = array_type;
+
+	switch (array_type) {
+	case DBUS_TYPE_BYTE:
+		{
+			int len = 0;
+
+			dbus_message_iter_get_fixed_array(&iter_array,
+					&variant->byte_array_value, &len);
+			variant->array.len = len;
+		}
+		return TRUE;
+
+	case DBUS_TYPE_STRING:
+	case DBUS_TYPE_OBJECT_PATH:
+		while (dbus_message_iter_get_arg_type(&iter_array) == array_type) {
+			const char *value;
+
+			dbus_message_iter_get_basic(&iter_array, &value);
+			__ni_dbus_pool_decoder_push(dec, &value, sizeof(value));
+			variant->array.len++;
+			dbus_message_iter_next(&iter_array);
+		}
+		variant->string_array_value = __ni_dbus_pool_decoder_pop(dec, base);
+		return TRUE;
+
+	case DBUS_TYPE_DICT_ENTRY:
+		return __ni_dbus_message_iter_get_pooled_dict(&iter_array, variant, dec);
+
+	case DBUS_TYPE_ARRAY:
+	case DBUS_TYPE_VARIANT:
+		if (array_type == DBUS_TYPE_ARRAY) {
+			char *signature = dbus_message_iter_get_signature(iter);
+			size_t len = strlen(signature);
+
+			/* skip the "a" of the outer array */
+			variant->array.element_type = DBUS_TYPE_INVALID;
+			variant->array.element_signature = __ni_dbus_variant_pool_alloc(dec->pool, len);
+			memcpy(variant->array.element_signature, signature + 1, len);
+			dbus_free(signature);
+		}
+
+		while (dbus_message_iter_get_arg_type(&iter_array) != DBUS_TYPE_INVALID) {
+			ni_dbus_variant_t elem;
+			dbus_bool_t rv;
+
+			memset(&elem, 0, sizeof(elem));
+			if (array_type == DBUS_TYPE_VARIANT)
+				rv = __ni_dbus_message_iter_get_pooled_variant(&iter_array, &elem, dec);
+			else
+				rv = __ni_dbus_message_iter_get_pooled(&iter_array, &elem, dec);
+			if (!rv) {
+				dec->top = base;
+				variant->array.len = 0;
+				return FALSE;
+			}
+
+			__ni_dbus_pool_decoder_push(dec, &elem, sizeof(elem));
+			variant->array.len++;
+			dbus_message_iter_next(&iter_array);
+		}
+		variant->variant_array_value = __ni_dbus_pool_decoder_pop(dec, base);
+		return TRUE;
+
+	default:
+		ni_debug_dbus("%s: cannot decode array of type %c", __FUNCTION__, array_type);
+		return FALSE;
+	}
+}
+
+static dbus_bool_t
+__ni_dbus_message_iter_get_pooled(DBusMessageIter *iter, ni_dbus_variant_t *variant,
+					ni_dbus_pool_decoder_t *dec)
+{
+	DBusMessageIter iter_struct;
+	size_t base = dec->top;
+	void *value;
+
+	variant->type = dbus_message_iter_get_arg_type(iter);
+	variant->__magic = NI_DBUS_VARIANT_MAGIC;
+	variant->__pooled = TRUE;
+
+	if ((value = ni_dbus_variant_datum_ptr(variant)) != NULL) {
+		/* Basic types; strings point into the message */
+		dbus_message_iter_get_basic(iter, value);
+		return TRUE;
+	}
+
+	switch (variant->type) {
+	case DBUS_TYPE_ARRAY:
+		return __ni_dbus_message_iter_get_pooled_array(iter, variant, dec);
+
+	case DBUS_TYPE_STRUCT:
+		dbus_message_iter_recurse(iter, &iter_struct);
+		while (dbus_message_iter_get_arg_type(&iter_struct) != DBUS_TYPE_INVALID) {
+			ni_dbus_variant_t member;
+
+			memset(&member, 0, sizeof(member));
+			if (!__ni_dbus_message_iter_get_pooled(&iter_struct, &member, dec)) {
+				dec->top = base;
+				variant->array.len = 0;
+				return FALSE;
+			}
+			__ni_dbus_pool_decoder_push(dec, &member, sizeof(member));
+			variant->array.len++;
+			dbus_message_iter_next(&iter_struct);
+		}
+		variant->struct_value = __ni_dbus_pool_decoder_pop(dec, base);
+		return TRUE;
+
+	default:
+		ni_debug_dbus("%s: cannot handle message with %c data", __func__, variant->type);
+		return FALSE;
+	}
+}
+
+/*
+ * Deserialize one argument into the variant pool of the message.
+ * The variant keeps a reference to the message.
+ */
+dbus_bool_t
+ni_dbus_message_iter_get_pooled(ni_dbus_message_t *msg, DBusMessageIter *iter,
+				ni_dbus_variant_t *variant)
+{
+	ni_dbus_pool_decoder_t dec;
+	dbus_bool_t rv;
+
+	ni_dbus_variant_destroy(variant);
+	if (!(dec.pool = __ni_dbus_message_variant_pool(msg)))
+		return ni_dbus_message_iter_get_variant_data(iter, variant);
+
+	dec.stack = dec.buffer;
+	dec.size = sizeof(dec.buffer);
+	dec.top = 0;
+
+	if (!(rv = __ni_dbus_message_iter_get_pooled(iter, variant, &dec)))
+		ni_dbus_variant_destroy(variant);
+
+	if (dec.stack != dec.buffer)
+		free(dec.stack);
+	return rv;
+}
+
 dbus_bool_t
 ni_dbus_message_iter_get_variant(DBusMessageIter *iter, ni_dbus_variant_t *variant)
 {
@@ -25,6 +25,7 @@ static dbus_bool_t		__ni_dbus_object_get_one_property(const ni_dbus_object_t *ob
 					ni_dbus_variant_t *var,
 					DBusError *error);
 static const char *		__ni_dbus_object_child_path(const ni_dbus_object_t *, const char *);
+static struct ni_dbus_name_index *__ni_dbus_name_index_get(const void *, size_t);
 
 const ni_dbus_class_t		ni_dbus_anonymous_class = {
 	"<anonymous>"
@@ -54,15 +55,130 @@ ni_dbus_object_new(const ni_dbus_class_t *class, const char *path, void *handle)
 	return object;
 }
 
+/*
+ * Objects with many children (e.g. the interface list with one child per
+ * network device) keep an index of their children by name, so that path
+ * lookups and appending children do not scan the children list.
+ */
+#define NI_DBUS_OBJECT_INDEX_MIN	16
+
+struct ni_dbus_object_index {
+	unsigned int		size;		/* number of buckets, power of 2 */
+	unsigned int		count;
+	ni_dbus_object_t **	bucket;
+	ni_dbus_object_t **	tail;		/* end of the children list */
+};
+
+static void
+__ni_dbus_object_index_insert(struct ni_dbus_object_index *index, ni_dbus_object_t *child)
+{
+	unsigned int hash = __ni_dbus_hash_name(child->name, strlen(child->name));
+	ni_dbus_object_t **head = &index->bucket[hash & (index->size - 1)];
+
+	child->index_next = *head;
+	*head = child;
+	index->count++;
+}
+
+static void
+__ni_dbus_object_index_grow(struct ni_dbus_object_index *index)
+{
+	ni_dbus_object_t **old_bucket = index->bucket;
+	unsigned int i, old_size = index->size;
+
+	index->size = old_size ? old_size * 2 : NI_DBUS_OBJECT_INDEX_MIN;
+	index->bucket = xcalloc(index->size, sizeof(index->bucket[0]));
+	index->count = 0;
+
+	for (i = 0; i < old_size; ++i) {
+		ni_dbus_object_t *child, *next;
+
+		for (child = old_bucket[i]; child; child = next) {
+			next = child->index_next;
+			__ni_dbus_object_index_insert(index, child);
+		}
+	}
+	free(old_bucket);
+}
+
+static void
+__ni_dbus_object_index_add(ni_dbus_object_t *parent, ni_dbus_object_t *child)
+{
+	struct ni_dbus_object_index *index = parent->child_index;
+
+	if (index->count >= 2 * index->size)
+		__ni_dbus_object_index_grow(index);
+	__ni_dbus_object_index_insert(index, child);
+}
+
+static void
+__ni_dbus_object_index_build(ni_dbus_object_t *parent)
+{
+	struct ni_dbus_object_index *index;
+	ni_dbus_object_t *child, **pos;
+
+	index = xcalloc(1, sizeof(*index));
+	parent->child_index = index;
+	__ni_dbus_object_index_grow(index);
+
+	for (pos = &parent->children; (child = *pos) != NULL; pos = &child->next)
+		__ni_dbus_object_index_add(parent, child);
+	index->tail = pos;
+}
+
+static void
+__ni_dbus_object_index_free(ni_dbus_object_t *parent)
+{
+	if (parent->child_index) {
+		free(parent->child_index->bucket);
+		free(parent->child_index);
+		parent->child_index = NULL;
+	}
+}
+
+/*
+ * Remove an object from its parent's list of children
+ */
+static void
+__ni_dbus_object_detach(ni_dbus_object_t *object)
+{
+	ni_dbus_object_t *parent = object->parent;
+	struct ni_dbus_object_index *index;
+
+	if (parent && (index = parent->child_index) != NULL && object->pprev) {
+		unsigned int hash = __ni_dbus_hash_name(object->name, strlen(object->name));
+		ni_dbus_object_t **pos, *cur;
+
+		for (pos = &index->bucket[hash & (index->size - 1)]; (cur = *pos); pos = &cur->index_next) {
+			if (cur == object) {
+				*pos = object->index_next;
+				index->count--;
+				break;
+			}
+		}
+		if (object->next == NULL)
+			index->tail = object->pprev;
+	}
+
+	object->index_next = NULL;
+	__ni_dbus_object_unlink(object);
+	object->parent = NULL;
+}
+
 static ni_dbus_object_t *
 __ni_dbus_object_new_child(ni_dbus_object_t *parent, const ni_dbus_class_t *object_class, const char *name,
 				void *object_handle)
 {
 	ni_dbus_object_t **pos, *child;
+	unsigned int count = 0;
 
 	/* Find the tail of the children list */
-	for (pos = &parent->children; (child = *pos) != NULL; pos = &child->next)
-		;
+	if (parent->child_index) {
+		pos = parent->child_index->tail;
+	} else {
+		for (pos = &parent->children; (child = *pos) != NULL; pos = &child->next)
+			count++;
+	}
 
 	child = __ni_dbus_object_new(object_class, __ni_dbus_object_child_path(parent, name));
 	if (!child)
@@ -71,6 +187,15 @@ __ni_dbus_object_new_child(ni_dbus_object_t *parent, const ni_dbus_class_t *obje
 	child->parent = parent;
 	__ni_dbus_object_insert(pos, child);
 	ni_string_dup(&child->name, name);
+
+	if (parent->child_index) {
+		__ni_dbus_object_index_add(parent, child);
+		parent->child_index->tail = &child->next;
+	} else
+	if (count + 1 >= NI_DBUS_OBJECT_INDEX_MIN) {
+		__ni_dbus_object_index_build(parent);
+	}
+
 	if (parent->server_object)
 		__ni_dbus_server_object_inherit(child, parent);
 	if (parent->client_object)
@@ -105,8 +230,7 @@ __ni_dbus_object_free(ni_dbus_object_t *object)
 {
 	ni_dbus_object_t *child;
 
-	__ni_dbus_object_unlink(object);
-	object->parent = NULL;
+	__ni_dbus_object_detach(object);
 
 	if (object->server_object)
 		__ni_dbus_server_object_destroy(object);
@@ -118,11 +242,45 @@ __ni_dbus_object_free(ni_dbus_object_t *object)
 
 	while ((child = object->children) != NULL)
 		__ni_dbus_object_free(child);
+	__ni_dbus_object_index_free(object);
 
 	free(object->interfaces);
 	free(object);
 }
 
+/*
+ * Property dict generations, per service
+ */
+ni_dbus_generation_t *
+ni_dbus_generation_array_get(ni_dbus_generation_array_t *array, const ni_dbus_service_t *service)
+{
+	ni_dbus_generation_t *gen;
+	unsigned int i;
+
+	for (i = 0; i < array->count; ++i) {
+		if (array->data[i].service == service)
+			return &array->data[i];
+	}
+
+	array->data = xrealloc(array->data, (array->count + 1) * sizeof(array->data[0]));
+	gen = &array->data[array->count++];
+	memset(gen, 0, sizeof(*gen));
+	gen->service = service;
+	return gen;
+}
+
+void
+ni_dbus_generation_array_destroy(ni_dbus_generation_array_t *array)
+{
+	unsigned int i;
+
+	for (i = 0; i < array->count; ++i)
+		free(array->data[i].data);
+	free(array->data);
+	array->data = NULL;
+	array->count = 0;
+}
+
 /*
  * User-visible function: delete an object previously created through
  * ni_dbus_server_create_anonymous_object.
@@ -133,8 +291,7 @@ ni_dbus_object_free(ni_dbus_object_t *object)
 	if (object->pprev) {
 		ni_debug_dbus("%s: deferring deletion of active object %s",
 				__FUNCTION__, object->path);
-		__ni_dbus_object_unlink(object);
-		object->parent = NULL;
+		__ni_dbus_object_detach(object);
 		__ni_dbus_object_insert(&__ni_dbus_objects_trashcan, object);
 	} else {
 		__ni_dbus_object_free(object);
@@ -172,15 +329,27 @@ ni_dbus_object_translate_error(ni_dbus_object_t *obj, const DBusError *error)
  * Look up an object by its relative name
  */
 static ni_dbus_object_t *
-__ni_dbus_object_get_child(ni_dbus_object_t *parent, const char *name)
+__ni_dbus_object_get_child(ni_dbus_object_t *parent, const char *name, size_t len)
 {
 	ni_dbus_object_t *child;
 
-	if (*name == '\0')
+	if (len == 0)
 		return parent;
 
+	if (parent->child_index) {
+		struct ni_dbus_object_index *index = parent->child_index;
+		unsigned int hash = __ni_dbus_hash_name(name, len);
+
+		child = index->bucket[hash & (index->size - 1)];
+		for ( ; child; child = child->index_next) {
+			if (!strncmp(child->name, name, len) && child->name[len] == '\0')
+				return child;
+		}
+		return NULL;
+	}
+
 	for (child = parent->children; child; child = child->next) {
-		if (!strcmp(child->name, name))
+		if (child->name && !strncmp(child->name, name, len) && child->name[len] == '\0')
 			return child;
 	}
 
@@ -192,7 +361,6 @@ __ni_dbus_object_lookup(ni_dbus_object_t *root_object, const char *path, int cre
 				const ni_dbus_class_t *object_class,
 				void *object_handle)
 {
-	char *path_copy = NULL, *name, *next_name;
 	ni_dbus_object_t *found;
 
 	if (path == NULL)
@@ -213,27 +381,37 @@ __ni_dbus_object_lookup(ni_dbus_object_t *root_object, const char *path, int cre
 		path = relative_path;
 	}
 
-	ni_string_dup(&path_copy, path);
-
 	found = root_object;
-	for (name = strtok(path_copy, "/"); name && found; name = next_name) {
+	while (found) {
 		ni_dbus_object_t *child;
+		const char *next;
+		size_t len;
 
-		next_name = strtok(NULL, "/");
-		child = __ni_dbus_object_get_child(found, name);
+		path += strspn(path, "/");
+		if (*path == '\0')
+			break;
+
+		len = strcspn(path, "/");
+		next = path + len + strspn(path + len, "/");
+
+		child = __ni_dbus_object_get_child(found, path, len);
 		if (child == NULL && create) {
-			if (next_name != NULL) {
+			char *name = xcalloc(1, len + 1);
+
+			memcpy(name, path, len);
+			if (*next != '\0') {
 				/* Intermediate path component */
 				child = __ni_dbus_object_new_child(found, NULL, name, NULL);
 			} else {
 				/* Final path component consumes object handle and functions */
 				child = __ni_dbus_object_new_child(found, object_class, name, object_handle);
 			}
+			free(name);
 		}
 		found = child;
+		path = next;
 	}
 
-	ni_string_free(&path_copy);
 	return found;
 }
 
@@ -500,43 +678,156 @@ ni_dbus_object_register_service(ni_dbus_object_t *object, const ni_dbus_service_
 	object->interfaces[count++] = svc;
 	object->interfaces[count] = NULL;
 
+	/* Build the dispatch indexes now rather than on the first call */
+	if (svc->methods)
+		__ni_dbus_name_index_get(svc->methods, sizeof(ni_dbus_method_t));
+	if (svc->properties)
+		__ni_dbus_name_index_get(svc->properties, sizeof(ni_dbus_property_t));
+
 	if (svc->properties)
 		ni_dbus_object_register_property_interface(object);
 	return TRUE;
 }
 
 /*
- * Find the named method
+ * Method, signal and property tables are looked up on every incoming call
+ * and property access. Tables with more than a handful of entries get a
+ * name index, built when the table is first used (usually when a service
+ * using it is registered) and kept for the life of the process; tables
+ * are static or live as long as their service.
  */
-const ni_dbus_method_t *
-ni_dbus_service_get_method(const ni_dbus_service_t *service, const char *name)
+#define NI_DBUS_NAME_INDEX_MIN		8
+
+typedef struct ni_dbus_name_index {
+	const void *		table;
+	unsigned int		mask;		/* 0: scan the table */
+	unsigned int *		slot;		/* entry number + 1, 0 if empty */
+} ni_dbus_name_index_t;
+
+static struct {
+	unsigned int		size;		/* power of 2 */
+	unsigned int		count;
+	ni_dbus_name_index_t **	data;
+} __ni_dbus_name_indexes;
+
+static inline const char *
+__ni_dbus_table_name(const void *table, size_t entry_size, unsigned int i)
+{
+	/* Both ni_dbus_method_t and ni_dbus_property_t start with the name */
+	return *(const char * const *) ((const char *) table + i * entry_size);
+}
+
+static ni_dbus_name_index_t *
+__ni_dbus_name_index_new(const void *table, size_t entry_size)
+{
+	ni_dbus_name_index_t *index;
+	unsigned int i, count, size;
+	const char *name;
+
+	index = xcalloc(1, sizeof(*index));
+	index->table = table;
+
+	for (count = 0; __ni_dbus_table_name(table, entry_size, count); ++count)
+		;
+	if (count < NI_DBUS_NAME_INDEX_MIN)
+		return index;
+
+	for (size = 16; size < 2 * count; size <<= 1)
+		;
+	index->mask = size - 1;
+	index->slot = xcalloc(size, sizeof(index->slot[0]));
+
+	for (i = 0; (name = __ni_dbus_table_name(table, entry_size, i)); ++i) {
+		unsigned int pos = __ni_dbus_hash_name(name, strlen(name)) & index->mask;
+
+		while (index->slot[pos])
+			pos = (pos + 1) & index->mask;
+		index->slot[pos] = i + 1;
+	}
+	return index;
+}
+
+static ni_dbus_name_index_t *
+__ni_dbus_name_index_get(const void *table, size_t entry_size)
+{
+	ni_dbus_name_index_t *index;
+	unsigned int pos;
+
+	if (__ni_dbus_name_indexes.count * 2 >= __ni_dbus_name_indexes.size) {
+		ni_dbus_name_index_t **old_data = __ni_dbus_name_indexes.data;
+		unsigned int i, old_size = __ni_dbus_name_indexes.size;
+
+		__ni_dbus_name_indexes.size = old_size ? old_size * 2 : 64;
+		__ni_dbus_name_indexes.data = xcalloc(__ni_dbus_name_indexes.size, sizeof(old_data[0]));
+		for (i = 0; i < old_size; ++i) {
+			if ((index = old_data[i]) == NULL)
+				continue;
+			pos = __ni_dbus_hash_pointer(index->table) & (__ni_dbus_name_indexes.size - 1);
+			while (__ni_dbus_name_indexes.data[pos])
+				pos = (pos + 1) & (__ni_dbus_name_indexes.size - 1);
+			__ni_dbus_name_indexes.data[pos] = index;
+		}
+		free(old_data);
+	}
+
+	pos = __ni_dbus_hash_pointer(table) & (__ni_dbus_name_indexes.size - 1);
+	while ((index = __ni_dbus_name_indexes.data[pos]) != NULL) {
+		if (index->table == table)
+			return index;
+		pos = (pos + 1) & (__ni_dbus_name_indexes.size - 1);
+	}
+
+	index = __ni_dbus_name_index_new(table, entry_size);
+	__ni_dbus_name_indexes.data[pos] = index;
+	__ni_dbus_name_indexes.count++;
+	return index;
+}
+
+static const void *
+__ni_dbus_table_lookup(const void *table, size_t entry_size, const char *name)
 {
-	const ni_dbus_method_t *method;
+	ni_dbus_name_index_t *index;
+	const char *entry_name;
+	unsigned int i, pos;
 
-	if (service->methods == NULL)
+	if (table == NULL || name == NULL)
 		return NULL;
-	for (method = service->methods; method->name; ++method) {
-		if (!strcmp(method->name, name))
-			return method;
+
+	index = __ni_dbus_name_index_get(table, entry_size);
+	if (index->mask == 0) {
+		for (i = 0; (entry_name = __ni_dbus_table_name(table, entry_size, i)); ++i) {
+			if (!strcmp(entry_name, name))
+				return (const char *) table + i * entry_size;
+		}
+		return NULL;
+	}
+
+	pos = __ni_dbus_hash_name(name, strlen(name)) & index->mask;
+	while ((i = index->slot[pos]) != 0) {
+		entry_name = __ni_dbus_table_name(table, entry_size, i - 1);
+		if (!strcmp(entry_name, name))
+			return (const char *) table + (i - 1) * entry_size;
+		pos = (pos + 1) & index->mask;
 	}
 	return NULL;
 }
 
+/*
+ * Find the named method
+ */
+const ni_dbus_method_t *
+ni_dbus_service_get_method(const ni_dbus_service_t *service, const char *name)
+{
+	return __ni_dbus_table_lookup(service->methods, sizeof(ni_dbus_method_t), name);
+}
+
 /*
  * Find the named signal
  */
 const ni_dbus_method_t *
 ni_dbus_service_get_signal(const ni_dbus_service_t *service, const char *name)
 {
-	const ni_dbus_method_t *method;
-
-	if (service->signals == NULL)
-		return NULL;
-	for (method = service->signals; method->name; ++method) {
-		if (!strcmp(method->name, name))
-			return method;
-	}
-	return NULL;
+	return __ni_dbus_table_lookup(service->signals, sizeof(ni_dbus_method_t), name);
 }
 
 
@@ -546,15 +837,7 @@ ni_dbus_service_get_signal(const ni_dbus_service_t *service, const char *name)
 const ni_dbus_property_t *
 __ni_dbus_service_get_property(const ni_dbus_property_t *property_list, const char *name)
 {
-	const ni_dbus_property_t *property;
-
-	if (property_list == NULL)
-		return NULL;
-	for (property = property_list; property->name; ++property) {
-		if (!strcmp(property->name, name))
-			return property;
-	}
-	return NULL;
+	return __ni_dbus_table_lookup(property_list, sizeof(ni_dbus_property_t), name);
 }
 
 const ni_dbus_property_t *
@@ -829,6 +1112,52 @@ ni_dbus_object_get_properties_as_dict(const ni_dbus_object_t *object,
 	return rv;
 }
 
+/*
+ * Get the named (top-level) properties of an object for a given dbus
+ * interface. Names not known by the interface are ignored.
+ */
+dbus_bool_t
+ni_dbus_object_get_properties_as_dict_projected(const ni_dbus_object_t *object,
+					const ni_dbus_service_t *interface,
+					const ni_string_array_t *names,
+					ni_dbus_variant_t *dict,
+					DBusError *error)
+{
+	DBusError local_error = DBUS_ERROR_INIT;
+	ni_dbus_property_t *subset;
+	unsigned int i, count = 0;
+	int rv;
+
+	if (names == NULL || names->count == 0)
+		return ni_dbus_object_get_properties_as_dict(object, interface, dict, error);
+
+	if (interface->properties == NULL)
+		return TRUE;
+
+	subset = xcalloc(names->count + 1, sizeof(subset[0]));
+	for (i = 0; i < names->count; ++i) {
+		const ni_dbus_property_t *property;
+
+		property = __ni_dbus_service_get_property(interface->properties, names->data[i]);
+		if (property)
+			subset[count++] = *property;
+	}
+
+	rv = TRUE;
+	if (count) {
+		if (error == NULL)
+			error = &local_error;
+
+		rv = __ni_dbus_object_get_properties_as_dict(object,
+						interface->name, subset,
+						dict, error);
+		dbus_error_free(&local_error);
+	}
+
+	free(subset);
+	return rv;
+}
+
 /*
  * Helper function for setting all properties from a dict
  */
@@ -9,6 +9,29 @@
 
 #include <wicked/dbus.h>
 
+/*
+ * Generation of the property dict of one service of an object.
+ * The server bumps it whenever the marshalled dict changes, clients
+ * keep the generation of the dict they applied last.
+ */
+typedef struct ni_dbus_generation {
+	const ni_dbus_service_t *service;
+	uint64_t		generation;
+
+	/* server only: the marshalled dict returned last */
+	void *			data;
+	size_t			len;
+} ni_dbus_generation_t;
+
+typedef struct ni_dbus_generation_array {
+	unsigned int		count;
+	ni_dbus_generation_t *	data;
+} ni_dbus_generation_array_t;
+
+extern ni_dbus_generation_t *	ni_dbus_generation_array_get(ni_dbus_generation_array_t *,
+					const ni_dbus_service_t *);
+extern void			ni_dbus_generation_array_destroy(ni_dbus_generation_array_t *);
+
 extern ni_dbus_object_t *	__ni_dbus_object_new(const ni_dbus_class_t *, const char *);
 extern void			__ni_dbus_object_free(ni_dbus_object_t *);
 extern void			__ni_dbus_server_object_inherit(ni_dbus_object_t *child, const ni_dbus_object_t *parent);
@@ -18,6 +41,31 @@ extern void			__ni_dbus_client_object_destroy(ni_dbus_object_t *object);
 extern const ni_intmap_t *	__ni_dbus_client_object_get_error_map(const ni_dbus_object_t *);
 extern dbus_bool_t		ni_dbus_object_register_property_interface(ni_dbus_object_t *object);
 
+/*
+ * Hash functions for the object and dispatch indexes
+ */
+static inline unsigned int
+__ni_dbus_hash_name(const char *name, size_t len)
+{
+	unsigned int hash = 2166136261U;
+
+	while (len--) {
+		hash ^= (unsigned char) *name++;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+static inline unsigned int
+__ni_dbus_hash_pointer(const void *ptr)
+{
+	unsigned long val = (unsigned long) ptr;
+
+	val ^= val >> 17;
+	val *= 0x9e3779b1UL;
+	return (unsigned int) (val ^ (val >> 15));
+}
+
 static inline void
 __ni_dbus_object_insert(ni_dbus_object_t **pos, ni_dbus_object_t *object)
 {
@@ -28,6 +28,7 @@
 #include <wicked/dbus-service.h>
 #include <wicked/resolver.h>
 #include "netinfo_priv.h"	/* for __ni_system_interface_update_lease */
+#include "appconfig.h"
 #include "dbus-common.h"
 #include "model.h"
 #include "debug.h"
@@ -142,7 +143,7 @@ __ni_objectmodel_routes_bind_device_name(ni_route_table_t *routes, const char *i
 }
 
 /*
- * Callback from addrconf supplicant whenever it acquired, released or lost a lease.
+ * Callback from addrconf supplicant whenever it acquired, updated, released or lost a lease.
  *
  * FIXME SECURITY:
  * Is it good enough to check for the sender interface to avoid that someone is sending
@@ -154,7 +155,7 @@ ni_objectmodel_addrconf_signal_handler(ni_dbus_connection_t *conn, ni_dbus_messa
 	ni_dbus_addrconf_forwarder_t *forwarder = user_data;
 	const char *signal_name = dbus_message_get_member(msg);
 	ni_netdev_t *ifp;
-	ni_addrconf_lease_t *lease = NULL;
+	ni_addrconf_lease_t *lease = NULL, *old;
 	ni_dbus_variant_t argv[16];
 	ni_uuid_t uuid = NI_UUID_INIT;
 	ni_event_t ifevent;
@@ -198,7 +199,8 @@ ni_objectmodel_addrconf_signal_handler(ni_dbus_connection_t *conn, ni_dbus_messa
 			ni_addrfamily_type_to_name(lease->family),
 			ni_addrconf_type_to_name(lease->type),
 			ni_uuid_print(&uuid), lease->update, lease->flags);
-	if (!strcmp(signal_name, NI_OBJECTMODEL_LEASE_ACQUIRED_SIGNAL)) {
+	if (!strcmp(signal_name, NI_OBJECTMODEL_LEASE_ACQUIRED_SIGNAL)
+	 || !strcmp(signal_name, NI_OBJECTMODEL_LEASE_UPDATED_SIGNAL)) {
 		if (lease->state != NI_ADDRCONF_STATE_GRANTED) {
 			ni_error("%s: unexpected lease state in signal %s", __func__, signal_name);
 			goto done;
@@ -226,6 +228,21 @@ ni_objectmodel_addrconf_signal_handler(ni_dbus_connection_t *conn, ni_dbus_messa
 				}
 			}
 		}
+
+		/* The supplicant changed only the lifetimes and already
+		 * updated the addresses; just record the new lease. When
+		 * we don't have the old one, apply it as acquired. */
+		old = ni_netdev_get_lease(ifp, lease->family, lease->type);
+		if (!strcmp(signal_name, NI_OBJECTMODEL_LEASE_UPDATED_SIGNAL)
+		 && old && old->state == NI_ADDRCONF_STATE_GRANTED) {
+			ni_debug_dbus("%s: recording updated %s:%s lease", ifp->name,
+					ni_addrfamily_type_to_name(lease->family),
+					ni_addrconf_type_to_name(lease->type));
+			lease->update &= ni_config_addrconf_update_mask(lease->type, lease->family);
+			ni_netdev_set_lease(ifp, lease);
+			lease = NULL;
+			goto done;
+		}
 	} else if (!strcmp(signal_name, NI_OBJECTMODEL_LEASE_RELEASED_SIGNAL)) {
 		lease->state = NI_ADDRCONF_STATE_RELEASED;
 		ifevent = NI_EVENT_ADDRESS_RELEASED;
@@ -15,6 +15,7 @@
 #include <signal.h>
 #include <getopt.h>
 #include <errno.h>
+#include <sys/time.h>
 
 #include <wicked/netinfo.h>
 #include <wicked/addrconf.h>
@@ -22,16 +23,25 @@
 #include <wicked/dbus-errors.h>
 #include <wicked/dbus-service.h>
 #include <wicked/system.h>
+#include <wicked/socket.h>
 #include <wicked/xml.h>
 #include "netinfo_priv.h"
+#include "util_priv.h"
 #include "dbus-common.h"
+#include "dbus-object.h"
+#include "dbus-connection.h"
 #include "model.h"
 #include "debug.h"
+#include "netif-snapshot.h"
 
 extern dbus_bool_t	ni_objectmodel_netif_list_refresh(ni_dbus_object_t *);
 static void		ni_objectmodel_register_netif_factory_service(ni_dbus_service_t *);
 static void		ni_objectmodel_netif_initialize(ni_dbus_object_t *object);
 static void		ni_objectmodel_netif_destroy(ni_dbus_object_t *object);
+static dbus_bool_t	ni_objectmodel_netif_client_state_subtrees_to_dict(const ni_client_state_subtree_array_t *,
+					ni_dbus_variant_t *);
+static dbus_bool_t	ni_objectmodel_netif_client_state_subtrees_from_dict(ni_client_state_subtree_array_t *,
+					const ni_dbus_variant_t *);
 
 const ni_dbus_class_t		ni_objectmodel_netif_class = {
 	.name		= NI_OBJECTMODEL_NETIF_CLASS,
@@ -69,6 +79,10 @@ ni_objectmodel_register_netif_classes(void)
 	/* register the netif class (to allow extensions to attach to it) */
 	ni_objectmodel_register_class(&ni_objectmodel_netif_class);
 
+	/* With lazy registration, link classes are created on first lookup */
+	if (ni_objectmodel_lazy_registration())
+		return;
+
 	for (iftype = 0; iftype < __NI_IFTYPE_MAX; ++iftype) {
 		const char *classname;
 
@@ -141,10 +155,36 @@ ni_objectmodel_register_netif_factory_service(ni_dbus_service_t *svc)
 void
 ni_objectmodel_register_netif_service(ni_iftype_t iftype, ni_dbus_service_t *svc)
 {
-	svc->compatible = ni_objectmodel_link_class(iftype);
-	ni_assert(svc->compatible);
+	const char *classname;
 
-	ni_objectmodel_register_service(svc);
+	if (!(classname = ni_objectmodel_link_classname(iftype)))
+		classname = NI_OBJECTMODEL_NETIF_CLASS;
+
+	ni_objectmodel_register_service_for_class(svc, classname);
+}
+
+/*
+ * Create the link class of the given name, if there is one.
+ * Used for lazy registration.
+ */
+const ni_dbus_class_t *
+ni_objectmodel_register_link_class(const char *classname)
+{
+	ni_dbus_class_t *link_class;
+	unsigned int iftype;
+
+	if (strncmp(classname, "netif-", 6))
+		return NULL;
+
+	for (iftype = 0; iftype < __NI_IFTYPE_MAX; ++iftype) {
+		if (!ni_string_eq(ni_objectmodel_link_classname(iftype), classname))
+			continue;
+
+		link_class = ni_objectmodel_class_new(classname, &ni_objectmodel_netif_class);
+		ni_objectmodel_register_class(link_class);
+		return link_class;
+	}
+	return NULL;
 }
 
 /*
@@ -294,9 +334,200 @@ ni_objectmodel_netif_list_identify_device(ni_dbus_object_t *object, const ni_dbu
 	return TRUE;
 }
 
+/*
+ * InterfaceList.callDevices(service, method, aa{sv})
+ *
+ * Call the same method on a set of devices in one round trip. Each
+ * array entry names the device by "ifindex" and carries the method
+ * "argument" dict, if any. The reply holds one dict per entry, in the
+ * same order, with either the "result" of the method (its callback
+ * info) or the "error-name" and "error-message" it failed with.
+ */
+static void
+ni_objectmodel_netif_list_call_device(ni_dbus_server_t *server, const char *interface,
+			const char *method_name, const ni_dbus_variant_t *entry,
+			uid_t caller_uid, ni_dbus_variant_t *result)
+{
+	DBusError error = DBUS_ERROR_INIT;
+	const ni_dbus_variant_t *argument;
+	const ni_dbus_service_t *svc;
+	const ni_dbus_method_t *method;
+	ni_dbus_object_t *object;
+	ni_dbus_message_t *reply;
+	ni_netconfig_t *nc;
+	ni_netdev_t *dev;
+	uint32_t ifindex = 0;
+	unsigned int argc;
+	dbus_bool_t rv;
+
+	if (!ni_dbus_dict_get_uint32(entry, "ifindex", &ifindex)) {
+		dbus_set_error(&error, DBUS_ERROR_INVALID_ARGS,
+				"bulk call entry without ifindex");
+		goto failed;
+	}
+	ni_dbus_dict_add_uint32(result, "ifindex", ifindex);
+
+	if (!(nc = ni_global_state_handle(0)) || !(dev = ni_netdev_by_index(nc, ifindex))
+	 || !(object = ni_objectmodel_get_netif_object(server, dev))) {
+		dbus_set_error(&error, NI_DBUS_ERROR_DEVICE_NOT_KNOWN,
+				"no interface with index %u", ifindex);
+		goto failed;
+	}
+
+	if (!(svc = ni_dbus_object_get_service(object, interface))
+	 || !(method = ni_dbus_service_get_method(svc, method_name))
+	 || (!method->handler && !method->handler_ex)) {
+		/* Async methods need the original call message */
+		dbus_set_error(&error, DBUS_ERROR_UNKNOWN_METHOD,
+				"Unknown method in bulk call to object %s, %s.%s",
+				object->path, interface, method_name);
+		goto failed;
+	}
+
+	argument = ni_dbus_dict_get(entry, "argument");
+	argc = argument ? 1 : 0;
+
+	if (method->call_signature) {
+		const char *signature = argument ? ni_dbus_variant_signature(argument) : "";
+
+		if (!signature || strcmp(signature, method->call_signature)) {
+			ni_debug_dbus("Mismatched call signature; expect=%s; got=%s",
+					method->call_signature, signature);
+			dbus_set_error(&error, DBUS_ERROR_INVALID_SIGNATURE,
+					"Bad call signature in bulk call to object %s, %s.%s",
+					object->path, interface, method_name);
+			goto failed;
+		}
+	}
+
+	if (object->class && object->class->refresh
+	 && !object->class->refresh(object)) {
+		dbus_set_error(&error, DBUS_ERROR_FAILED,
+				"Failed to refresh object %s", object->path);
+		goto failed;
+	}
+
+	reply = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+	if (method->handler_ex)
+		rv = method->handler_ex(object, method, argc, argument, caller_uid, reply, &error);
+	else
+		rv = method->handler(object, method, argc, argument, reply, &error);
+
+	if (rv) {
+		ni_dbus_variant_t value = NI_DBUS_VARIANT_INIT;
+
+		if (ni_dbus_message_get_args_variants(reply, &value, 1) > 0) {
+			/* move the method's result into the entry */
+			*ni_dbus_dict_add(result, "result") = value;
+		} else {
+			ni_dbus_variant_destroy(&value);
+		}
+	}
+	dbus_message_unref(reply);
+
+	if (rv) {
+		dbus_error_free(&error);
+		return;
+	}
+
+failed:
+	if (!dbus_error_is_set(&error))
+		dbus_set_error(&error, DBUS_ERROR_FAILED, "Unexpected error in method call");
+	ni_dbus_dict_add_string(result, "error-name", error.name);
+	ni_dbus_dict_add_string(result, "error-message", error.message);
+	dbus_error_free(&error);
+}
+
+static dbus_bool_t
+ni_objectmodel_netif_list_call_devices(ni_dbus_object_t *object, const ni_dbus_method_t *method,
+			unsigned int argc, const ni_dbus_variant_t *argv,
+			uid_t caller_uid, ni_dbus_message_t *reply, DBusError *error)
+{
+	ni_dbus_variant_t result = NI_DBUS_VARIANT_INIT;
+	const char *interface, *method_name;
+	ni_dbus_server_t *server;
+	unsigned int i;
+	dbus_bool_t rv;
+
+	if (argc != 3
+	 || !ni_dbus_variant_get_string(&argv[0], &interface)
+	 || !ni_dbus_variant_get_string(&argv[1], &method_name)
+	 || !ni_dbus_variant_is_dict_array(&argv[2]))
+		return ni_dbus_error_invalid_args(error, object->path, method->name);
+
+	if (!(server = ni_dbus_object_get_server(object))) {
+		dbus_set_error(error, DBUS_ERROR_FAILED, "%s: no server for bulk call",
+				object->path);
+		return FALSE;
+	}
+
+	ni_debug_dbus("%s: calling %s.%s() on %u devices", object->path,
+			interface, method_name, argv[2].array.len);
+
+	ni_dbus_dict_array_init(&result);
+	for (i = 0; i < argv[2].array.len; ++i) {
+		ni_objectmodel_netif_list_call_device(server, interface, method_name,
+				&argv[2].variant_array_value[i], caller_uid,
+				ni_dbus_dict_array_add(&result));
+	}
+
+	rv = ni_dbus_message_serialize_variants(reply, 1, &result, error);
+	ni_dbus_variant_destroy(&result);
+	return rv;
+}
+
+/*
+ * InterfaceList.subscribeEvents()/unsubscribeEvents()
+ * Opt in to (or out of) the interfaceEvents signal, which carries all
+ * interface events of a batch in a single signal. It is sent to the
+ * subscribed callers only.
+ */
+static dbus_bool_t
+ni_objectmodel_netif_list_subscription(ni_dbus_connection_t *connection, ni_dbus_object_t *object,
+			ni_dbus_message_t *call, ni_bool_t subscribe)
+{
+	ni_dbus_server_t *server;
+	ni_dbus_message_t *reply;
+	const char *sender;
+
+	if (!(server = ni_dbus_object_get_server(object)))
+		return FALSE;
+
+	sender = dbus_message_get_sender(call);
+	if (subscribe) {
+		if (!ni_dbus_server_add_subscriber(server, connection, sender))
+			return FALSE;
+	} else {
+		ni_dbus_server_del_subscriber(server, connection, sender);
+	}
+
+	reply = dbus_message_new_method_return(call);
+	if (ni_dbus_connection_send_message(connection, reply) < 0)
+		ni_error("unable to send reply (out of memory)");
+	dbus_message_unref(reply);
+	return TRUE;
+}
+
+static dbus_bool_t
+ni_objectmodel_netif_list_subscribe_events(ni_dbus_connection_t *connection, ni_dbus_object_t *object,
+			const ni_dbus_method_t *method, ni_dbus_message_t *call)
+{
+	return ni_objectmodel_netif_list_subscription(connection, object, call, TRUE);
+}
+
+static dbus_bool_t
+ni_objectmodel_netif_list_unsubscribe_events(ni_dbus_connection_t *connection, ni_dbus_object_t *object,
+			const ni_dbus_method_t *method, ni_dbus_message_t *call)
+{
+	return ni_objectmodel_netif_list_subscription(connection, object, call, FALSE);
+}
+
 static ni_dbus_method_t		ni_objectmodel_netif_list_methods[] = {
 	{ "deviceByName",	"s",		ni_objectmodel_netif_list_device_by_name },
 	{ "identifyDevice",	"sa{sv}",	ni_objectmodel_netif_list_identify_device },
+	{ "callDevices",	"ssaa{sv}",	.handler_ex = ni_objectmodel_netif_list_call_devices },
+	{ "subscribeEvents",	"",		.async_handler = ni_objectmodel_netif_list_subscribe_events },
+	{ "unsubscribeEvents",	"",		.async_handler = ni_objectmodel_netif_list_unsubscribe_events },
 	{ NULL }
 };
 
@@ -866,6 +1097,7 @@ __ni_objectmodel_netif_set_client_state_save_trigger(ni_netdev_t *dev)
 		ni_client_state_save(dev->client_state, dev->link.ifindex);
 		ni_debug_dbus("saving %s structure into a file for %s",
 			NI_CLIENT_STATE_XML_NODE, dev->name);
+		ni_netif_snapshot_changed();
 	}
 }
 
@@ -923,6 +1155,216 @@ ni_objectmodel_netif_set_client_state_config(ni_dbus_object_t *object, const ni_
 	return TRUE;
 }
 
+/*
+ * Interface event batching (used by wickedd).
+ *
+ * Events are queued and sent from a zero timeout timer, i.e. once per
+ * main loop iteration. A queued event without uuid is superseded by a
+ * later event of the same kind for the same device (linkUp, linkDown,
+ * linkUp sends a single linkUp), so the final state is always sent.
+ * Events with a uuid complete a caller's request and are never merged,
+ * neither are device create, delete and ready events; they also stop
+ * merging across them. A token bucket limits the signal rate; events
+ * over the limit stay queued, they are delayed but never dropped.
+ * Clients which subscribed via InterfaceList.subscribeEvents() also
+ * receive the events of each flush as a single interfaceEvents signal.
+ */
+typedef struct ni_objectmodel_netif_event {
+	char *			path;
+	unsigned int		path_hash;
+	ni_event_t		event;
+	ni_bool_t		has_uuid;
+	ni_uuid_t		uuid;
+} ni_objectmodel_netif_event_t;
+
+static struct ni_objectmodel_netif_event_queue {
+	ni_dbus_server_t *	server;
+	unsigned int		rate;
+	unsigned int		burst;
+
+	unsigned int		tokens;
+	struct timeval		refilled;
+	const ni_timer_t *	timer;
+
+	unsigned int		count;
+	ni_objectmodel_netif_event_t *data;
+} ni_objectmodel_netif_events;
+
+static void		ni_objectmodel_netif_events_flush(void *, const ni_timer_t *);
+
+void
+ni_objectmodel_netif_events_batch(ni_dbus_server_t *server, unsigned int rate,
+				unsigned int burst)
+{
+	struct ni_objectmodel_netif_event_queue *queue = &ni_objectmodel_netif_events;
+
+	queue->server = server;
+	queue->rate = rate;
+	queue->burst = burst > rate ? burst : rate;
+	queue->tokens = queue->burst;
+	ni_timer_get_time(&queue->refilled);
+}
+
+static unsigned int
+ni_objectmodel_netif_event_group(ni_event_t event)
+{
+	switch (event) {
+	case NI_EVENT_DEVICE_CREATE:
+	case NI_EVENT_DEVICE_DELETE:
+	case NI_EVENT_DEVICE_READY:
+		return __NI_EVENT_MAX;
+
+	case NI_EVENT_DEVICE_DOWN:
+		return NI_EVENT_DEVICE_UP;
+	case NI_EVENT_LINK_DOWN:
+		return NI_EVENT_LINK_UP;
+	case NI_EVENT_LINK_ASSOCIATION_LOST:
+		return NI_EVENT_LINK_ASSOCIATED;
+	case NI_EVENT_NETWORK_DOWN:
+		return NI_EVENT_NETWORK_UP;
+
+	default:
+		return event;
+	}
+}
+
+static void
+ni_objectmodel_netif_event_queue(const char *path, ni_event_t event, const ni_uuid_t *uuid)
+{
+	struct ni_objectmodel_netif_event_queue *queue = &ni_objectmodel_netif_events;
+	unsigned int group = ni_objectmodel_netif_event_group(event);
+	unsigned int hash = __ni_dbus_hash_name(path, strlen(path));
+	ni_objectmodel_netif_event_t *ev;
+	unsigned int i;
+
+	/* Drop the queued event of this kind superseded by this one */
+	for (i = queue->count; uuid == NULL && group != __NI_EVENT_MAX && i-- > 0; ) {
+		ev = &queue->data[i];
+		if (ev->path_hash != hash || !ni_string_eq(ev->path, path))
+			continue;
+		if (ev->has_uuid || ni_objectmodel_netif_event_group(ev->event) == __NI_EVENT_MAX)
+			break;
+		if (ni_objectmodel_netif_event_group(ev->event) != group)
+			continue;
+
+		ni_debug_dbus("%s: %s event superseded by %s", path,
+				ni_objectmodel_event_to_signal(ev->event),
+				ni_objectmodel_event_to_signal(event));
+		ni_string_free(&ev->path);
+		memmove(ev, ev + 1, (queue->count - i - 1) * sizeof(*ev));
+		queue->count--;
+		break;
+	}
+
+	if ((queue->count % 64) == 0)
+		queue->data = xrealloc(queue->data, (queue->count + 64) * sizeof(queue->data[0]));
+
+	ev = &queue->data[queue->count++];
+	memset(ev, 0, sizeof(*ev));
+	ni_string_dup(&ev->path, path);
+	ev->path_hash = hash;
+	ev->event = event;
+	if (uuid) {
+		ev->has_uuid = TRUE;
+		ev->uuid = *uuid;
+	}
+
+	if (!queue->timer)
+		queue->timer = ni_timer_register(0, ni_objectmodel_netif_events_flush, queue);
+}
+
+static void
+ni_objectmodel_netif_events_refill(struct ni_objectmodel_netif_event_queue *queue)
+{
+	struct timeval now, delta;
+	unsigned long msec, tokens;
+
+	ni_timer_get_time(&now);
+	timersub(&now, &queue->refilled, &delta);
+	msec = delta.tv_sec * 1000 + delta.tv_usec / 1000;
+
+	tokens = msec * queue->rate / 1000;
+	if (tokens == 0)
+		return;
+
+	queue->refilled = now;
+	if (queue->tokens + tokens > queue->burst)
+		queue->tokens = queue->burst;
+	else
+		queue->tokens += tokens;
+}
+
+static void
+ni_objectmodel_netif_events_flush(void *user_data, const ni_timer_t *timer)
+{
+	struct ni_objectmodel_netif_event_queue *queue = user_data;
+	ni_dbus_variant_t bulk = NI_DBUS_VARIANT_INIT;
+	ni_bool_t bulk_signal;
+	unsigned int i, count;
+
+	if (queue->timer != timer)
+		return;
+	queue->timer = NULL;
+
+	count = queue->count;
+	if (queue->rate) {
+		ni_objectmodel_netif_events_refill(queue);
+		if (count > queue->tokens)
+			count = queue->tokens;
+		queue->tokens -= count;
+	}
+
+	bulk_signal = ni_dbus_server_has_subscribers(queue->server);
+	if (bulk_signal)
+		ni_dbus_dict_array_init(&bulk);
+
+	for (i = 0; i < count; ++i) {
+		ni_objectmodel_netif_event_t *ev = &queue->data[i];
+		const char *signal_name = ni_objectmodel_event_to_signal(ev->event);
+		ni_dbus_variant_t arg = NI_DBUS_VARIANT_INIT;
+
+		if (ev->has_uuid)
+			ni_dbus_variant_set_uuid(&arg, &ev->uuid);
+
+		ni_debug_dbus("sending device event \"%s\" for %s", signal_name, ev->path);
+		ni_dbus_server_send_path_signal(queue->server, ev->path,
+				NI_OBJECTMODEL_NETIF_INTERFACE, signal_name,
+				ev->has_uuid ? 1 : 0, &arg);
+		ni_dbus_variant_destroy(&arg);
+
+		if (bulk_signal) {
+			ni_dbus_variant_t *dict = ni_dbus_dict_array_add(&bulk);
+
+			ni_dbus_dict_add_string(dict, "path", ev->path);
+			ni_dbus_dict_add_string(dict, "event", signal_name);
+			if (ev->has_uuid)
+				ni_dbus_dict_add_uuid(dict, "uuid", &ev->uuid);
+		}
+		ni_string_free(&ev->path);
+	}
+
+	if (bulk_signal) {
+		if (count)
+			ni_dbus_server_send_subscriber_signal(queue->server,
+					NI_OBJECTMODEL_NETIF_LIST_PATH,
+					NI_OBJECTMODEL_NETIFLIST_INTERFACE, "interfaceEvents",
+					1, &bulk);
+		ni_dbus_variant_destroy(&bulk);
+	}
+
+	queue->count -= count;
+	memmove(queue->data, queue->data + count, queue->count * sizeof(queue->data[0]));
+
+	if (queue->count) {
+		/* Over the rate limit; send the rest when there are tokens again */
+		unsigned long timeout = 1000 / queue->rate;
+
+		ni_debug_dbus("rate limit reached, delaying %u interface events", queue->count);
+		queue->timer = ni_timer_register(timeout ? timeout : 1,
+				ni_objectmodel_netif_events_flush, queue);
+	}
+}
+
 /*
  * Broadcast an interface event
  * The optional uuid argument helps the client match e.g. notifications
@@ -940,6 +1382,15 @@ ni_objectmodel_send_netif_event(ni_dbus_server_t *server, ni_dbus_object_t *obje
 		return FALSE;
 	}
 
+	if (ni_objectmodel_netif_events.server == server && object && object->path) {
+		if (!ni_objectmodel_event_to_signal(ifevent)) {
+			ni_warn("%s: no signal name for event %u", __func__, ifevent);
+			return FALSE;
+		}
+		ni_objectmodel_netif_event_queue(object->path, ifevent, uuid);
+		return TRUE;
+	}
+
 	return __ni_objectmodel_device_event(server, object, NI_OBJECTMODEL_NETIF_INTERFACE, ifevent, uuid);
 }
 
@@ -1243,6 +1694,59 @@ ni_objectmodel_netif_client_state_config_to_dict(const ni_client_state_config_t
 		return FALSE;
 	}
 
+	if (conf->subtrees.count &&
+	    !ni_objectmodel_netif_client_state_subtrees_to_dict(&conf->subtrees, var)) {
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * The subtree fingerprints are a dict of subtree name to uuid byte array;
+ * a name is repeated when the config contains multiple nodes with it.
+ */
+static dbus_bool_t
+ni_objectmodel_netif_client_state_subtrees_to_dict(const ni_client_state_subtree_array_t *subtrees,
+				ni_dbus_variant_t *dict)
+{
+	const ni_client_state_subtree_t *st;
+	ni_dbus_variant_t *var;
+	unsigned int i;
+
+	if (!(var = ni_dbus_dict_add(dict, NI_CLIENT_STATE_XML_CONFIG_SUBTREES_NODE)))
+		return FALSE;
+	ni_dbus_variant_init_dict(var);
+
+	for (i = 0; i < subtrees->count; ++i) {
+		st = &subtrees->data[i];
+		if (!ni_dbus_dict_add_byte_array(var, st->name,
+		    st->uuid.octets, sizeof(st->uuid.octets))) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static dbus_bool_t
+ni_objectmodel_netif_client_state_subtrees_from_dict(ni_client_state_subtree_array_t *subtrees,
+				const ni_dbus_variant_t *dict)
+{
+	const ni_dbus_variant_t *child;
+	const char *name;
+	ni_uuid_t uuid;
+	unsigned int i;
+
+	ni_client_state_subtree_array_destroy(subtrees);
+	for (i = 0; (child = ni_dbus_dict_get_entry(dict, i, &name)); ++i) {
+		if (!ni_dbus_variant_get_uuid(child, &uuid) ||
+		    !ni_client_state_subtree_array_append(subtrees, name, &uuid)) {
+			ni_client_state_subtree_array_destroy(subtrees);
+			return FALSE;
+		}
+	}
+
 	return TRUE;
 }
 
@@ -1325,6 +1829,14 @@ ni_objectmodel_netif_client_state_config_from_dict(ni_client_state_config_t *con
 		return FALSE;
 	}
 
+	/* Optional, not sent by older clients */
+	if ((child = ni_dbus_dict_get(var, NI_CLIENT_STATE_XML_CONFIG_SUBTREES_NODE))) {
+		if (!ni_objectmodel_netif_client_state_subtrees_from_dict(&conf->subtrees, child))
+			return FALSE;
+	} else {
+		ni_client_state_subtree_array_destroy(&conf->subtrees);
+	}
+
 	return TRUE;
 }
 
@@ -49,7 +49,38 @@ typedef struct ni_dbus_class_array {
 static ni_dbus_class_array_t	ni_objectmodel_class_registry;
 static ni_dbus_service_array_t	ni_objectmodel_service_registry;
 
+/*
+ * Services are also indexed by interface name. With lazy registration
+ * (used by short-lived client commands), an entry is only recorded when
+ * the service is registered; resolving its link class, binding the
+ * schema methods and the extensions is deferred until the service is
+ * looked up by name or tag, or an object of a compatible class asks
+ * for its interfaces.
+ */
+typedef struct ni_objectmodel_service_entry ni_objectmodel_service_entry_t;
+struct ni_objectmodel_service_entry {
+	ni_objectmodel_service_entry_t *next;
+	unsigned int		hash;
+	char *			name;
+	char *			class_name;
+	const ni_dbus_service_t *service;
+	ni_xs_service_t *	schema;
+	ni_bool_t		pending;
+};
+
+#define NI_OBJECTMODEL_SERVICE_BUCKETS	128
+static ni_objectmodel_service_entry_t *ni_objectmodel_service_index[NI_OBJECTMODEL_SERVICE_BUCKETS];
+
+static ni_bool_t		ni_objectmodel_lazy;
+static ni_dbus_class_array_t	ni_objectmodel_lazy_classes;
+
+static void			ni_objectmodel_defer_schema_services(ni_xs_scope_t *);
+static void			ni_objectmodel_materialize_class(const ni_dbus_class_t *);
+static const ni_dbus_service_t *ni_objectmodel_materialize_service(ni_objectmodel_service_entry_t *);
+static void			ni_objectmodel_bind_service_extensions(const ni_dbus_service_t *);
+
 static ni_dbus_service_t	ni_objectmodel_netif_root_interface;
+static ni_dbus_service_t	ni_objectmodel_debug_interface;
 
 ni_dbus_server_t *		__ni_objectmodel_server;
 ni_xs_scope_t *			__ni_objectmodel_schema;
@@ -86,8 +117,15 @@ ni_objectmodel_init(ni_dbus_server_t *server)
 		/* Register all built-in classes and services */
 		ni_objectmodel_register_all();
 
-		/* Register/amend all services defined in the schema */
-		ni_dbus_xml_register_services(__ni_objectmodel_schema);
+		/* Register/amend all services defined in the schema.
+		 * In lazy mode, only register the schema classes and
+		 * index the services by interface name. */
+		if (ni_objectmodel_lazy) {
+			ni_dbus_xml_register_classes(__ni_objectmodel_schema);
+			ni_objectmodel_defer_schema_services(__ni_objectmodel_schema);
+		} else {
+			ni_dbus_xml_register_services(__ni_objectmodel_schema);
+		}
 
 		/* If we're the server, create the initial objects of the
 		 * server-side object hierarchy.
@@ -100,13 +138,31 @@ ni_objectmodel_init(ni_dbus_server_t *server)
 			ni_objectmodel_register_ns_dynamic();
 		}
 
-		/* Bind all extensions */
-		ni_objectmodel_bind_extensions();
+		/* Bind all extensions; lazy mode binds them per service */
+		if (!ni_objectmodel_lazy)
+			ni_objectmodel_bind_extensions();
 	}
 
 	return __ni_objectmodel_schema;
 }
 
+/*
+ * Enable lazy registration of classes and services. Needs to be
+ * called before ni_objectmodel_init()
+ */
+void
+ni_objectmodel_set_lazy_registration(ni_bool_t lazy)
+{
+	if (__ni_objectmodel_schema == NULL)
+		ni_objectmodel_lazy = lazy;
+}
+
+ni_bool_t
+ni_objectmodel_lazy_registration(void)
+{
+	return ni_objectmodel_lazy;
+}
+
 void
 ni_objectmodel_register_all(void)
 {
@@ -131,6 +187,7 @@ ni_objectmodel_create_initial_objects(ni_dbus_server_t *server)
 	/* Register root interface with the root of the object hierarchy */
 	object = ni_dbus_server_get_root_object(server);
 	ni_dbus_object_register_service(object, &ni_objectmodel_netif_root_interface);
+	ni_dbus_object_register_service(object, &ni_objectmodel_debug_interface);
 
 	ni_objectmodel_create_netif_list(server);
 #ifdef MODEM
@@ -150,6 +207,7 @@ ni_objectmodel_bind_compatible_interfaces(ni_dbus_object_t *object)
 	}
 
 	NI_TRACE_ENTER_ARGS("object=%s, class=%s", object->path, object->class->name);
+	ni_objectmodel_materialize_class(object->class);
 	for (i = 0; i < ni_objectmodel_service_registry.count; ++i) {
 		const ni_dbus_service_t *service = ni_objectmodel_service_registry.services[i];
 
@@ -169,6 +227,7 @@ ni_objectmodel_compatible_services_for_class(const ni_dbus_class_t *query_class,
 {
 	unsigned int i, count;
 
+	ni_objectmodel_materialize_class(query_class);
 	for (i = count = 0; i < ni_objectmodel_service_registry.count; ++i) {
 		const ni_dbus_service_t *service = ni_objectmodel_service_registry.services[i];
 		const ni_dbus_class_t *class;
@@ -191,30 +250,169 @@ ni_objectmodel_compatible_services_for_class(const ni_dbus_class_t *query_class,
 /*
  * objectmodel service registry
  */
+static unsigned int
+ni_objectmodel_service_hash(const char *name)
+{
+	unsigned int hash = NI_DBUS_HASH_INIT;
+
+	while (*name)
+		hash = (hash ^ (unsigned char) *name++) * 16777619U;
+	return hash;
+}
+
+static ni_objectmodel_service_entry_t *
+ni_objectmodel_service_entry(const char *name, ni_bool_t create)
+{
+	ni_objectmodel_service_entry_t **pos, *entry;
+	unsigned int hash;
+
+	hash = ni_objectmodel_service_hash(name);
+	pos = &ni_objectmodel_service_index[hash % NI_OBJECTMODEL_SERVICE_BUCKETS];
+	for (entry = *pos; entry; entry = entry->next) {
+		if (entry->hash == hash && ni_string_eq(entry->name, name))
+			return entry;
+	}
+	if (!create)
+		return NULL;
+
+	entry = xcalloc(1, sizeof(*entry));
+	entry->hash = hash;
+	ni_string_dup(&entry->name, name);
+	entry->pending = ni_objectmodel_lazy;
+	entry->next = *pos;
+	*pos = entry;
+	return entry;
+}
+
 void
 ni_objectmodel_register_service(const ni_dbus_service_t *service)
 {
+	ni_objectmodel_service_entry_t *entry;
 	unsigned int index = ni_objectmodel_service_registry.count;
 
 	ni_assert(index < NI_DBUS_SERVICES_MAX);
 
 	ni_objectmodel_service_registry.services[index++] = service;
 	ni_objectmodel_service_registry.count = index;
+
+	entry = ni_objectmodel_service_entry(service->name, TRUE);
+	if (entry->service == NULL)
+		entry->service = service;
+	if (entry->class_name == NULL && service->compatible)
+		ni_string_dup(&entry->class_name, service->compatible->name);
 }
 
-const ni_dbus_service_t *
-ni_objectmodel_service_by_name(const char *name)
+/*
+ * Register a service whose compatible class is resolved by name when
+ * the service is materialized. Without lazy registration, the class
+ * is looked up right away.
+ */
+void
+ni_objectmodel_register_service_for_class(ni_dbus_service_t *service, const char *class_name)
 {
-	unsigned int i;
+	ni_objectmodel_service_entry_t *entry;
 
-	for (i = 0; i < ni_objectmodel_service_registry.count; ++i) {
-		const ni_dbus_service_t *service = ni_objectmodel_service_registry.services[i];
+	if (!ni_objectmodel_lazy) {
+		service->compatible = ni_objectmodel_get_class(class_name);
+		ni_assert(service->compatible);
+		ni_objectmodel_register_service(service);
+		return;
+	}
 
-		if (!strcmp(service->name, name))
-			return service;
+	ni_objectmodel_register_service(service);
+	entry = ni_objectmodel_service_entry(service->name, FALSE);
+	if (entry && entry->class_name == NULL)
+		ni_string_dup(&entry->class_name, class_name);
+}
+
+static void
+ni_objectmodel_defer_schema_services(ni_xs_scope_t *scope)
+{
+	ni_xs_service_t *xs_service;
+
+	for (xs_service = scope->services; xs_service; xs_service = xs_service->next) {
+		ni_objectmodel_service_entry_t *entry;
+		const ni_var_t *attr;
+
+		entry = ni_objectmodel_service_entry(xs_service->interface, TRUE);
+		entry->schema = xs_service;
+		entry->pending = TRUE;
+
+		attr = ni_var_array_get(&xs_service->attributes, "object-class");
+		if (entry->class_name == NULL && attr)
+			ni_string_dup(&entry->class_name, attr->value);
 	}
+}
 
-	return NULL;
+/*
+ * Complete the registration of a service deferred in lazy mode
+ */
+static const ni_dbus_service_t *
+ni_objectmodel_materialize_service(ni_objectmodel_service_entry_t *entry)
+{
+	ni_dbus_service_t *service;
+
+	if (!entry->pending)
+		return entry->service;
+	entry->pending = FALSE;
+
+	ni_debug_dbus("materializing dbus service %s", entry->name);
+	service = (ni_dbus_service_t *) entry->service;
+	if (service && service->compatible == NULL && entry->class_name)
+		service->compatible = ni_objectmodel_get_class(entry->class_name);
+
+	/* This registers a new service if there's no built-in one */
+	if (entry->schema)
+		ni_dbus_xml_register_service(entry->schema);
+
+	if (entry->service)
+		ni_objectmodel_bind_service_extensions(entry->service);
+	return entry->service;
+}
+
+/*
+ * Materialize all services compatible with a class or its superclasses
+ */
+static void
+ni_objectmodel_materialize_class(const ni_dbus_class_t *class)
+{
+	ni_objectmodel_service_entry_t *entry;
+	unsigned int i, index;
+
+	if (!ni_objectmodel_lazy)
+		return;
+
+	for (; class; class = class->superclass) {
+		for (i = 0; i < ni_objectmodel_lazy_classes.count; ++i) {
+			if (ni_objectmodel_lazy_classes.class[i] == class)
+				break;
+		}
+		if (i < ni_objectmodel_lazy_classes.count)
+			continue;
+
+		index = ni_objectmodel_lazy_classes.count;
+		ni_assert(index < NI_DBUS_CLASSES_MAX);
+		ni_objectmodel_lazy_classes.class[index++] = class;
+		ni_objectmodel_lazy_classes.count = index;
+
+		for (i = 0; i < NI_OBJECTMODEL_SERVICE_BUCKETS; ++i) {
+			for (entry = ni_objectmodel_service_index[i]; entry; entry = entry->next) {
+				if (entry->pending && ni_string_eq(entry->class_name, class->name))
+					ni_objectmodel_materialize_service(entry);
+			}
+		}
+	}
+}
+
+const ni_dbus_service_t *
+ni_objectmodel_service_by_name(const char *name)
+{
+	ni_objectmodel_service_entry_t *entry;
+
+	if (!name || !(entry = ni_objectmodel_service_entry(name, FALSE)))
+		return NULL;
+
+	return ni_objectmodel_materialize_service(entry);
 }
 
 const ni_dbus_service_t *
@@ -222,6 +420,7 @@ ni_objectmodel_service_by_class(const ni_dbus_class_t *class)
 {
 	unsigned int i;
 
+	ni_objectmodel_materialize_class(class);
 	for (i = 0; i < ni_objectmodel_service_registry.count; ++i) {
 		const ni_dbus_service_t *service = ni_objectmodel_service_registry.services[i];
 
@@ -235,8 +434,19 @@ ni_objectmodel_service_by_class(const ni_dbus_class_t *class)
 const ni_dbus_service_t *
 ni_objectmodel_service_by_tag(const char *tag)
 {
+	ni_objectmodel_service_entry_t *entry;
 	unsigned int i;
 
+	if (ni_objectmodel_lazy) {
+		for (i = 0; i < NI_OBJECTMODEL_SERVICE_BUCKETS; ++i) {
+			for (entry = ni_objectmodel_service_index[i]; entry; entry = entry->next) {
+				if (entry->pending && entry->schema
+				 && ni_string_eq(entry->schema->name, tag))
+					ni_objectmodel_materialize_service(entry);
+			}
+		}
+	}
+
 	for (i = 0; i < ni_objectmodel_service_registry.count; ++i) {
 		const ni_dbus_service_t *service = ni_objectmodel_service_registry.services[i];
 		const ni_xs_service_t *xs_service;
@@ -327,6 +537,9 @@ ni_objectmodel_get_class(const char *name)
 		if (!strcmp(class->name, name))
 			return class;
 	}
+
+	if (ni_objectmodel_lazy)
+		return ni_objectmodel_register_link_class(name);
 	return NULL;
 }
 
@@ -415,6 +628,44 @@ static ni_dbus_service_t	ni_objectmodel_netif_root_interface = {
 	.signals	= ni_objectmodel_netif_root_signals,
 };
 
+/*
+ * The debug interface of the root node, exporting the dbus call
+ * statistics of the server.
+ */
+static dbus_bool_t
+ni_objectmodel_debug_get_dbus_stats(ni_dbus_object_t *object, const ni_dbus_method_t *method,
+			unsigned int argc, const ni_dbus_variant_t *argv,
+			ni_dbus_message_t *reply, DBusError *error)
+{
+	ni_dbus_variant_t result = NI_DBUS_VARIANT_INIT;
+	dbus_bool_t rv;
+
+	rv = ni_dbus_stats_get(&result)
+	  && ni_dbus_message_serialize_variants(reply, 1, &result, error);
+	ni_dbus_variant_destroy(&result);
+	return rv;
+}
+
+static dbus_bool_t
+ni_objectmodel_debug_reset_dbus_stats(ni_dbus_object_t *object, const ni_dbus_method_t *method,
+			unsigned int argc, const ni_dbus_variant_t *argv,
+			ni_dbus_message_t *reply, DBusError *error)
+{
+	ni_dbus_stats_reset();
+	return TRUE;
+}
+
+static ni_dbus_method_t		ni_objectmodel_debug_methods[] = {
+	{ "getDBusStats",	"",		ni_objectmodel_debug_get_dbus_stats },
+	{ "resetDBusStats",	"",		ni_objectmodel_debug_reset_dbus_stats },
+	{ NULL }
+};
+
+static ni_dbus_service_t	ni_objectmodel_debug_interface = {
+	.name		= NI_OBJECTMODEL_DEBUG_INTERFACE,
+	.methods	= ni_objectmodel_debug_methods,
+};
+
 /*
  * Expand the environment of an extension
  * This should probably go with the objectmodel code.
@@ -670,57 +921,60 @@ ni_objectmodel_bind_extensions(void)
 	unsigned int i;
 
 	NI_TRACE_ENTER();
-	for (i = 0; i < ni_objectmodel_service_registry.count; ++i) {
-		const ni_dbus_service_t *service = ni_objectmodel_service_registry.services[i];
-		const ni_dbus_method_t *method;
-		ni_extension_t *extension;
-		const ni_c_binding_t *binding;
+	for (i = 0; i < ni_objectmodel_service_registry.count; ++i)
+		ni_objectmodel_bind_service_extensions(ni_objectmodel_service_registry.services[i]);
 
-		extension = ni_config_find_extension(ni_global.config, service->name);
-		if (extension == NULL)
-			continue;
+	return 0;
+}
+
+static void
+ni_objectmodel_bind_service_extensions(const ni_dbus_service_t *service)
+{
+	const ni_dbus_method_t *method;
+	ni_extension_t *extension;
+	const ni_c_binding_t *binding;
 
-		for (method = service->methods; method && method->name != NULL; ++method) {
-			ni_dbus_method_t *mod_method = (ni_dbus_method_t *) method;
+	extension = ni_config_find_extension(ni_global.config, service->name);
+	if (extension == NULL)
+		return;
 
-			if (method->handler != NULL)
-				continue;
-			if (ni_extension_script_find(extension, method->name) != NULL) {
-				ni_debug_dbus("binding method %s.%s to external command",
-						service->name, method->name);
-				mod_method->async_handler = ni_objectmodel_extension_call;
-				mod_method->async_completion = ni_objectmodel_extension_completion;
-			} else
-			if ((binding = ni_extension_find_c_binding(extension, method->name)) != NULL) {
-				void *addr;
-
-				if ((addr = ni_c_binding_get_address(binding)) == NULL) {
-					ni_error("cannot bind method %s.%s - invalid C binding",
-							service->name, method->name);
-					continue;
-				}
-
-				ni_debug_dbus("binding method %s.%s to builtin %s",
-						service->name, method->name, binding->symbol);
-				mod_method->handler = addr;
-			}
-		}
+	for (method = service->methods; method && method->name != NULL; ++method) {
+		ni_dbus_method_t *mod_method = (ni_dbus_method_t *) method;
 
-		/* Bind the properties table if we have one */
-		if ((binding = ni_extension_find_c_binding(extension, "__properties")) != NULL) {
-			ni_dbus_service_t *mod_service = ((ni_dbus_service_t *) service);
+		if (method->handler != NULL)
+			continue;
+		if (ni_extension_script_find(extension, method->name) != NULL) {
+			ni_debug_dbus("binding method %s.%s to external command",
+					service->name, method->name);
+			mod_method->async_handler = ni_objectmodel_extension_call;
+			mod_method->async_completion = ni_objectmodel_extension_completion;
+		} else
+		if ((binding = ni_extension_find_c_binding(extension, method->name)) != NULL) {
 			void *addr;
 
 			if ((addr = ni_c_binding_get_address(binding)) == NULL) {
-				ni_error("cannot bind %s properties - invalid C binding",
-						service->name);
-			} else {
-				mod_service->properties = addr;
+				ni_error("cannot bind method %s.%s - invalid C binding",
+						service->name, method->name);
+				continue;
 			}
-		}
 
+			ni_debug_dbus("binding method %s.%s to builtin %s",
+					service->name, method->name, binding->symbol);
+			mod_method->handler = addr;
+		}
 	}
 
-	return 0;
+	/* Bind the properties table if we have one */
+	if ((binding = ni_extension_find_c_binding(extension, "__properties")) != NULL) {
+		ni_dbus_service_t *mod_service = ((ni_dbus_service_t *) service);
+		void *addr;
+
+		if ((addr = ni_c_binding_get_address(binding)) == NULL) {
+			ni_error("cannot bind %s properties - invalid C binding",
+					service->name);
+		} else {
+			mod_service->properties = addr;
+		}
+	}
 }
 
@@ -7,8 +7,12 @@
 #include "config.h"
 #endif
 
+#include <time.h>
+#include <unistd.h>
+
 #include <wicked/util.h>
 #include <wicked/logging.h>
+#include <wicked/socket.h>
 #include <wicked/dbus-service.h>
 #include <wicked/dbus-errors.h>
 #include "dbus-server.h"
@@ -20,21 +24,67 @@
 
 struct ni_dbus_server_object {
 	ni_dbus_server_t *	server;			/* back pointer at server */
+
+	ni_dbus_object_t *	object;
+	const void *		indexed_handle;		/* key in the handle index */
+	ni_dbus_server_object_t *handle_next;
+
+	ni_dbus_generation_array_t generations;		/* of the property dicts */
 };
 
 static const ni_dbus_class_t	dbus_root_object_class = {
 	.name = "<root>",
 };
 
+typedef struct ni_dbus_server_peer {
+	ni_dbus_server_t *	server;
+	ni_dbus_connection_t *	connection;
+} ni_dbus_server_peer_t;
+
+typedef struct ni_dbus_server_subscriber {
+	ni_dbus_connection_t *	connection;
+	char *			name;		/* NULL for a peer */
+} ni_dbus_server_subscriber_t;
+
 struct ni_dbus_server {
 	ni_dbus_connection_t *	connection;
 	ni_dbus_object_t *	root_object;
+
+	/* Direct connections of local clients, see ni_dbus_server_listen_peers */
+	ni_dbus_listener_t *	listener;
+	struct {
+		unsigned int	count;
+		ni_dbus_server_peer_t **data;
+	} peers;
+	const ni_timer_t *	peer_reaper;
+
+	/* Clients subscribed to signals, see ni_dbus_server_add_subscriber */
+	struct {
+		unsigned int	count;
+		ni_dbus_server_subscriber_t *data;
+	} subscribers;
+	ni_bool_t		name_watch;
+
+	/* Objects by handle, see ni_dbus_server_find_object_by_handle */
+	struct {
+		unsigned int	size;
+		unsigned int	count;
+		ni_dbus_server_object_t **bucket;
+	} handle_index;
 };
 
 static dbus_bool_t		ni_dbus_object_register_object_manager(ni_dbus_object_t *);
 static dbus_bool_t		ni_dbus_object_register_introspectable_interface(ni_dbus_object_t *);
 static const char *		__ni_dbus_server_root_path(const char *);
 static void			__ni_dbus_server_object_init(ni_dbus_object_t *object, ni_dbus_server_t *server);
+static void			__ni_dbus_server_index_handle(ni_dbus_server_t *, ni_dbus_object_t *);
+static void			__ni_dbus_server_unindex_handle(ni_dbus_server_t *, ni_dbus_server_object_t *);
+static void			__ni_dbus_server_close_peers(ni_dbus_server_t *, ni_bool_t);
+static void			__ni_dbus_server_del_subscribers(ni_dbus_server_t *,
+					const ni_dbus_connection_t *, const char *);
+static void			__ni_dbus_server_reap_peers(void *, const ni_timer_t *);
+static DBusHandlerResult	__ni_dbus_object_dispatch(ni_dbus_connection_t *, DBusMessage *,
+					ni_dbus_object_t *);
 
 /*
  * Constructor for DBus server handle
@@ -71,6 +121,15 @@ ni_dbus_server_free(ni_dbus_server_t *server)
 {
 	NI_TRACE_ENTER();
 
+	ni_dbus_listener_free(server->listener);
+	server->listener = NULL;
+	__ni_dbus_server_close_peers(server, TRUE);
+	free(server->peers.data);
+	__ni_dbus_server_del_subscribers(server, NULL, NULL);
+	free(server->subscribers.data);
+	if (server->peer_reaper)
+		ni_timer_cancel(server->peer_reaper);
+
 	if (server->root_object)
 		__ni_dbus_object_free(server->root_object);
 	server->root_object = NULL;
@@ -79,9 +138,105 @@ ni_dbus_server_free(ni_dbus_server_t *server)
 		ni_dbus_connection_free(server->connection);
 	server->connection = NULL;
 
+	free(server->handle_index.bucket);
 	free(server);
 }
 
+/*
+ * Accept direct connections from local clients on a unix socket.
+ * Calls on these connections are dispatched to the same object tree
+ * as calls received via the bus, and all signals we send are also
+ * sent to every peer.
+ */
+static DBusHandlerResult
+__ni_dbus_server_peer_message(DBusConnection *conn, DBusMessage *msg, void *user_data)
+{
+	ni_dbus_server_peer_t *peer = user_data;
+	ni_dbus_server_t *server = peer->server;
+	const char *path = dbus_message_get_path(msg);
+	ni_dbus_object_t *object;
+
+	if (dbus_message_is_signal(msg, DBUS_INTERFACE_LOCAL, "Disconnected")) {
+		ni_debug_dbus("dbus peer disconnected");
+		/* Cannot free the connection while it is dispatching */
+		if (!server->peer_reaper)
+			server->peer_reaper = ni_timer_register(0,
+					__ni_dbus_server_reap_peers, server);
+		return DBUS_HANDLER_RESULT_HANDLED;
+	}
+
+	if (dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_METHOD_CALL || path == NULL)
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	if (!ni_dbus_object_get_relative_path(server->root_object, path)
+	 || !(object = ni_dbus_object_lookup(server->root_object, path)))
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	return __ni_dbus_object_dispatch(peer->connection, msg, object);
+}
+
+static ni_bool_t
+__ni_dbus_server_accept_peer(ni_dbus_listener_t *listener, ni_dbus_connection_t *connection, void *user_data)
+{
+	static const DBusObjectPathVTable vtable = {
+		.message_function = __ni_dbus_server_peer_message,
+	};
+	ni_dbus_server_t *server = user_data;
+	ni_dbus_server_peer_t *peer;
+
+	peer = xcalloc(1, sizeof(*peer));
+	peer->server = server;
+	peer->connection = connection;
+	ni_dbus_connection_register_fallback(connection, &vtable, peer);
+
+	if ((server->peers.count % 8) == 0)
+		server->peers.data = xrealloc(server->peers.data,
+				(server->peers.count + 8) * sizeof(server->peers.data[0]));
+	server->peers.data[server->peers.count++] = peer;
+	return TRUE;
+}
+
+static void
+__ni_dbus_server_close_peers(ni_dbus_server_t *server, ni_bool_t all)
+{
+	unsigned int i, j;
+
+	for (i = j = 0; i < server->peers.count; ++i) {
+		ni_dbus_server_peer_t *peer = server->peers.data[i];
+
+		if (!all && ni_dbus_connection_is_connected(peer->connection)) {
+			server->peers.data[j++] = peer;
+			continue;
+		}
+		__ni_dbus_server_del_subscribers(server, peer->connection, NULL);
+		ni_dbus_connection_free(peer->connection);
+		free(peer);
+	}
+	server->peers.count = j;
+}
+
+static void
+__ni_dbus_server_reap_peers(void *user_data, const ni_timer_t *timer)
+{
+	ni_dbus_server_t *server = user_data;
+
+	if (server->peer_reaper != timer)
+		return;
+	server->peer_reaper = NULL;
+	__ni_dbus_server_close_peers(server, FALSE);
+}
+
+dbus_bool_t
+ni_dbus_server_listen_peers(ni_dbus_server_t *server, const char *socket_path)
+{
+	if (server->listener)
+		return TRUE;
+
+	server->listener = ni_dbus_listener_open(socket_path,
+				__ni_dbus_server_accept_peer, server);
+	return server->listener != NULL;
+}
+
 /*
  * Retrieve the server's root object
  */
@@ -106,6 +261,7 @@ __ni_dbus_server_object_init(ni_dbus_object_t *object, ni_dbus_server_t *server)
 
 		object->server_object = calloc(1, sizeof(ni_dbus_server_object_t));
 		object->server_object->server = server;
+		object->server_object->object = object;
 
 		if (object->path) {
 			ni_dbus_connection_register_object(server->connection, object);
@@ -125,9 +281,6 @@ ni_dbus_server_send_signal(ni_dbus_server_t *server, ni_dbus_object_t *object,
 {
 	const ni_dbus_service_t *svc = NULL;
 	const ni_dbus_method_t *method;
-	DBusError error = DBUS_ERROR_INIT;
-	DBusMessage *msg = NULL;
-	dbus_bool_t rv = FALSE;
 
 	if (interface) {
 		if (!(svc = ni_dbus_object_get_service(object, interface)))
@@ -145,7 +298,26 @@ ni_dbus_server_send_signal(ni_dbus_server_t *server, ni_dbus_object_t *object,
 	if (svc && !(method = ni_dbus_service_get_signal(svc, signal_name)))
 		ni_warn("%s: unknown signal %s", __func__, signal_name);
 
-	msg = dbus_message_new_signal(object->path, interface, signal_name);
+	return ni_dbus_server_send_path_signal(server, object->path, interface,
+					signal_name, nargs, args);
+}
+
+/*
+ * Send a signal on behalf of an object path, without checking the
+ * interface and signal name against the object's services. Used to send
+ * signals queued for an object which may be gone by now.
+ */
+dbus_bool_t
+ni_dbus_server_send_path_signal(ni_dbus_server_t *server, const char *object_path,
+				const char *interface, const char *signal_name,
+				unsigned int nargs, const ni_dbus_variant_t *args)
+{
+	DBusError error = DBUS_ERROR_INIT;
+	DBusMessage *msg = NULL;
+	dbus_bool_t rv = FALSE;
+	unsigned int i;
+
+	msg = dbus_message_new_signal(object_path, interface, signal_name);
 	if (msg == NULL) {
 		ni_error("%s: unable to build %s() signal message", __func__, signal_name);
 		return FALSE;
@@ -157,9 +329,191 @@ ni_dbus_server_send_signal(ni_dbus_server_t *server, ni_dbus_object_t *object,
 	if (ni_dbus_connection_send_message(server->connection, msg) < 0)
 		goto out;
 
+	for (i = 0; i < server->peers.count; ++i) {
+		ni_dbus_server_peer_t *peer = server->peers.data[i];
+
+		if (ni_dbus_connection_is_connected(peer->connection))
+			ni_dbus_connection_send_message(peer->connection, msg);
+	}
+
+	rv = TRUE;
+
+out:
+	if (msg)
+		dbus_message_unref(msg);
+
+	return rv;
+}
+
+/*
+ * Some signals are only sent to the clients which asked for them.
+ * A client on the bus is known by its unique name and dropped when
+ * the name goes away; a peer is its connection.
+ */
+static int
+__ni_dbus_server_find_subscriber(const ni_dbus_server_t *server,
+				const ni_dbus_connection_t *connection, const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < server->subscribers.count; ++i) {
+		const ni_dbus_server_subscriber_t *sub = &server->subscribers.data[i];
+
+		if (sub->connection == connection && ni_string_eq(sub->name, name))
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * Remove the subscribers of a connection (all when NULL) with the
+ * given name (any when NULL).
+ */
+static void
+__ni_dbus_server_del_subscribers(ni_dbus_server_t *server,
+				const ni_dbus_connection_t *connection, const char *name)
+{
+	unsigned int i, j;
+
+	for (i = j = 0; i < server->subscribers.count; ++i) {
+		ni_dbus_server_subscriber_t *sub = &server->subscribers.data[i];
+
+		if ((connection && sub->connection != connection)
+		 || (name && !ni_string_eq(sub->name, name))) {
+			server->subscribers.data[j++] = *sub;
+			continue;
+		}
+		ni_debug_dbus("removed dbus subscriber %s", sub->name ? sub->name : "<peer>");
+		ni_string_free(&sub->name);
+	}
+	server->subscribers.count = j;
+}
+
+static void
+__ni_dbus_server_name_owner_changed(ni_dbus_connection_t *connection, ni_dbus_message_t *msg,
+				void *user_data)
+{
+	ni_dbus_server_t *server = user_data;
+	const char *name, *old_owner, *new_owner;
+
+	if (!dbus_message_is_signal(msg, NI_DBUS_INTERFACE, "NameOwnerChanged")
+	 || !dbus_message_get_args(msg, NULL,
+				DBUS_TYPE_STRING, &name,
+				DBUS_TYPE_STRING, &old_owner,
+				DBUS_TYPE_STRING, &new_owner,
+				DBUS_TYPE_INVALID))
+		return;
+
+	if (ni_string_empty(new_owner) && !ni_string_empty(name))
+		__ni_dbus_server_del_subscribers(server, connection, name);
+}
+
+dbus_bool_t
+ni_dbus_server_add_subscriber(ni_dbus_server_t *server, ni_dbus_connection_t *connection,
+				const char *name)
+{
+	ni_dbus_server_subscriber_t *sub;
+
+	if (!server || !connection)
+		return FALSE;
+
+	if (ni_dbus_connection_is_peer(connection))
+		name = NULL;
+	else if (ni_string_empty(name))
+		return FALSE;
+
+	if (__ni_dbus_server_find_subscriber(server, connection, name) >= 0)
+		return TRUE;
+
+	if (name && !server->name_watch) {
+		ni_dbus_add_signal_handler_ex(connection, NI_DBUS_BUS_NAME,
+				NI_DBUS_OBJECT_PATH, NI_DBUS_INTERFACE, "NameOwnerChanged",
+				__ni_dbus_server_name_owner_changed, server);
+		server->name_watch = TRUE;
+	}
+
+	if ((server->subscribers.count % 8) == 0)
+		server->subscribers.data = xrealloc(server->subscribers.data,
+				(server->subscribers.count + 8) * sizeof(server->subscribers.data[0]));
+	sub = &server->subscribers.data[server->subscribers.count++];
+	sub->connection = connection;
+	sub->name = NULL;
+	ni_string_dup(&sub->name, name);
+
+	ni_debug_dbus("added dbus subscriber %s", name ? name : "<peer>");
+	return TRUE;
+}
+
+dbus_bool_t
+ni_dbus_server_del_subscriber(ni_dbus_server_t *server, ni_dbus_connection_t *connection,
+				const char *name)
+{
+	if (!server || !connection)
+		return FALSE;
+
+	if (ni_dbus_connection_is_peer(connection))
+		name = NULL;
+
+	if (__ni_dbus_server_find_subscriber(server, connection, name) < 0)
+		return FALSE;
+
+	__ni_dbus_server_del_subscribers(server, connection, name);
+	return TRUE;
+}
+
+ni_bool_t
+ni_dbus_server_has_subscribers(const ni_dbus_server_t *server)
+{
+	return server && server->subscribers.count;
+}
+
+/*
+ * Send a signal to the subscribed clients only.
+ */
+dbus_bool_t
+ni_dbus_server_send_subscriber_signal(ni_dbus_server_t *server, const char *object_path,
+				const char *interface, const char *signal_name,
+				unsigned int nargs, const ni_dbus_variant_t *args)
+{
+	DBusError error = DBUS_ERROR_INIT;
+	DBusMessage *msg = NULL;
+	dbus_bool_t rv = FALSE;
+	unsigned int i;
+
+	if (!ni_dbus_server_has_subscribers(server))
+		return TRUE;
+
+	msg = dbus_message_new_signal(object_path, interface, signal_name);
+	if (msg == NULL) {
+		ni_error("%s: unable to build %s() signal message", __func__, signal_name);
+		return FALSE;
+	}
+
+	if (nargs && !ni_dbus_message_serialize_variants(msg, nargs, args, &error))
+		goto out;
+
+	for (i = 0; i < server->subscribers.count; ++i) {
+		ni_dbus_server_subscriber_t *sub = &server->subscribers.data[i];
+		DBusMessage *copy;
+
+		if (!ni_dbus_connection_is_connected(sub->connection))
+			continue;
+
+		/* A sent message is locked; address a copy to each client */
+		if (!(copy = dbus_message_copy(msg)))
+			goto out;
+		if (sub->name && !dbus_message_set_destination(copy, sub->name)) {
+			dbus_message_unref(copy);
+			goto out;
+		}
+		ni_dbus_connection_send_message(sub->connection, copy);
+		dbus_message_unref(copy);
+	}
+
 	rv = TRUE;
 
 out:
+	dbus_error_free(&error);
 	if (msg)
 		dbus_message_unref(msg);
 
@@ -189,6 +543,9 @@ __ni_dbus_server_object_destroy(ni_dbus_object_t *object)
 		ni_dbus_connection_unregister_object(server->connection, object);
 
 	if (object->server_object) {
+		if (server)
+			__ni_dbus_server_unindex_handle(server, object->server_object);
+		ni_dbus_generation_array_destroy(&object->server_object->generations);
 		free(object->server_object);
 		object->server_object = NULL;
 	}
@@ -206,6 +563,8 @@ ni_dbus_server_register_object(ni_dbus_server_t *server, const char *object_path
 
 	NI_TRACE_ENTER_ARGS("path=%s, handle=%p", object_path, object_handle);
 	object = ni_dbus_object_create(server->root_object, object_path, object_class, object_handle);
+	if (object && object_handle)
+		__ni_dbus_server_index_handle(server, object);
 
 	return object;
 }
@@ -216,8 +575,28 @@ ni_dbus_server_register_object(ni_dbus_server_t *server, const char *object_path
 static const ni_dbus_service_t __ni_dbus_object_manager_interface;
 static const ni_dbus_service_t __ni_dbus_object_properties_interface;
 static const ni_dbus_service_t __ni_dbus_object_introspectable_interface;
+
+/*
+ * Filter and state of an object enumeration, see GetManagedObjectsFiltered
+ */
+typedef struct ni_dbus_object_manager_filter {
+	ni_string_array_t	paths;
+	ni_string_array_t	interfaces;
+	ni_string_array_t	properties;
+	unsigned int		offset;
+	unsigned int		limit;
+
+	unsigned int		index;		/* of next matching object */
+	unsigned int		count;		/* objects in reply */
+	unsigned int		next;		/* offset of next chunk, 0 if done */
+
+	/* property dict generations of the returned objects, by path */
+	ni_dbus_variant_t *	generations;
+} ni_dbus_object_manager_filter_t;
+
 static dbus_bool_t		__ni_dbus_object_manager_enumerate_object(ni_dbus_object_t *,
-					ni_dbus_variant_t *dict, DBusError *);
+					ni_dbus_object_manager_filter_t *,
+					DBusMessageIter *, DBusError *);
 
 dbus_bool_t
 ni_dbus_object_register_object_manager(ni_dbus_object_t *object)
@@ -257,6 +636,39 @@ ni_dbus_get_standard_service(const char *name)
 	return NULL;
 }
 
+/*
+ * The objects are serialized into the reply one at a time, instead
+ * of building a dict of all objects first.
+ */
+static dbus_bool_t
+__ni_dbus_object_manager_stream_objects(ni_dbus_object_t *object,
+		ni_dbus_object_manager_filter_t *filter,
+		DBusMessageIter *iter, DBusError *error)
+{
+	DBusMessageIter iter_array;
+
+	if (!dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					      DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					      DBUS_TYPE_STRING_AS_STRING
+					      DBUS_TYPE_VARIANT_AS_STRING
+					      DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+					      &iter_array))
+		goto nomem;
+
+	if (!__ni_dbus_object_manager_enumerate_object(object, filter, &iter_array, error)) {
+		dbus_message_iter_abandon_container(iter, &iter_array);
+		return FALSE;
+	}
+
+	if (!dbus_message_iter_close_container(iter, &iter_array))
+		goto nomem;
+	return TRUE;
+
+nomem:
+	dbus_set_error(error, DBUS_ERROR_NO_MEMORY, "Error marshalling managed objects");
+	return FALSE;
+}
+
 static dbus_bool_t
 __ni_dbus_object_manager_get_managed_objects(ni_dbus_object_t *object,
 		const ni_dbus_method_t *method,
@@ -264,22 +676,110 @@ __ni_dbus_object_manager_get_managed_objects(ni_dbus_object_t *object,
 		ni_dbus_message_t *reply,
 		DBusError *error)
 {
-	ni_dbus_variant_t obj_dict = NI_DBUS_VARIANT_INIT;
-	int rv = TRUE;
+	ni_dbus_object_manager_filter_t filter;
+	DBusMessageIter iter;
 
 	NI_TRACE_ENTER_ARGS("path=%s, method=%s", object->path, method->name);
 
-	ni_dbus_variant_init_dict(&obj_dict);
-	rv = __ni_dbus_object_manager_enumerate_object(object, &obj_dict, error);
-	if (rv)
-		rv = ni_dbus_message_serialize_variants(reply, 1, &obj_dict, error);
-	ni_dbus_variant_destroy(&obj_dict);
+	memset(&filter, 0, sizeof(filter));
+	dbus_message_iter_init_append(reply, &iter);
+	return __ni_dbus_object_manager_stream_objects(object, &filter, &iter, error);
+}
+
+static dbus_bool_t
+__ni_dbus_object_manager_filter_strings(ni_string_array_t *array, const ni_dbus_variant_t *dict,
+		const char *name)
+{
+	const ni_dbus_variant_t *var;
+	unsigned int i;
+
+	if (!(var = ni_dbus_dict_get(dict, name)))
+		return TRUE;
+	if (!ni_dbus_variant_is_string_array(var))
+		return FALSE;
+
+	for (i = 0; i < var->array.len; ++i)
+		ni_string_array_append(array, var->string_array_value[i]);
+	return TRUE;
+}
+
+/*
+ * ObjectManager.GetManagedObjectsFiltered(a{sv} filter)
+ *
+ * Like GetManagedObjects, but returns only the objects below the path
+ * prefixes given in "paths", only the interfaces named in "interfaces"
+ * and only the properties named in "properties"; an empty or missing
+ * list does not restrict. At most "limit" objects are returned after
+ * skipping "offset" matching ones. The second return value is the
+ * offset to ask for the next chunk, or 0 when there are no more.
+ *
+ * Unless properties are projected, a third return value maps the path
+ * of each returned object to a dict of the generations of its property
+ * dicts, by interface name. A generation changes whenever the dict does,
+ * so clients can skip the dicts they have applied already.
+ */
+static dbus_bool_t
+__ni_dbus_object_manager_get_managed_objects_filtered(ni_dbus_object_t *object,
+		const ni_dbus_method_t *method,
+		unsigned int argc, const ni_dbus_variant_t *argv,
+		ni_dbus_message_t *reply,
+		DBusError *error)
+{
+	ni_dbus_variant_t generations = NI_DBUS_VARIANT_INIT;
+	ni_dbus_object_manager_filter_t filter;
+	DBusMessageIter iter;
+	uint32_t next;
+	dbus_bool_t rv = FALSE;
+
+	NI_TRACE_ENTER_ARGS("path=%s, method=%s", object->path, method->name);
+
+	memset(&filter, 0, sizeof(filter));
+	if (argc != 1 || !ni_dbus_variant_is_dict(&argv[0])
+	 || !__ni_dbus_object_manager_filter_strings(&filter.paths, &argv[0], "paths")
+	 || !__ni_dbus_object_manager_filter_strings(&filter.interfaces, &argv[0], "interfaces")
+	 || !__ni_dbus_object_manager_filter_strings(&filter.properties, &argv[0], "properties")) {
+		dbus_set_error(error, DBUS_ERROR_INVALID_ARGS,
+				"%s: bad arguments in call to %s", object->path, method->name);
+		goto out;
+	}
+	ni_dbus_dict_get_uint32(&argv[0], "offset", &filter.offset);
+	ni_dbus_dict_get_uint32(&argv[0], "limit", &filter.limit);
 
+	/* Generations refer to complete property dicts only */
+	if (filter.properties.count == 0) {
+		ni_dbus_variant_init_dict(&generations);
+		filter.generations = &generations;
+	}
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (!__ni_dbus_object_manager_stream_objects(object, &filter, &iter, error))
+		goto out;
+
+	next = filter.next;
+	if (!dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32, &next)) {
+		dbus_set_error(error, DBUS_ERROR_NO_MEMORY, "Error marshalling managed objects");
+		goto out;
+	}
+
+	if (filter.generations
+	 && !ni_dbus_message_serialize_variants(reply, 1, filter.generations, error))
+		goto out;
+
+	ni_debug_dbus("%s: returning %u objects, next offset %u", object->path,
+			filter.count, filter.next);
+	rv = TRUE;
+
+out:
+	ni_dbus_variant_destroy(&generations);
+	ni_string_array_destroy(&filter.paths);
+	ni_string_array_destroy(&filter.interfaces);
+	ni_string_array_destroy(&filter.properties);
 	return rv;
 }
 
 static ni_dbus_method_t	__ni_dbus_object_manager_methods[] = {
 	{ "GetManagedObjects",		NULL,		__ni_dbus_object_manager_get_managed_objects },
+	{ "GetManagedObjectsFiltered",	"a{sv}",	__ni_dbus_object_manager_get_managed_objects_filtered },
 	{ NULL }
 };
 
@@ -505,27 +1005,179 @@ static const ni_dbus_service_t __ni_dbus_object_introspectable_interface = {
 	.methods = __ni_dbus_object_introspectable_methods,
 };
 
+/*
+ * Check an object path against the path prefixes of a filter
+ */
+enum {
+	NI_DBUS_FILTER_PATH_NONE,	/* neither the object nor its children match */
+	NI_DBUS_FILTER_PATH_PARENT,	/* some children may match */
+	NI_DBUS_FILTER_PATH_MATCH,
+};
+
+static int
+__ni_dbus_object_manager_filter_path(const ni_dbus_object_manager_filter_t *filter, const char *path)
+{
+	int result = NI_DBUS_FILTER_PATH_NONE;
+	size_t len = strlen(path);
+	unsigned int i;
+
+	if (filter->paths.count == 0)
+		return NI_DBUS_FILTER_PATH_MATCH;
+
+	for (i = 0; i < filter->paths.count; ++i) {
+		const char *prefix = filter->paths.data[i];
+		size_t plen = strlen(prefix);
+
+		if (plen <= len && !strncmp(path, prefix, plen)
+		 && (path[plen] == '\0' || path[plen] == '/' || (plen && prefix[plen-1] == '/')))
+			return NI_DBUS_FILTER_PATH_MATCH;
+		if (plen > len && !strncmp(path, prefix, len) && prefix[len] == '/')
+			result = NI_DBUS_FILTER_PATH_PARENT;
+	}
+	return result;
+}
+
+/*
+ * Return the generation of the property dict of a service, bumping it
+ * when the marshalled dict differs from the one we returned last time.
+ * Generations are unique across objects and (most likely) across
+ * restarts, so a client can never mistake a new dict for the old one.
+ */
+static uint64_t
+__ni_dbus_object_manager_generation(ni_dbus_object_t *object,
+		const ni_dbus_service_t *service, const ni_dbus_variant_t *propdict)
+{
+	static uint64_t last_generation;
+	DBusError error = DBUS_ERROR_INIT;
+	ni_dbus_generation_t *gen;
+	DBusMessage *msg;
+	char *data = NULL;
+	int len = 0;
+
+	if (!object->server_object)
+		return 0;
+
+	if (last_generation == 0)
+		last_generation = ((uint64_t) (time(NULL) ^ getpid())) << 32;
+
+	msg = dbus_message_new_signal(object->path, service->name, "Properties");
+	if (msg == NULL)
+		return 0;
+	if (!ni_dbus_message_serialize_variants(msg, 1, propdict, &error)
+	 || !dbus_message_marshal(msg, &data, &len)) {
+		dbus_message_unref(msg);
+		dbus_error_free(&error);
+		return 0;
+	}
+	dbus_message_unref(msg);
+
+	gen = ni_dbus_generation_array_get(&object->server_object->generations, service);
+	if (!gen->generation || gen->len != (size_t) len || memcmp(gen->data, data, len)) {
+		gen->generation = ++last_generation;
+		free(gen->data);
+		gen->data = xmalloc(len);
+		memcpy(gen->data, data, len);
+		gen->len = len;
+	}
+	dbus_free(data);
+	return gen->generation;
+}
+
+static dbus_bool_t
+__ni_dbus_object_manager_append_object(ni_dbus_object_t *object,
+		const ni_dbus_object_manager_filter_t *filter,
+		DBusMessageIter *iter, DBusError *error)
+{
+	ni_dbus_variant_t *generations = NULL;
+	ni_dbus_dict_entry_t entry;
+	const ni_dbus_service_t *service;
+	unsigned int i;
+	int rv = TRUE;
+
+	memset(&entry, 0, sizeof(entry));
+	entry.key = object->path;
+	ni_dbus_variant_init_dict(&entry.datum);
+
+	if (filter->generations) {
+		generations = ni_dbus_dict_add(filter->generations, object->path);
+		ni_dbus_variant_init_dict(generations);
+	}
+
+	for (i = 0; rv && (service = object->interfaces[i]) != NULL; ++i) {
+		ni_dbus_variant_t *propdict;
+
+		if (filter->interfaces.count
+		 && ni_string_array_index(&filter->interfaces, service->name) < 0)
+			continue;
+
+		propdict = ni_dbus_dict_add(&entry.datum, service->name);
+		ni_dbus_variant_init_dict(propdict);
+		rv = ni_dbus_object_get_properties_as_dict_projected(object, service,
+					&filter->properties, propdict, error);
+
+		if (rv && generations)
+			ni_dbus_dict_add_uint64(generations, service->name,
+				__ni_dbus_object_manager_generation(object, service, propdict));
+	}
+
+	if (rv && !ni_dbus_message_iter_append_dict_entry(iter, &entry)) {
+		dbus_set_error(error, DBUS_ERROR_FAILED, "Error marshalling object %s", object->path);
+		rv = FALSE;
+	}
+
+	ni_dbus_variant_destroy(&entry.datum);
+	return rv;
+}
+
+static ni_bool_t
+__ni_dbus_object_manager_filter_interfaces(const ni_dbus_object_manager_filter_t *filter,
+		const ni_dbus_object_t *object)
+{
+	const ni_dbus_service_t *service;
+	unsigned int i;
+
+	if (filter->interfaces.count == 0)
+		return TRUE;
+
+	for (i = 0; (service = object->interfaces[i]) != NULL; ++i) {
+		if (ni_string_array_index(&filter->interfaces, service->name) >= 0)
+			return TRUE;
+	}
+	return FALSE;
+}
+
 dbus_bool_t
-__ni_dbus_object_manager_enumerate_object(ni_dbus_object_t *object, ni_dbus_variant_t *obj_dict, DBusError *error)
+__ni_dbus_object_manager_enumerate_object(ni_dbus_object_t *object,
+		ni_dbus_object_manager_filter_t *filter,
+		DBusMessageIter *iter, DBusError *error)
 {
 	ni_dbus_object_t *child;
-	int rv = TRUE;
+	int match, rv = TRUE;
 
-	if (object->interfaces) {
-		ni_dbus_variant_t *ifdict = ni_dbus_dict_add(obj_dict, object->path);
-		const ni_dbus_service_t *service;
-		unsigned int i;
+	match = __ni_dbus_object_manager_filter_path(filter, object->path);
+	if (match == NI_DBUS_FILTER_PATH_NONE)
+		return TRUE;
 
-		ni_dbus_variant_init_dict(ifdict);
-		for (i = 0; rv && (service = object->interfaces[i]) != NULL; ++i) {
-			ni_dbus_variant_t *propdict = ni_dbus_dict_add(ifdict, service->name);
+	if (match == NI_DBUS_FILTER_PATH_MATCH && object->interfaces
+	 && __ni_dbus_object_manager_filter_interfaces(filter, object)) {
+		unsigned int index = filter->index++;
 
-			ni_dbus_variant_init_dict(propdict);
-			rv = ni_dbus_object_get_properties_as_dict(object, service, propdict, error);
+		if (filter->limit && filter->count >= filter->limit) {
+			/* Reply is full, the client asks for the rest */
+			filter->next = index;
+			return TRUE;
+		}
+		if (index >= filter->offset) {
+			if (!__ni_dbus_object_manager_append_object(object, filter, iter, error))
+				return FALSE;
+			filter->count++;
 		}
 	}
 
-	for (child = object->children; child && rv; child = child->next) {
+	for (child = object->children; child && rv && !filter->next; child = child->next) {
+		if (__ni_dbus_object_manager_filter_path(filter, child->path) == NI_DBUS_FILTER_PATH_NONE)
+			continue;
+
 		/* If the object has a refresh function, call it now.
 		 * Note that the server method call handling code will
 		 * already have refreshed the top-level object, so we will
@@ -537,7 +1189,7 @@ __ni_dbus_object_manager_enumerate_object(ni_dbus_object_t *object, ni_dbus_vari
 			continue;
 		}
 
-		rv = __ni_dbus_object_manager_enumerate_object(child, obj_dict, error);
+		rv = __ni_dbus_object_manager_enumerate_object(child, filter, iter, error);
 	}
 
 	return rv;
@@ -567,17 +1219,35 @@ __ni_dbus_object_unregister(DBusConnection *conn, void *user_data)
 
 static DBusHandlerResult
 __ni_dbus_object_message(DBusConnection *conn, DBusMessage *call, void *user_data)
+{
+	ni_dbus_object_t *object = user_data;
+	ni_dbus_server_t *server;
+
+	if (!(server = ni_dbus_object_get_server(object)))
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	return __ni_dbus_object_dispatch(server->connection, call, object);
+}
+
+/*
+ * Dispatch a method call received on the given connection, which is
+ * either the bus connection or a peer connection of the server.
+ * The reply is sent back on the same connection.
+ */
+static DBusHandlerResult
+__ni_dbus_object_dispatch(ni_dbus_connection_t *connection, DBusMessage *call, ni_dbus_object_t *object)
 {
 	const char *interface = dbus_message_get_interface(call);
 	const char *method_name = dbus_message_get_member(call);
-	ni_dbus_object_t *object = user_data;
 	const ni_dbus_method_t *method;
 	DBusError error = DBUS_ERROR_INIT;
 	DBusMessage *reply = NULL;
 	const ni_dbus_service_t *svc;
-	ni_dbus_server_t *server;
+	struct timeval begin;
 	dbus_bool_t rv = FALSE;
 
+	ni_timer_get_time(&begin);
+
 	/* Clean out deceased objects */
 	ni_dbus_objects_garbage_collect();
 
@@ -595,8 +1265,6 @@ __ni_dbus_object_message(DBusConnection *conn, DBusMessage *call, void *user_dat
 		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 	}
 
-	server = ni_dbus_object_get_server(object);
-
 	method = ni_dbus_service_get_method(svc, method_name);
 	if (method == NULL
 	 || (!method->handler && !method->handler_ex && !method->async_handler)) {
@@ -642,7 +1310,8 @@ __ni_dbus_object_message(DBusConnection *conn, DBusMessage *call, void *user_dat
 		if (method->handler_ex) {
 			int err;
 
-			err = ni_dbus_object_get_caller_uid(object, call, &caller_uid);
+			err = ni_dbus_connection_get_caller_uid(connection,
+					dbus_message_get_sender(call), &caller_uid);
 			if (err < 0) {
 				ni_dbus_set_error_from_code(&error, err, "unable to get caller's uid");
 				goto error_reply;
@@ -679,7 +1348,7 @@ __ni_dbus_object_message(DBusConnection *conn, DBusMessage *call, void *user_dat
 				ni_dbus_variant_destroy(&argv[argc]);
 		} else
 		if (method->async_handler) {
-			rv = method->async_handler(server->connection, object, method, call);
+			rv = method->async_handler(connection, object, method, call);
 		} else {
 			dbus_set_error(&error, DBUS_ERROR_FAILED, "No server side handler for method");
 			rv = FALSE;
@@ -696,16 +1365,17 @@ error_reply:
 	}
 
 	/* send reply */
-	if (reply && ni_dbus_connection_send_message(server->connection, reply) < 0)
+	if (reply && ni_dbus_connection_send_message(connection, reply) < 0)
 		ni_error("unable to send reply (out of memory)");
 
+	/* Async handlers are only accounted until they return */
+	ni_dbus_stats_record(NI_DBUS_STATS_SERVER, call, &begin, rv ? NULL : error.name);
+
 	dbus_error_free(&error);
 	if (reply)
 		dbus_message_unref(reply);
 
 	return DBUS_HANDLER_RESULT_HANDLED;
-
-
 }
 
 /*
@@ -741,13 +1411,115 @@ ni_dbus_object_get_caller_uid(const ni_dbus_object_t *object, ni_dbus_message_t
 	return ni_dbus_connection_get_caller_uid(server->connection, dbus_message_get_sender(call), uidp);
 }
 
+/*
+ * Index of the server's objects by their handle. Objects are added when
+ * registered, or when found by a full tree scan; handles changing later
+ * are caught by checking the handle of an index hit.
+ */
+static void
+__ni_dbus_server_unindex_handle(ni_dbus_server_t *server, ni_dbus_server_object_t *sob)
+{
+	ni_dbus_server_object_t **pos, *cur;
+	unsigned int hash;
+
+	if (sob->indexed_handle == NULL || server->handle_index.size == 0)
+		return;
+
+	hash = __ni_dbus_hash_pointer(sob->indexed_handle);
+	pos = &server->handle_index.bucket[hash & (server->handle_index.size - 1)];
+	for ( ; (cur = *pos) != NULL; pos = &cur->handle_next) {
+		if (cur == sob) {
+			*pos = sob->handle_next;
+			server->handle_index.count--;
+			break;
+		}
+	}
+	sob->indexed_handle = NULL;
+	sob->handle_next = NULL;
+}
+
+static void
+__ni_dbus_server_index_insert(ni_dbus_server_t *server, ni_dbus_server_object_t *sob)
+{
+	unsigned int hash = __ni_dbus_hash_pointer(sob->indexed_handle);
+	ni_dbus_server_object_t **head;
+
+	head = &server->handle_index.bucket[hash & (server->handle_index.size - 1)];
+	sob->handle_next = *head;
+	*head = sob;
+	server->handle_index.count++;
+}
+
+static void
+__ni_dbus_server_index_handle(ni_dbus_server_t *server, ni_dbus_object_t *object)
+{
+	ni_dbus_server_object_t *sob = object->server_object;
+
+	if (sob == NULL || sob->server != server || object->handle == NULL)
+		return;
+
+	if (sob->indexed_handle == object->handle)
+		return;
+	__ni_dbus_server_unindex_handle(server, sob);
+
+	if (server->handle_index.count >= 2 * server->handle_index.size) {
+		ni_dbus_server_object_t **old_bucket = server->handle_index.bucket;
+		unsigned int i, old_size = server->handle_index.size;
+
+		server->handle_index.size = old_size ? old_size * 2 : 64;
+		server->handle_index.bucket = xcalloc(server->handle_index.size, sizeof(old_bucket[0]));
+		server->handle_index.count = 0;
+		for (i = 0; i < old_size; ++i) {
+			ni_dbus_server_object_t *cur, *next;
+
+			for (cur = old_bucket[i]; cur; cur = next) {
+				next = cur->handle_next;
+				__ni_dbus_server_index_insert(server, cur);
+			}
+		}
+		free(old_bucket);
+	}
+
+	sob->indexed_handle = object->handle;
+	__ni_dbus_server_index_insert(server, sob);
+}
+
+static ni_bool_t
+__ni_dbus_server_object_is_registered(const ni_dbus_server_t *server, const ni_dbus_object_t *object)
+{
+	while (object->parent)
+		object = object->parent;
+	return object == server->root_object;
+}
+
 /*
  * Find an object given its internal handle
  */
 ni_dbus_object_t *
 ni_dbus_server_find_object_by_handle(ni_dbus_server_t *server, const void *object_handle)
 {
-	return ni_dbus_object_find_descendant_by_handle(server->root_object, object_handle);
+	ni_dbus_server_object_t *sob;
+	ni_dbus_object_t *object;
+
+	if (object_handle == NULL)
+		return NULL;
+
+	if (server->handle_index.size) {
+		unsigned int hash = __ni_dbus_hash_pointer(object_handle);
+
+		sob = server->handle_index.bucket[hash & (server->handle_index.size - 1)];
+		for ( ; sob; sob = sob->handle_next) {
+			object = sob->object;
+			if (sob->indexed_handle == object_handle && object->handle == object_handle
+			 && __ni_dbus_server_object_is_registered(server, object))
+				return object;
+		}
+	}
+
+	object = ni_dbus_object_find_descendant_by_handle(server->root_object, object_handle);
+	if (object)
+		__ni_dbus_server_index_handle(server, object);
+	return object;
 }
 
 /*
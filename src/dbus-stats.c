@@ -0,0 +1,338 @@
+/*
+ *	Latency statistics of dbus method calls
+ *
+ *	Copyright (C) 2014 SUSE LINUX Products GmbH, Nuernberg, Germany.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/time.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/socket.h>
+#include "dbus-common.h"
+#include "util_priv.h"
+
+/*
+ * For every (interface, method) pair, we count the calls and errors
+ * and keep a log-linear latency histogram: values below 8 usec have
+ * their own bucket, above that every power of two is split into
+ * 8 sub-buckets, which bounds the error of any percentile to 12.5%.
+ *
+ * Calls taking longer than a threshold are also recorded in a small
+ * ring of slow call traces, together with their message size.
+ *
+ * All of this is updated from the (single threaded) dispatch loop,
+ * so a call costs a hash lookup and a few increments.
+ */
+#define NI_DBUS_STATS_SUB_BITS		3
+#define NI_DBUS_STATS_SUB_COUNT		(1U << NI_DBUS_STATS_SUB_BITS)
+#define NI_DBUS_STATS_BUCKETS		((32 - NI_DBUS_STATS_SUB_BITS + 1) * NI_DBUS_STATS_SUB_COUNT)
+#define NI_DBUS_STATS_HASH_SIZE		64
+#define NI_DBUS_STATS_SLOW_MAX		64
+#define NI_DBUS_STATS_SLOW_DEFAULT	500	/* msec */
+
+typedef struct ni_dbus_call_stats ni_dbus_call_stats_t;
+struct ni_dbus_call_stats {
+	ni_dbus_call_stats_t *	next;
+	unsigned int		hash;
+	ni_dbus_stats_side_t	side;
+	char *			interface;
+	char *			method;
+
+	uint64_t		count;
+	uint64_t		errors;
+	uint64_t		total_usec;
+	uint64_t		max_usec;
+	uint32_t		histogram[NI_DBUS_STATS_BUCKETS];
+};
+
+typedef struct ni_dbus_slow_call {
+	ni_dbus_stats_side_t	side;
+	struct timeval		time;
+	unsigned long		usec;
+	unsigned int		size;
+	char *			interface;
+	char *			method;
+	char *			path;
+	char *			error;
+} ni_dbus_slow_call_t;
+
+static struct ni_dbus_stats {
+	ni_dbus_call_stats_t *	bucket[NI_DBUS_STATS_HASH_SIZE];
+
+	unsigned long		slow_threshold;		/* usec */
+	unsigned int		slow_count;
+	ni_dbus_slow_call_t	slow[NI_DBUS_STATS_SLOW_MAX];
+} ni_dbus_stats = {
+	.slow_threshold		= NI_DBUS_STATS_SLOW_DEFAULT * 1000UL,
+};
+
+static const char *		ni_dbus_stats_side_names[__NI_DBUS_STATS_SIDE_MAX] = {
+	[NI_DBUS_STATS_SERVER]	= "server",
+	[NI_DBUS_STATS_CLIENT]	= "client",
+};
+
+/*
+ * Map a latency to its histogram bucket and back
+ */
+unsigned int
+ni_dbus_stats_bucket(unsigned long usec)
+{
+	unsigned int exp;
+
+	if (usec >= 0xffffffffUL)
+		return NI_DBUS_STATS_BUCKETS - 1;
+	if (usec < NI_DBUS_STATS_SUB_COUNT)
+		return usec;
+
+	exp = 31 - __builtin_clz((unsigned int) usec);
+	return (exp - NI_DBUS_STATS_SUB_BITS + 1) * NI_DBUS_STATS_SUB_COUNT +
+		((usec >> (exp - NI_DBUS_STATS_SUB_BITS)) & (NI_DBUS_STATS_SUB_COUNT - 1));
+}
+
+unsigned long
+ni_dbus_stats_bucket_usec(unsigned int bucket)
+{
+	unsigned int exp, sub;
+
+	if (bucket < NI_DBUS_STATS_SUB_COUNT)
+		return bucket;
+
+	exp = bucket / NI_DBUS_STATS_SUB_COUNT + NI_DBUS_STATS_SUB_BITS - 1;
+	sub = bucket % NI_DBUS_STATS_SUB_COUNT;
+	return (unsigned long) (NI_DBUS_STATS_SUB_COUNT + sub) << (exp - NI_DBUS_STATS_SUB_BITS);
+}
+
+static unsigned int
+ni_dbus_stats_hash(ni_dbus_stats_side_t side, const char *interface, const char *method)
+{
+	unsigned int hash = NI_DBUS_HASH_INIT ^ side;
+
+	while (*interface)
+		hash = (hash ^ (unsigned char) *interface++) * 16777619U;
+	hash = (hash ^ '.') * 16777619U;
+	while (*method)
+		hash = (hash ^ (unsigned char) *method++) * 16777619U;
+	return hash;
+}
+
+static ni_dbus_call_stats_t *
+ni_dbus_stats_get_entry(ni_dbus_stats_side_t side, const char *interface, const char *method)
+{
+	ni_dbus_call_stats_t **pos, *stats;
+	unsigned int hash;
+
+	hash = ni_dbus_stats_hash(side, interface, method);
+	pos = &ni_dbus_stats.bucket[hash % NI_DBUS_STATS_HASH_SIZE];
+	for (stats = *pos; stats; stats = stats->next) {
+		if (stats->hash == hash && stats->side == side
+		 && !strcmp(stats->method, method)
+		 && !strcmp(stats->interface, interface))
+			return stats;
+	}
+
+	stats = xcalloc(1, sizeof(*stats));
+	stats->hash = hash;
+	stats->side = side;
+	ni_string_dup(&stats->interface, interface);
+	ni_string_dup(&stats->method, method);
+	stats->next = *pos;
+	*pos = stats;
+	return stats;
+}
+
+static void
+ni_dbus_slow_call_destroy(ni_dbus_slow_call_t *slow)
+{
+	ni_string_free(&slow->interface);
+	ni_string_free(&slow->method);
+	ni_string_free(&slow->path);
+	ni_string_free(&slow->error);
+}
+
+static void
+ni_dbus_stats_trace_slow(ni_dbus_stats_side_t side, ni_dbus_message_t *call,
+			const struct timeval *now, unsigned long usec, const char *error)
+{
+	ni_dbus_slow_call_t *slow;
+	char *data = NULL;
+	int len = 0;
+
+	slow = &ni_dbus_stats.slow[ni_dbus_stats.slow_count++ % NI_DBUS_STATS_SLOW_MAX];
+	ni_dbus_slow_call_destroy(slow);
+
+	slow->side = side;
+	slow->time = *now;
+	slow->usec = usec;
+	ni_string_dup(&slow->interface, dbus_message_get_interface(call));
+	ni_string_dup(&slow->method, dbus_message_get_member(call));
+	ni_string_dup(&slow->path, dbus_message_get_path(call));
+	ni_string_dup(&slow->error, error);
+
+	/* There is no call to get the body size; use the marshalled message */
+	if (dbus_message_marshal(call, &data, &len)) {
+		slow->size = len;
+		dbus_free(data);
+	} else {
+		slow->size = 0;
+	}
+
+	ni_debug_dbus("slow %s call %s.%s(%s) took %lu usec, %u bytes",
+			ni_dbus_stats_side_names[side], slow->interface,
+			slow->method, slow->path, usec, slow->size);
+}
+
+/*
+ * Record a call which began at @begin, and failed if @error is set
+ */
+void
+ni_dbus_stats_record(ni_dbus_stats_side_t side, ni_dbus_message_t *call,
+			const struct timeval *begin, const char *error)
+{
+	const char *interface, *method;
+	ni_dbus_call_stats_t *stats;
+	struct timeval now, delta;
+	unsigned long usec;
+
+	if (!(interface = dbus_message_get_interface(call))
+	 || !(method = dbus_message_get_member(call)))
+		return;
+
+	ni_timer_get_time(&now);
+	if (timercmp(&now, begin, <))
+		usec = 0;
+	else {
+		timersub(&now, begin, &delta);
+		usec = delta.tv_sec * 1000000UL + delta.tv_usec;
+	}
+
+	stats = ni_dbus_stats_get_entry(side, interface, method);
+	stats->count++;
+	stats->total_usec += usec;
+	stats->histogram[ni_dbus_stats_bucket(usec)]++;
+	if (usec > stats->max_usec)
+		stats->max_usec = usec;
+	if (error)
+		stats->errors++;
+
+	if (ni_dbus_stats.slow_threshold && usec >= ni_dbus_stats.slow_threshold)
+		ni_dbus_stats_trace_slow(side, call, &now, usec, error);
+}
+
+void
+ni_dbus_stats_set_slow_threshold(unsigned int msec)
+{
+	ni_dbus_stats.slow_threshold = msec * 1000UL;
+}
+
+void
+ni_dbus_stats_reset(void)
+{
+	ni_dbus_call_stats_t *stats;
+	unsigned int i;
+
+	for (i = 0; i < NI_DBUS_STATS_HASH_SIZE; ++i) {
+		while ((stats = ni_dbus_stats.bucket[i]) != NULL) {
+			ni_dbus_stats.bucket[i] = stats->next;
+			ni_string_free(&stats->interface);
+			ni_string_free(&stats->method);
+			free(stats);
+		}
+	}
+
+	for (i = 0; i < NI_DBUS_STATS_SLOW_MAX; ++i)
+		ni_dbus_slow_call_destroy(&ni_dbus_stats.slow[i]);
+	memset(ni_dbus_stats.slow, 0, sizeof(ni_dbus_stats.slow));
+	ni_dbus_stats.slow_count = 0;
+}
+
+/*
+ * Export the statistics as a dict:
+ *	calls:		array of dicts with side, interface, method, count,
+ *			errors, total-usec, max-usec and a histogram array,
+ *			holding the lower bound (usec) and count of all
+ *			non-empty buckets
+ *	slow-calls:	array of dicts describing the slow calls
+ *	slow-threshold:	threshold of slow calls in usec
+ */
+dbus_bool_t
+ni_dbus_stats_get(ni_dbus_variant_t *result)
+{
+	ni_dbus_variant_t *calls, *slow_calls, *dict, *hist, *bucket;
+	ni_dbus_call_stats_t *stats;
+	unsigned int i, n, first;
+
+	ni_dbus_variant_init_dict(result);
+	ni_dbus_dict_add_uint32(result, "slow-threshold", ni_dbus_stats.slow_threshold);
+
+	calls = ni_dbus_dict_add(result, "calls");
+	ni_dbus_dict_array_init(calls);
+	for (i = 0; i < NI_DBUS_STATS_HASH_SIZE; ++i) {
+		for (stats = ni_dbus_stats.bucket[i]; stats; stats = stats->next) {
+			dict = ni_dbus_dict_array_add(calls);
+			ni_dbus_dict_add_string(dict, "side", ni_dbus_stats_side_names[stats->side]);
+			ni_dbus_dict_add_string(dict, "interface", stats->interface);
+			ni_dbus_dict_add_string(dict, "method", stats->method);
+			ni_dbus_dict_add_uint64(dict, "count", stats->count);
+			ni_dbus_dict_add_uint64(dict, "errors", stats->errors);
+			ni_dbus_dict_add_uint64(dict, "total-usec", stats->total_usec);
+			ni_dbus_dict_add_uint64(dict, "max-usec", stats->max_usec);
+
+			hist = ni_dbus_dict_add(dict, "histogram");
+			ni_dbus_dict_array_init(hist);
+			for (n = 0; n < NI_DBUS_STATS_BUCKETS; ++n) {
+				if (!stats->histogram[n])
+					continue;
+				bucket = ni_dbus_dict_array_add(hist);
+				ni_dbus_dict_add_uint32(bucket, "usec", ni_dbus_stats_bucket_usec(n));
+				ni_dbus_dict_add_uint32(bucket, "count", stats->histogram[n]);
+			}
+		}
+	}
+
+	slow_calls = ni_dbus_dict_add(result, "slow-calls");
+	ni_dbus_dict_array_init(slow_calls);
+
+	/* Oldest first */
+	n = ni_dbus_stats.slow_count;
+	first = n > NI_DBUS_STATS_SLOW_MAX ? n - NI_DBUS_STATS_SLOW_MAX : 0;
+	for (i = first; i < n; ++i) {
+		const ni_dbus_slow_call_t *slow = &ni_dbus_stats.slow[i % NI_DBUS_STATS_SLOW_MAX];
+
+		dict = ni_dbus_dict_array_add(slow_calls);
+		ni_dbus_dict_add_string(dict, "side", ni_dbus_stats_side_names[slow->side]);
+		ni_dbus_dict_add_uint64(dict, "time", slow->time.tv_sec);
+		ni_dbus_dict_add_uint64(dict, "usec", slow->usec);
+		ni_dbus_dict_add_uint32(dict, "size", slow->size);
+		ni_dbus_dict_add_string(dict, "interface", slow->interface);
+		ni_dbus_dict_add_string(dict, "method", slow->method);
+		if (slow->path)
+			ni_dbus_dict_add_string(dict, "path", slow->path);
+		if (slow->error)
+			ni_dbus_dict_add_string(dict, "error", slow->error);
+	}
+
+	return TRUE;
+}
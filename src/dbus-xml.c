@@ -23,7 +23,6 @@
 
 static void		ni_dbus_define_scalar_types(ni_xs_scope_t *);
 static void		ni_dbus_define_xml_notations(void);
-static int		ni_dbus_xml_register_classes(ni_xs_scope_t *);
 static ni_dbus_method_t *ni_dbus_xml_register_methods(ni_xs_service_t *, ni_xs_method_t *, const ni_dbus_method_t *);
 
 static dbus_bool_t	ni_dbus_validate_xml(xml_node_t *, const ni_xs_type_t *, const ni_dbus_xml_validate_context_t *);
@@ -80,50 +79,60 @@ ni_dbus_xml_register_services(ni_xs_scope_t *scope)
 	if ((rv = ni_dbus_xml_register_classes(scope)) < 0)
 		return rv;
 
-	for (xs_service = scope->services; xs_service; xs_service = xs_service->next) {
-		ni_dbus_service_t *service;
-		const ni_dbus_class_t *class = NULL;
-		const ni_var_t *attr;
+	for (xs_service = scope->services; xs_service; xs_service = xs_service->next)
+		ni_dbus_xml_register_service(xs_service);
 
-		/* An interface needs to be attached to an object. The object-class
-		 * attribute specifies which object class this can attach to. */
-		if ((attr = ni_var_array_get(&xs_service->attributes, "object-class")) != NULL) {
-			const char *class_name = attr->value;
+	return 0;
+}
 
-			if ((class = ni_objectmodel_get_class(class_name)) == NULL) {
-				ni_error("xml service definition for %s: unknown object-class \"%s\"",
-						xs_service->interface, class_name);
-			}
-		}
+/*
+ * Register or amend the dbus service described by a single schema service
+ */
+const ni_dbus_service_t *
+ni_dbus_xml_register_service(ni_xs_service_t *xs_service)
+{
+	ni_dbus_service_t *service;
+	const ni_dbus_class_t *class = NULL;
+	const ni_var_t *attr;
 
-		service = (ni_dbus_service_t *) ni_objectmodel_service_by_name(xs_service->interface);
-		if (service != NULL) {
-			if (service->compatible == NULL) {
-				service->compatible = class;
-			} else if (class && service->compatible != class) {
-				ni_error("schema definition of interface %s changes class from %s to %s",
-						xs_service->interface,
-						service->compatible->name,
-						class->name);
-			}
-		} else {
-			service = xcalloc(1, sizeof(*service));
-			ni_string_dup(&service->name, xs_service->interface);
-			service->compatible = class;
+	/* An interface needs to be attached to an object. The object-class
+	 * attribute specifies which object class this can attach to. */
+	if ((attr = ni_var_array_get(&xs_service->attributes, "object-class")) != NULL) {
+		const char *class_name = attr->value;
 
-			ni_debug_dbus("register dbus service description %s", service->name);
-			ni_objectmodel_register_service(service);
+		if ((class = ni_objectmodel_get_class(class_name)) == NULL) {
+			ni_error("xml service definition for %s: unknown object-class \"%s\"",
+					xs_service->interface, class_name);
 		}
+	}
 
-		service->schema = xs_service;
+	service = (ni_dbus_service_t *) ni_objectmodel_service_by_name(xs_service->interface);
+	if (service != NULL) {
+		if (service->compatible == NULL) {
+			service->compatible = class;
+		} else if (class && service->compatible != class) {
+			ni_error("schema definition of interface %s changes class from %s to %s",
+					xs_service->interface,
+					service->compatible->name,
+					class->name);
+		}
+	} else {
+		service = xcalloc(1, sizeof(*service));
+		ni_string_dup(&service->name, xs_service->interface);
+		service->compatible = class;
 
-		if (xs_service->methods)
-			service->methods = ni_dbus_xml_register_methods(xs_service, xs_service->methods, service->methods);
-		if (xs_service->signals)
-			service->signals = ni_dbus_xml_register_methods(xs_service, xs_service->signals, service->signals);
+		ni_debug_dbus("register dbus service description %s", service->name);
+		ni_objectmodel_register_service(service);
 	}
 
-	return 0;
+	service->schema = xs_service;
+
+	if (xs_service->methods)
+		service->methods = ni_dbus_xml_register_methods(xs_service, xs_service->methods, service->methods);
+	if (xs_service->signals)
+		service->signals = ni_dbus_xml_register_methods(xs_service, xs_service->signals, service->signals);
+
+	return service;
 }
 
 /*
@@ -71,6 +71,8 @@ ni_fsm_new(void)
 
 	fsm = calloc(1, sizeof(*fsm));
 	fsm->readonly = FALSE;
+	fsm->max_calls_in_flight = NI_FSM_MAX_CALLS_IN_FLIGHT;
+	fsm->bulk_call_min = NI_FSM_BULK_CALL_MIN;
 
 	ni_fsm_user_prompt_fn = ni_fsm_user_prompt_default;
 	return fsm;
@@ -80,6 +82,7 @@ void
 ni_fsm_free(ni_fsm_t *fsm)
 {
 	ni_ifworker_array_destroy(&fsm->workers);
+	free(fsm->call_queue.data);
 	free(fsm);
 }
 
@@ -192,8 +195,11 @@ ni_ifworker_reset(ni_ifworker_t *w)
 	w->target_range.min = NI_FSM_STATE_NONE;
 	w->target_range.max = __NI_FSM_STATE_MAX;
 
+	w->reload.incremental = FALSE;
+	ni_string_array_destroy(&w->reload.changed);
+
 	/* Clear config and stats*/
-	ni_client_state_config_init(&w->config.meta);
+	ni_client_state_config_reset(&w->config.meta);
 
 	ni_ifworker_cancel_timeout(w);
 
@@ -350,6 +356,8 @@ ni_fsm_require_list_insert(ni_fsm_require_t **list, ni_fsm_require_t *req)
 static void
 __ni_ifworker_done(ni_ifworker_t *w)
 {
+	/* Discard the reply of a call still in flight */
+	memset(&w->fsm.call, 0, sizeof(w->fsm.call));
 	w->fsm.action_table = NULL;
 	if (w->completion.callback)
 		w->completion.callback(w);
@@ -1273,6 +1281,7 @@ ni_ifworker_refresh_client_state(ni_ifworker_t *w, ni_client_state_t *cs)
 
 	w->config.meta.uuid = cs->config.uuid;
 	w->config.meta.owner = cs->config.owner;
+	ni_client_state_subtree_array_copy(&w->config.meta.subtrees, &cs->config.subtrees);
 	ni_ifworker_set_config_origin(w, cs->config.origin);
 
 	ni_client_state_debug(w->name, cs, "refresh");
@@ -1288,14 +1297,21 @@ ni_ifworker_generate_uuid(ni_ifworker_t *w)
 
 	uuid = &w->config.meta.uuid;
 	if (!xml_node_is_empty(w->config.node)) {
-		if (ni_ifconfig_generate_uuid(w->config.node, uuid))
+		if (ni_ifconfig_generate_uuid(w->config.node, uuid)) {
+			if (!ni_ifconfig_generate_subtree_uuids(w->config.node,
+						&w->config.meta.subtrees)) {
+				ni_warn("cannot generate subtree uuids for %s config"
+					" - hashing failed", w->name);
+			}
 			return;
+		}
 
 		ni_warn("cannot generate uuid for %s config - hashing failed",
 			w->name);
 	}
 
 	/* Generate a temporary uuid only */
+	ni_client_state_subtree_array_destroy(&w->config.meta.subtrees);
 	ni_uuid_generate(uuid);
 }
 
@@ -2293,7 +2309,7 @@ ni_fsm_mark_matching_workers(ni_fsm_t *fsm, ni_ifworker_array_t *marked, const n
 
 		/* Clean client-info origin and UUID on ifdown */
 		if (marker->target_range.max < NI_FSM_STATE_DEVICE_UP)
-			ni_client_state_config_init(&w->config.meta);
+			ni_client_state_config_reset(&w->config.meta);
 
 		if (marker->persistent)
 			ni_ifworker_control_set_persistent(w, TRUE);
@@ -3461,16 +3477,284 @@ document_error:
 	return -NI_ERROR_DOCUMENT_ERROR;
 }
 
+/*
+ * Incremental reload support.
+ *
+ * The worker is already up and only some top-level nodes of its config
+ * changed. Instead of a full ifdown/ifup cycle, we walk the usual up
+ * transitions, but call only these methods, which have been bound to
+ * a changed node, e.g. the changeDevice of the <ethernet> node or the
+ * requestLease of the <ipv4:static> node.
+ */
+ni_bool_t
+ni_ifworker_set_incremental_reload(ni_ifworker_t *w, const ni_string_array_t *changed)
+{
+	if (!w)
+		return FALSE;
+
+	w->reload.incremental = TRUE;
+	if (changed)
+		ni_string_array_copy(&w->reload.changed, changed);
+	else
+		ni_string_array_destroy(&w->reload.changed);
+	return TRUE;
+}
+
+static ni_bool_t
+ni_ifworker_reload_skip_binding(const ni_ifworker_t *w, const struct ni_fsm_transition_binding *bind)
+{
+	const xml_node_t *node;
+
+	if (!w->reload.incremental || bind->config == w->config.node)
+		return FALSE;
+
+	/* Methods without a config node have nothing to re-apply */
+	for (node = bind->config; node; node = node->parent) {
+		if (node->parent == w->config.node)
+			return ni_string_array_index(&w->reload.changed, node->name) < 0;
+	}
+	return TRUE;
+}
+
+/*
+ * Method calls of the transitions are sent asynchronously, so calls of
+ * independent workers are in flight at the same time. The bindings of
+ * one worker's action are still called one after the other: the reply
+ * only records the result (and the event callbacks to wait for, before
+ * any related signal is processed), ni_fsm_schedule() then continues
+ * with the next binding via ni_ifworker_do_common_resume().
+ */
+typedef struct ni_ifworker_call_ticket {
+	ni_fsm_t *		fsm;
+	ni_ifworker_t *		worker;
+	unsigned int		serial;
+} ni_ifworker_call_ticket_t;
+
+static unsigned int		ni_ifworker_call_serial;
+
+static void
+ni_ifworker_call_reply(int rv, ni_objectmodel_callback_info_t *callback_list, void *user_data)
+{
+	ni_ifworker_call_ticket_t *ticket = user_data;
+	ni_ifworker_t *w = ticket->worker;
+	ni_objectmodel_callback_info_t *cb;
+
+	if (ticket->fsm->calls_in_flight)
+		ticket->fsm->calls_in_flight--;
+
+	if (!w->fsm.call.pending || w->fsm.call.serial != ticket->serial) {
+		ni_debug_application("%s: discarding stale call reply", w->name);
+		while ((cb = callback_list) != NULL) {
+			callback_list = cb->next;
+			ni_objectmodel_callback_info_free(cb);
+		}
+		goto out;
+	}
+
+	w->fsm.call.pending = FALSE;
+	w->fsm.call.done = TRUE;
+	w->fsm.call.rv = rv;
+
+	if (rv >= 0 && callback_list) {
+		ni_fsm_transition_t *action = w->fsm.call.action;
+		struct ni_fsm_transition_binding *bind;
+
+		bind = &action->binding[w->fsm.call.binding - 1];
+		ni_debug_application("%s: adding callback for %s.%s()",
+				w->name, bind->service->name, bind->method->name);
+		ni_ifworker_add_callbacks(action, callback_list, w->name);
+		w->fsm.call.callbacks++;
+	}
+
+out:
+	ni_ifworker_release(w);
+	free(ticket);
+}
+
+static ni_ifworker_call_ticket_t *
+ni_ifworker_call_ticket_new(ni_fsm_t *fsm, ni_ifworker_t *w)
+{
+	ni_ifworker_call_ticket_t *ticket;
+
+	ticket = xcalloc(1, sizeof(*ticket));
+	ticket->fsm = fsm;
+	ticket->worker = ni_ifworker_get(w);
+	ticket->serial = ++ni_ifworker_call_serial;
+	return ticket;
+}
+
+static void
+ni_ifworker_call_ticket_free(ni_ifworker_call_ticket_t *ticket)
+{
+	ni_ifworker_release(ticket->worker);
+	free(ticket);
+}
+
 static int
-ni_ifworker_do_common(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_transition_t *action)
+ni_ifworker_call_async(ni_fsm_t *fsm, ni_ifworker_t *w, struct ni_fsm_transition_binding *bind)
 {
-	unsigned int i, count = 0;
+	ni_ifworker_call_ticket_t *ticket;
 	int rv;
 
-	/* Initially, enable waiting for this action */
-	w->fsm.wait_for = action;
+	ticket = ni_ifworker_call_ticket_new(fsm, w);
+	rv = ni_call_common_xml_async(w->object, bind->service, bind->method, bind->config,
+			ni_ifworker_error_handler, ni_ifworker_call_reply, ticket);
+	if (rv < 0) {
+		ni_ifworker_call_ticket_free(ticket);
+		return rv;
+	}
 
-	for (i = 0; i < action->num_bindings; ++i) {
+	w->fsm.call.serial = ticket->serial;
+	w->fsm.call.pending = TRUE;
+	fsm->calls_in_flight++;
+	return 0;
+}
+
+/*
+ * When many workers run the same transition (e.g. linkUp of a few
+ * hundred VLANs at boot), one method call per device makes the dbus
+ * round trips dominate. Calls of a scheduler pass are therefore queued
+ * and sent by ni_fsm_call_queue_flush(): methods called by at least
+ * fsm->bulk_call_min workers go out as one InterfaceList.callDevices(),
+ * the others as individual asynchronous calls. The per-device results
+ * arrive through the same ticket based ni_ifworker_call_reply().
+ */
+struct ni_fsm_queued_call {
+	ni_ifworker_call_ticket_t *		ticket;
+	struct ni_fsm_transition_binding *	bind;
+};
+
+static ni_bool_t
+ni_ifworker_call_queue(ni_fsm_t *fsm, ni_ifworker_t *w, struct ni_fsm_transition_binding *bind)
+{
+	struct ni_fsm_queued_call *qc;
+
+	if (!fsm->bulk_call_min || !w->object || !w->ifindex)
+		return FALSE;
+
+	/* Queued calls count as in flight; stay within the cap */
+	if (fsm->calls_in_flight >= fsm->max_calls_in_flight)
+		return FALSE;
+
+	if ((fsm->call_queue.count % 16) == 0) {
+		fsm->call_queue.data = xrealloc(fsm->call_queue.data,
+				(fsm->call_queue.count + 16) * sizeof(fsm->call_queue.data[0]));
+	}
+
+	qc = &fsm->call_queue.data[fsm->call_queue.count++];
+	qc->ticket = ni_ifworker_call_ticket_new(fsm, w);
+	qc->bind = bind;
+
+	w->fsm.call.serial = qc->ticket->serial;
+	w->fsm.call.pending = TRUE;
+	fsm->calls_in_flight++;
+	return TRUE;
+}
+
+/*
+ * Send the queued calls. Returns the number of calls that failed to
+ * be sent; their workers are ready to continue in the next pass.
+ */
+static unsigned int
+ni_fsm_call_queue_flush(ni_fsm_t *fsm)
+{
+	unsigned int i, j, count, nfailed = 0;
+	struct ni_fsm_queued_call *queue;
+
+	queue = fsm->call_queue.data;
+	count = fsm->call_queue.count;
+	fsm->call_queue.data = NULL;
+	fsm->call_queue.count = 0;
+
+	for (i = 0; i < count; ++i) {
+		struct ni_fsm_transition_binding *bind;
+		unsigned int nsame = 0;
+		ni_call_bulk_t *bulk;
+
+		if (!queue[i].ticket)
+			continue;
+
+		bind = queue[i].bind;
+		for (j = i; j < count; ++j) {
+			if (queue[j].ticket && queue[j].bind->service == bind->service
+			 && queue[j].bind->method == bind->method)
+				nsame++;
+		}
+
+		if (nsame < fsm->bulk_call_min
+		 || !(bulk = ni_call_bulk_new(bind->service, bind->method))) {
+			ni_ifworker_call_ticket_t *ticket = queue[i].ticket;
+			ni_ifworker_t *w = ticket->worker;
+			int rv;
+
+			queue[i].ticket = NULL;
+			rv = ni_call_common_xml_async(w->object, bind->service, bind->method,
+					bind->config, ni_ifworker_error_handler,
+					ni_ifworker_call_reply, ticket);
+			if (rv < 0) {
+				ni_ifworker_call_reply(rv, NULL, ticket);
+				nfailed++;
+			}
+			continue;
+		}
+
+		ni_debug_application("calling %s.%s() on %u devices in bulk",
+				bind->service->name, bind->method->name, nsame);
+		for (j = i; j < count; ++j) {
+			ni_ifworker_call_ticket_t *ticket = queue[j].ticket;
+			struct ni_fsm_transition_binding *other = queue[j].bind;
+			ni_ifworker_t *w;
+
+			if (!ticket || other->service != bind->service
+			 || other->method != bind->method)
+				continue;
+
+			queue[j].ticket = NULL;
+			w = ticket->worker;
+			if (ni_call_bulk_add(bulk, w->object, w->ifindex, other->config,
+					ni_ifworker_error_handler, ni_ifworker_call_reply,
+					ticket) < 0) {
+				ni_ifworker_call_reply(-NI_ERROR_INVALID_ARGS, NULL, ticket);
+				nfailed++;
+			}
+		}
+		ni_call_bulk_send(bulk);
+	}
+
+	free(queue);
+	return nfailed;
+}
+
+/*
+ * Handle the result of a binding call. Returns < 0 on failure, 1 when
+ * the action is done (ignored failure), 0 to continue.
+ */
+static int
+ni_ifworker_do_common_result(ni_ifworker_t *w, ni_fsm_transition_t *action,
+				struct ni_fsm_transition_binding *bind, int rv)
+{
+	if (rv >= 0)
+		return 0;
+
+	memset(&w->fsm.call, 0, sizeof(w->fsm.call));
+	if (action->common.may_fail) {
+		ni_error("[ignored] %s: call to %s.%s() failed: %s", w->name,
+				bind->service->name, bind->method->name, ni_strerror(rv));
+		ni_ifworker_set_state(w, action->next_state);
+		return 1;
+	}
+	ni_ifworker_fail(w, "call to %s.%s() failed: %s",
+			bind->service->name, bind->method->name, ni_strerror(rv));
+	return rv;
+}
+
+static int
+ni_ifworker_do_common_next(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_transition_t *action)
+{
+	unsigned int i;
+	int rv;
+
+	for (i = w->fsm.call.binding; i < action->num_bindings; ++i) {
 		struct ni_fsm_transition_binding *bind = &action->binding[i];
 		ni_objectmodel_callback_info_t *callback_list = NULL;
 
@@ -3480,34 +3764,42 @@ ni_ifworker_do_common(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_transition_t *acti
 		if (bind->skip_call)
 			continue;
 
+		if (ni_ifworker_reload_skip_binding(w, bind)) {
+			ni_debug_application("%s: config unchanged, skipping %s.%s()",
+				w->name, bind->service->name, bind->method->name);
+			continue;
+		}
+
 		ni_debug_application("%s: calling %s.%s()",
 				w->name, bind->service->name, bind->method->name);
 
-		rv = ni_call_common_xml(w->object, bind->service, bind->method, bind->config,
-				&callback_list, ni_ifworker_error_handler);
-		if (rv < 0) {
-			if (action->common.may_fail) {
-				ni_error("[ignored] %s: call to %s.%s() failed: %s", w->name,
-						bind->service->name, bind->method->name, ni_strerror(rv));
-				ni_ifworker_set_state(w, action->next_state);
+		w->fsm.call.binding = i + 1;
+		if (fsm->max_calls_in_flight && ni_ifworker_call_queue(fsm, w, bind))
+			return 0;
+
+		if (fsm->calls_in_flight < fsm->max_calls_in_flight) {
+			if ((rv = ni_ifworker_call_async(fsm, w, bind)) == 0)
 				return 0;
-			}
-			ni_ifworker_fail(w, "call to %s.%s() failed: %s",
-					bind->service->name, bind->method->name, ni_strerror(rv));
-			return rv;
+		} else {
+			rv = ni_call_common_xml(w->object, bind->service, bind->method, bind->config,
+					&callback_list, ni_ifworker_error_handler);
 		}
 
+		if ((rv = ni_ifworker_do_common_result(w, action, bind, rv)) != 0)
+			return rv < 0 ? rv : 0;
+
 		if (callback_list) {
 			ni_debug_application("%s: adding callback for %s.%s()",
 					w->name, bind->service->name, bind->method->name);
 			ni_ifworker_add_callbacks(action, callback_list, w->name);
-			count++;
+			w->fsm.call.callbacks++;
 		}
 	}
 
 	/* Reset wait_for this action if there are no callbacks */
-	if (count == 0)
+	if (w->fsm.call.callbacks == 0 && w->fsm.wait_for == action)
 		w->fsm.wait_for = NULL;
+	memset(&w->fsm.call, 0, sizeof(w->fsm.call));
 
 	if (w->fsm.wait_for != NULL)
 		return 0;
@@ -3516,6 +3808,36 @@ ni_ifworker_do_common(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_transition_t *acti
 	return 0;
 }
 
+/*
+ * Continue the current action after the reply of its call arrived
+ */
+static int
+ni_ifworker_do_common_resume(ni_fsm_t *fsm, ni_ifworker_t *w)
+{
+	ni_fsm_transition_t *action = w->fsm.call.action;
+	struct ni_fsm_transition_binding *bind;
+	int rv;
+
+	w->fsm.call.done = FALSE;
+	bind = &action->binding[w->fsm.call.binding - 1];
+	if ((rv = ni_ifworker_do_common_result(w, action, bind, w->fsm.call.rv)) != 0)
+		return rv < 0 ? rv : 0;
+
+	return ni_ifworker_do_common_next(fsm, w, action);
+}
+
+static int
+ni_ifworker_do_common(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_transition_t *action)
+{
+	/* Initially, enable waiting for this action */
+	w->fsm.wait_for = action;
+
+	memset(&w->fsm.call, 0, sizeof(w->fsm.call));
+	w->fsm.call.action = action;
+
+	return ni_ifworker_do_common_next(fsm, w, action);
+}
+
 /*
  * Finite state machine - create the device if it does not exist
  * Typically, this will create just the bare interface, like a bridge
@@ -3820,6 +4142,20 @@ ni_fsm_schedule(ni_fsm_t *fsm)
 				continue;
 			}
 
+			/* Wait for the reply of the call in flight */
+			if (w->fsm.call.pending)
+				continue;
+
+			if (w->fsm.call.done) {
+				if (ni_ifworker_do_common_resume(fsm, w) < 0 && !w->failed)
+					ni_ifworker_fail(w, "failed to transition from %s to %s",
+						ni_ifworker_state_name(w->fsm.state),
+						ni_ifworker_state_name(w->fsm.call.action ?
+							w->fsm.call.action->next_state : w->target_state));
+				made_progress = 1;
+				continue;
+			}
+
 			if (!w->kickstarted) {
 				if (!ni_ifworker_device_bound(w))
 					ni_ifworker_set_state(w, NI_FSM_STATE_DEVICE_DOWN);
@@ -3897,8 +4233,13 @@ ni_fsm_schedule(ni_fsm_t *fsm)
 			}
 		}
 
-		if (!made_progress)
+		if (!made_progress) {
+			/* Send the calls queued in this pass; workers whose
+			 * call could not be sent need another pass. */
+			if (ni_fsm_call_queue_flush(fsm))
+				continue;
 			break;
+		}
 
 		/* If all the requested workers are done (eg because they failed)
 		 * do not wait for any of the subordinate device which might still be
@@ -71,6 +71,7 @@
 #include "appconfig.h"
 #include "process.h"
 #include "debug.h"
+#include "util_priv.h"
 
 static int	__ni_netdev_update_addrs(ni_netdev_t *dev,
 				const ni_addrconf_lease_t *old_lease,
@@ -1970,15 +1971,11 @@ __ni_netdev_address_list_contains(ni_address_t *list, const ni_address_t *ap)
 	return 0;
 }
 
-static int
-__ni_rtnl_send_newaddr(ni_netdev_t *dev, const ni_address_t *ap, int flags)
+static struct nl_msg *
+__ni_rtnl_newaddr_msg(ni_netdev_t *dev, const ni_address_t *ap, int flags)
 {
 	struct ifaddrmsg ifa;
 	struct nl_msg *msg;
-	int err;
-
-	ni_debug_ifconfig("%s(%s/%u)", __FUNCTION__,
-			ni_sockaddr_print(&ap->local_addr), ap->prefixlen);
 
 	memset(&ifa, 0, sizeof(ifa));
 	ifa.ifa_index = dev->link.ifindex;
@@ -2054,21 +2051,82 @@ __ni_rtnl_send_newaddr(ni_netdev_t *dev, const ni_address_t *ap, int flags)
 			goto nla_put_failure;
 	}
 
+	return msg;
+
+nla_put_failure:
+	ni_error("failed to encode netlink attr");
+failed:
+	nlmsg_free(msg);
+	return NULL;
+}
+
+static int
+__ni_rtnl_send_newaddr(ni_netdev_t *dev, const ni_address_t *ap, int flags)
+{
+	struct nl_msg *msg;
+	int err;
+
+	ni_debug_ifconfig("%s(%s/%u)", __FUNCTION__,
+			ni_sockaddr_print(&ap->local_addr), ap->prefixlen);
+
+	if (!(msg = __ni_rtnl_newaddr_msg(dev, ap, flags)))
+		return -1;
+
 	if ((err = ni_nl_talk(msg, NULL)) && abs(err) != NLE_EXIST) {
 		ni_error("%s(%s/%u): ni_nl_talk failed [%s]", __func__,
 				ni_sockaddr_print(&ap->local_addr),
 				ap->prefixlen,  nl_geterror(err));
-		goto failed;
+		nlmsg_free(msg);
+		return -1;
 	}
 
 	nlmsg_free(msg);
 	return 0;
+}
 
-nla_put_failure:
-	ni_error("failed to encode netlink attr");
-failed:
-	nlmsg_free(msg);
-	return -1;
+/*
+ * Refresh the lifetimes of existing IPv6 addresses of a device, e.g.
+ * after a dhcp6 renew, with one batch of netlink requests.
+ */
+int
+ni_system_ipv6_addrs_update_lifetimes(ni_netdev_t *dev, const ni_address_t *list)
+{
+	struct nl_msg **msgs;
+	const ni_address_t *ap;
+	unsigned int i, count;
+	int err = 0;
+
+	for (count = 0, ap = list; ap; ap = ap->next)
+		count++;
+	if (!dev || !count)
+		return 0;
+
+	msgs = xcalloc(count, sizeof(msgs[0]));
+	for (i = 0, ap = list; ap; ap = ap->next, ++i) {
+		if (ap->family != AF_INET6
+		 || !(msgs[i] = __ni_rtnl_newaddr_msg(dev, ap, NLM_F_REPLACE))) {
+			err = -1;
+			goto cleanup;
+		}
+		ni_debug_ifconfig("%s: updating lifetimes of %s/%u: preferred %u, valid %u",
+				dev->name, ni_sockaddr_print(&ap->local_addr), ap->prefixlen,
+				ap->ipv6_cache_info.preferred_lft,
+				ap->ipv6_cache_info.valid_lft);
+	}
+
+	if ((err = ni_nl_talk_batch(msgs, count)) < 0) {
+		ni_error("%s: unable to update address lifetimes [%s]",
+				dev->name, nl_geterror(err));
+		err = -1;
+	}
+
+cleanup:
+	for (i = 0; i < count; ++i) {
+		if (msgs[i])
+			nlmsg_free(msgs[i]);
+	}
+	free(msgs);
+	return err;
 }
 
 static int
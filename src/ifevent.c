@@ -26,6 +26,7 @@
 #include "sysfs.h"
 #include "kernel.h"
 #include "appconfig.h"
+#include "netif-snapshot.h"
 
 /* RFC 5006, RFC 6106 */
 #if defined(ND_OPT_RDNSS_INFORMATION)
@@ -608,6 +609,7 @@ __ni_rtevent_process_cb(struct nl_msg *msg, void *ptr)
 		return NL_SKIP;
 	}
 
+	ni_netif_snapshot_changed();
 	return NL_OK;
 }
 
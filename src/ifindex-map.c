@@ -0,0 +1,161 @@
+/*
+ *	Index of addrconf supplicant devices by interface index
+ *
+ *	Copyright (C) 2014 SUSE LINUX Products GmbH, Nuernberg, Germany.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include <wicked/util.h>
+
+#include "ifindex-map.h"
+#include "util_priv.h"
+
+#define NI_IFINDEX_MAP_MIN	16
+
+struct ni_ifindex_map_entry {
+	ni_ifindex_map_entry_t *	next;
+	unsigned int			ifindex;
+	void *				data;
+};
+
+/*
+ * Interface indexes are allocated sequentially by the kernel, so
+ * the low bits distribute them evenly over the buckets.
+ */
+static inline ni_ifindex_map_entry_t **
+__ni_ifindex_map_bucket(const ni_ifindex_map_t *map, unsigned int ifindex)
+{
+	return &map->bucket[ifindex & (map->size - 1)];
+}
+
+static void
+__ni_ifindex_map_grow(ni_ifindex_map_t *map)
+{
+	ni_ifindex_map_entry_t **old_bucket = map->bucket;
+	ni_ifindex_map_entry_t *entry, *next, **head;
+	unsigned int i, old_size = map->size;
+
+	map->size = old_size ? old_size * 2 : NI_IFINDEX_MAP_MIN;
+	map->bucket = xcalloc(map->size, sizeof(map->bucket[0]));
+
+	for (i = 0; i < old_size; ++i) {
+		for (entry = old_bucket[i]; entry; entry = next) {
+			next = entry->next;
+			head = __ni_ifindex_map_bucket(map, entry->ifindex);
+			entry->next = *head;
+			*head = entry;
+		}
+	}
+	free(old_bucket);
+}
+
+void
+ni_ifindex_map_destroy(ni_ifindex_map_t *map)
+{
+	ni_ifindex_map_entry_t *entry;
+	unsigned int i;
+
+	for (i = 0; i < map->size; ++i) {
+		while ((entry = map->bucket[i]) != NULL) {
+			map->bucket[i] = entry->next;
+			free(entry);
+		}
+	}
+	free(map->bucket);
+	map->bucket = NULL;
+	map->size = 0;
+	map->count = 0;
+}
+
+/*
+ * Map the interface index to data, replacing a previous mapping
+ */
+void
+ni_ifindex_map_set(ni_ifindex_map_t *map, unsigned int ifindex, void *data)
+{
+	ni_ifindex_map_entry_t *entry, **head;
+
+	if (map->size) {
+		for (entry = *__ni_ifindex_map_bucket(map, ifindex); entry; entry = entry->next) {
+			if (entry->ifindex == ifindex) {
+				entry->data = data;
+				return;
+			}
+		}
+	}
+
+	if (map->count >= map->size)
+		__ni_ifindex_map_grow(map);
+
+	entry = xcalloc(1, sizeof(*entry));
+	entry->ifindex = ifindex;
+	entry->data = data;
+
+	head = __ni_ifindex_map_bucket(map, ifindex);
+	entry->next = *head;
+	*head = entry;
+	map->count++;
+}
+
+void *
+ni_ifindex_map_get(const ni_ifindex_map_t *map, unsigned int ifindex)
+{
+	ni_ifindex_map_entry_t *entry;
+
+	if (!map->size)
+		return NULL;
+
+	for (entry = *__ni_ifindex_map_bucket(map, ifindex); entry; entry = entry->next) {
+		if (entry->ifindex == ifindex)
+			return entry->data;
+	}
+	return NULL;
+}
+
+/*
+ * Remove the mapping of the interface index, when it maps to data
+ * or data is NULL. Returns the data of the removed mapping.
+ */
+void *
+ni_ifindex_map_remove(ni_ifindex_map_t *map, unsigned int ifindex, const void *data)
+{
+	ni_ifindex_map_entry_t *entry, **pos;
+	void *old;
+
+	if (!map->size)
+		return NULL;
+
+	for (pos = __ni_ifindex_map_bucket(map, ifindex); (entry = *pos); pos = &entry->next) {
+		if (entry->ifindex != ifindex)
+			continue;
+		if (data && entry->data != data)
+			return NULL;
+
+		*pos = entry->next;
+		old = entry->data;
+		free(entry);
+		map->count--;
+		return old;
+	}
+	return NULL;
+}
@@ -0,0 +1,46 @@
+/*
+ *	Index of addrconf supplicant devices by interface index
+ *
+ *	Copyright (C) 2014 SUSE LINUX Products GmbH, Nuernberg, Germany.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ *
+ */
+#ifndef __WICKED_IFINDEX_MAP_H__
+#define __WICKED_IFINDEX_MAP_H__
+
+#include <wicked/types.h>
+
+/*
+ * The supplicants look up their device for every netlink event and
+ * dbus call by interface index; this maps the index to the device.
+ * The dbus object path of a device is derived from the index, too.
+ * A zeroed map is empty and ready to use.
+ */
+typedef struct ni_ifindex_map_entry	ni_ifindex_map_entry_t;
+
+typedef struct ni_ifindex_map {
+	ni_ifindex_map_entry_t **	bucket;
+	unsigned int			size;	/* power of 2 */
+	unsigned int			count;
+} ni_ifindex_map_t;
+
+extern void		ni_ifindex_map_destroy(ni_ifindex_map_t *);
+extern void		ni_ifindex_map_set(ni_ifindex_map_t *, unsigned int, void *);
+extern void *		ni_ifindex_map_get(const ni_ifindex_map_t *, unsigned int);
+extern void *		ni_ifindex_map_remove(ni_ifindex_map_t *, unsigned int, const void *);
+
+#endif /* __WICKED_IFINDEX_MAP_H__ */
@@ -53,6 +53,7 @@
 #include "sysfs.h"
 #include "kernel.h"
 #include "appconfig.h"
+#include "netif-snapshot.h"
 
 
 static int		__ni_process_ifinfomsg(ni_linkinfo_t *link, struct nlmsghdr *h,
@@ -539,6 +540,7 @@ __ni_system_refresh_interface_addrs(ni_netconfig_t *nc, ni_netdev_t *dev)
 			ni_error("Problem parsing RTM_NEWADDR message for %s", dev->name);
 	}
 
+	ni_netif_snapshot_changed();
 	res = 0;
 
 failed:
@@ -575,6 +577,7 @@ __ni_system_refresh_interface_routes(ni_netconfig_t *nc, ni_netdev_t *dev)
 			ni_error("Problem parsing RTM_NEWROUTE message");
 	}
 
+	ni_netif_snapshot_changed();
 	res = 0;
 
 failed:
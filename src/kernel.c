@@ -497,6 +497,82 @@ __ni_nl_talk(ni_netlink_t *nl, struct nl_msg *msg,
 	return err;
 }
 
+/*
+ * Send several requests at once, before we wait for their replies,
+ * instead of one round trip per request. Returns the first error
+ * reported for any of them.
+ */
+struct __ni_nl_batch_state {
+	unsigned int		replies;
+	int			error;
+};
+
+static int
+__ni_nl_batch_ack_handler(struct nl_msg *msg, void *arg)
+{
+	struct __ni_nl_batch_state *state = arg;
+
+	state->replies++;
+	return NL_OK;
+}
+
+static int
+__ni_nl_batch_error_handler(struct sockaddr_nl *sender, struct nlmsgerr *err, void *arg)
+{
+	struct __ni_nl_batch_state *state = arg;
+
+	ni_debug_ifconfig("netlink reports error %d", err->error);
+	state->replies++;
+	if (state->error == 0)
+		state->error = -nl_syserr2nlerr(err->error);
+	return NL_OK;
+}
+
+int
+ni_nl_talk_batch(struct nl_msg **msgs, unsigned int count)
+{
+	struct __ni_nl_batch_state state = { 0, 0 };
+	struct nl_sock *nl_sock;
+	struct nl_cb *cb;
+	unsigned int sent;
+	int err = 0;
+
+	if (!__ni_global_netlink || !(nl_sock = __ni_global_netlink->nl_sock)) {
+		ni_error("%s: no netlink socket", __func__);
+		return -NLE_BAD_SOCK;
+	}
+
+	/* Get the callback first, so nothing is sent whose acks we
+	 * could not consume */
+	if (!(cb = __ni_nl_cb_clone(__ni_global_netlink)))
+		return -NLE_NOMEM;
+
+	nl_cb_err(cb, NL_CB_CUSTOM, __ni_nl_batch_error_handler, &state);
+	nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, __ni_nl_batch_ack_handler, &state);
+
+	for (sent = 0; sent < count; ++sent) {
+		if ((err = nl_send_auto(nl_sock, msgs[sent])) < 0) {
+			ni_error("%s: unable to send: %s", __func__, nl_geterror(err));
+			break;
+		}
+		err = 0;
+	}
+
+	while (state.replies < sent) {
+		int rv;
+
+		if ((rv = nl_recvmsgs(nl_sock, cb)) < 0) {
+			ni_debug_socket("%s: recv failed: %s", __func__, nl_geterror(rv));
+			if (err == 0)
+				err = rv;
+			break;
+		}
+	}
+
+	nl_cb_put(cb);
+	return err ? err : state.error;
+}
+
 /*
  * Helper functions for storing all netlink responses in a list
  */
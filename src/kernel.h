@@ -85,6 +85,7 @@ struct ni_nlmsg_list {
 };
 
 extern int	ni_nl_talk(struct nl_msg *, struct ni_nlmsg_list *);
+extern int	ni_nl_talk_batch(struct nl_msg **, unsigned int);
 extern int	ni_nl_dump_store(int af, int type, struct ni_nlmsg_list *list);
 
 extern void	ni_nlmsg_list_init(struct ni_nlmsg_list *);
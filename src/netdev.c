@@ -36,6 +36,7 @@
 #include "netinfo_priv.h"
 #include "util_priv.h"
 #include "appconfig.h"
+#include "netif-snapshot.h"
 
 /*
  * Constructor for network interface.
@@ -519,6 +520,7 @@ ni_netdev_set_client_state(ni_netdev_t *dev, ni_client_state_t *client_state)
 		ni_client_state_free(dev->client_state);
 
 	dev->client_state = client_state;
+	ni_netif_snapshot_changed();
 }
 
 ni_client_state_t *
@@ -543,9 +545,11 @@ ni_netdev_load_client_state(ni_netdev_t *dev)
 		ni_netdev_set_client_state(dev, ni_client_state_clone(&cs));
 		ni_debug_ifconfig("loading %s structure from a file for %s",
 			NI_CLIENT_STATE_XML_NODE, dev->name);
+		ni_client_state_reset(&cs);
 		return TRUE;
 	}
 
+	ni_client_state_reset(&cs);
 	return FALSE;
 }
 
@@ -684,6 +688,7 @@ ni_netdev_set_lease(ni_netdev_t *dev, ni_addrconf_lease_t *lease)
 		;
 
 	*pos = lease;
+	ni_netif_snapshot_changed();
 	return 0;
 }
 
@@ -692,8 +697,10 @@ ni_netdev_unset_lease(ni_netdev_t *dev, unsigned int family, ni_addrconf_mode_t
 {
 	ni_addrconf_lease_t *lease;
 
-	if ((lease = __ni_netdev_find_lease(dev, family, type, 1)) != NULL)
+	if ((lease = __ni_netdev_find_lease(dev, family, type, 1)) != NULL) {
 		ni_addrconf_lease_free(lease);
+		ni_netif_snapshot_changed();
+	}
 	return 0;
 }
 
@@ -0,0 +1,568 @@
+/*
+ *	Read-only shared memory snapshot of the wickedd interface state
+ *
+ *	Copyright (C) 2014 SUSE LINUX Products GmbH, Nuernberg, Germany.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <errno.h>
+#include <time.h>
+
+#include <wicked/netinfo.h>
+#include <wicked/addrconf.h>
+#include <wicked/logging.h>
+#include <wicked/socket.h>
+#include <wicked/route.h>
+#include <wicked/vlan.h>
+#include <wicked/bonding.h>
+
+#include "netinfo_priv.h"
+#include "client/client_state.h"
+#include "netif-snapshot.h"
+#include "util_priv.h"
+
+#define NI_NETIF_SNAPSHOT_MIN_CAPACITY	64
+#define NI_NETIF_SNAPSHOT_DELAY		10	/* msec to coalesce changes */
+#define NI_NETIF_SNAPSHOT_READ_RETRIES	1000
+#define NI_NETIF_SNAPSHOT_REOPEN_RETRIES 3
+
+static struct ni_netif_snapshot_writer {
+	char *				path;
+	int				fd;
+	ni_netif_snapshot_header_t *	hdr;
+	size_t				size;
+	const ni_timer_t *		timer;
+} __ni_netif_snapshot = { .fd = -1 };
+
+static inline size_t
+__ni_netif_snapshot_size(unsigned int capacity)
+{
+	return sizeof(ni_netif_snapshot_header_t) +
+		capacity * sizeof(ni_netif_snapshot_netif_t);
+}
+
+static inline ni_netif_snapshot_netif_t *
+__ni_netif_snapshot_records(const ni_netif_snapshot_header_t *hdr)
+{
+	return (ni_netif_snapshot_netif_t *) (hdr + 1);
+}
+
+static inline void
+__ni_netif_snapshot_strcpy(char *dst, const char *src, size_t size)
+{
+	if (src)
+		snprintf(dst, size, "%s", src);
+}
+
+static void
+__ni_netif_snapshot_pack_addr(unsigned char *data, const ni_sockaddr_t *sa)
+{
+	if (sa->ss_family == AF_INET)
+		memcpy(data, &sa->sin.sin_addr, sizeof(sa->sin.sin_addr));
+	else
+	if (sa->ss_family == AF_INET6)
+		memcpy(data, &sa->six.sin6_addr, sizeof(sa->six.sin6_addr));
+}
+
+static void
+__ni_netif_snapshot_unpack_addr(ni_sockaddr_t *sa, unsigned int family, const unsigned char *data)
+{
+	struct in_addr ipv4;
+	struct in6_addr ipv6;
+
+	memset(sa, 0, sizeof(*sa));
+	if (family == AF_INET) {
+		memcpy(&ipv4, data, sizeof(ipv4));
+		ni_sockaddr_set_ipv4(sa, ipv4, 0);
+	} else
+	if (family == AF_INET6) {
+		memcpy(&ipv6, data, sizeof(ipv6));
+		ni_sockaddr_set_ipv6(sa, ipv6, 0);
+	}
+}
+
+/*
+ * Copy the state of a netdev into its snapshot record
+ */
+static void
+__ni_netif_snapshot_fill_netif(ni_netif_snapshot_netif_t *rec, const ni_netdev_t *dev)
+{
+	const ni_client_state_t *cs = dev->client_state;
+	const ni_addrconf_lease_t *lease;
+	const ni_route_table_t *tab;
+	const ni_address_t *ap;
+	unsigned int i;
+
+	memset(rec, 0, sizeof(*rec));
+	rec->ifindex = dev->link.ifindex;
+	rec->ifflags = dev->link.ifflags;
+	rec->type = dev->link.type;
+	rec->mtu = dev->link.mtu;
+	rec->hwaddr = dev->link.hwaddr;
+	__ni_netif_snapshot_strcpy(rec->name, dev->name, sizeof(rec->name));
+	__ni_netif_snapshot_strcpy(rec->alias, dev->link.alias, sizeof(rec->alias));
+	__ni_netif_snapshot_strcpy(rec->lowerdev, dev->link.lowerdev.name, sizeof(rec->lowerdev));
+	__ni_netif_snapshot_strcpy(rec->masterdev, dev->link.masterdev.name, sizeof(rec->masterdev));
+	if (dev->vlan) {
+		rec->vlan_tag = dev->vlan->tag;
+		rec->vlan_protocol = dev->vlan->protocol;
+	}
+	if (dev->bonding)
+		rec->bonding_mode = dev->bonding->mode;
+
+	if (cs) {
+		rec->has_client_state = 1;
+		rec->persistent = cs->control.persistent;
+		rec->usercontrol = cs->control.usercontrol;
+		rec->config_uuid = cs->config.uuid;
+		__ni_netif_snapshot_strcpy(rec->config_origin, cs->config.origin, sizeof(rec->config_origin));
+	}
+
+	for (ap = dev->addrs; ap && rec->naddrs < NI_NETIF_SNAPSHOT_MAX_ADDRS; ap = ap->next) {
+		ni_netif_snapshot_addr_t *sa = &rec->addrs[rec->naddrs++];
+
+		sa->family = ap->family;
+		sa->prefixlen = ap->prefixlen;
+		sa->flags = ap->flags;
+		sa->valid_lft = ap->ipv6_cache_info.valid_lft;
+		sa->preferred_lft = ap->ipv6_cache_info.preferred_lft;
+		__ni_netif_snapshot_pack_addr(sa->local, &ap->local_addr);
+		__ni_netif_snapshot_strcpy(sa->label, ap->label, sizeof(sa->label));
+	}
+
+	for (tab = dev->routes; tab; tab = tab->next) {
+		for (i = 0; i < tab->routes.count; ++i) {
+			const ni_route_t *rp = tab->routes.data[i];
+			ni_netif_snapshot_route_t *sr;
+
+			if (rec->nroutes >= NI_NETIF_SNAPSHOT_MAX_ROUTES)
+				break;
+
+			sr = &rec->routes[rec->nroutes++];
+			sr->family = rp->family;
+			sr->prefixlen = rp->prefixlen;
+			sr->type = rp->type;
+			sr->scope = rp->scope;
+			sr->protocol = rp->protocol;
+			sr->table = rp->table;
+			sr->priority = rp->priority;
+			__ni_netif_snapshot_pack_addr(sr->destination, &rp->destination);
+			__ni_netif_snapshot_pack_addr(sr->gateway, &rp->nh.gateway);
+		}
+	}
+
+	for (lease = dev->leases; lease && rec->nleases < NI_NETIF_SNAPSHOT_MAX_LEASES; lease = lease->next) {
+		ni_netif_snapshot_lease_t *sl = &rec->leases[rec->nleases++];
+
+		sl->family = lease->family;
+		sl->type = lease->type;
+		sl->state = lease->state;
+		sl->flags = lease->flags;
+	}
+}
+
+/*
+ * Copy all interfaces into the snapshot records
+ */
+static void
+__ni_netif_snapshot_fill(ni_netif_snapshot_header_t *hdr, ni_netconfig_t *nc)
+{
+	ni_netif_snapshot_netif_t *records = __ni_netif_snapshot_records(hdr);
+	ni_netdev_t *dev;
+	unsigned int count = 0;
+
+	for (dev = ni_netconfig_devlist(nc); dev && count < hdr->capacity; dev = dev->next)
+		__ni_netif_snapshot_fill_netif(&records[count++], dev);
+
+	hdr->count = count;
+	hdr->generation++;
+	hdr->timestamp = time(NULL);
+}
+
+/*
+ * Create a new snapshot file with the given capacity, fill it
+ * and put it in place of the current one.
+ */
+static ni_bool_t
+__ni_netif_snapshot_create(struct ni_netif_snapshot_writer *w, ni_netconfig_t *nc,
+			unsigned int capacity)
+{
+	ni_netif_snapshot_header_t *hdr;
+	char tmpname[PATH_MAX];
+	size_t size;
+	int fd;
+
+	size = __ni_netif_snapshot_size(capacity);
+	snprintf(tmpname, sizeof(tmpname), "%s.tmp", w->path);
+
+	if ((fd = open(tmpname, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0) {
+		ni_error("unable to create netif snapshot %s: %m", tmpname);
+		return FALSE;
+	}
+	if (ftruncate(fd, size) < 0) {
+		ni_error("unable to resize netif snapshot %s: %m", tmpname);
+		goto failed;
+	}
+	hdr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED) {
+		ni_error("unable to map netif snapshot %s: %m", tmpname);
+		goto failed;
+	}
+
+	hdr->magic = NI_NETIF_SNAPSHOT_MAGIC;
+	hdr->version = NI_NETIF_SNAPSHOT_VERSION;
+	hdr->record_size = sizeof(ni_netif_snapshot_netif_t);
+	hdr->capacity = capacity;
+	hdr->pid = getpid();
+	if (w->hdr)
+		hdr->generation = w->hdr->generation;
+	__ni_netif_snapshot_fill(hdr, nc);
+
+	if (rename(tmpname, w->path) < 0) {
+		ni_error("unable to rename netif snapshot to %s: %m", w->path);
+		munmap(hdr, size);
+		goto failed;
+	}
+
+	if (w->hdr) {
+		/* Tell readers still using the old file to reopen */
+		w->hdr->seqcount++;
+		__sync_synchronize();
+		w->hdr->obsolete = 1;
+		__sync_synchronize();
+		w->hdr->seqcount++;
+
+		munmap(w->hdr, w->size);
+		close(w->fd);
+	}
+
+	w->fd = fd;
+	w->hdr = hdr;
+	w->size = size;
+	return TRUE;
+
+failed:
+	close(fd);
+	unlink(tmpname);
+	return FALSE;
+}
+
+/*
+ * Rewrite the snapshot from the current interface state
+ */
+ni_bool_t
+ni_netif_snapshot_publish(void)
+{
+	struct ni_netif_snapshot_writer *w = &__ni_netif_snapshot;
+	ni_netconfig_t *nc;
+	ni_netdev_t *dev;
+	unsigned int count;
+
+	if (!w->hdr || !(nc = ni_global_state_handle(0)))
+		return FALSE;
+
+	for (count = 0, dev = ni_netconfig_devlist(nc); dev; dev = dev->next)
+		count++;
+
+	if (count > w->hdr->capacity) {
+		if (!__ni_netif_snapshot_create(w, nc, count * 2))
+			return FALSE;
+	} else {
+		w->hdr->seqcount++;
+		__sync_synchronize();
+
+		__ni_netif_snapshot_fill(w->hdr, nc);
+
+		__sync_synchronize();
+		w->hdr->seqcount++;
+	}
+
+	ni_debug_events("published netif snapshot generation %llu with %u interfaces",
+			(unsigned long long) w->hdr->generation, w->hdr->count);
+	return TRUE;
+}
+
+static void
+__ni_netif_snapshot_timeout(void *user_data, const ni_timer_t *timer)
+{
+	struct ni_netif_snapshot_writer *w = user_data;
+
+	if (w->timer == timer) {
+		w->timer = NULL;
+		ni_netif_snapshot_publish();
+	}
+}
+
+/*
+ * Schedule an update of the snapshot. Called whenever the interface
+ * state changes; does nothing unless this process publishes one.
+ */
+void
+ni_netif_snapshot_changed(void)
+{
+	struct ni_netif_snapshot_writer *w = &__ni_netif_snapshot;
+
+	if (!w->hdr || w->timer)
+		return;
+
+	w->timer = ni_timer_register(NI_NETIF_SNAPSHOT_DELAY,
+				__ni_netif_snapshot_timeout, w);
+}
+
+ni_bool_t
+ni_netif_snapshot_open(const char *path)
+{
+	struct ni_netif_snapshot_writer *w = &__ni_netif_snapshot;
+	unsigned int capacity = NI_NETIF_SNAPSHOT_MIN_CAPACITY;
+	ni_netconfig_t *nc;
+	ni_netdev_t *dev;
+
+	if (w->hdr || ni_string_empty(path) || !(nc = ni_global_state_handle(0)))
+		return FALSE;
+
+	for (dev = ni_netconfig_devlist(nc); dev; dev = dev->next)
+		capacity++;
+
+	ni_string_dup(&w->path, path);
+	if (!__ni_netif_snapshot_create(w, nc, capacity)) {
+		ni_string_free(&w->path);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+void
+ni_netif_snapshot_close(void)
+{
+	struct ni_netif_snapshot_writer *w = &__ni_netif_snapshot;
+
+	if (w->timer) {
+		ni_timer_cancel(w->timer);
+		w->timer = NULL;
+	}
+	if (w->hdr) {
+		unlink(w->path);
+		munmap(w->hdr, w->size);
+		close(w->fd);
+		w->hdr = NULL;
+		w->fd = -1;
+	}
+	ni_string_free(&w->path);
+}
+
+/*
+ * Reader side: rebuild a netdev from its snapshot record
+ */
+static ni_netdev_t *
+__ni_netif_snapshot_netdev(const ni_netif_snapshot_netif_t *rec)
+{
+	ni_netdev_t *dev;
+	ni_sockaddr_t addr;
+	unsigned int i;
+
+	dev = ni_netdev_new(rec->name, rec->ifindex);
+	dev->link.type = rec->type;
+	dev->link.ifflags = rec->ifflags;
+	dev->link.mtu = rec->mtu;
+	dev->link.hwaddr = rec->hwaddr;
+	if (*rec->alias)
+		ni_string_dup(&dev->link.alias, rec->alias);
+	if (*rec->lowerdev)
+		ni_netdev_ref_set_ifname(&dev->link.lowerdev, rec->lowerdev);
+	if (*rec->masterdev)
+		ni_netdev_ref_set_ifname(&dev->link.masterdev, rec->masterdev);
+
+	if (rec->type == NI_IFTYPE_VLAN) {
+		ni_vlan_t *vlan = ni_netdev_get_vlan(dev);
+
+		vlan->tag = rec->vlan_tag;
+		vlan->protocol = rec->vlan_protocol;
+	} else
+	if (rec->type == NI_IFTYPE_BOND) {
+		ni_netdev_get_bonding(dev)->mode = rec->bonding_mode;
+	}
+
+	if (rec->has_client_state) {
+		ni_client_state_t *cs = ni_netdev_get_client_state(dev);
+
+		cs->control.persistent = rec->persistent;
+		cs->control.usercontrol = rec->usercontrol;
+		cs->config.uuid = rec->config_uuid;
+		if (*rec->config_origin)
+			ni_string_dup(&cs->config.origin, rec->config_origin);
+	}
+
+	for (i = 0; i < rec->naddrs && i < NI_NETIF_SNAPSHOT_MAX_ADDRS; ++i) {
+		const ni_netif_snapshot_addr_t *sa = &rec->addrs[i];
+		ni_address_t *ap;
+
+		__ni_netif_snapshot_unpack_addr(&addr, sa->family, sa->local);
+		if (!(ap = ni_address_new(sa->family, sa->prefixlen, &addr, &dev->addrs)))
+			continue;
+		ap->flags = sa->flags;
+		ap->ipv6_cache_info.valid_lft = sa->valid_lft;
+		ap->ipv6_cache_info.preferred_lft = sa->preferred_lft;
+		if (*sa->label)
+			ni_string_dup(&ap->label, sa->label);
+	}
+
+	for (i = 0; i < rec->nroutes && i < NI_NETIF_SNAPSHOT_MAX_ROUTES; ++i) {
+		const ni_netif_snapshot_route_t *sr = &rec->routes[i];
+		ni_route_t *rp = ni_route_new();
+
+		rp->family = sr->family;
+		rp->prefixlen = sr->prefixlen;
+		rp->type = sr->type;
+		rp->scope = sr->scope;
+		rp->protocol = sr->protocol;
+		rp->table = sr->table;
+		rp->priority = sr->priority;
+		__ni_netif_snapshot_unpack_addr(&rp->destination, sr->family, sr->destination);
+		__ni_netif_snapshot_unpack_addr(&rp->nh.gateway, sr->family, sr->gateway);
+		if (!ni_route_tables_add_route(&dev->routes, rp))
+			ni_route_free(rp);
+	}
+
+	for (i = 0; i < rec->nleases && i < NI_NETIF_SNAPSHOT_MAX_LEASES; ++i) {
+		const ni_netif_snapshot_lease_t *sl = &rec->leases[i];
+		ni_addrconf_lease_t *lease;
+
+		lease = ni_addrconf_lease_new(sl->type, sl->family);
+		lease->state = sl->state;
+		lease->flags = sl->flags;
+		ni_netdev_set_lease(dev, lease);
+	}
+
+	return dev;
+}
+
+/*
+ * Copy a consistent view of a mapped snapshot.
+ * Returns 1 on success, 0 when the file has been replaced and -1 on error.
+ */
+static int
+__ni_netif_snapshot_copy(const ni_netif_snapshot_header_t *map, size_t size,
+		ni_netif_snapshot_header_t *hdr, ni_netif_snapshot_netif_t **records)
+{
+	const volatile uint32_t *seqcount = &map->seqcount;
+	unsigned int retries;
+	uint32_t seq;
+
+	if (map->magic != NI_NETIF_SNAPSHOT_MAGIC ||
+	    map->version != NI_NETIF_SNAPSHOT_VERSION ||
+	    map->record_size != sizeof(ni_netif_snapshot_netif_t) ||
+	    __ni_netif_snapshot_size(map->capacity) > size) {
+		ni_error("netif snapshot has an incompatible format");
+		return -1;
+	}
+
+	for (retries = 0; retries < NI_NETIF_SNAPSHOT_READ_RETRIES; ++retries) {
+		if ((seq = *seqcount) & 1) {
+			sched_yield();
+			continue;
+		}
+		__sync_synchronize();
+
+		*hdr = *map;
+		if (hdr->obsolete)
+			return 0;
+		if (hdr->count > hdr->capacity)
+			continue;
+
+		*records = xrealloc(*records, (hdr->count + 1) * sizeof(**records));
+		memcpy(*records, __ni_netif_snapshot_records(map),
+				hdr->count * sizeof(**records));
+
+		__sync_synchronize();
+		if (*seqcount == seq)
+			return 1;
+	}
+
+	ni_error("netif snapshot is busy, giving up");
+	return -1;
+}
+
+/*
+ * Read the snapshot published by wickedd and add its interfaces
+ * to the given netconfig handle. Returns the number of interfaces.
+ */
+int
+ni_netif_snapshot_load(const char *path, ni_netconfig_t *nc, uint64_t *generation)
+{
+	ni_netif_snapshot_netif_t *records = NULL;
+	ni_netif_snapshot_header_t hdr;
+	unsigned int attempt, i;
+	int rv = -1;
+
+	for (attempt = 0; rv < 0 && attempt < NI_NETIF_SNAPSHOT_REOPEN_RETRIES; ++attempt) {
+		ni_netif_snapshot_header_t *map;
+		struct stat stb;
+		int fd;
+
+		if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+			ni_error("unable to open netif snapshot %s: %m", path);
+			break;
+		}
+		if (fstat(fd, &stb) < 0 || (size_t) stb.st_size < sizeof(hdr)) {
+			ni_error("netif snapshot %s is truncated", path);
+			close(fd);
+			break;
+		}
+		map = mmap(NULL, stb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (map == MAP_FAILED) {
+			ni_error("unable to map netif snapshot %s: %m", path);
+			break;
+		}
+
+		switch (__ni_netif_snapshot_copy(map, stb.st_size, &hdr, &records)) {
+		case 1:
+			rv = hdr.count;
+			break;
+		case 0:
+			ni_debug_events("netif snapshot %s has been replaced", path);
+			break;
+		default:
+			attempt = NI_NETIF_SNAPSHOT_REOPEN_RETRIES;
+			break;
+		}
+		munmap(map, stb.st_size);
+	}
+
+	if (rv >= 0) {
+		for (i = 0; i < hdr.count; ++i)
+			ni_netconfig_device_append(nc, __ni_netif_snapshot_netdev(&records[i]));
+		if (generation)
+			*generation = hdr.generation;
+	}
+
+	free(records);
+	return rv;
+}
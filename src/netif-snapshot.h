@@ -0,0 +1,134 @@
+/*
+ *	Read-only shared memory snapshot of the wickedd interface state
+ *
+ *	Copyright (C) 2014 SUSE LINUX Products GmbH, Nuernberg, Germany.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ *
+ */
+#ifndef __WICKED_NETIF_SNAPSHOT_H__
+#define __WICKED_NETIF_SNAPSHOT_H__
+
+#include <net/if.h>
+#include <wicked/types.h>
+#include <wicked/util.h>
+
+/*
+ * wickedd publishes the state of its network interfaces in a file
+ * (on tmpfs) mapped into memory, which clients like "wicked ifstatus"
+ * can read without a dbus round trip and without loading the schema.
+ *
+ * The file consists of a header followed by an array of fixed size
+ * netif records. Updates are protected by a sequence counter: it is
+ * odd while wickedd rewrites the records, so readers copy the data
+ * and retry when the counter was odd or has changed meanwhile.
+ * When the number of interfaces exceeds the capacity of the file,
+ * wickedd publishes a larger one under the same name and marks the
+ * old one obsolete.
+ */
+#define NI_NETIF_SNAPSHOT_MAGIC		0x776e6973	/* "wnis" */
+#define NI_NETIF_SNAPSHOT_VERSION	1
+
+#define NI_NETIF_SNAPSHOT_MAX_ADDRS	32
+#define NI_NETIF_SNAPSHOT_MAX_ROUTES	32
+#define NI_NETIF_SNAPSHOT_MAX_LEASES	8
+
+typedef struct ni_netif_snapshot_addr {
+	uint8_t			family;
+	uint8_t			prefixlen;
+	uint16_t		__pad;
+	uint32_t		flags;
+	uint32_t		valid_lft;
+	uint32_t		preferred_lft;
+	unsigned char		local[16];
+	char			label[IFNAMSIZ];
+} ni_netif_snapshot_addr_t;
+
+typedef struct ni_netif_snapshot_route {
+	uint8_t			family;
+	uint8_t			prefixlen;
+	uint8_t			type;
+	uint8_t			scope;
+	uint8_t			protocol;
+	uint8_t			__pad[3];
+	uint32_t		table;
+	uint32_t		priority;
+	unsigned char		destination[16];
+	unsigned char		gateway[16];	/* first nexthop only */
+} ni_netif_snapshot_route_t;
+
+typedef struct ni_netif_snapshot_lease {
+	uint8_t			family;
+	uint8_t			type;
+	uint16_t		state;
+	uint32_t		flags;
+} ni_netif_snapshot_lease_t;
+
+typedef struct ni_netif_snapshot_netif {
+	uint32_t		ifindex;
+	uint32_t		ifflags;
+	uint32_t		type;
+	uint32_t		mtu;
+	char			name[IFNAMSIZ];
+	char			alias[64];
+	char			lowerdev[IFNAMSIZ];
+	char			masterdev[IFNAMSIZ];
+	ni_hwaddr_t		hwaddr;
+	uint16_t		vlan_tag;
+	uint16_t		vlan_protocol;
+	uint32_t		bonding_mode;
+
+	/* client state, as set by ifup */
+	uint8_t			has_client_state;
+	uint8_t			persistent;
+	uint8_t			usercontrol;
+	uint8_t			__pad;
+	ni_uuid_t		config_uuid;
+	char			config_origin[128];
+
+	uint16_t		naddrs;
+	uint16_t		nroutes;
+	uint16_t		nleases;
+	uint16_t		__pad2;
+	ni_netif_snapshot_addr_t addrs[NI_NETIF_SNAPSHOT_MAX_ADDRS];
+	ni_netif_snapshot_route_t routes[NI_NETIF_SNAPSHOT_MAX_ROUTES];
+	ni_netif_snapshot_lease_t leases[NI_NETIF_SNAPSHOT_MAX_LEASES];
+} ni_netif_snapshot_netif_t;
+
+typedef struct ni_netif_snapshot_header {
+	uint32_t		magic;
+	uint32_t		version;
+	uint32_t		record_size;
+	uint32_t		capacity;
+	uint32_t		seqcount;	/* odd while being updated */
+	uint32_t		obsolete;	/* replaced by a larger file */
+	uint32_t		count;
+	uint32_t		pid;
+	uint64_t		generation;
+	uint64_t		timestamp;	/* time of last update */
+} ni_netif_snapshot_header_t;
+
+/* wickedd */
+extern ni_bool_t		ni_netif_snapshot_open(const char *path);
+extern void			ni_netif_snapshot_close(void);
+extern void			ni_netif_snapshot_changed(void);
+extern ni_bool_t		ni_netif_snapshot_publish(void);
+
+/* clients */
+extern int			ni_netif_snapshot_load(const char *path, ni_netconfig_t *nc,
+						uint64_t *generation);
+
+#endif /* __WICKED_NETIF_SNAPSHOT_H__ */
@@ -9,6 +9,7 @@
 
 #include <signal.h>
 #include <limits.h>
+#include <unistd.h>
 #include <errno.h>
 
 #include <wicked/netinfo.h>
@@ -375,6 +376,9 @@ ni_server_listen_dbus(const char *dbus_name)
 ni_dbus_client_t *
 ni_create_dbus_client(const char *dbus_name)
 {
+	const char *peer_socket;
+	ni_dbus_client_t *client;
+
 	__ni_assert_initialized();
 	if (dbus_name == NULL)
 		dbus_name = ni_global.config->dbus_name;
@@ -383,6 +387,15 @@ ni_create_dbus_client(const char *dbus_name)
 		return NULL;
 	}
 
+	/* Talk to wickedd directly if it listens for peer connections */
+	peer_socket = ni_global.config->dbus_peer_socket;
+	if (peer_socket && ni_string_eq(dbus_name, ni_global.config->dbus_name)
+	 && geteuid() == 0 && ni_file_exists(peer_socket)) {
+		if ((client = ni_dbus_client_open_peer(peer_socket, dbus_name)) != NULL)
+			return client;
+		ni_debug_dbus("Cannot connect to %s, falling back to the bus", peer_socket);
+	}
+
 	return ni_dbus_client_open(ni_global.config->dbus_type, dbus_name);
 }
 
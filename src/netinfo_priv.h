@@ -123,11 +123,29 @@ typedef struct ni_capture_protinfo {
 	uint16_t		ip_port;
 } ni_capture_protinfo_t;
 
+/* Match the DHCP replies to one client; xid as in the message */
+typedef struct ni_capture_client_filter {
+	uint32_t		xid;
+	ni_hwaddr_t		chaddr;
+} ni_capture_client_filter_t;
+
+typedef void		ni_capture_recv_handler_t(ni_capture_t *, ni_buffer_t *);
+
+struct sock_filter;
+
 extern int		ni_capture_devinfo_init(ni_capture_devinfo_t *, const char *, const ni_linkinfo_t *);
 extern int		ni_capture_devinfo_refresh(ni_capture_devinfo_t *, const char *, const ni_linkinfo_t *);
 extern ni_capture_t *	ni_capture_open(const ni_capture_devinfo_t *, const ni_capture_protinfo_t *, void (*)(ni_socket_t *));
+extern ni_capture_t *	ni_capture_open_shared(const ni_capture_devinfo_t *, const ni_capture_protinfo_t *,
+					ni_capture_recv_handler_t *);
 extern int		ni_capture_recv(ni_capture_t *, ni_buffer_t *);
-extern ssize_t		ni_capture_send(ni_capture_t *, const ni_buffer_t *, const ni_timeout_param_t *);
+extern int		ni_capture_build_filter(const ni_capture_protinfo_t *,
+					const ni_capture_client_filter_t *, unsigned int,
+					struct sock_filter **);
+extern int		ni_capture_set_client_filter(ni_capture_t *, uint32_t, const ni_hwaddr_t *);
+extern ssize_t		ni_capture_send(ni_capture_t *, ni_buffer_t *, const ni_timeout_param_t *);
+extern ssize_t		ni_capture_send_update_secs(ni_capture_t *, ni_buffer_t *,
+					const ni_timeout_param_t *, unsigned int);
 extern void		ni_capture_disarm_retransmit(ni_capture_t *);
 extern void		ni_capture_force_retransmit(ni_capture_t *, unsigned int);
 extern void		ni_capture_free(ni_capture_t *);
@@ -135,6 +153,10 @@ extern int		ni_capture_desc(const ni_capture_t *);
 extern int		ni_capture_build_udp_header(ni_buffer_t *,
 					struct in_addr src_addr, uint16_t src_port,
 					struct in_addr dst_addr, uint16_t dst_port);
+extern int		ni_capture_update_udp_payload(ni_buffer_t *, unsigned int,
+					const void *, size_t);
+extern uint32_t		ni_capture_checksum_partial(uint32_t, const void *, size_t);
+extern uint16_t		ni_capture_checksum_fold(uint32_t);
 extern void		ni_capture_set_user_data(ni_capture_t *, void *);
 extern void *		ni_capture_get_user_data(const ni_capture_t *);
 extern int		ni_capture_is_valid(const ni_capture_t *, int protocol);
@@ -0,0 +1,371 @@
+/*
+ *	Jittered, rate limited scheduling of addrconf transmissions
+ *
+ *	Copyright (C) 2014 SUSE LINUX Products GmbH, Nuernberg, Germany.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/socket.h>
+
+#include "txsched.h"
+#include "util_priv.h"
+
+struct ni_txsched {
+	char *			name;
+	unsigned int		window;		/* msec, 0: no jitter */
+	unsigned int		rate;		/* jobs per second, 0: unlimited */
+	unsigned int		burst;
+
+	unsigned int		tokens;
+	struct timeval		refilled;
+
+	ni_txsched_job_t *	jobs;		/* sorted by start time */
+	const ni_timer_t *	timer;
+
+	ni_txsched_stats_t	stats;
+};
+
+static void			ni_txsched_run(void *, const ni_timer_t *);
+
+ni_txsched_t *
+ni_txsched_new(const char *name, unsigned int window, unsigned int rate, unsigned int burst)
+{
+	ni_txsched_t *sched;
+
+	sched = xcalloc(1, sizeof(*sched));
+	ni_string_dup(&sched->name, name);
+	sched->window = window;
+	sched->rate = rate;
+	sched->burst = burst > rate ? burst : rate;
+	sched->tokens = sched->burst;
+	ni_timer_get_time(&sched->refilled);
+	return sched;
+}
+
+void
+ni_txsched_free(ni_txsched_t *sched)
+{
+	if (!sched)
+		return;
+
+	while (sched->jobs)
+		ni_txsched_cancel(sched->jobs);
+	if (sched->timer)
+		ni_timer_cancel(sched->timer);
+	ni_string_free(&sched->name);
+	free(sched);
+}
+
+static void
+ni_txsched_timeval_add_msec(struct timeval *tv, unsigned long msec)
+{
+	struct timeval delta;
+
+	delta.tv_sec = msec / 1000;
+	delta.tv_usec = (msec % 1000) * 1000;
+	timeradd(tv, &delta, tv);
+}
+
+static unsigned long
+ni_txsched_timeval_msec(const struct timeval *from, const struct timeval *to)
+{
+	struct timeval delta;
+
+	if (!timercmp(to, from, >))
+		return 0;
+	timersub(to, from, &delta);
+	return delta.tv_sec * 1000 + delta.tv_usec / 1000;
+}
+
+static ni_bool_t
+ni_txsched_job_overdue(const ni_txsched_job_t *job, const struct timeval *now)
+{
+	return timerisset(&job->deadline) && !timercmp(&job->deadline, now, >);
+}
+
+static void
+ni_txsched_unlink(ni_txsched_t *sched, ni_txsched_job_t *job)
+{
+	ni_txsched_job_t **pos;
+
+	for (pos = &sched->jobs; *pos; pos = &(*pos)->next) {
+		if (*pos == job) {
+			*pos = job->next;
+			break;
+		}
+	}
+	job->next = NULL;
+	job->sched = NULL;
+	sched->stats.pending--;
+}
+
+static void
+ni_txsched_refill(ni_txsched_t *sched, const struct timeval *now)
+{
+	unsigned long msec, tokens;
+
+	msec = ni_txsched_timeval_msec(&sched->refilled, now);
+	tokens = msec * sched->rate / 1000;
+	if (tokens == 0)
+		return;
+
+	sched->refilled = *now;
+	if (sched->tokens + tokens > sched->burst)
+		sched->tokens = sched->burst;
+	else
+		sched->tokens += tokens;
+}
+
+/*
+ * Arm the timer for the next job to start: the first in the queue,
+ * or, when that one waits for the rate, the next token or deadline.
+ */
+static void
+ni_txsched_arm(ni_txsched_t *sched)
+{
+	ni_txsched_job_t *job;
+	struct timeval now;
+	unsigned long timeout;
+
+	if (!(job = sched->jobs)) {
+		if (sched->timer)
+			ni_timer_cancel(sched->timer);
+		sched->timer = NULL;
+		ni_txsched_log_stats(sched);
+		return;
+	}
+
+	ni_timer_get_time(&now);
+	ni_txsched_refill(sched, &now);
+	if (timercmp(&job->start, &now, >)) {
+		timeout = ni_txsched_timeval_msec(&now, &job->start);
+	} else if (!sched->rate || sched->tokens) {
+		timeout = 0;
+	} else {
+		timeout = 1000 / sched->rate ?: 1;
+		for (; job && !timercmp(&job->start, &now, >); job = job->next) {
+			if (timerisset(&job->deadline)
+			 && ni_txsched_timeval_msec(&now, &job->deadline) < timeout)
+				timeout = ni_txsched_timeval_msec(&now, &job->deadline);
+		}
+	}
+
+	if (sched->timer)
+		sched->timer = ni_timer_rearm(sched->timer, timeout);
+	if (!sched->timer)
+		sched->timer = ni_timer_register(timeout, ni_txsched_run, sched);
+}
+
+void
+ni_txsched_submit(ni_txsched_t *sched, ni_txsched_job_t *job, const char *what,
+			ni_txsched_func_t *func, void *user_data,
+			const struct timeval *deadline)
+{
+	ni_txsched_job_t **pos, *cur;
+	unsigned long jitter = 0;
+
+	if (job->sched)
+		ni_txsched_unlink(job->sched, job);
+	else
+		sched->stats.queued++;
+
+	job->func = func;
+	job->user_data = user_data;
+	job->what = what;
+	job->limited = 0;
+
+	ni_timer_get_time(&job->queued);
+	job->start = job->queued;
+	if (sched->window)
+		jitter = random() % (sched->window + 1);
+	ni_txsched_timeval_add_msec(&job->start, jitter);
+
+	timerclear(&job->deadline);
+	if (deadline && timerisset(deadline)) {
+		job->deadline = *deadline;
+		if (timercmp(&job->start, &job->deadline, >))
+			job->start = job->deadline;
+	}
+
+	for (pos = &sched->jobs; (cur = *pos); pos = &cur->next) {
+		if (timercmp(&job->start, &cur->start, <))
+			break;
+	}
+	job->next = cur;
+	job->sched = sched;
+	*pos = job;
+
+	if (++sched->stats.pending > sched->stats.max_pending)
+		sched->stats.max_pending = sched->stats.pending;
+
+	ni_debug_dhcp("%s: scheduled %s in %lu msec, %u pending",
+			sched->name, what ? what : "job",
+			ni_txsched_timeval_msec(&job->queued, &job->start),
+			sched->stats.pending);
+
+	ni_txsched_arm(sched);
+}
+
+ni_bool_t
+ni_txsched_cancel(ni_txsched_job_t *job)
+{
+	ni_txsched_t *sched;
+
+	if (!job || !(sched = job->sched))
+		return FALSE;
+
+	ni_txsched_unlink(sched, job);
+	sched->stats.cancelled++;
+
+	ni_debug_dhcp("%s: cancelled %s, %u pending", sched->name,
+			job->what ? job->what : "job", sched->stats.pending);
+
+	ni_txsched_arm(sched);
+	return TRUE;
+}
+
+/*
+ * Pick the next job to start: jobs at their deadline first, then the
+ * due jobs in order as long as there are tokens left.
+ */
+static ni_txsched_job_t *
+ni_txsched_next(ni_txsched_t *sched, const struct timeval *now)
+{
+	ni_txsched_job_t *job;
+
+	for (job = sched->jobs; job && !timercmp(&job->start, now, >); job = job->next) {
+		if (ni_txsched_job_overdue(job, now)) {
+			if (sched->rate && !sched->tokens) {
+				sched->stats.forced++;
+			} else if (sched->rate) {
+				sched->tokens--;
+			}
+			return job;
+		}
+	}
+
+	if (!(job = sched->jobs) || timercmp(&job->start, now, >))
+		return NULL;
+
+	if (sched->rate) {
+		if (!sched->tokens) {
+			for (; job && !timercmp(&job->start, now, >); job = job->next)
+				job->limited = 1;
+			return NULL;
+		}
+		sched->tokens--;
+	}
+	return job;
+}
+
+static void
+ni_txsched_run(void *user_data, const ni_timer_t *timer)
+{
+	ni_txsched_t *sched = user_data;
+	ni_txsched_job_t *job;
+	struct timeval now;
+	unsigned long wait;
+
+	if (sched->timer != timer) {
+		ni_warn("%s: bad timer handle", __func__);
+		return;
+	}
+	sched->timer = NULL;
+
+	ni_timer_get_time(&now);
+	ni_txsched_refill(sched, &now);
+
+	/* The job may submit or cancel others, so start over each time */
+	while ((job = ni_txsched_next(sched, &now)) != NULL) {
+		ni_txsched_unlink(sched, job);
+
+		wait = ni_txsched_timeval_msec(&job->queued, &now);
+		sched->stats.sent++;
+		sched->stats.total_wait += wait;
+		if (sched->stats.max_wait < wait)
+			sched->stats.max_wait = wait;
+		if (job->limited)
+			sched->stats.limited++;
+
+		ni_debug_dhcp("%s: starting %s after %lu msec%s", sched->name,
+				job->what ? job->what : "job", wait,
+				ni_txsched_job_overdue(job, &now) ? " (deadline)" : "");
+
+		job->func(job->user_data);
+	}
+
+	ni_txsched_arm(sched);
+}
+
+const ni_txsched_stats_t *
+ni_txsched_get_stats(const ni_txsched_t *sched)
+{
+	return sched ? &sched->stats : NULL;
+}
+
+void
+ni_txsched_log_stats(const ni_txsched_t *sched)
+{
+	const ni_txsched_stats_t *stats = &sched->stats;
+
+	ni_debug_dhcp("%s: %lu jobs queued, %lu sent (%lu rate limited, "
+			"%lu at deadline), %lu cancelled, %u pending (max %u), "
+			"wait avg %llu max %lu msec", sched->name,
+			stats->queued, stats->sent, stats->limited, stats->forced,
+			stats->cancelled, stats->pending, stats->max_pending,
+			stats->sent ? stats->total_wait / stats->sent : 0,
+			stats->max_wait);
+}
+
+/*
+ * Return the statistics as a dict, for the Debug dbus interface
+ * of the supplicants.
+ */
+dbus_bool_t
+ni_txsched_get_stats_dict(const ni_txsched_t *sched, ni_dbus_variant_t *dict)
+{
+	const ni_txsched_stats_t *stats;
+
+	ni_dbus_variant_init_dict(dict);
+	if (!sched)
+		return TRUE;
+
+	stats = &sched->stats;
+	return ni_dbus_dict_add_string(dict, "name", sched->name)
+	    && ni_dbus_dict_add_uint32(dict, "window", sched->window)
+	    && ni_dbus_dict_add_uint32(dict, "rate", sched->rate)
+	    && ni_dbus_dict_add_uint32(dict, "burst", sched->burst)
+	    && ni_dbus_dict_add_uint64(dict, "queued", stats->queued)
+	    && ni_dbus_dict_add_uint64(dict, "sent", stats->sent)
+	    && ni_dbus_dict_add_uint64(dict, "limited", stats->limited)
+	    && ni_dbus_dict_add_uint64(dict, "forced", stats->forced)
+	    && ni_dbus_dict_add_uint64(dict, "cancelled", stats->cancelled)
+	    && ni_dbus_dict_add_uint32(dict, "pending", stats->pending)
+	    && ni_dbus_dict_add_uint32(dict, "max-pending", stats->max_pending)
+	    && ni_dbus_dict_add_uint64(dict, "max-wait", stats->max_wait)
+	    && ni_dbus_dict_add_uint64(dict, "avg-wait", stats->sent ?
+					stats->total_wait / stats->sent : 0);
+}
@@ -0,0 +1,88 @@
+/*
+ *	Jittered, rate limited scheduling of addrconf transmissions
+ *
+ *	Copyright (C) 2014 SUSE LINUX Products GmbH, Nuernberg, Germany.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ *
+ */
+#ifndef __WICKED_TXSCHED_H__
+#define __WICKED_TXSCHED_H__
+
+#include <sys/time.h>
+#include <wicked/types.h>
+#include <wicked/socket.h>
+#include <wicked/dbus.h>
+
+/*
+ * The dhcp supplicants do not start a (re)acquire, renewal or rebind
+ * of a lease right away, but submit a job for it to the scheduler of
+ * the daemon. A job is started after a random delay within the window
+ * and when the token bucket (rate per second, burst) permits, so many
+ * interfaces restarted at once do not send their first messages in
+ * one burst. A job is never started later than its deadline, even
+ * when this exceeds the rate. Retransmissions are not scheduled.
+ *
+ * Jobs are embedded into the structure they act on; submitting a job
+ * which is already queued reschedules it.
+ */
+typedef struct ni_txsched	ni_txsched_t;
+typedef struct ni_txsched_job	ni_txsched_job_t;
+typedef void			ni_txsched_func_t(void *);
+
+struct ni_txsched_job {
+	ni_txsched_job_t *	next;
+	ni_txsched_t *		sched;		/* set while queued */
+	ni_txsched_func_t *	func;
+	void *			user_data;
+	const char *		what;
+
+	struct timeval		queued;
+	struct timeval		start;
+	struct timeval		deadline;	/* unset: none */
+	unsigned int		limited : 1;
+};
+
+typedef struct ni_txsched_stats {
+	unsigned long		queued;		/* jobs submitted */
+	unsigned long		sent;		/* jobs started */
+	unsigned long		limited;	/* ... which had to wait for the rate */
+	unsigned long		forced;		/* ... at their deadline over the rate */
+	unsigned long		cancelled;
+	unsigned int		pending;
+	unsigned int		max_pending;
+	unsigned long		max_wait;	/* msec from submit to start */
+	unsigned long long	total_wait;
+} ni_txsched_stats_t;
+
+extern ni_txsched_t *	ni_txsched_new(const char *, unsigned int, unsigned int, unsigned int);
+extern void		ni_txsched_free(ni_txsched_t *);
+
+extern void		ni_txsched_submit(ni_txsched_t *, ni_txsched_job_t *, const char *,
+					ni_txsched_func_t *, void *, const struct timeval *);
+extern ni_bool_t	ni_txsched_cancel(ni_txsched_job_t *);
+
+extern const ni_txsched_stats_t *ni_txsched_get_stats(const ni_txsched_t *);
+extern void		ni_txsched_log_stats(const ni_txsched_t *);
+extern dbus_bool_t	ni_txsched_get_stats_dict(const ni_txsched_t *, ni_dbus_variant_t *);
+
+static inline ni_bool_t
+ni_txsched_job_pending(const ni_txsched_job_t *job)
+{
+	return job->sched != NULL;
+}
+
+#endif /* __WICKED_TXSCHED_H__ */
@@ -0,0 +1,300 @@
+/*
+ * Run the DHCP capture filters built by ni_capture_build_filter in a
+ * userspace BPF interpreter against a set of hand crafted packets, as
+ * received by a SOCK_DGRAM packet socket (starting at the IP header).
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <net/ethernet.h>
+#include <net/if_arp.h>
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <wicked/util.h>
+#include <wicked/netinfo.h>
+#include "netinfo_priv.h"
+
+#define DHCP_CLIENT_PORT	68
+#define DHCP_SERVER_PORT	67
+#define BOOTREQUEST		1
+#define BOOTREPLY		2
+
+typedef struct test_packet {
+	unsigned char		data[512];
+	unsigned int		len;
+} test_packet_t;
+
+static unsigned int		failures;
+static unsigned int		checks;
+
+/*
+ * A minimal classic BPF interpreter, covering the instructions the
+ * capture filters use. Loads beyond the packet drop it, as in the
+ * kernel.
+ */
+static unsigned int
+bpf_run(const struct sock_filter *prog, unsigned int len, const unsigned char *pkt, unsigned int plen)
+{
+	uint32_t A = 0, X = 0, k;
+	unsigned int pc, off;
+
+	for (pc = 0; pc < len; ++pc) {
+		const struct sock_filter *insn = &prog[pc];
+
+		k = insn->k;
+		switch (insn->code) {
+		case BPF_LD | BPF_W | BPF_ABS:
+		case BPF_LD | BPF_W | BPF_IND:
+			off = k + (BPF_MODE(insn->code) == BPF_IND ? X : 0);
+			if (off + 4 > plen)
+				return 0;
+			A = (pkt[off] << 24) | (pkt[off + 1] << 16) | (pkt[off + 2] << 8) | pkt[off + 3];
+			break;
+		case BPF_LD | BPF_H | BPF_ABS:
+		case BPF_LD | BPF_H | BPF_IND:
+			off = k + (BPF_MODE(insn->code) == BPF_IND ? X : 0);
+			if (off + 2 > plen)
+				return 0;
+			A = (pkt[off] << 8) | pkt[off + 1];
+			break;
+		case BPF_LD | BPF_B | BPF_ABS:
+		case BPF_LD | BPF_B | BPF_IND:
+			off = k + (BPF_MODE(insn->code) == BPF_IND ? X : 0);
+			if (off + 1 > plen)
+				return 0;
+			A = pkt[off];
+			break;
+		case BPF_LDX | BPF_B | BPF_MSH:
+			if (k >= plen)
+				return 0;
+			X = (pkt[k] & 0xf) << 2;
+			break;
+		case BPF_JMP | BPF_JA:
+			pc += k;
+			break;
+		case BPF_JMP | BPF_JEQ | BPF_K:
+			pc += (A == k) ? insn->jt : insn->jf;
+			break;
+		case BPF_JMP | BPF_JSET | BPF_K:
+			pc += (A & k) ? insn->jt : insn->jf;
+			break;
+		case BPF_RET | BPF_K:
+			return k;
+		default:
+			fprintf(stderr, "unsupported BPF instruction 0x%04x at %u\n", insn->code, pc);
+			return 0;
+		}
+	}
+
+	fprintf(stderr, "BPF program runs off its end\n");
+	return 0;
+}
+
+static void
+build_packet(test_packet_t *p, uint8_t ip_proto, uint16_t frag, unsigned int ip_opts,
+		uint16_t dport, uint8_t op, uint32_t xid, const ni_hwaddr_t *chaddr)
+{
+	unsigned int ihl = 20 + 4 * ip_opts;
+	unsigned char *ip = p->data, *udp, *dhcp;
+
+	memset(p, 0, sizeof(*p));
+	p->len = ihl + 8 + 300;
+
+	ip[0] = 0x40 | (ihl >> 2);
+	ip[2] = p->len >> 8;
+	ip[3] = p->len & 0xff;
+	ip[6] = frag >> 8;
+	ip[7] = frag & 0xff;
+	ip[8] = 64;
+	ip[9] = ip_proto;
+
+	udp = ip + ihl;
+	udp[0] = DHCP_SERVER_PORT >> 8;
+	udp[1] = DHCP_SERVER_PORT & 0xff;
+	udp[2] = dport >> 8;
+	udp[3] = dport & 0xff;
+
+	dhcp = udp + 8;
+	dhcp[0] = op;
+	dhcp[1] = ARPHRD_ETHER;
+	dhcp[2] = chaddr ? chaddr->len : 0;
+	memcpy(dhcp + 4, &xid, 4);
+	if (chaddr)
+		memcpy(dhcp + 28, chaddr->data, chaddr->len);
+}
+
+static void
+check(const char *name, const struct sock_filter *prog, int len,
+		const test_packet_t *p, ni_bool_t expect)
+{
+	ni_bool_t pass;
+
+	checks++;
+	pass = bpf_run(prog, len, p->data, p->len) != 0;
+	if (pass != expect) {
+		printf("FAIL: %s: packet %s, expected it to be %s\n", name,
+				pass ? "passed" : "dropped",
+				expect ? "passed" : "dropped");
+		failures++;
+	}
+}
+
+static void
+make_hwaddr(ni_hwaddr_t *hw, unsigned int len, unsigned char seed)
+{
+	unsigned int i;
+
+	memset(hw, 0, sizeof(*hw));
+	hw->type = ARPHRD_ETHER;
+	hw->len = len;
+	for (i = 0; i < len; ++i)
+		hw->data[i] = seed + i;
+}
+
+static void
+test_clients(const ni_capture_protinfo_t *protinfo, unsigned int count, unsigned int hwlen)
+{
+	ni_capture_client_filter_t clients[8];
+	struct sock_filter *prog;
+	test_packet_t p;
+	ni_hwaddr_t other;
+	char name[64];
+	unsigned int i;
+	int len;
+
+	for (i = 0; i < count; ++i) {
+		clients[i].xid = htonl(0x12345600 + i);
+		make_hwaddr(&clients[i].chaddr, hwlen, 0x10 * (i + 1));
+	}
+	make_hwaddr(&other, hwlen, 0xa0);
+
+	len = ni_capture_build_filter(protinfo, clients, count, &prog);
+	snprintf(name, sizeof(name), "%u clients, hwlen %u", count, hwlen);
+	if (len <= 0 || len > BPF_MAXINSNS) {
+		printf("FAIL: %s: cannot build filter (%d)\n", name, len);
+		failures++;
+		return;
+	}
+
+	for (i = 0; i < count; ++i) {
+		const ni_capture_client_filter_t *c = &clients[i];
+		const ni_capture_client_filter_t *n = &clients[(i + 1) % count];
+
+		build_packet(&p, IPPROTO_UDP, 0, 0, DHCP_CLIENT_PORT, BOOTREPLY, c->xid, &c->chaddr);
+		check(name, prog, len, &p, TRUE);
+
+		build_packet(&p, IPPROTO_UDP, 0, 2, DHCP_CLIENT_PORT, BOOTREPLY, c->xid, &c->chaddr);
+		check(name, prog, len, &p, TRUE);
+
+		build_packet(&p, IPPROTO_UDP, 0, 0, DHCP_CLIENT_PORT, BOOTREQUEST, c->xid, &c->chaddr);
+		check(name, prog, len, &p, FALSE);
+
+		build_packet(&p, IPPROTO_UDP, 0, 0, DHCP_CLIENT_PORT, BOOTREPLY, c->xid ^ htonl(0x80000000), &c->chaddr);
+		check(name, prog, len, &p, FALSE);
+
+		build_packet(&p, IPPROTO_UDP, 0, 0, DHCP_CLIENT_PORT, BOOTREPLY, c->xid, &other);
+		check(name, prog, len, &p, hwlen == 0);
+
+		if (count > 1) {
+			build_packet(&p, IPPROTO_UDP, 0, 0, DHCP_CLIENT_PORT, BOOTREPLY, c->xid, &n->chaddr);
+			check(name, prog, len, &p, hwlen == 0);
+		}
+
+		if (hwlen) {
+			/* Only the last chaddr byte differs */
+			other = c->chaddr;
+			other.data[hwlen - 1] ^= 0xff;
+			build_packet(&p, IPPROTO_UDP, 0, 0, DHCP_CLIENT_PORT, BOOTREPLY, c->xid, &other);
+			check(name, prog, len, &p, FALSE);
+			make_hwaddr(&other, hwlen, 0xa0);
+		}
+
+		build_packet(&p, IPPROTO_UDP, 0, 0, DHCP_SERVER_PORT, BOOTREPLY, c->xid, &c->chaddr);
+		check(name, prog, len, &p, FALSE);
+
+		build_packet(&p, IPPROTO_TCP, 0, 0, DHCP_CLIENT_PORT, BOOTREPLY, c->xid, &c->chaddr);
+		check(name, prog, len, &p, FALSE);
+
+		build_packet(&p, IPPROTO_UDP, 0x2001, 0, DHCP_CLIENT_PORT, BOOTREPLY, c->xid, &c->chaddr);
+		check(name, prog, len, &p, FALSE);
+	}
+
+	/* Reply truncated right before chaddr */
+	build_packet(&p, IPPROTO_UDP, 0, 0, DHCP_CLIENT_PORT, BOOTREPLY, clients[0].xid, &clients[0].chaddr);
+	p.len = 20 + 8 + 28;
+	check(name, prog, len, &p, hwlen == 0);
+
+	free(prog);
+}
+
+static void
+test_unfiltered(const ni_capture_protinfo_t *protinfo, unsigned int count)
+{
+	ni_capture_client_filter_t *clients;
+	struct sock_filter *prog;
+	test_packet_t p;
+	ni_hwaddr_t hw;
+	char name[64];
+	int len;
+
+	/* Without clients, or too many of them, all DHCP packets pass */
+	clients = calloc(count ? count : 1, sizeof(*clients));
+	len = ni_capture_build_filter(protinfo, clients, count, &prog);
+	snprintf(name, sizeof(name), "unfiltered, %u clients", count);
+	if (len <= 0 || len > BPF_MAXINSNS) {
+		printf("FAIL: %s: cannot build filter (%d)\n", name, len);
+		failures++;
+		free(clients);
+		return;
+	}
+
+	make_hwaddr(&hw, 6, 0x20);
+	build_packet(&p, IPPROTO_UDP, 0, 0, DHCP_CLIENT_PORT, BOOTREPLY, 0xdeadbeef, &hw);
+	check(name, prog, len, &p, TRUE);
+	build_packet(&p, IPPROTO_UDP, 0, 0, DHCP_CLIENT_PORT, BOOTREQUEST, 0, NULL);
+	check(name, prog, len, &p, TRUE);
+	build_packet(&p, IPPROTO_UDP, 0, 0, DHCP_SERVER_PORT, BOOTREPLY, 0, &hw);
+	check(name, prog, len, &p, FALSE);
+	build_packet(&p, IPPROTO_UDP, 0x0001, 0, DHCP_CLIENT_PORT, BOOTREPLY, 0, &hw);
+	check(name, prog, len, &p, FALSE);
+
+	free(prog);
+	free(clients);
+}
+
+int
+main(int argc, char **argv)
+{
+	ni_capture_protinfo_t protinfo;
+	struct sock_filter *prog;
+
+	memset(&protinfo, 0, sizeof(protinfo));
+	protinfo.eth_protocol = ETHERTYPE_IP;
+	protinfo.ip_protocol = IPPROTO_UDP;
+	protinfo.ip_port = DHCP_CLIENT_PORT;
+
+	test_clients(&protinfo, 1, 6);
+	test_clients(&protinfo, 3, 6);
+	test_clients(&protinfo, 2, 7);
+	test_clients(&protinfo, 2, 16);
+	test_clients(&protinfo, 2, 1);
+	test_clients(&protinfo, 2, 0);
+	test_unfiltered(&protinfo, 0);
+	test_unfiltered(&protinfo, BPF_MAXINSNS);
+
+	protinfo.eth_protocol = ETHERTYPE_ARP;
+	checks++;
+	if (ni_capture_build_filter(&protinfo, NULL, 0, &prog) != 0) {
+		printf("FAIL: ARP capture should not need a filter\n");
+		failures++;
+	}
+
+	printf("%u checks, %u failures\n", checks, failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * Compare the word-at-a-time internet checksum of the capture code
+ * with a 16bit-at-a-time loop, as used before, for typical packet
+ * sizes.
+ *
+ *   ./checksum-bench --count 1000000
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/time.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <wicked/util.h>
+#include <wicked/netinfo.h>
+#include "netinfo_priv.h"
+
+#define BENCH_ROUNDS		5
+
+static volatile uint16_t	bench_sink;
+
+static uint32_t
+scalar_checksum_partial(uint32_t sum, const void *data, uint16_t len)
+{
+	const uint16_t *s = data;
+
+	while (len > 1) {
+		sum += *s++;
+		len -= 2;
+	}
+	if (len == 1) {
+		union {
+			uint8_t c[2];
+			uint16_t s;
+		} bs;
+		bs.c[0] = *(const uint8_t *) s;
+		bs.c[1] = 0;
+		sum += bs.s;
+	}
+	return sum;
+}
+
+static uint16_t
+scalar_checksum(const void *data, uint16_t len)
+{
+	return ni_capture_checksum_fold(scalar_checksum_partial(0, data, len));
+}
+
+static uint16_t
+word_checksum(const void *data, uint16_t len)
+{
+	return ni_capture_checksum_fold(ni_capture_checksum_partial(0, data, len));
+}
+
+static double
+bench_round(uint16_t (*func)(const void *, uint16_t), const void *data,
+		unsigned int len, unsigned int count)
+{
+	struct timeval start, end, delta;
+	unsigned int i;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < count; ++i)
+		bench_sink = func(data, len);
+	gettimeofday(&end, NULL);
+
+	timersub(&end, &start, &delta);
+	return (delta.tv_sec * 1e9 + delta.tv_usec * 1e3) / count;
+}
+
+/*
+ * Report the best of a few rounds, to filter out noise from other
+ * processes.
+ */
+static double
+bench_run(uint16_t (*func)(const void *, uint16_t), const void *data,
+		unsigned int len, unsigned int count)
+{
+	double nsec, best = 0;
+	unsigned int round;
+
+	for (round = 0; round < BENCH_ROUNDS; ++round) {
+		nsec = bench_round(func, data, len, count / BENCH_ROUNDS ?: 1);
+		if (round == 0 || nsec < best)
+			best = nsec;
+	}
+	return best;
+}
+
+int
+main(int argc, char **argv)
+{
+	static struct option options[] = {
+		{ "count",		required_argument,	NULL,	'c' },
+		{ NULL }
+	};
+	static const unsigned int sizes[] = { 20, 28, 300, 576, 1500 };
+	static unsigned char data[1500];
+	unsigned int i, count = 1000000;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "c:", options, NULL)) != EOF) {
+		switch (c) {
+		case 'c':
+			if (ni_parse_uint(optarg, &count, 10) < 0 || count == 0)
+				goto usage;
+			break;
+		default:
+		usage:
+			fprintf(stderr, "Usage: %s [--count n]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	for (i = 0; i < sizeof(data); ++i)
+		data[i] = random();
+
+	printf("%6s %12s %12s %8s\n", "bytes", "16bit ns", "word ns", "speedup");
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+		double scalar, word;
+
+		if (scalar_checksum(data, sizes[i]) != word_checksum(data, sizes[i])) {
+			fprintf(stderr, "checksums of %u bytes differ\n", sizes[i]);
+			return 1;
+		}
+
+		scalar = bench_run(scalar_checksum, data, sizes[i], count);
+		word = bench_run(word_checksum, data, sizes[i], count);
+		printf("%6u %12.1f %12.1f %7.2fx\n", sizes[i], scalar, word,
+				word > 0 ? scalar / word : 0);
+	}
+	return 0;
+}
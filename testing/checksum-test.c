@@ -0,0 +1,198 @@
+/*
+ * Check the word-at-a-time internet checksum of the capture code
+ * against a plain 16bit-at-a-time implementation, for all lengths
+ * and alignments up to a full frame, and the incremental update of
+ * UDP checksums against a full recomputation.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <wicked/util.h>
+#include <wicked/netinfo.h>
+#include "netinfo_priv.h"
+#include "buffer.h"
+
+#define MAX_LEN		1500
+
+static unsigned int	failures;
+static unsigned int	checks;
+
+static uint16_t
+ref_checksum(uint32_t sum, const unsigned char *data, size_t len)
+{
+	uint16_t word;
+
+	while (len > 1) {
+		memcpy(&word, data, 2);
+		sum += word;
+		data += 2;
+		len -= 2;
+	}
+	if (len == 1) {
+		unsigned char pad[2] = { data[0], 0 };
+
+		memcpy(&word, pad, 2);
+		sum += word;
+	}
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return ~sum;
+}
+
+static void
+test_checksum(void)
+{
+	static unsigned char data[MAX_LEN + 8];
+	unsigned int len, align, i;
+	uint32_t seed;
+
+	for (i = 0; i < sizeof(data); ++i)
+		data[i] = random();
+
+	for (len = 0; len <= MAX_LEN; ++len) {
+		for (align = 0; align < 8; ++align) {
+			seed = random() & 0xffff;
+
+			checks++;
+			if (ni_capture_checksum_fold(ni_capture_checksum_partial(seed, data + align, len))
+			    != ref_checksum(seed, data + align, len)) {
+				printf("FAIL: checksum of %u bytes at offset %u\n", len, align);
+				failures++;
+			}
+		}
+	}
+
+	/* All ones data makes the carries pile up */
+	memset(data, 0xff, sizeof(data));
+	for (len = 0; len <= MAX_LEN; len += 7) {
+		checks++;
+		if (ni_capture_checksum_fold(ni_capture_checksum_partial(0xffff, data, len))
+		    != ref_checksum(0xffff, data, len)) {
+			printf("FAIL: checksum of %u 0xff bytes\n", len);
+			failures++;
+		}
+	}
+
+	/* Summing in pieces; all but the last of even length */
+	for (i = 0; i < 100; ++i) {
+		unsigned int a = 2 * (random() % 300), b = random() % 600;
+		uint32_t sum;
+
+		for (len = 0; len < a + b; ++len)
+			data[len] = random();
+
+		sum = ni_capture_checksum_partial(0, data, a);
+		sum = ni_capture_checksum_partial(sum, data + a, b);
+		checks++;
+		if (ni_capture_checksum_fold(sum) != ref_checksum(0, data, a + b)) {
+			printf("FAIL: checksum of %u + %u bytes\n", a, b);
+			failures++;
+		}
+	}
+}
+
+/*
+ * A packet built by ni_capture_build_udp_header sums to zero,
+ * including the pseudo header.
+ */
+static ni_bool_t
+udp_checksum_ok(const ni_buffer_t *bp)
+{
+	const unsigned char *pkt = ni_buffer_head(bp);
+	unsigned int ihl = (pkt[0] & 0xf) << 2;
+	unsigned int ulen = ni_buffer_count(bp) - ihl;
+	unsigned char pseudo[12];
+
+	if (ref_checksum(0, pkt, ihl) != 0)
+		return FALSE;
+
+	memcpy(pseudo, pkt + 12, 8);
+	pseudo[8] = 0;
+	pseudo[9] = IPPROTO_UDP;
+	pseudo[10] = ulen >> 8;
+	pseudo[11] = ulen & 0xff;
+
+	{
+		unsigned char buf[12 + MAX_LEN];
+
+		memcpy(buf, pseudo, 12);
+		memcpy(buf + 12, pkt + ihl, ulen);
+		return ref_checksum(0, buf, 12 + ulen) == 0;
+	}
+}
+
+static void
+test_udp_update(void)
+{
+	unsigned int i, len, offset;
+	struct in_addr src, dst;
+
+	src.s_addr = 0;
+	dst.s_addr = htonl(INADDR_BROADCAST);
+
+	for (i = 0; i < 500; ++i) {
+		unsigned char payload[600], update[8];
+		ni_buffer_t buf;
+
+		len = 240 + random() % 300;
+		for (offset = 0; offset < len; ++offset)
+			payload[offset] = random();
+
+		ni_buffer_init_dynamic(&buf, 2048);
+		ni_buffer_reserve_head(&buf, 64);
+		ni_buffer_put(&buf, payload, len);
+		if (ni_capture_build_udp_header(&buf, src, 68, dst, 67) < 0) {
+			printf("FAIL: cannot build UDP header\n");
+			failures++;
+			ni_buffer_destroy(&buf);
+			return;
+		}
+
+		checks++;
+		if (!udp_checksum_ok(&buf)) {
+			printf("FAIL: bad checksum of a %u bytes payload\n", len);
+			failures++;
+		}
+
+		/* Like the secs field of a retransmitted DHCP message */
+		for (offset = 0; offset < sizeof(update); ++offset)
+			update[offset] = random();
+		offset = 2 * (random() % ((len - sizeof(update)) / 2));
+
+		checks++;
+		if (ni_capture_update_udp_payload(&buf, offset, update, 2 + 2 * (i % 4)) < 0
+		 || !udp_checksum_ok(&buf)) {
+			printf("FAIL: bad checksum after updating a %u bytes payload at %u\n",
+					len, offset);
+			failures++;
+		}
+
+		checks++;
+		if (ni_capture_update_udp_payload(&buf, offset + 1, update, 2) == 0) {
+			printf("FAIL: accepted an update at an odd offset\n");
+			failures++;
+		}
+
+		ni_buffer_destroy(&buf);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	srandom(1);
+
+	test_checksum();
+	test_udp_update();
+
+	printf("%u checks, %u failures\n", checks, failures);
+	return failures ? 1 : 0;
+}
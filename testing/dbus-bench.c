@@ -0,0 +1,194 @@
+/*
+ * Compare the method call round-trip latency via the dbus daemon
+ * with the one of a direct peer-to-peer connection.
+ *
+ * Forks a small server, which acquires a bus name and listens for
+ * peer connections, and calls its echo method via both transports.
+ * Run it as root on the system bus, or on a private session bus:
+ *
+ *   dbus-run-session -- ./dbus-bench --bus-type session
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/socket.h>
+#include <wicked/dbus.h>
+#include "dbus-server.h"
+
+#define BENCH_BUS_NAME		"org.opensuse.Network.Bench"
+#define BENCH_OBJECT_PATH	"/org/opensuse/Network/Bench/Echo"
+#define BENCH_INTERFACE		"org.opensuse.Network.Bench"
+
+static dbus_bool_t
+bench_echo(ni_dbus_object_t *object, const ni_dbus_method_t *method,
+		unsigned int argc, const ni_dbus_variant_t *argv,
+		ni_dbus_message_t *reply, DBusError *error)
+{
+	return ni_dbus_message_serialize_variants(reply, argc, argv, error);
+}
+
+static ni_dbus_method_t		bench_methods[] = {
+	{ "echo",		"u",		bench_echo },
+	{ NULL }
+};
+
+static const ni_dbus_service_t	bench_service = {
+	.name = BENCH_INTERFACE,
+	.methods = bench_methods,
+};
+
+static const ni_dbus_class_t	bench_class = {
+	.name = "bench",
+};
+
+static void
+bench_serve(const char *bus_type, const char *socket_path, int ready_fd)
+{
+	ni_dbus_server_t *server;
+	ni_dbus_object_t *object;
+
+	if (!(server = ni_dbus_server_open(bus_type, BENCH_BUS_NAME, NULL)))
+		exit(1);
+	if (!ni_dbus_server_listen_peers(server, socket_path))
+		exit(1);
+
+	object = ni_dbus_server_register_object(server, "Echo", &bench_class, NULL);
+	if (!object || !ni_dbus_object_register_service(object, &bench_service))
+		exit(1);
+
+	if (write(ready_fd, "", 1) != 1)
+		exit(1);
+	close(ready_fd);
+
+	while (1)
+		ni_socket_wait(ni_timer_next_timeout());
+}
+
+static int
+compare_ulong(const void *a, const void *b)
+{
+	unsigned long x = *(const unsigned long *) a, y = *(const unsigned long *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int
+bench_run(const char *transport, ni_dbus_client_t *client, unsigned int count)
+{
+	unsigned long *usec, total = 0;
+	ni_dbus_object_t *object;
+	struct timeval start, end, delta;
+	unsigned int i;
+
+	object = ni_dbus_client_object_new(client, &bench_class,
+				BENCH_OBJECT_PATH, BENCH_INTERFACE, NULL);
+	usec = calloc(count, sizeof(usec[0]));
+
+	for (i = 0; i < count; ++i) {
+		uint32_t value = i, result = 0;
+
+		gettimeofday(&start, NULL);
+		if (ni_dbus_object_call_simple(object, NULL, "echo",
+				DBUS_TYPE_UINT32, &value,
+				DBUS_TYPE_UINT32, &result) < 0 || result != value) {
+			fprintf(stderr, "%s: echo call %u failed\n", transport, i);
+			free(usec);
+			return 1;
+		}
+		gettimeofday(&end, NULL);
+		timersub(&end, &start, &delta);
+		usec[i] = delta.tv_sec * 1000000 + delta.tv_usec;
+		total += usec[i];
+	}
+
+	qsort(usec, count, sizeof(usec[0]), compare_ulong);
+	printf("%-6s %8u calls: avg %6lu usec, min %6lu, p50 %6lu, p99 %6lu, max %6lu\n",
+			transport, count, total / count, usec[0], usec[count / 2],
+			usec[count * 99 / 100], usec[count - 1]);
+
+	ni_dbus_object_free(object);
+	free(usec);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static struct option options[] = {
+		{ "bus-type",		required_argument,	NULL,	't' },
+		{ "peer-socket",	required_argument,	NULL,	's' },
+		{ "count",		required_argument,	NULL,	'c' },
+		{ NULL }
+	};
+	const char *bus_type = "system";
+	const char *socket_path = "/tmp/wicked-dbus-bench.sock";
+	unsigned int count = 10000;
+	ni_dbus_client_t *client;
+	int c, pipefd[2], rv = 0;
+	char ready;
+	pid_t pid;
+
+	while ((c = getopt_long(argc, argv, "t:s:c:", options, NULL)) != EOF) {
+		switch (c) {
+		case 't':
+			bus_type = optarg;
+			break;
+		case 's':
+			socket_path = optarg;
+			break;
+		case 'c':
+			if (ni_parse_uint(optarg, &count, 10) < 0 || count == 0)
+				goto usage;
+			break;
+		default:
+		usage:
+			fprintf(stderr, "Usage: %s [--bus-type system|session] "
+					"[--peer-socket path] [--count n]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (pipe(pipefd) < 0 || (pid = fork()) < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (pid == 0) {
+		close(pipefd[0]);
+		bench_serve(bus_type, socket_path, pipefd[1]);
+	}
+	close(pipefd[1]);
+	if (read(pipefd[0], &ready, 1) != 1) {
+		fprintf(stderr, "bench server failed to start\n");
+		waitpid(pid, NULL, 0);
+		return 1;
+	}
+
+	if (!(client = ni_dbus_client_open(bus_type, BENCH_BUS_NAME))) {
+		rv = 1;
+	} else {
+		rv |= bench_run("bus", client, count);
+		ni_dbus_client_free(client);
+	}
+
+	if (!(client = ni_dbus_client_open_peer(socket_path, BENCH_BUS_NAME))) {
+		rv = 1;
+	} else {
+		rv |= bench_run("peer", client, count);
+		ni_dbus_client_free(client);
+	}
+
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+	return rv;
+}
@@ -0,0 +1,302 @@
+/*
+ * Measure the allocations and time per message it takes to serialize
+ * and deserialize typical dbus payloads: the argument dict of a linkUp
+ * call, and a lease as sent with the addrconf callbacks.
+ *
+ * Deserialization is measured both with the heap based decoder and
+ * with the variant pool used by ni_dbus_message_get_args_variants.
+ * Every message is demarshalled from its wire format first, like one
+ * received from the bus; the "demarshal" line shows that share.
+ *
+ *   ./dbus-variant-bench --count 100000
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/time.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <linux/rtnetlink.h>
+
+#include <wicked/util.h>
+#include <wicked/netinfo.h>
+#include <wicked/addrconf.h>
+#include <wicked/address.h>
+#include <wicked/route.h>
+#include <wicked/resolver.h>
+#include <wicked/objectmodel.h>
+#include <wicked/dbus.h>
+#include "dbus-common.h"
+
+/*
+ * Count the allocations of the whole process, including the ones
+ * of libdbus.
+ */
+extern void *		__libc_malloc(size_t);
+extern void *		__libc_calloc(size_t, size_t);
+extern void *		__libc_realloc(void *, size_t);
+
+static unsigned long	nallocs;
+
+void *
+malloc(size_t size)
+{
+	nallocs++;
+	return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+	nallocs++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	nallocs++;
+	return __libc_realloc(ptr, size);
+}
+
+typedef struct bench_payload {
+	const char *		name;
+	char *			wire;
+	int			wire_len;
+	ni_dbus_variant_t	argv[2];
+	unsigned int		argc;
+} bench_payload_t;
+
+#define BENCH_ROUNDS		5
+
+enum {
+	BENCH_SERIALIZE,
+	BENCH_DEMARSHAL,
+	BENCH_DECODE_HEAP,
+	BENCH_DECODE_POOL,
+};
+
+static void
+bench_linkup_payload(bench_payload_t *p)
+{
+	ni_netdev_req_t *req = ni_netdev_req_new();
+	DBusError error = DBUS_ERROR_INIT;
+
+	req->ifflags = NI_IFF_DEVICE_UP | NI_IFF_LINK_UP | NI_IFF_NETWORK_UP;
+	req->mtu = 1500;
+	req->txqlen = 1000;
+	ni_string_dup(&req->alias, "uplink");
+
+	p->name = "linkUp";
+	p->argc = 1;
+	ni_dbus_variant_init_dict(&p->argv[0]);
+	if (!ni_objectmodel_marshal_netdev_request(req, &p->argv[0], &error)) {
+		fprintf(stderr, "cannot marshal link request: %s\n", error.message);
+		exit(1);
+	}
+	ni_netdev_req_free(req);
+}
+
+static void
+bench_lease_payload(bench_payload_t *p)
+{
+	ni_addrconf_lease_t *lease;
+	ni_sockaddr_t addr, gw;
+	ni_uuid_t uuid;
+
+	lease = ni_addrconf_lease_new(NI_ADDRCONF_DHCP, AF_INET);
+	lease->state = NI_ADDRCONF_STATE_GRANTED;
+	lease->time_acquired = time(NULL);
+	ni_uuid_generate(&lease->uuid);
+	ni_string_dup(&lease->hostname, "client.example.com");
+
+	ni_sockaddr_parse(&addr, "192.168.1.100", AF_INET);
+	ni_address_new(AF_INET, 24, &addr, &lease->addrs);
+
+	ni_sockaddr_parse(&addr, "0.0.0.0", AF_INET);
+	ni_sockaddr_parse(&gw, "192.168.1.1", AF_INET);
+	ni_route_create(0, &addr, &gw, RT_TABLE_MAIN, &lease->routes);
+	ni_sockaddr_parse(&addr, "10.0.0.0", AF_INET);
+	ni_sockaddr_parse(&gw, "192.168.1.254", AF_INET);
+	ni_route_create(8, &addr, &gw, RT_TABLE_MAIN, &lease->routes);
+
+	lease->resolver = ni_resolver_info_new();
+	ni_string_dup(&lease->resolver->default_domain, "example.com");
+	ni_string_array_append(&lease->resolver->dns_servers, "192.168.1.1");
+	ni_string_array_append(&lease->resolver->dns_servers, "192.168.1.2");
+	ni_string_array_append(&lease->resolver->dns_search, "example.com");
+	ni_string_array_append(&lease->resolver->dns_search, "corp.example.com");
+	ni_string_array_append(&lease->ntp_servers, "192.168.1.1");
+
+	lease->dhcp4.server_id.s_addr = htonl(0xc0a80101);
+	lease->dhcp4.address.s_addr = htonl(0xc0a80164);
+	lease->dhcp4.netmask.s_addr = htonl(0xffffff00);
+	lease->dhcp4.broadcast.s_addr = htonl(0xc0a801ff);
+	lease->dhcp4.lease_time = 86400;
+	lease->dhcp4.renewal_time = 43200;
+	lease->dhcp4.rebind_time = 75600;
+	lease->dhcp4.mtu = 1500;
+
+	p->name = "lease";
+	p->argc = 2;
+	ni_uuid_generate(&uuid);
+	ni_dbus_variant_set_uuid(&p->argv[0], &uuid);
+	ni_dbus_variant_init_dict(&p->argv[1]);
+	if (!ni_objectmodel_get_addrconf_lease(lease, &p->argv[1])) {
+		fprintf(stderr, "cannot marshal lease\n");
+		exit(1);
+	}
+	ni_addrconf_lease_free(lease);
+}
+
+static ni_dbus_message_t *
+bench_serialize(const bench_payload_t *p)
+{
+	ni_dbus_message_t *msg;
+	DBusError error = DBUS_ERROR_INIT;
+
+	msg = dbus_message_new_signal("/org/opensuse/Network/Interface/1",
+				"org.opensuse.Network.Interface", p->name);
+	if (!ni_dbus_message_serialize_variants(msg, p->argc, p->argv, &error)) {
+		fprintf(stderr, "%s: cannot serialize: %s\n", p->name, error.message);
+		exit(1);
+	}
+	return msg;
+}
+
+static void
+bench_decode_heap(ni_dbus_message_t *msg)
+{
+	ni_dbus_variant_t argv[2];
+	DBusMessageIter iter;
+	unsigned int i, argc;
+
+	memset(argv, 0, sizeof(argv));
+	dbus_message_iter_init(msg, &iter);
+	for (argc = 0; argc < 2; ++argc) {
+		if (dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_INVALID)
+			break;
+		if (!ni_dbus_message_iter_get_variant_data(&iter, &argv[argc]))
+			exit(1);
+		dbus_message_iter_next(&iter);
+	}
+	for (i = 0; i < argc; ++i)
+		ni_dbus_variant_destroy(&argv[i]);
+}
+
+static void
+bench_decode_pool(ni_dbus_message_t *msg)
+{
+	ni_dbus_variant_t argv[2];
+	int i, argc;
+
+	memset(argv, 0, sizeof(argv));
+	if ((argc = ni_dbus_message_get_args_variants(msg, argv, 2)) < 0)
+		exit(1);
+	for (i = 0; i < argc; ++i)
+		ni_dbus_variant_destroy(&argv[i]);
+}
+
+static double
+bench_round(const bench_payload_t *p, int mode, unsigned int count)
+{
+	struct timeval start, end, delta;
+	unsigned int i;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < count; ++i) {
+		ni_dbus_message_t *msg;
+		DBusError error = DBUS_ERROR_INIT;
+
+		if (mode == BENCH_SERIALIZE) {
+			msg = bench_serialize(p);
+		} else
+		if (!(msg = dbus_message_demarshal(p->wire, p->wire_len, &error))) {
+			fprintf(stderr, "%s: cannot demarshal: %s\n", p->name, error.message);
+			exit(1);
+		}
+
+		if (mode == BENCH_DECODE_HEAP)
+			bench_decode_heap(msg);
+		else if (mode == BENCH_DECODE_POOL)
+			bench_decode_pool(msg);
+		dbus_message_unref(msg);
+	}
+	gettimeofday(&end, NULL);
+
+	timersub(&end, &start, &delta);
+	return (delta.tv_sec * 1e9 + delta.tv_usec * 1e3) / count;
+}
+
+/*
+ * Report the best of a few rounds, to filter out noise from other
+ * processes.
+ */
+static void
+bench_run(const bench_payload_t *p, int mode, const char *label, unsigned int count)
+{
+	unsigned long allocs;
+	double nsec, best = 0;
+	unsigned int round;
+
+	allocs = nallocs;
+	for (round = 0; round < BENCH_ROUNDS; ++round) {
+		nsec = bench_round(p, mode, count / BENCH_ROUNDS ?: 1);
+		if (round == 0 || nsec < best)
+			best = nsec;
+	}
+	allocs = (nallocs - allocs) / BENCH_ROUNDS;
+
+	printf("%-8s %-16s %8.1f allocs/msg %10.0f ns/msg\n", p->name, label,
+			(double) allocs / (count / BENCH_ROUNDS ?: 1), best);
+}
+
+int
+main(int argc, char **argv)
+{
+	static struct option options[] = {
+		{ "count",		required_argument,	NULL,	'c' },
+		{ NULL }
+	};
+	bench_payload_t payloads[2];
+	unsigned int i, count = 100000;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "c:", options, NULL)) != EOF) {
+		switch (c) {
+		case 'c':
+			if (ni_parse_uint(optarg, &count, 10) < 0 || count == 0)
+				goto usage;
+			break;
+		default:
+		usage:
+			fprintf(stderr, "Usage: %s [--count n]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	memset(payloads, 0, sizeof(payloads));
+	bench_linkup_payload(&payloads[0]);
+	bench_lease_payload(&payloads[1]);
+
+	for (i = 0; i < 2; ++i) {
+		bench_payload_t *p = &payloads[i];
+		ni_dbus_message_t *msg;
+
+		msg = bench_serialize(p);
+		dbus_message_set_serial(msg, 1);
+		if (!dbus_message_marshal(msg, &p->wire, &p->wire_len))
+			return 1;
+		dbus_message_unref(msg);
+
+		printf("%s: %d bytes\n", p->name, p->wire_len);
+		bench_run(p, BENCH_SERIALIZE, "serialize", count);
+		bench_run(p, BENCH_DEMARSHAL, "demarshal", count);
+		bench_run(p, BENCH_DECODE_HEAP, "demarshal+heap", count);
+		bench_run(p, BENCH_DECODE_POOL, "demarshal+pool", count);
+	}
+	return 0;
+}
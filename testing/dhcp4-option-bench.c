@@ -0,0 +1,114 @@
+/*
+ * Measure how fast the DHCP4 option decoder turns recorded responses
+ * into leases.
+ *
+ *   ./dhcp4-option-bench --count 100000
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/types.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <wicked/util.h>
+#include <wicked/netinfo.h>
+#include <wicked/addrconf.h>
+#include "dhcp4/dhcp.h"
+#include "dhcp4/protocol.h"
+#include "buffer.h"
+#include "dhcp4-payloads.h"
+
+#define BENCH_ROUNDS		5
+
+/*
+ * Parse a response count times, as the fsm would: from a buffer
+ * positioned behind the fixed size message header.
+ */
+static double
+bench_round(const dhcp4_sample_t *s, unsigned int count)
+{
+	static uint32_t data[1500 / sizeof(uint32_t)];
+	struct timeval start, end, delta;
+	const ni_dhcp4_message_t *message;
+	ni_addrconf_lease_t *lease;
+	ni_buffer_t buf;
+	unsigned int i;
+
+	memcpy(data, s->data, s->len);
+	message = (const ni_dhcp4_message_t *) data;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < count; ++i) {
+		ni_buffer_init_reader(&buf, data, s->len);
+		buf.head = sizeof(*message);
+
+		lease = NULL;
+		if (ni_dhcp4_parse_response(message, &buf, &lease) != s->msg_type || !lease) {
+			fprintf(stderr, "unable to parse %s\n", s->name);
+			exit(1);
+		}
+		ni_addrconf_lease_free(lease);
+	}
+	gettimeofday(&end, NULL);
+
+	timersub(&end, &start, &delta);
+	return (delta.tv_sec * 1e9 + delta.tv_usec * 1e3) / count;
+}
+
+/*
+ * Report the best of a few rounds, to filter out noise from other
+ * processes.
+ */
+static double
+bench_run(const dhcp4_sample_t *s, unsigned int count)
+{
+	double nsec, best = 0;
+	unsigned int round;
+
+	for (round = 0; round < BENCH_ROUNDS; ++round) {
+		nsec = bench_round(s, count / BENCH_ROUNDS ?: 1);
+		if (round == 0 || nsec < best)
+			best = nsec;
+	}
+	return best;
+}
+
+int
+main(int argc, char **argv)
+{
+	static struct option options[] = {
+		{ "count",		required_argument,	NULL,	'c' },
+		{ NULL }
+	};
+	unsigned int i, count = 100000;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "c:", options, NULL)) != EOF) {
+		switch (c) {
+		case 'c':
+			if (ni_parse_uint(optarg, &count, 10) < 0 || count == 0)
+				goto usage;
+			break;
+		default:
+		usage:
+			fprintf(stderr, "Usage: %s [--count n]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	printf("%-10s %6s %12s %12s\n", "response", "bytes", "ns/parse", "parses/sec");
+	for (i = 0; i < DHCP4_SAMPLES; ++i) {
+		const dhcp4_sample_t *s = &dhcp4_samples[i];
+		double nsec;
+
+		nsec = bench_run(s, count);
+		printf("%-10s %6u %12.1f %12.0f\n", s->name, s->len, nsec,
+				nsec > 0 ? 1e9 / nsec : 0);
+	}
+	return 0;
+}
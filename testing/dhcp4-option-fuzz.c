@@ -0,0 +1,426 @@
+/*
+ * Feed the DHCP4 option decoder with recorded responses, checks that
+ * splitting options (RFC 3396) does not change the resulting lease,
+ * then with randomly mutated copies of them. A mutated response has
+ * to be either rejected or turned into a lease which can be written
+ * out; run it in valgrind or with -fsanitize=address to catch more.
+ *
+ *   ./dhcp4-option-fuzz --count 100000 --seed 42
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <wicked/util.h>
+#include <wicked/netinfo.h>
+#include <wicked/addrconf.h>
+#include <wicked/resolver.h>
+#include <wicked/route.h>
+#include <wicked/logging.h>
+#include <wicked/xml.h>
+#include "dhcp4/dhcp.h"
+#include "dhcp4/protocol.h"
+#include "dhcp4/lease.h"
+#include "buffer.h"
+#include "dhcp4-payloads.h"
+
+#define DHCP4_OPTIONS_OFFSET	240
+#define MAX_PAYLOAD		1500
+
+typedef struct payload {
+	unsigned char		data[MAX_PAYLOAD];
+	unsigned int		len;
+} payload_t;
+
+static unsigned int		failures;
+static unsigned int		checks;
+
+static void
+fail(const char *fmt, const char *name)
+{
+	printf("FAIL: ");
+	printf(fmt, name);
+	printf("\n");
+	failures++;
+}
+
+static void
+lease_xml_print(const char *str, void *user_data)
+{
+	ni_stringbuf_puts(user_data, str);
+}
+
+/*
+ * The lease as it is written to the lease file
+ */
+static char *
+lease_to_string(ni_addrconf_lease_t *lease)
+{
+	ni_stringbuf_t out = NI_STRINGBUF_INIT_DYNAMIC;
+	xml_node_t *node;
+
+	lease->time_acquired = 0;
+	node = xml_node_new("lease", NULL);
+	if (ni_dhcp4_lease_to_xml(lease, node) == 0)
+		xml_node_print_fn(node, lease_xml_print, &out);
+	xml_node_free(node);
+	return out.string;
+}
+
+static unsigned int
+lease_route_count(const ni_addrconf_lease_t *lease)
+{
+	const ni_route_table_t *tab;
+	unsigned int count = 0;
+
+	for (tab = lease->routes; tab; tab = tab->next)
+		count += tab->routes.count;
+	return count;
+}
+
+static void
+test_samples(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < DHCP4_SAMPLES; ++i) {
+		const dhcp4_sample_t *s = &dhcp4_samples[i];
+		ni_addrconf_lease_t *lease;
+		int msg_type;
+
+		checks++;
+		msg_type = dhcp4_sample_parse(s->data, s->len, &lease);
+		if (msg_type != s->msg_type || !lease) {
+			fail("%s: not parsed", s->name);
+			continue;
+		}
+
+		checks++;
+		if (!lease->dhcp4.address.s_addr || !lease->dhcp4.server_id.s_addr
+		 || !lease->dhcp4.lease_time || !lease->resolver
+		 || !lease->resolver->dns_servers.count || !lease_route_count(lease))
+			fail("%s: incomplete lease", s->name);
+
+		ni_addrconf_lease_free(lease);
+	}
+
+	/* The split classless routes are joined before they are decoded */
+	{
+		ni_addrconf_lease_t *lease;
+
+		checks++;
+		dhcp4_sample_parse(dhcp4_sample_ack_csr, sizeof(dhcp4_sample_ack_csr), &lease);
+		if (!lease || lease_route_count(lease) != 51
+		 || !lease->resolver || !ni_string_eq(lease->resolver->default_domain, "big.example.net"))
+			fail("%s: split or overloaded options not decoded", "ack-csr");
+		if (lease)
+			ni_addrconf_lease_free(lease);
+	}
+
+	/* The empty rapid commit option is a flag */
+	{
+		const dhcp4_sample_t *s = &dhcp4_samples[1];
+		ni_addrconf_lease_t *lease;
+		payload_t p;
+
+		checks++;
+		dhcp4_sample_parse(s->data, s->len, &lease);
+		if (!lease || lease->dhcp4.rapid_commit)
+			fail("%s: rapid commit set without option", s->name);
+		if (lease)
+			ni_addrconf_lease_free(lease);
+
+		checks++;
+		memcpy(p.data, s->data, s->len);
+		p.len = s->len;
+		while (p.len > DHCP4_OPTIONS_OFFSET && p.data[p.len - 1] != DHCP4_END)
+			p.len--;
+		p.data[p.len - 1] = DHCP4_RAPID_COMMIT;
+		p.data[p.len++] = 0;
+		p.data[p.len++] = DHCP4_END;
+		dhcp4_sample_parse(p.data, p.len, &lease);
+		if (!lease || !lease->dhcp4.rapid_commit)
+			fail("%s: rapid commit option not decoded", s->name);
+		if (lease)
+			ni_addrconf_lease_free(lease);
+	}
+}
+
+/*
+ * Options whose instances are concatenated
+ */
+static ni_bool_t
+option_concatenated(unsigned int code)
+{
+	switch (code) {
+	case DHCP4_ROUTERS:
+	case DHCP4_DNSSERVER:
+	case DHCP4_HOSTNAME:
+	case DHCP4_DNSDOMAIN:
+	case DHCP4_NISDOMAIN:
+	case DHCP4_NISSERVER:
+	case DHCP4_NTPSERVER:
+	case DHCP4_NETBIOSNAMESERVER:
+	case DHCP4_POSIX_TZ_STRING:
+	case DHCP4_POSIX_TZ_DBNAME:
+	case DHCP4_DNSSEARCH:
+	case DHCP4_CSR:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/*
+ * Rewrite the options field of a response, splitting the given option
+ * in two instances at the given offset and putting the second one at
+ * the end.
+ */
+static ni_bool_t
+split_option(const dhcp4_sample_t *s, payload_t *p, unsigned int code, unsigned int at)
+{
+	const unsigned char *opt = s->data + DHCP4_OPTIONS_OFFSET;
+	unsigned int olen = s->len - DHCP4_OPTIONS_OFFSET;
+	unsigned int pos = 0, len, out;
+	const unsigned char *tail = NULL;
+	unsigned int tail_len = 0;
+	ni_bool_t found = FALSE;
+
+	memcpy(p->data, s->data, DHCP4_OPTIONS_OFFSET);
+	out = DHCP4_OPTIONS_OFFSET;
+
+	while (pos + 1 < olen && opt[pos] != DHCP4_END) {
+		if (opt[pos] == DHCP4_PAD) {
+			pos++;
+			continue;
+		}
+		len = opt[pos + 1];
+		if (opt[pos] == code && found)
+			return FALSE;	/* already split */
+		if (opt[pos] == code && at < len) {
+			p->data[out++] = code;
+			p->data[out++] = at;
+			memcpy(p->data + out, opt + pos + 2, at);
+			out += at;
+			tail = opt + pos + 2 + at;
+			tail_len = len - at;
+			found = TRUE;
+		} else {
+			memcpy(p->data + out, opt + pos, len + 2);
+			out += len + 2;
+		}
+		pos += len + 2;
+	}
+	if (!found)
+		return FALSE;
+
+	p->data[out++] = code;
+	p->data[out++] = tail_len;
+	memcpy(p->data + out, tail, tail_len);
+	out += tail_len;
+	p->data[out++] = DHCP4_END;
+	p->len = out;
+	return TRUE;
+}
+
+static void
+test_split(void)
+{
+	unsigned int i, code, at;
+
+	for (i = 0; i < DHCP4_SAMPLES; ++i) {
+		const dhcp4_sample_t *s = &dhcp4_samples[i];
+		ni_addrconf_lease_t *lease;
+		char *expect;
+
+		dhcp4_sample_parse(s->data, s->len, &lease);
+		if (!lease)
+			continue;
+		expect = lease_to_string(lease);
+		ni_addrconf_lease_free(lease);
+
+		for (code = 1; code < DHCP4_END; ++code) {
+			if (!option_concatenated(code))
+				continue;
+
+			for (at = 0; at < 255; at += 1 + random() % 5) {
+				payload_t p;
+				char *result;
+
+				if (!split_option(s, &p, code, at))
+					break;
+
+				checks++;
+				dhcp4_sample_parse(p.data, p.len, &lease);
+				if (!lease) {
+					fail("%s: split option not parsed", s->name);
+					continue;
+				}
+				result = lease_to_string(lease);
+				if (!ni_string_eq(result, expect)) {
+					printf("FAIL: %s: option %u split at %u differs\n",
+							s->name, code, at);
+					failures++;
+				}
+				ni_string_free(&result);
+				ni_addrconf_lease_free(lease);
+			}
+		}
+		ni_string_free(&expect);
+	}
+}
+
+static void
+mutate(payload_t *p)
+{
+	unsigned int n, pos, len;
+
+	switch (random() % 6) {
+	case 0:
+		/* flip a bit anywhere */
+		pos = random() % p->len;
+		p->data[pos] ^= 1 << (random() % 8);
+		break;
+
+	case 1:
+		/* garble an option length or code */
+		if (p->len <= DHCP4_OPTIONS_OFFSET)
+			break;
+		pos = DHCP4_OPTIONS_OFFSET + random() % (p->len - DHCP4_OPTIONS_OFFSET);
+		p->data[pos] = random();
+		break;
+
+	case 2:
+		/* truncate */
+		p->len = DHCP4_OPTIONS_OFFSET + random() % (p->len - DHCP4_OPTIONS_OFFSET + 1);
+		break;
+
+	case 3:
+		/* insert a random option in front */
+		len = random() % 64;
+		if (p->len + len + 2 > sizeof(p->data))
+			break;
+		memmove(p->data + DHCP4_OPTIONS_OFFSET + len + 2,
+				p->data + DHCP4_OPTIONS_OFFSET,
+				p->len - DHCP4_OPTIONS_OFFSET);
+		p->data[DHCP4_OPTIONS_OFFSET] = 1 + random() % 254;
+		p->data[DHCP4_OPTIONS_OFFSET + 1] = len;
+		for (n = 0; n < len; ++n)
+			p->data[DHCP4_OPTIONS_OFFSET + 2 + n] = random();
+		p->len += len + 2;
+		break;
+
+	case 4:
+		/* overload the file and sname fields with random data */
+		if (p->len + 3 > sizeof(p->data))
+			break;
+		memmove(p->data + DHCP4_OPTIONS_OFFSET + 3,
+				p->data + DHCP4_OPTIONS_OFFSET,
+				p->len - DHCP4_OPTIONS_OFFSET);
+		p->data[DHCP4_OPTIONS_OFFSET] = DHCP4_OPTIONSOVERLOADED;
+		p->data[DHCP4_OPTIONS_OFFSET + 1] = 1;
+		p->data[DHCP4_OPTIONS_OFFSET + 2] = random() % 4;
+		p->len += 3;
+		for (n = 44; n < 236; ++n)
+			p->data[n] = random() % 4 ? random() : DHCP4_END;
+		break;
+
+	default:
+		/* repeat an option of the response */
+		for (pos = DHCP4_OPTIONS_OFFSET; pos + 1 < p->len; pos += p->data[pos + 1] + 2) {
+			if (p->data[pos] == DHCP4_PAD || p->data[pos] == DHCP4_END)
+				break;
+			if (random() % 4)
+				continue;
+			len = p->data[pos + 1] + 2;
+			if (pos + len > p->len || p->len + len > sizeof(p->data))
+				break;
+			memmove(p->data + pos + len, p->data + pos, p->len - pos);
+			p->len += len;
+			break;
+		}
+		break;
+	}
+}
+
+static void
+test_fuzz(unsigned int count)
+{
+	unsigned int i, n, accepted = 0;
+
+	for (i = 0; i < count; ++i) {
+		const dhcp4_sample_t *s = &dhcp4_samples[random() % DHCP4_SAMPLES];
+		ni_addrconf_lease_t *lease;
+		payload_t p;
+
+		memcpy(p.data, s->data, s->len);
+		p.len = s->len;
+		for (n = 1 + random() % 4; n; --n)
+			mutate(&p);
+
+		checks++;
+		if (dhcp4_sample_parse(p.data, p.len, &lease) < 0) {
+			if (lease) {
+				fail("%s: lease returned for rejected response", s->name);
+				ni_addrconf_lease_free(lease);
+			}
+			continue;
+		}
+		if (!lease) {
+			fail("%s: no lease returned for accepted response", s->name);
+			continue;
+		}
+
+		accepted++;
+		free(lease_to_string(lease));
+		ni_addrconf_lease_free(lease);
+	}
+	printf("%u mutated responses, %u accepted\n", count, accepted);
+}
+
+int
+main(int argc, char **argv)
+{
+	static struct option options[] = {
+		{ "count",	required_argument,	NULL,	'c' },
+		{ "seed",	required_argument,	NULL,	's' },
+		{ NULL }
+	};
+	unsigned int count = 20000, seed = 1;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "c:s:", options, NULL)) != EOF) {
+		switch (c) {
+		case 'c':
+			if (ni_parse_uint(optarg, &count, 10) < 0)
+				goto usage;
+			break;
+		case 's':
+			if (ni_parse_uint(optarg, &seed, 10) < 0)
+				goto usage;
+			break;
+		default:
+		usage:
+			fprintf(stderr, "Usage: %s [--count n] [--seed n]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	/* Mutated responses cause a lot of warnings */
+	ni_log_level_set("error");
+	srandom(seed);
+
+	test_samples();
+	test_split();
+	test_fuzz(count);
+
+	printf("%u checks, %u failures\n", checks, failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * DHCP4 responses for the option decoder fuzz test and benchmark,
+ * as sent by a server: an OFFER and an ACK with the usual options,
+ * and an ACK with a classless route option split in two (RFC 3396)
+ * and DNS options in the overloaded file field.
+ */
+#ifndef __WICKED_TESTING_DHCP4_PAYLOADS_H__
+#define __WICKED_TESTING_DHCP4_PAYLOADS_H__
+
+static const unsigned char	dhcp4_sample_offer[] = {
+	0x02, 0x01, 0x06, 0x00, 0x39, 0x03, 0xf3, 0x26, 0x00, 0x00, 0x80, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0xc0, 0xa8, 0x0a, 0x2a, 0xc0, 0xa8, 0x0a, 0x01,
+	0x00, 0x00, 0x00, 0x00, 0x52, 0x54, 0x00, 0xa1, 0xb2, 0xc3, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x63, 0x82, 0x53, 0x63,
+	0x35, 0x01, 0x02, 0x36, 0x04, 0xc0, 0xa8, 0x0a, 0x01, 0x33, 0x04, 0x00,
+	0x00, 0xa8, 0xc0, 0x01, 0x04, 0xff, 0xff, 0xff, 0x00, 0x1c, 0x04, 0xc0,
+	0xa8, 0x0a, 0xff, 0x03, 0x08, 0xc0, 0xa8, 0x0a, 0x01, 0xc0, 0xa8, 0x0a,
+	0x02, 0x06, 0x0c, 0xc0, 0xa8, 0x0a, 0x35, 0xc0, 0xa8, 0x0a, 0x36, 0x09,
+	0x09, 0x09, 0x09, 0x0f, 0x0b, 0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65,
+	0x2e, 0x63, 0x6f, 0x6d, 0x77, 0x1a, 0x07, 0x65, 0x78, 0x61, 0x6d, 0x70,
+	0x6c, 0x65, 0x03, 0x63, 0x6f, 0x6d, 0x00, 0x03, 0x6c, 0x61, 0x62, 0xc0,
+	0x00, 0x04, 0x63, 0x6f, 0x72, 0x70, 0xc0, 0x00, 0x2a, 0x04, 0xc0, 0xa8,
+	0x0a, 0x7b, 0x1a, 0x02, 0x05, 0xdc, 0xff,
+};
+
+static const unsigned char	dhcp4_sample_ack[] = {
+	0x02, 0x01, 0x06, 0x00, 0x39, 0x03, 0xf3, 0x26, 0x00, 0x00, 0x80, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0xc0, 0xa8, 0x0a, 0x2a, 0xc0, 0xa8, 0x0a, 0x01,
+	0x00, 0x00, 0x00, 0x00, 0x52, 0x54, 0x00, 0xa1, 0xb2, 0xc3, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x62, 0x6f, 0x6f, 0x74,
+	0x2e, 0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2e, 0x63, 0x6f, 0x6d,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x2f, 0x70, 0x78, 0x65, 0x6c, 0x69, 0x6e, 0x75, 0x78, 0x2e, 0x30, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x63, 0x82, 0x53, 0x63,
+	0x35, 0x01, 0x05, 0x36, 0x04, 0xc0, 0xa8, 0x0a, 0x01, 0x33, 0x04, 0x00,
+	0x00, 0xa8, 0xc0, 0x3a, 0x04, 0x00, 0x00, 0x54, 0x60, 0x3b, 0x04, 0x00,
+	0x00, 0x93, 0xa8, 0x01, 0x04, 0xff, 0xff, 0xff, 0x00, 0x03, 0x04, 0xc0,
+	0xa8, 0x0a, 0x01, 0x79, 0x13, 0x00, 0xc0, 0xa8, 0x0a, 0x01, 0x08, 0x0a,
+	0xc0, 0xa8, 0x0a, 0x02, 0x14, 0xac, 0x10, 0x20, 0xc0, 0xa8, 0x0a, 0x03,
+	0x06, 0x08, 0xc0, 0xa8, 0x0a, 0x35, 0xc0, 0xa8, 0x0a, 0x36, 0x0f, 0x0b,
+	0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2e, 0x63, 0x6f, 0x6d, 0x0c,
+	0x07, 0x68, 0x6f, 0x73, 0x74, 0x2d, 0x34, 0x32, 0x28, 0x0f, 0x6e, 0x69,
+	0x73, 0x2e, 0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2e, 0x63, 0x6f,
+	0x6d, 0x29, 0x08, 0xc0, 0xa8, 0x0a, 0x07, 0xc0, 0xa8, 0x0a, 0x08, 0x2c,
+	0x04, 0xc0, 0xa8, 0x0a, 0x09, 0x2e, 0x01, 0x08, 0x2a, 0x08, 0xc0, 0xa8,
+	0x0a, 0x7b, 0xc0, 0xa8, 0x0a, 0x7c, 0x64, 0x1a, 0x43, 0x45, 0x54, 0x2d,
+	0x31, 0x43, 0x45, 0x53, 0x54, 0x2c, 0x4d, 0x33, 0x2e, 0x35, 0x2e, 0x30,
+	0x2c, 0x4d, 0x31, 0x30, 0x2e, 0x35, 0x2e, 0x30, 0x2f, 0x33, 0x65, 0x0d,
+	0x45, 0x75, 0x72, 0x6f, 0x70, 0x65, 0x2f, 0x42, 0x65, 0x72, 0x6c, 0x69,
+	0x6e, 0xff,
+};
+
+static const unsigned char	dhcp4_sample_ack_csr[] = {
+	0x02, 0x01, 0x06, 0x00, 0x0b, 0xad, 0xca, 0xfe, 0x00, 0x00, 0x80, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x0a, 0xc8, 0x03, 0x11, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x52, 0x54, 0x00, 0xa1, 0xb2, 0xc3, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x06, 0x04, 0x0a, 0xc8, 0x00, 0x35, 0x0f, 0x0f, 0x62, 0x69, 0x67, 0x2e,
+	0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2e, 0x6e, 0x65, 0x74, 0xff,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x63, 0x82, 0x53, 0x63,
+	0x35, 0x01, 0x05, 0x36, 0x04, 0x0a, 0xc8, 0x00, 0xfe, 0x33, 0x04, 0x00,
+	0x01, 0x51, 0x80, 0x34, 0x01, 0x01, 0x01, 0x04, 0xff, 0xff, 0x00, 0x00,
+	0x79, 0xff, 0x14, 0x0a, 0x00, 0x00, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a,
+	0x00, 0x10, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x00, 0x20, 0x0a, 0xc8,
+	0x00, 0x01, 0x14, 0x0a, 0x00, 0x30, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a,
+	0x00, 0x40, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x00, 0x50, 0x0a, 0xc8,
+	0x00, 0x01, 0x14, 0x0a, 0x00, 0x60, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a,
+	0x00, 0x70, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x00, 0x80, 0x0a, 0xc8,
+	0x00, 0x01, 0x14, 0x0a, 0x00, 0x90, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a,
+	0x00, 0xa0, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x00, 0xb0, 0x0a, 0xc8,
+	0x00, 0x01, 0x14, 0x0a, 0x00, 0xc0, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a,
+	0x00, 0xd0, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x00, 0xe0, 0x0a, 0xc8,
+	0x00, 0x01, 0x14, 0x0a, 0x00, 0xf0, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a,
+	0x01, 0x00, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x01, 0x10, 0x0a, 0xc8,
+	0x00, 0x01, 0x14, 0x0a, 0x01, 0x20, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a,
+	0x01, 0x30, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x01, 0x40, 0x0a, 0xc8,
+	0x00, 0x01, 0x14, 0x0a, 0x01, 0x50, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a,
+	0x01, 0x60, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x01, 0x70, 0x0a, 0xc8,
+	0x00, 0x01, 0x14, 0x0a, 0x01, 0x80, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a,
+	0x01, 0x90, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x01, 0xa0, 0x0a, 0xc8,
+	0x00, 0x01, 0x14, 0x0a, 0x01, 0xb0, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a,
+	0x01, 0xc0, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x01, 0xd0, 0x0a, 0xc8,
+	0x00, 0x01, 0x14, 0x0a, 0x01, 0xe0, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a,
+	0x01, 0xf0, 0x0a, 0xc8, 0x00, 0x79, 0x96, 0x01, 0x14, 0x0a, 0x02, 0x00,
+	0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x02, 0x10, 0x0a, 0xc8, 0x00, 0x01,
+	0x14, 0x0a, 0x02, 0x20, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x02, 0x30,
+	0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x02, 0x40, 0x0a, 0xc8, 0x00, 0x01,
+	0x14, 0x0a, 0x02, 0x50, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x02, 0x60,
+	0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x02, 0x70, 0x0a, 0xc8, 0x00, 0x01,
+	0x14, 0x0a, 0x02, 0x80, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x02, 0x90,
+	0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x02, 0xa0, 0x0a, 0xc8, 0x00, 0x01,
+	0x14, 0x0a, 0x02, 0xb0, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x02, 0xc0,
+	0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x02, 0xd0, 0x0a, 0xc8, 0x00, 0x01,
+	0x14, 0x0a, 0x02, 0xe0, 0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x02, 0xf0,
+	0x0a, 0xc8, 0x00, 0x01, 0x14, 0x0a, 0x03, 0x00, 0x0a, 0xc8, 0x00, 0x01,
+	0x14, 0x0a, 0x03, 0x10, 0x0a, 0xc8, 0x00, 0x01, 0x00, 0x0a, 0xc8, 0x00,
+	0x01, 0xff,
+};
+
+typedef struct dhcp4_sample {
+	const char *		name;
+	const unsigned char *	data;
+	unsigned int		len;
+	int			msg_type;
+} dhcp4_sample_t;
+
+static const dhcp4_sample_t	dhcp4_samples[] = {
+	{ "offer",	dhcp4_sample_offer,	sizeof(dhcp4_sample_offer),	DHCP4_OFFER	},
+	{ "ack",	dhcp4_sample_ack,	sizeof(dhcp4_sample_ack),	DHCP4_ACK	},
+	{ "ack-csr",	dhcp4_sample_ack_csr,	sizeof(dhcp4_sample_ack_csr),	DHCP4_ACK	},
+};
+
+#define DHCP4_SAMPLES	(sizeof(dhcp4_samples) / sizeof(dhcp4_samples[0]))
+
+/*
+ * Parse a response the way the fsm does, from a copy of the packet
+ * data in a buffer of its own.
+ */
+static inline int
+dhcp4_sample_parse(const unsigned char *data, size_t len, ni_addrconf_lease_t **leasep)
+{
+	const ni_dhcp4_message_t *message;
+	ni_buffer_t buf;
+	int rv;
+
+	*leasep = NULL;
+	ni_buffer_init_dynamic(&buf, len ? len : 1);
+	ni_buffer_put(&buf, data, len);
+	if (!(message = ni_buffer_pull_head(&buf, sizeof(*message)))) {
+		ni_buffer_destroy(&buf);
+		return -1;
+	}
+	rv = ni_dhcp4_parse_response(message, &buf, leasep);
+	ni_buffer_destroy(&buf);
+	return rv;
+}
+
+#endif /* __WICKED_TESTING_DHCP4_PAYLOADS_H__ */
@@ -0,0 +1,174 @@
+/*
+ * Compare the device lookup of the supplicants by interface index,
+ * a walk of the active device list as used before and the ifindex
+ * map, for synthetic link events on many devices. Part of the devices
+ * is recreated with new interface indexes first, as with containers
+ * coming and going.
+ *
+ *   ./ifindex-map-bench --devices 4096 --count 1000000
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/time.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <wicked/util.h>
+#include "ifindex-map.h"
+#include "util_priv.h"
+
+#define BENCH_ROUNDS		5
+
+typedef struct bench_device	bench_device_t;
+struct bench_device {
+	bench_device_t *	next;
+	unsigned int		ifindex;
+	unsigned int		events;
+};
+
+static bench_device_t *		bench_active;
+static ni_ifindex_map_t		bench_index;
+
+static bench_device_t *
+list_by_index(unsigned int ifindex)
+{
+	bench_device_t *dev;
+
+	for (dev = bench_active; dev; dev = dev->next) {
+		if (dev->ifindex == ifindex)
+			return dev;
+	}
+	return NULL;
+}
+
+static bench_device_t *
+map_by_index(unsigned int ifindex)
+{
+	return ni_ifindex_map_get(&bench_index, ifindex);
+}
+
+static void
+bench_devices_create(bench_device_t *devs, unsigned int ndevs)
+{
+	bench_device_t **tail = &bench_active;
+	unsigned int i, ifindex = 2;
+
+	for (i = 0; i < ndevs; ++i) {
+		devs[i].ifindex = ifindex++;
+		ni_ifindex_map_set(&bench_index, devs[i].ifindex, &devs[i]);
+		*tail = &devs[i];
+		tail = &devs[i].next;
+	}
+
+	/* recreate every third device with a new index */
+	for (i = 0; i < ndevs; i += 3) {
+		ni_ifindex_map_remove(&bench_index, devs[i].ifindex, &devs[i]);
+		devs[i].ifindex = ifindex++;
+		ni_ifindex_map_set(&bench_index, devs[i].ifindex, &devs[i]);
+	}
+}
+
+static double
+bench_round(bench_device_t *(*lookup)(unsigned int), const unsigned int *events,
+		unsigned int nevents, unsigned int count)
+{
+	struct timeval start, end, delta;
+	bench_device_t *dev;
+	unsigned int i;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < count; ++i) {
+		if ((dev = lookup(events[i % nevents])) != NULL)
+			dev->events++;
+	}
+	gettimeofday(&end, NULL);
+
+	timersub(&end, &start, &delta);
+	return (delta.tv_sec * 1e9 + delta.tv_usec * 1e3) / count;
+}
+
+/*
+ * Report the best of a few rounds, to filter out noise from other
+ * processes.
+ */
+static double
+bench_run(bench_device_t *(*lookup)(unsigned int), const unsigned int *events,
+		unsigned int nevents, unsigned int count)
+{
+	double nsec, best = 0;
+	unsigned int round;
+
+	for (round = 0; round < BENCH_ROUNDS; ++round) {
+		nsec = bench_round(lookup, events, nevents, count / BENCH_ROUNDS ?: 1);
+		if (round == 0 || nsec < best)
+			best = nsec;
+	}
+	return best;
+}
+
+int
+main(int argc, char **argv)
+{
+	static struct option options[] = {
+		{ "devices",		required_argument,	NULL,	'd' },
+		{ "count",		required_argument,	NULL,	'c' },
+		{ NULL }
+	};
+	unsigned int i, ndevs = 4096, count = 1000000, nevents;
+	unsigned int *events;
+	bench_device_t *devs;
+	double list, map;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "d:c:", options, NULL)) != EOF) {
+		switch (c) {
+		case 'd':
+			if (ni_parse_uint(optarg, &ndevs, 10) < 0 || ndevs == 0)
+				goto usage;
+			break;
+		case 'c':
+			if (ni_parse_uint(optarg, &count, 10) < 0 || count == 0)
+				goto usage;
+			break;
+		default:
+		usage:
+			fprintf(stderr, "Usage: %s [--devices n] [--count n]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	devs = xcalloc(ndevs, sizeof(devs[0]));
+	bench_devices_create(devs, ndevs);
+
+	/* link events for random devices, some for interfaces we don't manage */
+	nevents = 65536;
+	events = xcalloc(nevents, sizeof(events[0]));
+	for (i = 0; i < nevents; ++i) {
+		if (random() % 10)
+			events[i] = devs[random() % ndevs].ifindex;
+		else
+			events[i] = 2 * ndevs + random() % ndevs;
+	}
+
+	for (i = 0; i < nevents; ++i) {
+		if (list_by_index(events[i]) != map_by_index(events[i])) {
+			fprintf(stderr, "lookup mismatch for ifindex %u\n", events[i]);
+			return 1;
+		}
+	}
+
+	list = bench_run(list_by_index, events, nevents, count);
+	map = bench_run(map_by_index, events, nevents, count);
+
+	printf("%u devices, %u events\n", ndevs, count);
+	printf("%-12s %10.1f nsec/event\n", "list walk", list);
+	printf("%-12s %10.1f nsec/event\n", "ifindex map", map);
+
+	ni_ifindex_map_destroy(&bench_index);
+	free(events);
+	free(devs);
+	return 0;
+}
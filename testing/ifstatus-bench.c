@@ -0,0 +1,125 @@
+/*
+ * Compare how many "wicked show" (or ifstatus) invocations per second
+ * we can run via dbus with the ones reading the netif snapshot of wickedd.
+ *
+ * Needs a running wickedd with a <netif-snapshot> configured:
+ *
+ *   ./ifstatus-bench --wicked /usr/sbin/wicked --count 200 all
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+
+#include <wicked/util.h>
+#include <wicked/constants.h>
+
+static const char *	opt_wicked = "/usr/sbin/wicked";
+static const char *	opt_config;
+static const char *	opt_command = "show";
+
+static int
+bench_run(const char *mode, char **ifnames, unsigned int count)
+{
+	struct timeval start, end, delta;
+	const char *args[64];
+	unsigned int i, n = 0;
+	double secs;
+
+	args[n++] = opt_wicked;
+	if (opt_config) {
+		args[n++] = "--config";
+		args[n++] = opt_config;
+	}
+	args[n++] = opt_command;
+	args[n++] = "--brief";
+	if (mode)
+		args[n++] = mode;
+	for (i = 0; ifnames[i] && n < 63; ++i)
+		args[n++] = ifnames[i];
+	args[n] = NULL;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < count; ++i) {
+		int status;
+		pid_t pid;
+
+		if ((pid = fork()) < 0) {
+			perror("fork");
+			return 1;
+		}
+		if (pid == 0) {
+			int fd = open("/dev/null", O_WRONLY);
+
+			dup2(fd, 1);
+			execv(opt_wicked, (char **) args);
+			_exit(127);
+		}
+		if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+		    WEXITSTATUS(status) == 127 ||
+		    WEXITSTATUS(status) == NI_WICKED_ST_ERROR ||
+		    WEXITSTATUS(status) == NI_WICKED_ST_USAGE) {
+			fprintf(stderr, "%s %s %s failed\n", opt_wicked, opt_command,
+					mode ? mode : "");
+			return 1;
+		}
+	}
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &delta);
+	secs = delta.tv_sec + delta.tv_usec / 1e6;
+
+	printf("%-10s %6u runs in %7.3f sec: %8.1f invocations/sec\n",
+			mode ? mode : "dbus", count, secs, count / secs);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static struct option options[] = {
+		{ "wicked",		required_argument,	NULL,	'w' },
+		{ "config",		required_argument,	NULL,	'f' },
+		{ "command",		required_argument,	NULL,	'C' },
+		{ "count",		required_argument,	NULL,	'c' },
+		{ NULL }
+	};
+	unsigned int count = 100;
+	int c, rv = 0;
+
+	while ((c = getopt_long(argc, argv, "w:f:C:c:", options, NULL)) != EOF) {
+		switch (c) {
+		case 'w':
+			opt_wicked = optarg;
+			break;
+		case 'f':
+			opt_config = optarg;
+			break;
+		case 'C':
+			opt_command = optarg;
+			break;
+		case 'c':
+			if (ni_parse_uint(optarg, &count, 10) < 0 || count == 0)
+				goto usage;
+			break;
+		default:
+		usage:
+			fprintf(stderr, "Usage: %s [--wicked path] [--config file] "
+					"[--command show|ifstatus] [--count n] "
+					"<ifname ...>|all\n", argv[0]);
+			return 1;
+		}
+	}
+	if (optind >= argc)
+		goto usage;
+
+	rv |= bench_run(NULL, argv + optind, count);
+	rv |= bench_run("--snapshot", argv + optind, count);
+	return rv;
+}
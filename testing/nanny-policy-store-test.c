@@ -0,0 +1,129 @@
+/*
+ * Check the nanny policy store: policies written, replaced and deleted
+ * have to come back from a rescan of the file as last written.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include "nanny/nanny.h"
+
+static unsigned int	failures;
+static unsigned int	checks;
+
+static char		store_path[] = "/tmp/nanny-policy-store-test.XXXXXX";
+
+static void
+check(ni_bool_t ok, const char *fmt, ...)
+{
+	va_list ap;
+
+	checks++;
+	if (ok)
+		return;
+
+	failures++;
+	printf("FAIL: ");
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+	printf("\n");
+}
+
+static ni_nanny_policy_store_t *
+test_reopen(ni_nanny_policy_store_t *store)
+{
+	if (store)
+		ni_nanny_policy_store_close(store);
+	return ni_nanny_policy_store_open(store_path);
+}
+
+static const char *
+test_lookup(ni_nanny_policy_store_t *store, const char *name, char **doc)
+{
+	unsigned int i;
+
+	ni_string_free(doc);
+	for (i = 0; i < store->count; ++i) {
+		if (ni_string_eq(store->data[i].name, name)) {
+			*doc = ni_nanny_policy_store_get(store, i);
+			return *doc ? *doc : "";
+		}
+	}
+	return NULL;
+}
+
+static void
+test_put_drop(void)
+{
+	ni_nanny_policy_store_t *store;
+	char *doc = NULL;
+
+	store = test_reopen(NULL);
+	check(store != NULL, "put-drop: cannot open store");
+	if (!store)
+		return;
+
+	check(ni_nanny_policy_store_put(store, "policyA", "<policy name=\"policyA\"/>"),
+			"put-drop: cannot put policyA");
+	check(ni_nanny_policy_store_put(store, "policyB", "<policy name=\"policyB\"/>"),
+			"put-drop: cannot put policyB");
+	check(ni_nanny_policy_store_flush(store), "put-drop: cannot flush");
+	check(ni_nanny_policy_store_drop(store, "policyA"), "put-drop: cannot drop policyA");
+	check(test_lookup(store, "policyA", &doc) == NULL,
+			"put-drop: dropped policyA still in the index");
+	check(ni_nanny_policy_store_flush(store), "put-drop: cannot flush drop");
+
+	store = test_reopen(store);
+	check(store && store->count == 1, "put-drop: %u policies after rescan",
+			store ? store->count : 0);
+	if (!store)
+		return;
+	check(test_lookup(store, "policyA", &doc) == NULL,
+			"put-drop: dropped policyA back after rescan");
+	check(ni_string_eq(test_lookup(store, "policyB", &doc), "<policy name=\"policyB\"/>"),
+			"put-drop: policyB is \"%s\" after rescan", doc);
+
+	/* put it again after the delete: the new one is live */
+	check(ni_nanny_policy_store_put(store, "policyA", "<policy name=\"policyA\" v=\"2\"/>"),
+			"put-drop: cannot put policyA again");
+	check(ni_nanny_policy_store_put(store, "policyB", "<policy name=\"policyB\" v=\"2\"/>"),
+			"put-drop: cannot replace policyB");
+	store = test_reopen(store);
+	check(store && store->count == 2, "put-drop: %u policies after second rescan",
+			store ? store->count : 0);
+	if (!store)
+		return;
+	check(ni_string_eq(test_lookup(store, "policyA", &doc), "<policy name=\"policyA\" v=\"2\"/>"),
+			"put-drop: policyA is \"%s\" after put, drop, put", doc);
+	check(ni_string_eq(test_lookup(store, "policyB", &doc), "<policy name=\"policyB\" v=\"2\"/>"),
+			"put-drop: policyB is \"%s\" after replace", doc);
+
+	ni_string_free(&doc);
+	ni_nanny_policy_store_close(store);
+}
+
+int
+main(int argc, char **argv)
+{
+	int fd;
+
+	if ((fd = mkstemp(store_path)) < 0) {
+		perror(store_path);
+		return 1;
+	}
+	close(fd);
+
+	test_put_drop();
+
+	unlink(store_path);
+	printf("%u checks, %u failures\n", checks, failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+#!/bin/bash
+#
+# DHCPv4 rapid commit (RFC 4039) test
+#
+# Creates a veth pair, runs dhcp4-responder.py on one end and the
+# wickedd-dhcp4 tester on the other one and checks that
+#
+#  - a rapid commit request to a rapid commit server is answered by
+#    an ACK to the DISCOVER,
+#  - a rapid commit request to a regular server falls back to the
+#    OFFER/REQUEST/ACK exchange,
+#  - a regular request to a rapid commit server uses the regular
+#    OFFER/REQUEST/ACK exchange,
+#
+# and that each of them ends with a bound lease.
+#
+# Needs root (veth, packet sockets) and python3.
+#
+# Usage: dhcp4-rapid-commit.sh [path to wickedd-dhcp4]
+#
+
+EXPECTED_ARGS=1
+
+scriptdir=$(cd "$(dirname "$0")" && pwd)
+
+if [[ $# -gt $EXPECTED_ARGS ]]; then
+	echo "Usage: `basename $0` [path to wickedd-dhcp4]"
+	exit 1
+fi
+
+DHCP4=${1:-${scriptdir}/../../dhcp4/wickedd-dhcp4}
+RESPONDER=${scriptdir}/dhcp4-responder.py
+CLIENT_IF=wdhcp4t0
+SERVER_IF=wdhcp4t1
+
+if [[ ! -x "$DHCP4" ]]; then
+	echo "Cannot find wickedd-dhcp4 at $DHCP4"
+	exit 1
+fi
+if [[ $EUID -ne 0 ]]; then
+	echo "`basename $0` needs to be run as root"
+	exit 1
+fi
+
+tmpdir=$(mktemp -d /tmp/dhcp4-rapid-commit.XXXXXX) || exit 1
+responder_pid=
+
+cleanup()
+{
+	if [[ -n "$responder_pid" ]]; then
+		kill "$responder_pid" 2>/dev/null
+		wait "$responder_pid" 2>/dev/null
+	fi
+	responder_pid=
+	ip link del "$CLIENT_IF" 2>/dev/null
+	rm -rf "$tmpdir"
+}
+trap cleanup EXIT
+
+ip link add "$CLIENT_IF" type veth peer name "$SERVER_IF" || exit 1
+ip link set "$CLIENT_IF" up || exit 1
+ip link set "$SERVER_IF" up || exit 1
+
+cat > "$tmpdir/config.xml" <<EOF
+<config>
+  <piddir path="$tmpdir" mode="0755"/>
+  <statedir path="$tmpdir" mode="0755"/>
+  <storedir path="$tmpdir" mode="0755"/>
+</config>
+EOF
+
+for rapid in true false; do
+	cat > "$tmpdir/request-$rapid.xml" <<EOF
+<request type="lease">
+  <rapid-commit>$rapid</rapid-commit>
+</request>
+EOF
+done
+
+failed=0
+
+# run_test <name> <responder options> <request rapid-commit> <expected exchange>
+run_test()
+{
+	local name=$1 responder_opts=$2 rapid=$3 expected=$4
+	local exchange
+
+	rm -f "$tmpdir/responder.log" "$tmpdir/lease.info"
+
+	python3 "$RESPONDER" $responder_opts "$SERVER_IF" > "$tmpdir/responder.log" &
+	responder_pid=$!
+	sleep 1
+
+	(cd "$tmpdir" && "$DHCP4" --config "$tmpdir/config.xml" \
+		--test --test-timeout 10 \
+		--test-request "$tmpdir/request-$rapid.xml" \
+		--test-output "$tmpdir/lease.info" \
+		--test-format leaseinfo "$CLIENT_IF") > "$tmpdir/dhcp4.log" 2>&1
+
+	kill "$responder_pid" 2>/dev/null
+	wait "$responder_pid" 2>/dev/null
+	responder_pid=
+
+	exchange=$(sed -e 's/^.*: //' "$tmpdir/responder.log" | tr '\n' ',')
+	exchange=${exchange%,}
+
+	if [[ "$exchange" != "$expected" ]]; then
+		echo "FAIL: $name: exchange '$exchange', expected '$expected'"
+		cat "$tmpdir/dhcp4.log"
+		failed=$((failed + 1))
+	elif ! grep -q "^IPADDR='10.1.0.100/24'" "$tmpdir/lease.info" 2>/dev/null; then
+		echo "FAIL: $name: no lease bound"
+		cat "$tmpdir/dhcp4.log"
+		failed=$((failed + 1))
+	else
+		echo "PASS: $name"
+	fi
+}
+
+run_test "rapid commit" "--rapid" true \
+	"type 1 -> 5"
+run_test "rapid commit, regular server" "" true \
+	"type 1 -> 2,type 3 -> 5"
+run_test "regular request, rapid commit server" "--rapid" false \
+	"type 1 -> 2,type 3 -> 5"
+
+if [[ $failed -ne 0 ]]; then
+	echo "$failed test(s) failed"
+	exit 1
+fi
+exit 0
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+#
+# Minimal scripted DHCPv4 responder, used by dhcp4-rapid-commit.sh
+#
+# Answers every DISCOVER on the given interface with an OFFER (or, with
+# --rapid, with an ACK when the DISCOVER carries the rapid commit option)
+# and every REQUEST with an ACK. Each answer is logged on stdout as
+#
+#	<ifname>: type <request msg type> -> <reply msg type>
+#
+# so the caller can check which exchange took place.
+#
+# Usage: dhcp4-responder.py [--rapid] [--network 10.N.0.0/24] <ifname>
+#
+
+import socket, struct, select, sys
+
+ETH_P_IP	= 0x0800
+DHCP_DISCOVER	= 1
+DHCP_OFFER	= 2
+DHCP_REQUEST	= 3
+DHCP_ACK	= 5
+OPT_MSGTYPE	= 53
+OPT_SERVERID	= 54
+OPT_RAPID	= 80
+
+def usage():
+	sys.stderr.write("Usage: %s [--rapid] [--network <N>] <ifname>\n" % sys.argv[0])
+	sys.exit(1)
+
+def csum(b):
+	if len(b) % 2:
+		b += b'\0'
+	s = sum(struct.unpack('!%dH' % (len(b) // 2), b))
+	while s >> 16:
+		s = (s & 0xffff) + (s >> 16)
+	return ~s & 0xffff
+
+def inaddr(a):
+	return socket.inet_aton(a)
+
+def options_parse(b):
+	opts = {}
+	i = 0
+	while i < len(b):
+		code = b[i]
+		if code == 0:
+			i += 1
+			continue
+		if code == 255 or i + 1 >= len(b):
+			break
+		olen = b[i + 1]
+		opts[code] = b[i + 2:i + 2 + olen]
+		i += 2 + olen
+	return opts
+
+def build_reply(req, mtype, server, yiaddr, rapid):
+	op, htype, hlen, hops, xid, secs, flags = struct.unpack('!BBBBIHH', req[:12])
+	chaddr = req[28:44]
+
+	msg = struct.pack('!BBBBIHH', 2, htype, hlen, 0, xid, 0, flags)
+	msg += b'\0' * 4 + inaddr(yiaddr) + inaddr(server) + b'\0' * 4
+	msg += chaddr + b'\0' * 192 + b'\x63\x82\x53\x63'
+	msg += bytes([OPT_MSGTYPE, 1, mtype, OPT_SERVERID, 4]) + inaddr(server)
+	msg += bytes([51, 4]) + struct.pack('!I', 3600)
+	msg += bytes([1, 4]) + inaddr('255.255.255.0')
+	msg += bytes([3, 4]) + inaddr(server)
+	if rapid:
+		msg += bytes([OPT_RAPID, 0])
+	msg += b'\xff'
+
+	udp = struct.pack('!HHHH', 67, 68, 8 + len(msg), 0) + msg
+	iph = struct.pack('!BBHHHBBH4s4s', 0x45, 0, 20 + len(udp), 0, 0, 64, 17, 0,
+			inaddr(server), inaddr('255.255.255.255'))
+	iph = iph[:10] + struct.pack('!H', csum(iph)) + iph[12:]
+	eth = b'\xff' * 6 + b'\x02\0\0\0\0\x01' + struct.pack('!H', ETH_P_IP)
+	return eth + iph + udp
+
+def main():
+	args = sys.argv[1:]
+	rapid = False
+	network = 1
+
+	while args and args[0].startswith('--'):
+		opt = args.pop(0)
+		if opt == '--rapid':
+			rapid = True
+		elif opt == '--network' and args:
+			network = int(args.pop(0))
+		else:
+			usage()
+	if len(args) != 1:
+		usage()
+	ifname = args[0]
+
+	server = '10.%d.0.1' % network
+	yiaddr = '10.%d.0.100' % network
+
+	sock = socket.socket(socket.AF_PACKET, socket.SOCK_RAW, socket.htons(ETH_P_IP))
+	sock.bind((ifname, ETH_P_IP))
+
+	while True:
+		select.select([sock], [], [])
+		pkt, addr = sock.recvfrom(4096)
+		if addr[2] == socket.PACKET_OUTGOING:
+			continue
+
+		ip = pkt[14:]
+		if len(ip) < 20 or ip[9] != 17:
+			continue
+		ihl = (ip[0] & 15) * 4
+		sport, dport = struct.unpack('!HH', ip[ihl:ihl + 4])
+		if dport != 67:
+			continue
+
+		req = ip[ihl + 8:]
+		if len(req) < 240:
+			continue
+		opts = options_parse(req[240:])
+		mtype = opts.get(OPT_MSGTYPE, b'\0')[0]
+
+		if mtype == DHCP_DISCOVER:
+			if rapid and OPT_RAPID in opts:
+				reply = DHCP_ACK
+			else:
+				reply = DHCP_OFFER
+		elif mtype == DHCP_REQUEST:
+			if OPT_SERVERID in opts and opts[OPT_SERVERID] != inaddr(server):
+				continue
+			reply = DHCP_ACK
+		else:
+			continue
+
+		print('%s: type %d -> %d' % (ifname, mtype, reply), flush=True)
+		sock.send(build_reply(req, reply, server, yiaddr,
+				rapid and mtype == DHCP_DISCOVER))
+
+if __name__ == '__main__':
+	main()
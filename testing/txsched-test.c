@@ -0,0 +1,225 @@
+/*
+ * Check the addrconf transmit scheduler: the jitter window, the rate
+ * and burst limits, jobs started at their deadline over the rate and
+ * cancelled or resubmitted jobs.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <wicked/util.h>
+#include <wicked/socket.h>
+#include "txsched.h"
+
+#define NJOBS		20
+#define SLACK		100	/* msec of timer latency we tolerate */
+
+static unsigned int	failures;
+static unsigned int	checks;
+
+static struct timeval	epoch;
+
+typedef struct test_job {
+	ni_txsched_job_t	job;
+	unsigned int		runs;
+	long			started;	/* msec since epoch */
+} test_job_t;
+
+static long
+msec_since_epoch(void)
+{
+	struct timeval now, delta;
+
+	ni_timer_get_time(&now);
+	timersub(&now, &epoch, &delta);
+	return delta.tv_sec * 1000 + delta.tv_usec / 1000;
+}
+
+static void
+test_job_run(void *user_data)
+{
+	test_job_t *tj = user_data;
+
+	tj->runs++;
+	tj->started = msec_since_epoch();
+}
+
+static void
+check(ni_bool_t ok, const char *fmt, ...)
+{
+	va_list ap;
+
+	checks++;
+	if (ok)
+		return;
+
+	failures++;
+	printf("FAIL: ");
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+	printf("\n");
+}
+
+static void
+run_timers(void)
+{
+	long timeout;
+
+	while ((timeout = ni_timer_next_timeout()) >= 0)
+		usleep(timeout * 1000);
+}
+
+static ni_txsched_t *
+test_begin(test_job_t *jobs, unsigned int window, unsigned int rate, unsigned int burst)
+{
+	memset(jobs, 0, NJOBS * sizeof(*jobs));
+	ni_timer_get_time(&epoch);
+	return ni_txsched_new("test", window, rate, burst);
+}
+
+static void
+test_jitter(void)
+{
+	test_job_t jobs[NJOBS];
+	ni_txsched_t *sched;
+	unsigned int i;
+	long latest = 0;
+
+	sched = test_begin(jobs, 300, 0, 0);
+	for (i = 0; i < NJOBS; ++i)
+		ni_txsched_submit(sched, &jobs[i].job, "jitter", test_job_run, &jobs[i], NULL);
+	run_timers();
+
+	for (i = 0; i < NJOBS; ++i) {
+		check(jobs[i].runs == 1, "jitter: job %u ran %u times", i, jobs[i].runs);
+		check(jobs[i].started <= 300 + SLACK, "jitter: job %u started after %ld msec",
+				i, jobs[i].started);
+		if (latest < jobs[i].started)
+			latest = jobs[i].started;
+	}
+	check(latest > 0, "jitter: all jobs started at once");
+	check(ni_txsched_get_stats(sched)->limited == 0, "jitter: jobs rate limited");
+	ni_txsched_free(sched);
+}
+
+static void
+test_rate(void)
+{
+	test_job_t jobs[NJOBS];
+	const ni_txsched_stats_t *stats;
+	ni_txsched_t *sched;
+	unsigned int i, j, n;
+
+	/* 10 jobs at once, then one per 100 msec */
+	sched = test_begin(jobs, 0, 10, 10);
+	for (i = 0; i < NJOBS; ++i)
+		ni_txsched_submit(sched, &jobs[i].job, "rate", test_job_run, &jobs[i], NULL);
+	run_timers();
+
+	for (i = 0; i < NJOBS; ++i) {
+		check(jobs[i].runs == 1, "rate: job %u ran %u times", i, jobs[i].runs);
+
+		/* no more jobs in any interval than the bucket permits */
+		for (j = i, n = 0; j < NJOBS; ++j) {
+			if (jobs[j].started >= jobs[i].started)
+				n++;
+		}
+		check(n <= 10 + (msec_since_epoch() - jobs[i].started) * 10 / 1000 + 1,
+				"rate: %u jobs since %ld msec", n, jobs[i].started);
+	}
+	check(jobs[9].started <= SLACK, "rate: burst started after %ld msec",
+			jobs[9].started);
+	check(jobs[NJOBS - 1].started >= 1000 - SLACK,
+			"rate: last job started after %ld msec only",
+			jobs[NJOBS - 1].started);
+
+	stats = ni_txsched_get_stats(sched);
+	check(stats->queued == NJOBS && stats->sent == NJOBS,
+			"rate: %lu queued, %lu sent", stats->queued, stats->sent);
+	check(stats->limited >= NJOBS - 10 - 1, "rate: %lu rate limited", stats->limited);
+	check(stats->forced == 0, "rate: %lu started at deadline", stats->forced);
+	check(stats->pending == 0 && stats->max_pending == NJOBS,
+			"rate: %u pending, max %u", stats->pending, stats->max_pending);
+	ni_txsched_free(sched);
+}
+
+static void
+test_deadline(void)
+{
+	test_job_t jobs[NJOBS];
+	const ni_txsched_stats_t *stats;
+	struct timeval deadline;
+	ni_txsched_t *sched;
+	unsigned int i;
+
+	/* one job per second, but all of them due within 300 msec */
+	sched = test_begin(jobs, 0, 1, 1);
+	deadline = epoch;
+	deadline.tv_usec += 300000;
+	if (deadline.tv_usec >= 1000000) {
+		deadline.tv_sec++;
+		deadline.tv_usec -= 1000000;
+	}
+	for (i = 0; i < 5; ++i)
+		ni_txsched_submit(sched, &jobs[i].job, "deadline", test_job_run, &jobs[i], &deadline);
+	run_timers();
+
+	for (i = 0; i < 5; ++i) {
+		check(jobs[i].runs == 1, "deadline: job %u ran %u times", i, jobs[i].runs);
+		check(jobs[i].started <= 300 + SLACK, "deadline: job %u started after %ld msec",
+				i, jobs[i].started);
+	}
+	stats = ni_txsched_get_stats(sched);
+	check(stats->forced >= 3, "deadline: %lu started at deadline", stats->forced);
+	ni_txsched_free(sched);
+}
+
+static void
+test_cancel(void)
+{
+	test_job_t jobs[NJOBS];
+	const ni_txsched_stats_t *stats;
+	ni_txsched_t *sched;
+	unsigned int i;
+
+	sched = test_begin(jobs, 100, 0, 0);
+	for (i = 0; i < 3; ++i)
+		ni_txsched_submit(sched, &jobs[i].job, "cancel", test_job_run, &jobs[i], NULL);
+
+	/* resubmitting a queued job reschedules it */
+	ni_txsched_submit(sched, &jobs[2].job, "cancel", test_job_run, &jobs[2], NULL);
+	check(ni_txsched_cancel(&jobs[1].job), "cancel: queued job not cancelled");
+	check(!ni_txsched_job_pending(&jobs[1].job), "cancel: cancelled job still pending");
+	run_timers();
+
+	check(jobs[0].runs == 1, "cancel: job 0 ran %u times", jobs[0].runs);
+	check(jobs[1].runs == 0, "cancel: cancelled job ran %u times", jobs[1].runs);
+	check(jobs[2].runs == 1, "cancel: resubmitted job ran %u times", jobs[2].runs);
+	check(!ni_txsched_cancel(&jobs[0].job), "cancel: cancelled a finished job");
+
+	stats = ni_txsched_get_stats(sched);
+	check(stats->queued == 3 && stats->sent == 2 && stats->cancelled == 1,
+			"cancel: %lu queued, %lu sent, %lu cancelled",
+			stats->queued, stats->sent, stats->cancelled);
+	ni_txsched_free(sched);
+}
+
+int
+main(int argc, char **argv)
+{
+	srandom(1);
+
+	test_jitter();
+	test_rate();
+	test_deadline();
+	test_cancel();
+
+	printf("%u checks, %u failures\n", checks, failures);
+	return failures ? 1 : 0;
+}